@@ -16,9 +16,13 @@
 #include "scritedocument.h"
 #include "garbagecollector.h"
 
+#include <QSet>
+#include <QMutex>
+#include <QThread>
 #include <QFuture>
 #include <QJsonObject>
 #include <QTimerEvent>
+#include <QReadWriteLock>
 #include <QFutureWatcher>
 #include <QThreadStorage>
 #include <QtConcurrentRun>
@@ -27,6 +31,7 @@
 
 #include "3rdparty/sonnet/sonnet/src/core/speller.h"
 #include "3rdparty/sonnet/sonnet/src/core/loader_p.h"
+#include "3rdparty/sonnet/sonnet/src/core/spellerplugin_p.h"
 #include "3rdparty/sonnet/sonnet/src/core/textbreaks_p.h"
 #include "3rdparty/sonnet/sonnet/src/core/guesslanguage.h"
 
@@ -39,22 +44,29 @@ public:
 
     int timestamp = -1;
     QString text;
+    QStringList characterNames;
+    QStringList ignoreList;
+    int wordCacheRevision = 0;
     QList<TextFragment> misspelledFragments;
 };
 
 class EnglishLanguageSpeller : public Sonnet::Speller
 {
 public:
+    EnglishLanguageSpeller() : Sonnet::Speller(EnglishLanguageSpeller::language()) { }
+    ~EnglishLanguageSpeller() { }
+
+    static QString language() {
 #ifdef Q_OS_MAC
-    EnglishLanguageSpeller() : Sonnet::Speller("en") { }
+        return QStringLiteral("en");
 #else
 #ifdef Q_OS_WIN
-    EnglishLanguageSpeller() : Sonnet::Speller() { }
+        return QString();
 #else
-    EnglishLanguageSpeller() : Sonnet::Speller("en_US") { }
+        return QStringLiteral("en_US");
 #endif
 #endif
-    ~EnglishLanguageSpeller() { }
+    }
 };
 
 struct SpellCheckServiceRequest
@@ -63,18 +75,196 @@ struct SpellCheckServiceRequest
     int timestamp;
     QStringList characterNames;
     QStringList ignoreList;
+
+    // Result of the previous request on the same SpellCheckService, if any.
+    QString previousText;
+    QStringList previousCharacterNames;
+    QStringList previousIgnoreList;
+    int previousWordCacheRevision = -1;
+    QList<TextFragment> previousFragments;
 };
 
+/**
+ * Spell-check results are cached per word and shared by all SpellCheckService
+ * instances in the process. A word is looked up in hunspell only the first time
+ * it is seen; after that whether it is misspelled comes from the cache. Suggestions
+ * are the most expensive thing to ask hunspell for, so they are looked up only when
+ * somebody asks for them and are cached along with the word.
+ */
+class SpellCheckWordCache
+{
+public:
+    static SpellCheckWordCache *instance();
+
+    enum { MaxWords = 100000 };
+
+    // Changes whenever a word is added to the personal dictionary, because results
+    // computed before that may have flagged the word as misspelled.
+    int revision() const { return m_revision.loadAcquire(); }
+
+    bool isMisspelled(const QString &word, bool *known) const;
+    void setMisspelled(const QString &word, bool val);
+    void addToDictionary(const QString &word);
+
+    bool suggestions(const QString &word, QStringList *suggestions) const;
+    void setSuggestions(const QString &word, const QStringList &suggestions);
+
+private:
+    void makeRoomFor(const QString &word);
+
+private:
+    struct Word
+    {
+        bool misspelled = false;
+        bool hasSuggestions = false;
+        QStringList suggestions;
+    };
+    QAtomicInt m_revision;
+    mutable QReadWriteLock m_lock;
+    QHash<QString,Word> m_words;
+
+    // Spellers on sweep threads don't know about words added to the personal
+    // dictionary after they were created. So these words are never evicted.
+    QSet<QString> m_dictionaryWords;
+};
+
+Q_GLOBAL_STATIC(SpellCheckWordCache, GlobalSpellCheckWordCache)
+
+SpellCheckWordCache *SpellCheckWordCache::instance()
+{
+    return GlobalSpellCheckWordCache();
+}
+
+bool SpellCheckWordCache::isMisspelled(const QString &word, bool *known) const
+{
+    QReadLocker locker(&m_lock);
+    const auto it = m_words.constFind(word);
+    *known = it != m_words.constEnd();
+    return *known ? it->misspelled : false;
+}
+
+void SpellCheckWordCache::setMisspelled(const QString &word, bool val)
+{
+    QWriteLocker locker(&m_lock);
+
+    // A speller may have checked the word before it was added to the personal
+    // dictionary. Such a stale result must not overwrite the dictionary entry.
+    if(val && m_dictionaryWords.contains(word))
+        return;
+
+    this->makeRoomFor(word);
+
+    Word &entry = m_words[word];
+    if(entry.misspelled != val)
+    {
+        entry.hasSuggestions = false;
+        entry.suggestions.clear();
+    }
+    entry.misspelled = val;
+}
+
+void SpellCheckWordCache::addToDictionary(const QString &word)
+{
+    QWriteLocker locker(&m_lock);
+    this->makeRoomFor(word);
+
+    Word &entry = m_words[word];
+    entry.misspelled = false;
+    entry.hasSuggestions = false;
+    entry.suggestions.clear();
+
+    m_dictionaryWords += word;
+    m_revision.ref();
+}
+
+bool SpellCheckWordCache::suggestions(const QString &word, QStringList *suggestions) const
+{
+    QReadLocker locker(&m_lock);
+    const auto it = m_words.constFind(word);
+    if(it == m_words.constEnd() || !it->hasSuggestions)
+        return false;
+
+    *suggestions = it->suggestions;
+    return true;
+}
+
+void SpellCheckWordCache::setSuggestions(const QString &word, const QStringList &suggestions)
+{
+    QWriteLocker locker(&m_lock);
+    if(m_dictionaryWords.contains(word))
+        return;
+
+    this->makeRoomFor(word);
+
+    Word &entry = m_words[word];
+    entry.misspelled = true;
+    entry.hasSuggestions = true;
+    entry.suggestions = suggestions;
+}
+
+void SpellCheckWordCache::makeRoomFor(const QString &word)
+{
+    if(m_words.size() < MaxWords || m_words.contains(word))
+        return;
+
+    m_words.clear();
+    Q_FOREACH(QString dictionaryWord, m_dictionaryWords)
+        m_words[dictionaryWord] = Word();
+}
+
+static EnglishLanguageSpeller &ThreadSpeller()
+{
+    // Creating a speller looks up the dictionary in Sonnet's loader, so we
+    // create one per thread and reuse it across requests.
+    static QThreadStorage<EnglishLanguageSpeller*> spellers;
+    if(!spellers.hasLocalData())
+        spellers.setLocalData(new EnglishLanguageSpeller);
+    return *spellers.localData();
+}
+
+static Sonnet::SpellerPlugin *SweepSpeller()
+{
+    // Spellers handed out by Sonnet::Speller share one dictionary instance, which
+    // cannot be used from more than one thread at a time. Sweep threads therefore
+    // create dictionary instances of their own.
+    static QMutex spellersLock;
+    static QThreadStorage<Sonnet::SpellerPlugin*> spellers;
+    if(!spellers.hasLocalData())
+    {
+        QMutexLocker locker(&spellersLock);
+        Sonnet::Loader *loader = Sonnet::Loader::openLoader();
+        spellers.setLocalData(loader ? loader->createSpeller(EnglishLanguageSpeller::language()) : nullptr);
+    }
+    return spellers.localData();
+}
+
+template <class Speller>
+static bool IsMisspelled(Speller &speller, const QString &word)
+{
+    bool known = false;
+    const bool misspelled = SpellCheckWordCache::instance()->isMisspelled(word, &known);
+    if(known)
+        return misspelled;
+
+    const bool ret = speller.isMisspelled(word);
+    SpellCheckWordCache::instance()->setMisspelled(word, ret);
+    return ret;
+}
+
 void InitializeSpellCheckThread()
 {
     Sonnet::Loader::openLoader();
 }
 
-SpellCheckServiceResult CheckSpellings(const SpellCheckServiceRequest &request)
+template <class Speller>
+SpellCheckServiceResult CheckSpellingsUsing(Speller &speller, const SpellCheckServiceRequest &request)
 {
     SpellCheckServiceResult result;
     result.timestamp = request.timestamp;
     result.text = request.text;
+    result.characterNames = request.characterNames;
+    result.ignoreList = request.ignoreList;
+    result.wordCacheRevision = SpellCheckWordCache::instance()->revision();
 
     if(request.text.isEmpty())
         return result; // Should never happen
@@ -99,20 +289,59 @@ SpellCheckServiceResult CheckSpellings(const SpellCheckServiceRequest &request)
      * Note and StructureElement also. This fits into the whole model-view thinking that
      * QML apps are required to leverage.
      *
-     * There is obviously room for improvement in this implementation. We could cache
-     * spell-check done in the previous round and only check for delta changes in here.
-     * But for now, we simply take a brute-force approach. But this function could be a
-     * good place for us to accept community contribution.
+     * Words are looked up in SpellCheckWordCache before asking hunspell. On top of that,
+     * words that lie in the part of the text that did not change since the previous
+     * request simply carry over their previous result. Only words in the edited span
+     * are checked again.
      */
 
     const Sonnet::TextBreaks::Positions wordPositions = Sonnet::TextBreaks::wordBreaks(request.text);
     if(wordPositions.isEmpty() || Sonnet::Loader::openLoader() == nullptr)
         return result;
 
-    EnglishLanguageSpeller speller;
+    // Figure out the unchanged head and tail of the text. Previous results are
+    // valid in there only if the lists of words to skip are the same as before.
+    const QString &text = request.text;
+    const QString &previousText = request.previousText;
+    int head = 0, tail = 0;
+    QHash<int,int> previousFragments; // start -> length
+    if(!previousText.isEmpty() &&
+       request.previousWordCacheRevision == result.wordCacheRevision &&
+       request.previousIgnoreList == request.ignoreList &&
+       request.previousCharacterNames == request.characterNames)
+    {
+        const int length = qMin(text.length(), previousText.length());
+        while(head < length && text.at(head) == previousText.at(head))
+            ++head;
+        while(tail < length-head && text.at(text.length()-tail-1) == previousText.at(previousText.length()-tail-1))
+            ++tail;
+
+        Q_FOREACH(TextFragment fragment, request.previousFragments)
+            previousFragments.insert(fragment.start(), fragment.length());
+    }
+    const int tailStart = text.length() - tail;
+    const int tailShift = previousText.length() - text.length();
+
     Q_FOREACH(Sonnet::TextBreaks::Position wordPosition, wordPositions)
     {
-        const QString word = request.text.mid(wordPosition.start, wordPosition.length);
+        // A word, along with the character after it, completely within the unchanged
+        // head; or along with the character before it within the unchanged tail.
+        const int wordEnd = wordPosition.start + wordPosition.length;
+        if(wordEnd < head)
+        {
+            if(previousFragments.value(wordPosition.start, -1) == wordPosition.length)
+                result.misspelledFragments << TextFragment(wordPosition.start, wordPosition.length);
+            continue;
+        }
+
+        if(wordPosition.start > tailStart)
+        {
+            if(previousFragments.value(wordPosition.start+tailShift, -1) == wordPosition.length)
+                result.misspelledFragments << TextFragment(wordPosition.start, wordPosition.length);
+            continue;
+        }
+
+        const QString word = text.mid(wordPosition.start, wordPosition.length);
         if(word.isEmpty())
             continue; // not sure why this would happen, but just keeping safe.
 
@@ -130,7 +359,7 @@ SpellCheckServiceResult CheckSpellings(const SpellCheckServiceRequest &request)
             break;
         }
 
-        const bool misspelled = speller.isMisspelled(word);
+        const bool misspelled = IsMisspelled(speller, word);
         if(misspelled)
         {
             if(request.ignoreList.contains(word))
@@ -145,7 +374,7 @@ SpellCheckServiceResult CheckSpellings(const SpellCheckServiceRequest &request)
                     continue;
             }
 
-            TextFragment fragment(wordPosition.start, wordPosition.length, speller.suggest(word));
+            TextFragment fragment(wordPosition.start, wordPosition.length);
             if(fragment.isValid())
                 result.misspelledFragments << fragment;
         }
@@ -154,13 +383,46 @@ SpellCheckServiceResult CheckSpellings(const SpellCheckServiceRequest &request)
     return result;
 }
 
+SpellCheckServiceResult CheckSpellings(const SpellCheckServiceRequest &request)
+{
+    return CheckSpellingsUsing(ThreadSpeller(), request);
+}
+
+QList<SpellCheckServiceResult> SweepSpellings(const QList<SpellCheckServiceRequest> &requests, const QSharedPointer<QAtomicInt> &cancelled)
+{
+    QList<SpellCheckServiceResult> results;
+
+#ifdef Q_OS_MAC
+    // NSSpellChecker is shared by the whole process, so sweeps run on the
+    // spell-check thread and use its speller.
+    EnglishLanguageSpeller &speller = ThreadSpeller();
+#else
+    Sonnet::SpellerPlugin *plugin = SweepSpeller();
+    if(plugin == nullptr)
+        return results;
+    Sonnet::SpellerPlugin &speller = *plugin;
+#endif
+
+    Q_FOREACH(SpellCheckServiceRequest request, requests)
+    {
+        if(cancelled->loadAcquire())
+            break;
+
+        results << CheckSpellingsUsing(speller, request);
+    }
+
+    return results;
+}
+
 bool AddToDictionary(const QString &word)
 {
     /**
      * It is assumed that word contains a single word. We won't bother checking for that.
      */
-    EnglishLanguageSpeller speller;
-    return speller.addToPersonal(word);
+    const bool ret = ThreadSpeller().addToPersonal(word);
+    if(ret)
+        SpellCheckWordCache::instance()->addToDictionary(word);
+    return ret;
 }
 
 QStringList GetSpellingSuggestions(const QString &word)
@@ -168,8 +430,13 @@ QStringList GetSpellingSuggestions(const QString &word)
     /**
      * It is assumed that word contains a single word. We won't bother checking for that.
      */
-    EnglishLanguageSpeller speller;
-    return speller.suggest(word);
+    QStringList ret;
+    if(SpellCheckWordCache::instance()->suggestions(word, &ret))
+        return ret;
+
+    ret = ThreadSpeller().suggest(word);
+    SpellCheckWordCache::instance()->setSuggestions(word, ret);
+    return ret;
 }
 
 static QThreadPool &SpellCheckServiceThreadPool()
@@ -205,6 +472,29 @@ static QThreadPool &SpellCheckServiceThreadPool()
     return threadPool;
 }
 
+static QThreadPool &SpellCheckSweepThreadPool()
+{
+    /**
+     * SpellCheckSweep checks spellings of scenes in parallel on this pool, each thread
+     * with a speller of its own. It is kept separate from SpellCheckServiceThreadPool()
+     * so that spell-check requests from the editor are not stuck behind a sweep.
+     */
+#ifdef Q_OS_MAC
+    return SpellCheckServiceThreadPool();
+#else
+    static bool initialized = false;
+    static QThreadPool threadPool;
+    if(!initialized)
+    {
+        SpellCheckServiceThreadPool(); // make sure that the loader is initialized
+        threadPool.setMaxThreadCount(qMax(QThread::idealThreadCount()-1, 1));
+        initialized = true;
+    }
+
+    return threadPool;
+#endif
+}
+
 SpellCheckService::SpellCheckService(QObject *parent)
     : QObject(parent),
       m_textTracker(&m_textModifiable)
@@ -271,13 +561,8 @@ void SpellCheckService::update()
 
     emit started();
 
-    SpellCheckServiceRequest request;
-    request.text = m_text;
-    request.timestamp = m_textModifiable.modificationTime();
-    request.characterNames = ScriteDocument::instance()->structure()->characterNames();
-    request.ignoreList = ScriteDocument::instance()->spellCheckIgnoreList();
-
-    request.characterNames << QStringLiteral("Rajkumar");
+    const SpellCheckServiceRequest request = this->createRequest(ScriteDocument::instance()->structure()->characterNames(),
+                                                                 ScriteDocument::instance()->spellCheckIgnoreList());
 
     QFutureWatcher<SpellCheckServiceResult> *watcher = new QFutureWatcher<SpellCheckServiceResult>(this);
     connect(watcher, SIGNAL(finished()), this, SLOT(spellCheckComplete()), Qt::QueuedConnection);
@@ -289,12 +574,36 @@ void SpellCheckService::update()
 
 QStringList SpellCheckService::suggestions(const QString &word)
 {
+    QStringList ret;
+    if(SpellCheckWordCache::instance()->suggestions(word, &ret))
+        return ret;
+
     QThreadPool &threadPool = SpellCheckServiceThreadPool();
     QFuture<QStringList> future = QtConcurrent::run(&threadPool, GetSpellingSuggestions, word);
     future.waitForFinished();
     return future.result();
 }
 
+void SpellCheckService::suggestionsAsync(const QString &word, QObject *receiver, const std::function<void (const QStringList &)> &callback)
+{
+    QStringList ret;
+    if(SpellCheckWordCache::instance()->suggestions(word, &ret))
+    {
+        callback(ret);
+        return;
+    }
+
+    QFutureWatcher<QStringList> *watcher = new QFutureWatcher<QStringList>(receiver);
+    QObject::connect(watcher, &QFutureWatcher<QStringList>::finished, receiver, [watcher,callback]() {
+        GarbageCollector::instance()->add(watcher);
+        callback(watcher->result());
+    }, Qt::QueuedConnection);
+
+    QThreadPool &threadPool = SpellCheckServiceThreadPool();
+    QFuture<QStringList> future = QtConcurrent::run(&threadPool, GetSpellingSuggestions, word);
+    watcher->setFuture(future);
+}
+
 bool SpellCheckService::addToDictionary(const QString &word)
 {
     QThreadPool &threadPool = SpellCheckServiceThreadPool();
@@ -313,6 +622,33 @@ void SpellCheckService::componentComplete()
     this->doUpdate();
 }
 
+SpellCheckServiceRequest SpellCheckService::createRequest(const QStringList &characterNames, const QStringList &ignoreList) const
+{
+    SpellCheckServiceRequest request;
+    request.text = m_text;
+    request.timestamp = m_textModifiable.modificationTime();
+    request.characterNames = characterNames;
+    request.ignoreList = ignoreList;
+
+    request.characterNames << QStringLiteral("Rajkumar");
+
+    request.previousText = m_checkedText;
+    request.previousIgnoreList = m_checkedIgnoreList;
+    request.previousCharacterNames = m_checkedCharacterNames;
+    request.previousFragments = m_checkedFragments;
+    request.previousWordCacheRevision = m_checkedWordCacheRevision;
+
+    return request;
+}
+
+void SpellCheckService::acceptSweepResult(const SpellCheckServiceResult &result)
+{
+    if(m_textModifiable.isModified(result.timestamp))
+        return;
+
+    this->acceptResult(result);
+}
+
 void SpellCheckService::setMisspelledFragments(const QList<TextFragment> &val)
 {
     if(m_misspelledFragments == val)
@@ -372,6 +708,120 @@ void SpellCheckService::spellCheckComplete()
 
 void SpellCheckService::acceptResult(const SpellCheckServiceResult &result)
 {
+    m_checkedText = result.text;
+    m_checkedIgnoreList = result.ignoreList;
+    m_checkedCharacterNames = result.characterNames;
+    m_checkedFragments = result.misspelledFragments;
+    m_checkedWordCacheRevision = result.wordCacheRevision;
+
     this->setMisspelledFragments(result.misspelledFragments);
     emit finished();
 }
+
+///////////////////////////////////////////////////////////////////////////////
+
+SpellCheckSweep::SpellCheckSweep(QObject *parent)
+    : QObject(parent)
+{
+    m_progress->setProgressText("Checking spellings ...");
+}
+
+SpellCheckSweep::~SpellCheckSweep()
+{
+    if(!m_cancelled.isNull())
+        m_cancelled->storeRelease(1);
+}
+
+void SpellCheckSweep::start()
+{
+    if(this->isRunning())
+        return;
+
+    Structure *structure = ScriteDocument::instance()->structure();
+    const QStringList characterNames = structure->characterNames();
+    const QStringList ignoreList = ScriteDocument::instance()->spellCheckIgnoreList();
+
+    m_cancelled.reset(new QAtomicInt(0));
+    const QSharedPointer<QAtomicInt> cancelled = m_cancelled;
+    QThreadPool &threadPool = SpellCheckSweepThreadPool();
+
+    // Each scene is one unit of work. The pool spreads them across its threads.
+    int sceneCount = 0;
+    for(int i=0; i<structure->elementCount(); i++)
+    {
+        Scene *scene = structure->elementAt(i)->scene();
+        if(scene == nullptr)
+            continue;
+
+        QList< QPointer<SceneElement> > paragraphs;
+        QList<SpellCheckServiceRequest> requests;
+        for(int j=0; j<scene->elementCount(); j++)
+        {
+            SceneElement *paragraph = scene->elementAt(j);
+            if(paragraph->text().isEmpty())
+                continue;
+
+            paragraphs << paragraph;
+            requests << paragraph->spellCheck()->createRequest(characterNames, ignoreList);
+        }
+
+        if(requests.isEmpty())
+            continue;
+
+        QFutureWatcher< QList<SpellCheckServiceResult> > *watcher = new QFutureWatcher< QList<SpellCheckServiceResult> >(this);
+        connect(watcher, &QFutureWatcherBase::finished, this, [=]() {
+            GarbageCollector::instance()->add(watcher);
+            if(cancelled->loadAcquire())
+                return;
+
+            const QList<SpellCheckServiceResult> results = watcher->result();
+            for(int k=0; k<results.size() && k<paragraphs.size(); k++)
+            {
+                SceneElement *paragraph = paragraphs.at(k);
+                if(paragraph != nullptr)
+                    paragraph->spellCheck()->acceptSweepResult(results.at(k));
+            }
+
+            m_progress->tick();
+            this->setPendingCount(m_pendingCount-1);
+        }, Qt::QueuedConnection);
+
+        QFuture< QList<SpellCheckServiceResult> > future = QtConcurrent::run(&threadPool, SweepSpellings, requests, cancelled);
+        watcher->setFuture(future);
+        ++sceneCount;
+    }
+
+    if(sceneCount == 0)
+        return;
+
+    m_progress->start();
+    m_progress->setProgressStepFromCount(sceneCount);
+    emit started();
+
+    this->setPendingCount(sceneCount);
+}
+
+void SpellCheckSweep::cancel()
+{
+    if(!this->isRunning())
+        return;
+
+    m_cancelled->storeRelease(1);
+    this->setPendingCount(0);
+}
+
+void SpellCheckSweep::setPendingCount(int val)
+{
+    const bool wasRunning = this->isRunning();
+    m_pendingCount = qMax(val, 0);
+    if(wasRunning == this->isRunning())
+        return;
+
+    emit runningChanged();
+
+    if(!this->isRunning())
+    {
+        m_progress->finish();
+        emit finished();
+    }
+}
@@ -16,19 +16,22 @@
 
 #include <QObject>
 #include <QJsonArray>
+#include <QSharedPointer>
 #include <QQmlParserStatus>
 
+#include <functional>
+
 #include "modifiable.h"
 #include "execlatertimer.h"
+#include "progressreport.h"
 
 struct TextFragment
 {
     TextFragment() {}
     TextFragment(const TextFragment &other)
-        : m_start(other.m_start), m_length(other.m_length),
-          m_suggestions(other.m_suggestions) { }
-    TextFragment(int s, int l, const QStringList &slist)
-        : m_start(s), m_length(l), m_suggestions(slist) { }
+        : m_start(other.m_start), m_length(other.m_length) { }
+    TextFragment(int s, int l)
+        : m_start(s), m_length(l) { }
 
     int start() const { return m_start; }
     int length() const { return m_length; }
@@ -36,25 +39,22 @@ struct TextFragment
     bool isValid() { return m_length > 0 && m_start >= 0; }
     bool operator == (const TextFragment &other) const {
         return m_start == other.m_start &&
-               m_length == other.m_length &&
-               m_suggestions == other.m_suggestions;
+               m_length == other.m_length;
     }
     TextFragment & operator = (const TextFragment &other) {
         m_start = other.m_start;
         m_length = other.m_length;
-        m_suggestions = other.m_suggestions;
         return *this;
     }
-    QStringList suggestions() const { return m_suggestions; }
 
 private:
     int m_start = -1;
     int m_length = 0;
-    QStringList m_suggestions;
 };
 Q_DECLARE_METATYPE(TextFragment)
 
 class SpellCheckServiceResult;
+struct SpellCheckServiceRequest;
 class SpellCheckService : public QObject, public Modifiable, public QQmlParserStatus
 {
     Q_OBJECT
@@ -90,6 +90,10 @@ public:
     Q_INVOKABLE void update();
 
     static QStringList suggestions(const QString &word);
+
+    // Looks up suggestions in the background and calls back on the receiver's
+    // thread with them. Words whose suggestions are cached are answered right away.
+    static void suggestionsAsync(const QString &word, QObject *receiver, const std::function<void(const QStringList &)> &callback);
     static bool addToDictionary(const QString &word);
 
     // QQmlParserStatus interface
@@ -101,6 +105,10 @@ signals:
     void finished();
 
 private:
+    friend class SpellCheckSweep;
+    SpellCheckServiceRequest createRequest(const QStringList &characterNames, const QStringList &ignoreList) const;
+    void acceptSweepResult(const SpellCheckServiceResult &result);
+
     void setMisspelledFragments(const QList<TextFragment> &val);
     void doUpdate();
     void timerEvent(QTimerEvent *event);
@@ -117,6 +125,50 @@ private:
     ModificationTracker m_textTracker;
     QJsonArray m_misspelledFragmentsJson;
     QList<TextFragment> m_misspelledFragments;
+
+    // Text and word lists of the last accepted result, so that the next
+    // request only has to re-check words that changed since then.
+    QString m_checkedText;
+    QStringList m_checkedIgnoreList;
+    QStringList m_checkedCharacterNames;
+    QList<TextFragment> m_checkedFragments;
+    int m_checkedWordCacheRevision = -1;
+};
+
+/**
+ * Checks spellings of all paragraphs in all scenes of the current document. Scenes
+ * are spread across a pool of threads, each with its own speller. Results are handed
+ * over to the SpellCheckService of each SceneElement as they come in.
+ */
+class SpellCheckSweep : public QObject
+{
+    Q_OBJECT
+
+public:
+    SpellCheckSweep(QObject *parent=nullptr);
+    ~SpellCheckSweep();
+
+    Q_PROPERTY(ProgressReport* progress READ progress CONSTANT)
+    ProgressReport *progress() const { return m_progress; }
+
+    Q_PROPERTY(bool running READ isRunning NOTIFY runningChanged)
+    bool isRunning() const { return m_pendingCount > 0; }
+    Q_SIGNAL void runningChanged();
+
+    Q_INVOKABLE void start();
+    Q_INVOKABLE void cancel();
+
+signals:
+    void started();
+    void finished();
+
+private:
+    void setPendingCount(int val);
+
+private:
+    int m_pendingCount = 0;
+    QSharedPointer<QAtomicInt> m_cancelled;
+    ProgressReport *m_progress = new ProgressReport(this);
 };
 
 #endif // SPELL_CHECK_SERVICE_H
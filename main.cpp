@@ -281,6 +281,7 @@ int main(int argc, char **argv)
     qmlRegisterType<ScreenplayAdapter>(scriteModuleUri, 1, 0, "ScreenplayAdapter");
     qmlRegisterType<ScreenplayTextDocument>(scriteModuleUri, 1, 0, "ScreenplayTextDocument");
     qmlRegisterType<ScreenplayElementPageBreaks>(scriteModuleUri, 1, 0, "ScreenplayElementPageBreaks");
+    qmlRegisterUncreatableType<ScreenplayLengthIndex>(scriteModuleUri, 1, 0, "ScreenplayLengthIndex", reason);
     qmlRegisterType<ImagePrinter>(scriteModuleUri, 1, 0, "ImagePrinter");
     qmlRegisterType<TextDocumentItem>(scriteModuleUri, 1, 0, "TextDocumentItem");
     qmlRegisterType<ScreenplayTextDocumentOffsets>(scriteModuleUri, 1, 0, "ScreenplayTextDocumentOffsets");
@@ -289,6 +290,7 @@ int main(int argc, char **argv)
     qmlRegisterType<SimpleTabBarItem>(scriteModuleUri, 1, 0, "SimpleTabBarItem");
 
     qmlRegisterType<SpellCheckService>(scriteModuleUri, 1, 0, "SpellCheckService");
+    qmlRegisterType<SpellCheckSweep>(scriteModuleUri, 1, 0, "SpellCheckSweep");
 
     qmlRegisterType<BoundingBoxEvaluator>(scriteModuleUri, 1, 0, "BoundingBoxEvaluator");
     qmlRegisterType<BoundingBoxPreview>(scriteModuleUri, 1, 0, "BoundingBoxPreview");
@@ -184,17 +184,40 @@ Item {
                 anchors.fill: parent
                 busyMessage: "Exporting to \"" + exporter.fileName + "\" ..."
 
+                property bool cancelled: false
+
                 onVisibleChanged: {
                     if(visible) {
                         app.execLater(busyOverlay, 100, function() {
-                            if(exporter.write()) {
-                                app.revealFileOnDesktop(exporter.fileName)
-                                modalDialog.close()
-                            } else
-                                busyOverlay.visible = false
+                            exporter.writeLater()
                         })
                     }
                 }
+
+                Button2 {
+                    text: "Cancel"
+                    enabled: !busyOverlay.cancelled
+                    anchors.bottom: parent.bottom
+                    anchors.horizontalCenter: parent.horizontalCenter
+                    anchors.bottomMargin: 20
+                    onClicked: {
+                        busyOverlay.cancelled = true
+                        exporter.cancel()
+                    }
+                }
+            }
+
+            Connections {
+                target: exporter
+                onFinished: {
+                    if(success) {
+                        app.revealFileOnDesktop(exporter.fileName)
+                        modalDialog.close()
+                    } else if(busyOverlay.cancelled)
+                        modalDialog.close()
+                    else
+                        busyOverlay.visible = false
+                }
             }
         }
     }
@@ -2413,7 +2413,7 @@ Rectangle {
 
                                 SearchAgent.engine: searchBar.searchEngine
                                 SearchAgent.onSearchRequest: {
-                                    SearchAgent.searchResultCount = SearchAgent.indexesOf(string, otherCharacterName).length > 0 ? 1 : 0
+                                    SearchAgent.searchResultCount = scriteDocument.structure.searchCharacterNames(string, searchBar.searchEngine.searchFlags).indexOf(otherCharacterName) >= 0 ? 1 : 0
                                 }
                                 SearchAgent.onCurrentSearchResultIndexChanged: {
                                     highlight = SearchAgent.currentSearchResultIndex >= 0
@@ -837,6 +837,48 @@ Rectangle {
                 anchors.verticalCenter: parent.verticalCenter
                 opacity: screenplayTextDocument.paused ? 0.5 : 1
             }
+
+            Rectangle {
+                width: 1
+                height: parent.height
+                color: primaryColors.borderColor
+                visible: screenplayEditorSettings.enableSpellCheck
+            }
+
+            Image {
+                source: "../icons/action/done_all.png"
+                height: parent.height; width: height; mipmap: true
+                anchors.verticalCenter: parent.verticalCenter
+                visible: screenplayEditorSettings.enableSpellCheck
+                scale: spellCheckSweepMouseArea.containsMouse ? (spellCheckSweepMouseArea.pressed ? 1 : 1.5) : 1
+                Behavior on scale { NumberAnimation { duration: 250 } }
+
+                SpellCheckSweep {
+                    id: spellCheckSweep
+                }
+
+                MouseArea {
+                    id: spellCheckSweepMouseArea
+                    anchors.fill: parent
+                    hoverEnabled: true
+                    onClicked: {
+                        if(spellCheckSweep.running)
+                            spellCheckSweep.cancel()
+                        else
+                            spellCheckSweep.start()
+                    }
+                    ToolTip.visible: containsMouse && !pressed
+                    ToolTip.text: spellCheckSweep.running ? "Click here to stop checking spellings." : "Click here to check spellings in all scenes of the screenplay."
+                    ToolTip.delay: 1000
+                }
+            }
+
+            Text {
+                font.pixelSize: statusBar.height * 0.5
+                text: Math.round(spellCheckSweep.progress.progress*100) + "%"
+                anchors.verticalCenter: parent.verticalCenter
+                visible: screenplayEditorSettings.enableSpellCheck && spellCheckSweep.running
+            }
         }
 
         Item {
@@ -1669,9 +1711,12 @@ Rectangle {
 
                             menu: Menu2 {
                                 property int cursorPosition: -1
+                                property var spellingSuggestions: []
                                 onAboutToShow: {
+                                    spellingSuggestions = []
                                     cursorPosition = sceneTextEditor.cursorPosition
                                     sceneTextEditor.persistentSelection = true
+                                    sceneDocumentBinder.requestSpellingSuggestionsForWordAt(cursorPosition)
                                 }
                                 onAboutToHide: {
                                     sceneTextEditor.persistentSelection = false
@@ -1679,8 +1724,16 @@ Rectangle {
                                     sceneTextEditor.cursorPosition = cursorPosition
                                 }
 
+                                Connections {
+                                    target: sceneDocumentBinder
+                                    onSpellingSuggestionsForWordAtAvailable: {
+                                        if(position === cursorPosition)
+                                            spellingSuggestions = suggestions
+                                    }
+                                }
+
                                 Repeater {
-                                    model: sceneDocumentBinder.spellingSuggestions
+                                    model: spellingSuggestions
 
                                     MenuItem2 {
                                         text: modelData
@@ -42,8 +42,7 @@ Rectangle {
         app.execLater(screenplayTextDocument, 250, function() {
             previewItem.screenplay.currentElementIndex = 0
             screenplayTextDocument.screenplay = previewItem.screenplay
-            screenplayTextDocument.print(screenplayImagePrinter)
-            noticeText.visible = false
+            screenplayTextDocument.syncInBackground()
         })
     }
 
@@ -53,7 +52,14 @@ Rectangle {
         sceneNumbers: true
         purpose: ScreenplayTextDocument.ForPrinting
         secondsPerPage: formatting ? formatting.secondsPerPage : 60
-        syncEnabled: true
+        syncEnabled: false
+
+        // Pages are laid out in the background, so that the UI remains responsive
+        // while the preview is generated.
+        onPrintLayoutFinished: {
+            print(screenplayImagePrinter)
+            noticeText.visible = false
+        }
     }
 
     FontMetrics {
@@ -108,12 +108,15 @@ HEADERS += \
     src/document/transliteration.h \
     src/document/scritedocument.h \
     src/document/documentfilesystem.h \
+    src/document/documentbackupstore.h \
     src/document/structure.h \
     src/document/screenplaytextdocument.h \
     src/document/undoredo.h \
     src/document/screenplayadapter.h \
     src/document/screenplay.h \
+    src/document/screenplaysearchindex.h \
     src/document/scene.h \
+    src/document/paragraphlayoutcache.h \
     src/core/application.h \
     src/core/autoupdate.h \
     src/exporters/finaldraftexporter.h \
@@ -136,7 +139,10 @@ HEADERS += \
     src/reports/progressreport.h \
     src/reports/screenplaysubsetreport.h \
     src/reports/locationscreenplayreport.h \
-    src/utils/urlattributes.h
+    src/utils/urlattributes.h \
+    src/utils/binaryheader.h \
+    src/utils/textmatcher.h \
+    src/utils/textsearchindex.h
 
 SOURCES += \
     main.cpp \
@@ -212,14 +218,17 @@ SOURCES += \
     src/utils/qobjectserializer.cpp \
     src/document/scritedocument.cpp \
     src/document/screenplay.cpp \
+    src/document/screenplaysearchindex.cpp \
     src/document/scene.cpp \
     src/document/documentfilesystem.cpp \
+    src/document/documentbackupstore.cpp \
     src/document/structure.cpp \
     src/document/screenplaytextdocument.cpp \
     src/document/undoredo.cpp \
     src/document/transliteration.cpp \
     src/document/screenplayadapter.cpp \
     src/document/formatting.cpp \
+    src/document/paragraphlayoutcache.cpp \
     src/core/autoupdate.cpp \
     src/core/application.cpp \
     src/exporters/htmlexporter.cpp \
@@ -242,7 +251,9 @@ SOURCES += \
     src/reports/characterscreenplayreport.cpp \
     src/reports/progressreport.cpp \
     src/reports/locationscreenplayreport.cpp \
-    src/utils/urlattributes.cpp
+    src/utils/urlattributes.cpp \
+    src/utils/binaryheader.cpp \
+    src/utils/textmatcher.cpp
 
 RESOURCES += \
     scrite_bengali_font.qrc \
@@ -19,6 +19,7 @@
 #include "timeprofiler.h"
 #include "execlatertimer.h"
 #include "scritedocument.h"
+#include "paragraphlayoutcache.h"
 
 #include <QDir>
 #include <QUuid>
@@ -324,6 +325,18 @@ QJsonObject Application::systemFontInfo()
     return ret;
 }
 
+QJsonObject Application::paragraphLayoutCacheInfo()
+{
+    const ParagraphLayoutCache *cache = ParagraphLayoutCache::instance();
+
+    QJsonObject ret;
+    ret.insert("entryCount", cache->entryCount());
+    ret.insert("maxEntries", cache->maxEntries());
+    ret.insert("hitCount", cache->hitCount());
+    ret.insert("missCount", cache->missCount());
+    return ret;
+}
+
 QColor Application::pickColor(const QColor &initial) const
 {
     QColorDialog::ColorDialogOptions options =
@@ -163,6 +163,7 @@ public:
     static QFontDatabase &fontDatabase();
 
     Q_INVOKABLE static QJsonObject systemFontInfo();
+    Q_INVOKABLE static QJsonObject paragraphLayoutCacheInfo();
     Q_INVOKABLE QColor pickColor(const QColor &initial) const;
     Q_INVOKABLE QString colorName(const QColor &color) const { return color.name(); }
     Q_INVOKABLE QRectF textBoundingRect(const QString &text, const QFont &font) const;
@@ -149,12 +149,16 @@ void Attachment::setFilePath(const QString &val)
     if(m_filePath == val || !m_filePath.isEmpty())
         return;
 
+    // Files in the DFS are not extracted from the document here, that happens when
+    // the attachment is first opened.
     ScriteDocument *doc = ScriteDocument::instance()->instance();
     DocumentFileSystem *dfs = doc->fileSystem();
-    const QString path = QFile::exists(val) ? val : dfs->absolutePath(val);
-    QFileInfo fi(path);
-    if(!fi.exists() || !fi.isReadable())
-        return;
+    if(!dfs->exists(val))
+    {
+        QFileInfo fi(val);
+        if(!fi.exists() || !fi.isReadable())
+            return;
+    }
 
     m_filePath = val;
     emit filePathChanged();
@@ -206,10 +210,8 @@ void Attachment::deserializeFromJson(const QJsonObject &json)
     this->setMimeType( json.value( QStringLiteral("#mimeType") ).toString() );
     this->setOriginalFileName( json.value( QStringLiteral("#originalFileName") ).toString() );
 
-    ScriteDocument *doc = ScriteDocument::instance()->instance();
-    DocumentFileSystem *dfs = doc->fileSystem();
-    const QString path = dfs->absolutePath(m_filePath);
-    this->setType( Attachment::determineType(QFileInfo(path)) );
+    // Only the suffix is looked at, so the file need not be extracted for this.
+    this->setType( Attachment::determineType(QFileInfo(m_filePath)) );
 }
 
 Attachment::Type Attachment::determineType(const QFileInfo &fi)
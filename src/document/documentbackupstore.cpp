@@ -0,0 +1,418 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include "documentbackupstore.h"
+
+#include <QDir>
+#include <QSet>
+#include <QHash>
+#include <QtDebug>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QDirIterator>
+#include <QJsonDocument>
+#include <QTemporaryFile>
+#include <QCryptographicHash>
+
+#include "quazip.h"
+#include "quazipfile.h"
+
+static const QString blobsFolderName = QStringLiteral(".blobs");
+static const QString pendingRemovalsFileName = QStringLiteral("pending-removals");
+
+static QString blobsFolder(const QString &backupFileName)
+{
+    return QFileInfo(backupFileName).absolutePath() + QStringLiteral("/") + blobsFolderName;
+}
+
+static QString blobFilePath(const QString &blobsFolder, const QString &blob)
+{
+    return blobsFolder + QStringLiteral("/") + blob.left(2) + QStringLiteral("/") + blob;
+}
+
+static QJsonObject loadManifest(const QString &backupFileName)
+{
+    QFile file(backupFileName);
+    if( !file.open(QFile::ReadOnly) )
+        return QJsonObject();
+
+    const QJsonObject manifest = QJsonDocument::fromJson(file.readAll()).object();
+    if( manifest.value(QStringLiteral("format")).toString() != QStringLiteral("ScriteBackup") ||
+        manifest.value(QStringLiteral("version")).toInt() > DocumentBackupStore::Version )
+        return QJsonObject();
+
+    return manifest;
+}
+
+static QFileInfoList siblingBackups(const QString &backupFileName)
+{
+    const QFileInfo fi(backupFileName);
+    QFileInfoList ret = fi.absoluteDir().entryInfoList({QStringLiteral("*.") + DocumentBackupStore::fileSuffix()}, QDir::Files, QDir::Name);
+    for(int i=ret.size()-1; i>=0; i--)
+    {
+        if(ret.at(i).absoluteFilePath() == fi.absoluteFilePath())
+            ret.removeAt(i);
+    }
+    return ret;
+}
+
+QString DocumentBackupStore::fileSuffix()
+{
+    return QStringLiteral("scritebackup");
+}
+
+bool DocumentBackupStore::isBackup(const QString &fileName)
+{
+    return QFileInfo(fileName).suffix() == fileSuffix();
+}
+
+bool DocumentBackupStore::backup(const QString &documentFileName, const QString &backupFileName)
+{
+    const QFileInfo documentFileInfo(documentFileName);
+
+    QuaZip srcZip(documentFileInfo.absoluteFilePath());
+    srcZip.setUtf8Enabled(true);
+    if( !srcZip.open(QuaZip::mdUnzip) )
+        return false;
+
+    const QString blobs = blobsFolder(backupFileName);
+    if( !QDir().mkpath(blobs) )
+        return false;
+
+    // Entries whose CRC and sizes match those of an entry by the same name in
+    // the latest backup, are not read at all. We simply refer to the same blob.
+    QHash<QString,QJsonObject> previousEntries;
+    const QFileInfoList previousBackups = siblingBackups(backupFileName);
+    if(!previousBackups.isEmpty())
+    {
+        const QJsonArray entries = loadManifest(previousBackups.last().absoluteFilePath()).value(QStringLiteral("entries")).toArray();
+        for(const QJsonValue &item : entries)
+        {
+            const QJsonObject entry = item.toObject();
+            previousEntries.insert(entry.value(QStringLiteral("name")).toString(), entry);
+        }
+    }
+
+    bool success = true;
+    QJsonArray entries;
+    for(bool more = srcZip.goToFirstFile(); more && success; more = srcZip.goToNextFile())
+    {
+        QuaZipFileInfo64 info;
+        if( !srcZip.getCurrentFileInfo(&info) )
+        {
+            success = false;
+            break;
+        }
+
+        QJsonObject entry;
+        entry.insert(QStringLiteral("name"), info.name);
+        entry.insert(QStringLiteral("method"), int(info.method));
+        entry.insert(QStringLiteral("crc"), double(info.crc));
+        entry.insert(QStringLiteral("compressedSize"), double(info.compressedSize));
+        entry.insert(QStringLiteral("uncompressedSize"), double(info.uncompressedSize));
+        entry.insert(QStringLiteral("dateTime"), double(info.dateTime.toMSecsSinceEpoch()));
+        entry.insert(QStringLiteral("internalAttr"), int(info.internalAttr));
+        entry.insert(QStringLiteral("externalAttr"), double(info.externalAttr));
+
+        const QJsonObject previousEntry = previousEntries.value(info.name);
+        const QString previousBlob = previousEntry.value(QStringLiteral("blob")).toString();
+        if( !previousBlob.isEmpty() &&
+            previousEntry.value(QStringLiteral("method")) == entry.value(QStringLiteral("method")) &&
+            previousEntry.value(QStringLiteral("crc")) == entry.value(QStringLiteral("crc")) &&
+            previousEntry.value(QStringLiteral("compressedSize")) == entry.value(QStringLiteral("compressedSize")) &&
+            previousEntry.value(QStringLiteral("uncompressedSize")) == entry.value(QStringLiteral("uncompressedSize")) &&
+            QFile::exists(blobFilePath(blobs, previousBlob)) )
+        {
+            entry.insert(QStringLiteral("level"), previousEntry.value(QStringLiteral("level")));
+            entry.insert(QStringLiteral("blob"), previousBlob);
+            entries.append(entry);
+            continue;
+        }
+
+        int method = 0, level = 0;
+        QuaZipFile srcFile(&srcZip);
+        if( !srcFile.open(QFile::ReadOnly, &method, &level, true) )
+        {
+            qInfo("Could not open '%s' for reading.", qPrintable(info.name));
+            success = false;
+            break;
+        }
+
+        QTemporaryFile blobFile(blobs + QStringLiteral("/blob-XXXXXX"));
+        if( !blobFile.open() )
+        {
+            success = false;
+            break;
+        }
+
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        qint64 bytesCopied = 0;
+        const int bufferLength = 65535;
+        char buffer[bufferLength];
+        while(bytesCopied < qint64(info.compressedSize))
+        {
+            const qint64 nrBytes = srcFile.read(buffer, bufferLength);
+            if(nrBytes <= 0 || blobFile.write(buffer, nrBytes) != nrBytes)
+                break;
+            hash.addData(buffer, int(nrBytes));
+            bytesCopied += nrBytes;
+        }
+        srcFile.close();
+
+        if(bytesCopied != qint64(info.compressedSize))
+        {
+            qInfo("Could not copy '%s' into backup.", qPrintable(info.name));
+            success = false;
+            break;
+        }
+
+        const QString blob = QString::fromLatin1(hash.result().toHex());
+        const QString blobPath = blobFilePath(blobs, blob);
+        if( !QFile::exists(blobPath) )
+        {
+            QDir().mkpath(QFileInfo(blobPath).absolutePath());
+
+            // QTemporaryFile removes the file from its new path as well, unless told otherwise.
+            blobFile.setAutoRemove(false);
+            if( !blobFile.rename(blobPath) )
+            {
+                blobFile.setAutoRemove(true);
+                success = false;
+                break;
+            }
+        }
+
+        entry.insert(QStringLiteral("level"), level);
+        entry.insert(QStringLiteral("blob"), blob);
+        entries.append(entry);
+    }
+
+    const QString comment = srcZip.getComment();
+    srcZip.close();
+
+    if(!success)
+        return false;
+
+    // A manifest that refers to missing blobs cannot be restored. Report failure,
+    // so that the caller can fall back to copying the document as a whole.
+    for(const QJsonValue &item : qAsConst(entries))
+    {
+        const QString blob = item.toObject().value(QStringLiteral("blob")).toString();
+        if( !QFile::exists(blobFilePath(blobs, blob)) )
+        {
+            qInfo("Backup blob '%s' is missing.", qPrintable(blob));
+            return false;
+        }
+    }
+
+    QJsonObject manifest;
+    manifest.insert(QStringLiteral("format"), QStringLiteral("ScriteBackup"));
+    manifest.insert(QStringLiteral("version"), Version);
+    manifest.insert(QStringLiteral("document"), documentFileInfo.fileName());
+    manifest.insert(QStringLiteral("size"), double(documentFileInfo.size()));
+    manifest.insert(QStringLiteral("entries"), entries);
+    if(!comment.isEmpty())
+        manifest.insert(QStringLiteral("comment"), comment);
+
+    QSaveFile manifestFile(backupFileName);
+    if( !manifestFile.open(QFile::WriteOnly) )
+        return false;
+
+    manifestFile.write(QJsonDocument(manifest).toJson());
+    return manifestFile.commit();
+}
+
+bool DocumentBackupStore::restore(const QString &backupFileName, const QString &fileName)
+{
+    const QJsonObject manifest = loadManifest(backupFileName);
+    if(manifest.isEmpty())
+        return false;
+
+    const QString blobs = blobsFolder(backupFileName);
+
+    QuaZip dstZip(fileName);
+    dstZip.setUtf8Enabled(true);
+    if( !dstZip.open(QuaZip::mdCreate) )
+        return false;
+
+    bool success = true;
+    const QJsonArray entries = manifest.value(QStringLiteral("entries")).toArray();
+    for(const QJsonValue &item : entries)
+    {
+        const QJsonObject entry = item.toObject();
+
+        QuaZipFileInfo64 info;
+        info.name = entry.value(QStringLiteral("name")).toString();
+        info.method = quint16(entry.value(QStringLiteral("method")).toInt());
+        info.crc = quint32(entry.value(QStringLiteral("crc")).toDouble());
+        info.compressedSize = quint64(entry.value(QStringLiteral("compressedSize")).toDouble());
+        info.uncompressedSize = quint64(entry.value(QStringLiteral("uncompressedSize")).toDouble());
+        info.dateTime = QDateTime::fromMSecsSinceEpoch(qint64(entry.value(QStringLiteral("dateTime")).toDouble()));
+        info.internalAttr = quint16(entry.value(QStringLiteral("internalAttr")).toInt());
+        info.externalAttr = quint32(entry.value(QStringLiteral("externalAttr")).toDouble());
+        const int level = entry.value(QStringLiteral("level")).toInt();
+
+        QFile blobFile( blobFilePath(blobs, entry.value(QStringLiteral("blob")).toString()) );
+        if( !blobFile.open(QFile::ReadOnly) )
+        {
+            qInfo("Backup is missing contents of '%s'.", qPrintable(info.name));
+            success = false;
+            break;
+        }
+
+        QuaZipFile dstFile(&dstZip);
+        if( !dstFile.open(QFile::WriteOnly, QuaZipNewInfo(info), nullptr, info.crc, info.method, level, true) )
+        {
+            success = false;
+            break;
+        }
+
+        const int bufferLength = 65535;
+        char buffer[bufferLength];
+        while(success && !blobFile.atEnd())
+        {
+            const qint64 nrBytes = blobFile.read(buffer, bufferLength);
+            success = nrBytes >= 0 && dstFile.write(buffer, nrBytes) == nrBytes;
+        }
+
+        dstFile.close();
+        success &= dstFile.getZipError() == ZIP_OK;
+        if(!success)
+            break;
+    }
+
+    const QString comment = manifest.value(QStringLiteral("comment")).toString();
+    if(!comment.isEmpty())
+        dstZip.setComment(comment);
+
+    dstZip.close();
+    success &= dstZip.getZipError() == ZIP_OK;
+
+    if(!success)
+        QFile::remove(fileName);
+
+    return success;
+}
+
+QByteArray DocumentBackupStore::read(const QString &backupFileName, const QString &entryName)
+{
+    const QJsonObject manifest = loadManifest(backupFileName);
+    const QJsonArray entries = manifest.value(QStringLiteral("entries")).toArray();
+    for(const QJsonValue &item : entries)
+    {
+        const QJsonObject entry = item.toObject();
+        if(entry.value(QStringLiteral("name")).toString() != entryName)
+            continue;
+
+        QFile blobFile( blobFilePath(blobsFolder(backupFileName), entry.value(QStringLiteral("blob")).toString()) );
+        if( !blobFile.open(QFile::ReadOnly) )
+            return QByteArray();
+
+        const QByteArray blob = blobFile.readAll();
+        const int method = entry.value(QStringLiteral("method")).toInt();
+        if(method == 0)
+            return blob;
+
+        if(method != Z_DEFLATED)
+            return QByteArray();
+
+        const qint64 uncompressedSize = qint64(entry.value(QStringLiteral("uncompressedSize")).toDouble());
+        if(uncompressedSize <= 0 || uncompressedSize > INT_MAX)
+            return QByteArray();
+
+        QByteArray ret(int(uncompressedSize), Qt::Uninitialized);
+
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        if( inflateInit2(&stream, -MAX_WBITS) != Z_OK )
+            return QByteArray();
+
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(blob.constData()));
+        stream.avail_in = uInt(blob.size());
+        stream.next_out = reinterpret_cast<Bytef*>(ret.data());
+        stream.avail_out = uInt(ret.size());
+
+        const int result = inflate(&stream, Z_FINISH);
+        inflateEnd(&stream);
+
+        return result == Z_STREAM_END ? ret : QByteArray();
+    }
+
+    return QByteArray();
+}
+
+QJsonObject DocumentBackupStore::readMetaData(const QString &backupFileName)
+{
+    // Same as DocumentFileSystem::readMetaData(), the archive comment is kept in the manifest.
+    const QString comment = loadManifest(backupFileName).value(QStringLiteral("comment")).toString();
+    if(comment.isEmpty())
+        return QJsonObject();
+
+    return QJsonDocument::fromJson(comment.toLatin1()).object();
+}
+
+bool DocumentBackupStore::remove(const QString &backupFileName)
+{
+    if( !QFile::remove(backupFileName) )
+        return false;
+
+    // Looking for unreferenced blobs means reading every manifest in the folder.
+    // So we do that only once every few removals, rather than each time. The count
+    // is kept in the blobs folder, and is cleared out along with the garbage.
+    static const int maxPendingRemovals = 10;
+
+    const QString folder = blobsFolder(backupFileName);
+    QFile pendingFile(folder + QStringLiteral("/") + pendingRemovalsFileName);
+    int pendingRemovals = pendingFile.open(QFile::ReadOnly) ? pendingFile.readAll().trimmed().toInt() : 0;
+    pendingFile.close();
+
+    if(++pendingRemovals < maxPendingRemovals)
+    {
+        if( pendingFile.open(QFile::WriteOnly) )
+            pendingFile.write( QByteArray::number(pendingRemovals) );
+        return true;
+    }
+
+    collectGarbage(backupFileName);
+    return true;
+}
+
+bool DocumentBackupStore::collectGarbage(const QString &backupFileName)
+{
+    QSet<QString> referencedBlobs;
+    const QFileInfoList backups = siblingBackups(backupFileName);
+    for(const QFileInfo &backup : backups)
+    {
+        // Blobs are left alone, if we can't be sure of what some backup refers to.
+        const QJsonObject manifest = loadManifest(backup.absoluteFilePath());
+        if(manifest.isEmpty())
+            return false;
+
+        const QJsonArray entries = manifest.value(QStringLiteral("entries")).toArray();
+        for(const QJsonValue &item : entries)
+            referencedBlobs += item.toObject().value(QStringLiteral("blob")).toString();
+    }
+
+    const QString folder = blobsFolder(backupFileName);
+    QDirIterator it(folder, QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext())
+    {
+        const QString blobPath = it.next();
+        if(!referencedBlobs.contains(it.fileName()))
+            QFile::remove(blobPath);
+    }
+
+    return true;
+}
@@ -0,0 +1,62 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef DOCUMENTBACKUPSTORE_H
+#define DOCUMENTBACKUPSTORE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QJsonObject>
+
+/**
+ * Backups of a document are kept in a content-addressed store, instead of as
+ * complete copies of the document. Each backup is a small JSON manifest that
+ * lists the entries of the document's ZIP archive along with the name of the
+ * blob holding each entry's compressed stream. Blobs are named after the SHA-1
+ * of their contents and live in a .blobs folder next to the manifests. So an
+ * entry is stored only once, no matter how many backups refer to it.
+ *
+ * Compressed streams are copied as they are, both while backing up and while
+ * restoring. Nothing is ever inflated or deflated, except when read() is asked
+ * for the contents of a single entry.
+ */
+class DocumentBackupStore
+{
+public:
+    enum { Version = 1 };
+
+    static QString fileSuffix();
+    static bool isBackup(const QString &fileName);
+
+    // Records a backup of documentFileName, which must be a ZIP based document.
+    // Entries that are already in the store are not copied again.
+    static bool backup(const QString &documentFileName, const QString &backupFileName);
+
+    // Reconstructs the document recorded in backupFileName into fileName.
+    static bool restore(const QString &backupFileName, const QString &fileName);
+
+    // Returns the uncompressed contents of one entry recorded in backupFileName.
+    static QByteArray read(const QString &backupFileName, const QString &entryName);
+
+    // Returns the DocumentFileSystem meta-data of the document recorded in backupFileName.
+    static QJsonObject readMetaData(const QString &backupFileName);
+
+    // Removes a backup. Blobs that no other backup refers to are removed by
+    // collectGarbage(), which remove() calls once every few removals.
+    static bool remove(const QString &backupFileName);
+
+    // Removes blobs that no backup in the folder of backupFileName refers to.
+    static bool collectGarbage(const QString &backupFileName);
+};
+
+#endif // DOCUMENTBACKUPSTORE_H
@@ -14,33 +14,181 @@
 #include "documentfilesystem.h"
 
 #include <QDir>
+#include <QSet>
+#include <QHash>
+#include <QQueue>
+#include <QFuture>
 #include <QtDebug>
 #include <QDateTime>
+#include <QSaveFile>
 #include <QDataStream>
+#include <QJsonDocument>
+#include <QThreadPool>
 #include <QTemporaryDir>
 #include <QStandardPaths>
+#include <QtConcurrentRun>
 
 #include "quazip.h"
 #include "quazipfile.h"
+#include "binaryheader.h"
 
 struct DocumentFileSystemData
 {
     QByteArray header;
+    QByteArray binaryHeader;
+    QJsonObject metaData;
     QList<DocumentFile*> files;
-    QScopedPointer<QTemporaryDir> folder;
+    QSharedPointer<QTemporaryDir> folder;
+
+    // Bookkeeping required for incremental saves. We remember the archive from
+    // which the folder was last extracted (or into which it was last saved), along
+    // with the size & timestamp of every entry as it was at that time. Entries that
+    // were not written to through the DFS API, and whose size & timestamp haven't
+    // changed since, can be copied raw from that archive while saving, without
+    // having to inflate and deflate them all over again.
+    struct EntryStamp
+    {
+        qint64 size = -1;
+        QDateTime lastModified;
+        bool operator == (const EntryStamp &other) const {
+            return size == other.size && lastModified == other.lastModified;
+        }
+    };
+    QString archiveFileName;
+    EntryStamp archiveStamp;
+    QSet<QString> dirtyEntries;
+
+    // Size & timestamp of the archive change whenever someone touches, copies or
+    // syncs it, even if its contents are the same. So when they don't match, we go
+    // by the CRC and sizes of its entries, as listed in its central directory.
+    struct ArchiveEntry
+    {
+        quint32 crc = 0;
+        qint64 compressedSize = -1;
+        qint64 uncompressedSize = -1;
+        bool operator == (const ArchiveEntry &other) const {
+            return crc == other.crc && compressedSize == other.compressedSize && uncompressedSize == other.uncompressedSize;
+        }
+    };
+    typedef QHash<QString,ArchiveEntry> ArchiveDirectory;
+    ArchiveDirectory archiveDirectory;
+    static ArchiveDirectory readArchiveDirectory(const QString &fileName);
+    QHash<QString,EntryStamp> entryStamps;
+
+    // Every change made to an entry through the DFS API bumps its generation. A save
+    // clears the dirty mark of an entry only if its generation is the same as when
+    // the entry was copied for saving, so changes made while saving are not lost.
+    QHash<QString,quint64> entryGenerations;
+    quint64 lastGeneration = 0;
+
+    // Entries of the archive that have not been extracted into the folder yet.
+    // They are extracted the first time someone asks for them, and copied raw
+    // from the archive while saving until then.
+    QSet<QString> lazyEntries;
+
+    // Lazy entries that could not be extracted, because the archive was changed by
+    // someone else. They are reported (and forgotten) by DocumentFileSystem.
+    QStringList lostEntries;
+
+    static EntryStamp stamp(const QFileInfo &fi) {
+        EntryStamp ret;
+        if(fi.exists()) {
+            ret.size = fi.size();
+            ret.lastModified = fi.lastModified();
+        }
+        return ret;
+    }
 
     void pack(QDataStream &ds, const QString &path);
 
-    QStringList filePaths() const {
+    QString entryName(const QString &absPath) const {
+        return QDir(folder->path()).relativeFilePath(absPath);
+    }
+    void markDirty(const QString &absPath) {
+        if(absPath.isEmpty())
+            return;
+        const QString name = this->entryName(absPath);
+        dirtyEntries += name;
+        entryGenerations.insert(name, ++lastGeneration);
+    }
+    void forgetEntry(const QString &absPath) {
+        const QString name = this->entryName(absPath);
+        dirtyEntries.remove(name);
+        entryStamps.remove(name);
+        lazyEntries.remove(name);
+        entryGenerations.insert(name, ++lastGeneration);
+    }
+    void resetArchive() {
+        archiveFileName.clear();
+        archiveStamp = EntryStamp();
+        archiveDirectory.clear();
+        dirtyEntries.clear();
+        entryStamps.clear();
+        lazyEntries.clear();
+        lostEntries.clear();
+        entryGenerations.clear();
+    }
+    void setArchive(const QString &fileName, const QStringList &entries, const QStringList &lazy) {
+        this->resetArchive();
+        archiveFileName = QFileInfo(fileName).absoluteFilePath();
+        archiveStamp = stamp(QFileInfo(archiveFileName));
+        archiveDirectory = readArchiveDirectory(archiveFileName);
+        for(const QString &entry : entries)
+            entryStamps.insert(entry, stamp(QFileInfo(folder->filePath(entry))));
+        lazyEntries = QSet<QString>::fromList(lazy);
+    }
+    bool isLazyEntry(const QString &path) const {
+        return !lazyEntries.isEmpty() && lazyEntries.contains(this->entryName(path));
+    }
+    void extractLazyEntry(const QString &path);
+    void verifyArchive();
+
+    QHash<QString,EntryStamp> cleanEntries() const;
+
+    QStringList folderEntries() const {
         QStringList ret;
         this->filePaths(ret, folder->path());
         return ret;
     }
+    QStringList filePaths() const {
+        QStringList ret = this->folderEntries();
+        for(const QString &entry : lazyEntries) {
+            if(!ret.contains(entry))
+                ret.append(entry);
+        }
+        return ret;
+    }
 
 private:
     void filePaths(QStringList &paths, const QString &dirPath) const;
 };
 
+struct DocumentFileSystemSaveTask
+{
+    // Captured by prepareSave(), on the thread that owns the DFS. Entries that have
+    // to be compressed are copied into the snapshot folder, so performSave() never
+    // reads from the DFS folder, which may change while the save is in progress.
+    QString fileName;
+    QString archiveFileName;
+    DocumentFileSystemData::EntryStamp archiveStamp;
+    DocumentFileSystemData::ArchiveDirectory archiveDirectory;
+    QSharedPointer<QTemporaryDir> folder;
+    QSharedPointer<QTemporaryDir> snapshot;
+    QHash<QString,DocumentFileSystemData::EntryStamp> cleanEntries;
+    QSet<QString> lazyEntries;
+    QHash<QString,quint64> snapshotGenerations;
+    QHash<QString,DocumentFileSystemData::EntryStamp> entryStamps;
+    QString comment;
+
+    // Filled by writeHeaders(), unless the headers are streamed into the snapshot
+    QByteArray header;
+    QByteArray binaryHeader;
+
+    // Filled by performSave(), on whichever thread it is called from
+    bool success = false;
+    DocumentFileSystemData::ArchiveDirectory savedDirectory;
+};
+
 void DocumentFileSystemData::pack(QDataStream &ds, const QString &path)
 {
     const QFileInfo fi(path);
@@ -86,6 +234,27 @@ void DocumentFileSystemData::pack(QDataStream &ds, const QString &path)
     }
 }
 
+QHash<QString,DocumentFileSystemData::EntryStamp> DocumentFileSystemData::cleanEntries() const
+{
+    QHash<QString,EntryStamp> ret;
+
+    // If the archive was modified by someone else after we last extracted from it or
+    // saved into it, then none of its entries can be trusted.
+    if(archiveFileName.isEmpty() || !(stamp(QFileInfo(archiveFileName)) == archiveStamp))
+        return ret;
+
+    auto it = entryStamps.constBegin();
+    auto end = entryStamps.constEnd();
+    while(it != end)
+    {
+        if(!dirtyEntries.contains(it.key()) && stamp(QFileInfo(folder->filePath(it.key()))) == it.value())
+            ret.insert(it.key(), it.value());
+        ++it;
+    }
+
+    return ret;
+}
+
 void DocumentFileSystemData::filePaths(QStringList &paths, const QString &dirPath) const
 {
     QDir fsDir(this->folder->path());
@@ -124,6 +293,9 @@ DocumentFileSystem::~DocumentFileSystem()
 void DocumentFileSystem::reset()
 {
     d->header.clear();
+    d->binaryHeader.clear();
+    d->metaData = QJsonObject();
+    d->resetArchive();
 
     while(!d->files.isEmpty())
     {
@@ -136,7 +308,7 @@ void DocumentFileSystem::reset()
     qDebug() << "PA: " << d->folder->path();
 }
 
-bool doUnzip(const QFileInfo &fileInfo, const QTemporaryDir &dstDir)
+bool doUnzip(const QFileInfo &fileInfo, const QTemporaryDir &dstDir, const QSet<QString> &entriesToExtract, QStringList *extractedEntries=nullptr, QStringList *otherEntries=nullptr)
 {
     const QString zipFileName = fileInfo.absoluteFilePath();
 
@@ -156,6 +328,15 @@ bool doUnzip(const QFileInfo &fileInfo, const QTemporaryDir &dstDir)
         if( !qzip.getCurrentFileInfo(&qfileInfo) )
             break;
 
+        // Only the entries asked for are extracted, the rest are merely listed.
+        if( !entriesToExtract.contains(qfileInfo.name) )
+        {
+            if(otherEntries)
+                otherEntries->append(qfileInfo.name);
+            qzip.goToNextFile();
+            continue;
+        }
+
         const QFileInfo dstFileInfo = dstDir.filePath(qfileInfo.name);
         const QString dstFileName = dstFileInfo.absoluteFilePath();
         QDir().mkpath(dstFileInfo.absolutePath());
@@ -189,6 +370,9 @@ bool doUnzip(const QFileInfo &fileInfo, const QTemporaryDir &dstDir)
         dstFile.close();
         srcFile.close();
         qzip.goToNextFile();
+
+        if(extractedEntries)
+            extractedEntries->append(qfileInfo.name);
     }
 
     qzip.close();
@@ -196,6 +380,116 @@ bool doUnzip(const QFileInfo &fileInfo, const QTemporaryDir &dstDir)
     return true;
 }
 
+void DocumentFileSystemData::extractLazyEntry(const QString &path)
+{
+    if(lazyEntries.isEmpty())
+        return;
+
+    const QString name = this->entryName(path);
+    if(!lazyEntries.contains(name))
+        return;
+
+    // If the archive was changed by someone else, this extracts whatever can still
+    // be extracted from it, including this entry.
+    this->verifyArchive();
+    if(!lazyEntries.contains(name))
+        return;
+
+    QStringList extractedEntries;
+    QSet<QString> entriesToExtract;
+    entriesToExtract += name;
+    if( !doUnzip(QFileInfo(archiveFileName), *folder, entriesToExtract, &extractedEntries) || extractedEntries.isEmpty() )
+    {
+        qInfo("Could not extract '%s' from %s", qPrintable(name), qPrintable(archiveFileName));
+        QFile::remove(folder->filePath(name));
+        return;
+    }
+
+    lazyEntries.remove(name);
+
+    // The extracted file is identical to the entry in the archive, so it can
+    // still be copied raw from there while saving.
+    entryStamps.insert(name, stamp(QFileInfo(folder->filePath(name))));
+}
+
+void DocumentFileSystemData::verifyArchive()
+{
+    if(archiveFileName.isEmpty())
+        return;
+
+    const EntryStamp currentStamp = stamp(QFileInfo(archiveFileName));
+    if(currentStamp == archiveStamp)
+        return;
+
+    const ArchiveDirectory currentDirectory = readArchiveDirectory(archiveFileName);
+    auto isIntact = [&](const QString &entry) {
+        const auto it = currentDirectory.constFind(entry);
+        const auto it2 = archiveDirectory.constFind(entry);
+        return it != currentDirectory.constEnd() && it2 != archiveDirectory.constEnd() && it.value() == it2.value();
+    };
+
+    // Only entries that are still the same can be copied raw from the archive.
+    QHash<QString,EntryStamp> intactEntryStamps;
+    for(auto it = entryStamps.constBegin(); it != entryStamps.constEnd(); ++it)
+    {
+        if(isIntact(it.key()))
+            intactEntryStamps.insert(it.key(), it.value());
+    }
+
+    // Lazy entries exist nowhere else. So we extract all of them right away, instead
+    // of depending on an archive that someone else is changing.
+    QSet<QString> entriesToExtract;
+    for(const QString &entry : qAsConst(lazyEntries))
+    {
+        if(isIntact(entry))
+            entriesToExtract += entry;
+    }
+
+    QStringList extractedEntries;
+    if(!entriesToExtract.isEmpty())
+        doUnzip(QFileInfo(archiveFileName), *folder, entriesToExtract, &extractedEntries);
+
+    for(const QString &entry : qAsConst(lazyEntries))
+    {
+        if(extractedEntries.contains(entry))
+            intactEntryStamps.insert(entry, stamp(QFileInfo(folder->filePath(entry))));
+        else
+        {
+            qInfo("Could not extract '%s', because %s was modified", qPrintable(entry), qPrintable(archiveFileName));
+            QFile::remove(folder->filePath(entry));
+            lostEntries << entry;
+        }
+    }
+
+    lazyEntries.clear();
+    entryStamps = intactEntryStamps;
+    archiveStamp = currentStamp;
+    archiveDirectory = currentDirectory;
+}
+
+DocumentFileSystemData::ArchiveDirectory DocumentFileSystemData::readArchiveDirectory(const QString &fileName)
+{
+    ArchiveDirectory ret;
+
+    QuaZip qzip(fileName);
+    qzip.setUtf8Enabled(true);
+    if( !qzip.open(QuaZip::mdUnzip) )
+        return ret;
+
+    const QList<QuaZipFileInfo64> infoList = qzip.getFileInfoList64();
+    for(const QuaZipFileInfo64 &info : infoList)
+    {
+        ArchiveEntry entry;
+        entry.crc = info.crc;
+        entry.compressedSize = qint64(info.compressedSize);
+        entry.uncompressedSize = qint64(info.uncompressedSize);
+        ret.insert(info.name, entry);
+    }
+
+    qzip.close();
+    return ret;
+}
+
 bool DocumentFileSystem::load(const QString &fileName, Format *format)
 {
     this->reset();
@@ -224,11 +518,23 @@ bool DocumentFileSystem::load(const QString &fileName, Format *format)
     // document as a ZIP file.
     file.close();
 
-    if( doUnzip( QFileInfo(fileName), *d->folder ) )
+    // Only the headers are extracted right away. Everything else (photos,
+    // attachments and so on) is extracted when it is first asked for.
+    QSet<QString> headerEntries;
+    headerEntries += QStringLiteral("_header.json");
+    headerEntries += BinaryHeader::fileName();
+
+    QStringList extractedEntries, lazyEntries;
+    if( doUnzip( QFileInfo(fileName), *d->folder, headerEntries, &extractedEntries, &lazyEntries ) )
     {
         const QString headerFileName = d->folder->filePath(QStringLiteral("_header.json"));
         QFile headerFile(headerFileName);
         d->header = headerFile.open(QFile::ReadOnly) ? headerFile.readAll() : QByteArray();
+
+        QFile binaryHeaderFile( d->folder->filePath(BinaryHeader::fileName()) );
+        d->binaryHeader = binaryHeaderFile.open(QFile::ReadOnly) ? binaryHeaderFile.readAll() : QByteArray();
+
+        d->setArchive(fileName, extractedEntries, lazyEntries);
         if(format)
             *format = ZipFormat;
     }
@@ -236,50 +542,263 @@ bool DocumentFileSystem::load(const QString &fileName, Format *format)
     return !d->header.isEmpty();
 }
 
-void doZipRecursively(const QDir &dir, const QDir &rootDir, QuaZip &qzip)
+enum RawCopyResult { RawCopyDone, RawCopyNotPossible, RawCopyFailed };
+
+RawCopyResult doCopyRawEntry(QuaZip &srcZip, const QString &entryName, QuaZip &dstZip)
+{
+    if( !srcZip.setCurrentFile(entryName, QuaZip::csSensitive) )
+        return RawCopyNotPossible;
+
+    QuaZipFileInfo64 entryInfo;
+    if( !srcZip.getCurrentFileInfo(&entryInfo) )
+        return RawCopyNotPossible;
+
+    int method = 0, level = 0;
+    QuaZipFile srcFile(&srcZip);
+    if( !srcFile.open(QFile::ReadOnly, &method, &level, true) )
+        return RawCopyNotPossible;
+
+    // Once we begin writing into the destination archive, there is no going back.
+    // Any failure from here on means that the archive being created is corrupt.
+    QuaZipFile dstFile(&dstZip);
+    if( !dstFile.open(QFile::WriteOnly, QuaZipNewInfo(entryInfo), nullptr, entryInfo.crc, method, level, true) )
+        return RawCopyFailed;
+
+    qint64 bytesCopied = 0;
+    const int bufferLength = 65535;
+    char buffer[bufferLength];
+    while(bytesCopied < qint64(entryInfo.compressedSize))
+    {
+        const qint64 nrBytes = srcFile.read(buffer, bufferLength);
+        if(nrBytes <= 0 || dstFile.write(buffer, nrBytes) != nrBytes)
+            break;
+        bytesCopied += nrBytes;
+    }
+
+    dstFile.close();
+    srcFile.close();
+
+    if(bytesCopied != qint64(entryInfo.compressedSize) || dstFile.getZipError() != UNZ_OK)
+        return RawCopyFailed;
+
+    return RawCopyDone;
+}
+
+typedef QHash<QString,DocumentFileSystemData::EntryStamp> EntryStamps;
+
+// Entries in formats that are compressed already gain nothing from being deflated
+// again, so they are stored as they are.
+bool isCompressedFormat(const QFileInfo &fileInfo)
+{
+    static const QSet<QString> suffixes = QSet<QString>()
+            << QStringLiteral("jpg") << QStringLiteral("jpeg") << QStringLiteral("png")
+            << QStringLiteral("gif") << QStringLiteral("webp") << QStringLiteral("mp4")
+            << QStringLiteral("m4v") << QStringLiteral("mov") << QStringLiteral("mp3")
+            << QStringLiteral("m4a") << QStringLiteral("pdf") << QStringLiteral("zip");
+    return suffixes.contains(fileInfo.suffix().toLower());
+}
+
+struct ZipEntry
+{
+    enum Action { CopyRaw, Store, Deflate, DeflateInParallel };
+
+    QString srcFilePath;
+    QString dstFilePath;
+    DocumentFileSystemData::EntryStamp stamp;
+    Action action = Deflate;
+};
+
+struct DeflatedEntry
+{
+    bool success = false;
+    QByteArray data;
+    quint32 crc = 0;
+    qint64 size = 0;
+};
+
+void collectZipEntries(const QDir &dir, const QDir &rootDir, QList<ZipEntry> &zipEntries)
 {
     const QFileInfoList entries = dir.entryInfoList(QDir::NoDotAndDotDot|QDir::Files|QDir::Dirs, QDir::Name|QDir::DirsLast);
     for(const QFileInfo &entry : entries)
     {
         if(entry.isDir())
         {
-            doZipRecursively(entry.absoluteFilePath(), rootDir, qzip);
+            collectZipEntries(entry.absoluteFilePath(), rootDir, zipEntries);
             continue;
         }
 
-        const QString srcFilePath = entry.absoluteFilePath();
-        const QString dstFilePath = rootDir.relativeFilePath(srcFilePath);
+        ZipEntry zipEntry;
+        zipEntry.srcFilePath = entry.absoluteFilePath();
+        zipEntry.dstFilePath = rootDir.relativeFilePath(zipEntry.srcFilePath);
+        zipEntry.stamp = DocumentFileSystemData::stamp(entry);
+        zipEntries.append(zipEntry);
+    }
+}
 
-        QFile srcFile(srcFilePath);
-        if( !srcFile.open(QFile::ReadOnly) )
-        {
-            qInfo("Could not open '%s' for reading.", qPrintable(srcFilePath));
-            continue;
-        }
+// Deflates a whole file in memory, into the raw form in which ZIP archives store
+// it. This is what runs on the thread-pool while saving, so it must not touch
+// anything other than the file it is given.
+DeflatedEntry doDeflateEntry(const QString &srcFilePath)
+{
+    DeflatedEntry ret;
 
-        QuaZipFile dstFile(&qzip);
-        if( !dstFile.open(QFile::WriteOnly, QuaZipNewInfo(dstFilePath,srcFilePath)) )
+    QFile srcFile(srcFilePath);
+    if( !srcFile.open(QFile::ReadOnly) )
+        return ret;
+
+    const QByteArray bytes = srcFile.readAll();
+    srcFile.close();
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if( deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK )
+        return ret;
+
+    ret.data.resize( int(deflateBound(&stream, uLong(bytes.size()))) );
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(bytes.constData()));
+    stream.avail_in = uInt(bytes.size());
+    stream.next_out = reinterpret_cast<Bytef*>(ret.data.data());
+    stream.avail_out = uInt(ret.data.size());
+
+    const int result = deflate(&stream, Z_FINISH);
+    ret.data.resize( int(stream.total_out) );
+    deflateEnd(&stream);
+
+    if(result != Z_STREAM_END)
+        return DeflatedEntry();
+
+    ret.crc = quint32( crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(bytes.constData()), uInt(bytes.size())) );
+    ret.size = bytes.size();
+    ret.success = true;
+    return ret;
+}
+
+bool doWriteDeflatedEntry(QuaZip &qzip, const ZipEntry &zipEntry, const DeflatedEntry &deflatedEntry)
+{
+    QuaZipNewInfo info(zipEntry.dstFilePath, zipEntry.srcFilePath);
+    info.uncompressedSize = ulong(deflatedEntry.size);
+
+    QuaZipFile dstFile(&qzip);
+    if( !dstFile.open(QFile::WriteOnly, info, nullptr, deflatedEntry.crc, Z_DEFLATED, Z_DEFAULT_COMPRESSION, true) )
+    {
+        qInfo("Could not open '%s' for writing.", qPrintable(zipEntry.srcFilePath));
+        return false;
+    }
+
+    const bool success = dstFile.write(deflatedEntry.data) == deflatedEntry.data.size();
+    dstFile.close();
+
+    return success && dstFile.getZipError() == ZIP_OK;
+}
+
+bool doWriteEntry(QuaZip &qzip, const ZipEntry &zipEntry, bool store)
+{
+    QFile srcFile(zipEntry.srcFilePath);
+    if( !srcFile.open(QFile::ReadOnly) )
+    {
+        qInfo("Could not open '%s' for reading.", qPrintable(zipEntry.srcFilePath));
+        return false;
+    }
+
+    QuaZipFile dstFile(&qzip);
+    const QuaZipNewInfo info(zipEntry.dstFilePath, zipEntry.srcFilePath);
+    const bool opened = store ? dstFile.open(QFile::WriteOnly, info, nullptr, 0, 0, 0) : dstFile.open(QFile::WriteOnly, info);
+    if( !opened )
+    {
+        qInfo("Could not open '%s' for writing.", qPrintable(zipEntry.srcFilePath));
+        return false;
+    }
+
+    bool success = true;
+    const int bufferLength = 65535;
+    char buffer[bufferLength];
+    while(success && !srcFile.atEnd())
+    {
+        const qint64 nrBytes = srcFile.read(buffer, bufferLength);
+        success = nrBytes >= 0 && dstFile.write(buffer, nrBytes) == nrBytes;
+    }
+
+    dstFile.close();
+    srcFile.close();
+
+    if(!success)
+        qInfo("Could not write '%s' into the archive.", qPrintable(zipEntry.srcFilePath));
+
+    return success && dstFile.getZipError() == ZIP_OK;
+}
+
+bool doZipEntries(const QList<ZipEntry> &zipEntries, QuaZip &qzip, QuaZip *srcZip)
+{
+    // Entries are deflated on a thread-pool, a few entries ahead of the one being
+    // written. Their deflated streams are then written raw, in the same order in
+    // which the entries were listed, so that archives come out the same way
+    // no matter how many threads did the work.
+    //
+    // Every entry in flight holds its file and its deflated stream in memory, so
+    // we go ahead only as far as the total size of entries in flight permits. The
+    // entry being written is always let in, however large it is.
+    QThreadPool threadPool;
+    static const qint64 maxInFlightBytes = 128*1024*1024;
+    qint64 inFlightBytes = 0;
+    QQueue< QFuture<DeflatedEntry> > deflateJobs;
+    int nextDeflateJob = 0;
+
+    bool success = true;
+    for(int i=0; i<zipEntries.size() && success; i++)
+    {
+        while(nextDeflateJob < zipEntries.size())
         {
-            qInfo("Could not open '%s' for writing.", qPrintable(srcFilePath));
-            continue;
+            const ZipEntry &zipEntry = zipEntries.at(nextDeflateJob);
+            if(zipEntry.action == ZipEntry::DeflateInParallel)
+            {
+                const qint64 size = qMax(zipEntry.stamp.size, qint64(0));
+                if(!deflateJobs.isEmpty() && inFlightBytes + size > maxInFlightBytes)
+                    break;
+
+                inFlightBytes += size;
+                deflateJobs.enqueue( QtConcurrent::run(&threadPool, doDeflateEntry, zipEntry.srcFilePath) );
+            }
+            ++nextDeflateJob;
         }
 
-        const int bufferLength = 65535;
-        char buffer[bufferLength];
-        while(!srcFile.atEnd())
+        const ZipEntry &zipEntry = zipEntries.at(i);
+        switch(zipEntry.action)
         {
-            const int nrBytes = srcFile.read(buffer, bufferLength);
-            dstFile.write(buffer, nrBytes);
-            if(nrBytes < bufferLength)
-                break;
+        case ZipEntry::CopyRaw:
+            // Entries that have not changed since the last save are copied over in their
+            // compressed form, straight from the previously saved archive. There is no
+            // copy of them anywhere else that we can safely read from.
+            if( doCopyRawEntry(*srcZip, zipEntry.dstFilePath, qzip) != RawCopyDone )
+            {
+                qInfo("Could not copy '%s' from previous save.", qPrintable(zipEntry.dstFilePath));
+                success = false;
+            }
+            break;
+        case ZipEntry::Store:
+            success = doWriteEntry(qzip, zipEntry, true);
+            break;
+        case ZipEntry::Deflate:
+            success = doWriteEntry(qzip, zipEntry, false);
+            break;
+        case ZipEntry::DeflateInParallel: {
+            const DeflatedEntry deflatedEntry = deflateJobs.dequeue().result();
+            inFlightBytes -= qMax(zipEntry.stamp.size, qint64(0));
+            if(deflatedEntry.success)
+                success = doWriteDeflatedEntry(qzip, zipEntry, deflatedEntry);
+            else
+                success = doWriteEntry(qzip, zipEntry, false);
+            } break;
         }
-
-        dstFile.close();
-        srcFile.close();
     }
+
+    // Let go of jobs that are no longer needed, because we failed midway.
+    threadPool.clear();
+    threadPool.waitForDone();
+
+    return success;
 }
 
-bool doZip(const QFileInfo &fileInfo, const QTemporaryDir &srcDir)
+bool doZip(const QFileInfo &fileInfo, const QTemporaryDir &srcDir, const QString &srcZipFileName=QString(), const EntryStamps &cleanEntries=EntryStamps(), const QSet<QString> &lazyEntries=QSet<QString>(), const QString &comment=QString())
 {
     const QString zipFileName = fileInfo.absoluteFilePath();
 
@@ -291,49 +810,208 @@ bool doZip(const QFileInfo &fileInfo, const QTemporaryDir &srcDir)
         return false;
     }
 
+    // Entries that are clean or were never extracted exist only in the source
+    // archive. We would rather fail than save a document without them.
+    QScopedPointer<QuaZip> srcZip;
+    if(!cleanEntries.isEmpty() || !lazyEntries.isEmpty())
+    {
+        srcZip.reset(new QuaZip(srcZipFileName));
+        srcZip->setUtf8Enabled(true);
+        if( srcZipFileName.isEmpty() || !srcZip->open(QuaZip::mdUnzip) )
+        {
+            qInfo("Could not open %s", qPrintable(srcZipFileName));
+            qzip.close();
+            return false;
+        }
+    }
+
     const QDir rootDir(srcDir.path());
 
-    doZipRecursively(rootDir, rootDir, qzip);
+    QList<ZipEntry> zipEntries;
+    collectZipEntries(rootDir, rootDir, zipEntries);
+
+    // Files small enough to be deflated in memory are deflated in parallel. Larger
+    // ones are streamed through QuaZip, like before.
+    static const qint64 maxParallelDeflateSize = 64*1024*1024;
+    // Headers hold the whole document, so they are always streamed.
+    for(ZipEntry &zipEntry : zipEntries)
+    {
+        if(zipEntry.dstFilePath == QStringLiteral("_header.json") || zipEntry.dstFilePath == BinaryHeader::fileName())
+            zipEntry.action = ZipEntry::Deflate;
+        else if(isCompressedFormat(QFileInfo(zipEntry.srcFilePath)))
+            zipEntry.action = ZipEntry::Store;
+        else if(zipEntry.stamp.size >= 0 && zipEntry.stamp.size <= maxParallelDeflateSize)
+            zipEntry.action = ZipEntry::DeflateInParallel;
+        else
+            zipEntry.action = ZipEntry::Deflate;
+    }
+
+    for(auto it = cleanEntries.constBegin(); it != cleanEntries.constEnd(); ++it)
+    {
+        ZipEntry zipEntry;
+        zipEntry.dstFilePath = it.key();
+        zipEntry.stamp = it.value();
+        zipEntry.action = ZipEntry::CopyRaw;
+        zipEntries.append(zipEntry);
+    }
+
+    std::sort(zipEntries.begin(), zipEntries.end(), [](const ZipEntry &a, const ZipEntry &b) {
+        return a.dstFilePath < b.dstFilePath;
+    });
+
+    bool success = doZipEntries(zipEntries, qzip, srcZip.data());
+
+    if(!comment.isEmpty())
+        qzip.setComment(comment);
+
+    for(const QString &lazyEntry : lazyEntries)
+    {
+        if(!success)
+            break;
+
+        // A lazy entry exists nowhere else, so it must be copied as is.
+        const RawCopyResult result = doCopyRawEntry(*srcZip, lazyEntry, qzip);
+        if(result == RawCopyNotPossible)
+            qInfo("Could not find '%s' in %s", qPrintable(lazyEntry), qPrintable(srcZipFileName));
+        success = result == RawCopyDone;
+    }
 
     qzip.close();
+    if(!srcZip.isNull())
+        srcZip->close();
 
-    return true;
+    return success && qzip.getZipError() == ZIP_OK;
 }
 
 bool DocumentFileSystem::save(const QString &fileName)
 {
-    if(fileName.isEmpty())
+    const QSharedPointer<DocumentFileSystemSaveTask> task = this->prepareSave(fileName);
+    if(task.isNull())
         return false;
 
+    if( DocumentFileSystem::writeHeaders(task, d->header, d->binaryHeader) )
+        DocumentFileSystem::performSave(task);
+    return this->finishSave(task);
+}
+
+QSharedPointer<DocumentFileSystemSaveTask> DocumentFileSystem::prepareSave(const QString &fileName)
+{
+    if(fileName.isEmpty())
+        return QSharedPointer<DocumentFileSystemSaveTask>();
+
     // Ensure that unwanted files are no longer in the DFS folder
     this->cleanup();
 
-#if 0
-    QFile file(fileName);
-    if( !file.open(QFile::WriteOnly) )
+    // If someone else changed the archive we loaded from, then entries that were not
+    // extracted yet are extracted now, so that this and future saves don't need it.
+    d->verifyArchive();
+    this->reportLostEntries();
+
+    QSharedPointer<DocumentFileSystemSaveTask> task(new DocumentFileSystemSaveTask);
+    task->fileName = fileName;
+    task->folder = d->folder;
+    task->snapshot.reset(new QTemporaryDir);
+    task->archiveFileName = d->archiveFileName;
+    task->archiveStamp = d->archiveStamp;
+    task->archiveDirectory = d->archiveDirectory;
+    task->lazyEntries = d->lazyEntries;
+    if(!d->metaData.isEmpty())
+        task->comment = QString::fromLatin1( QJsonDocument(d->metaData).toJson(QJsonDocument::Compact) );
+
+    if(!task->snapshot->isValid())
+        return QSharedPointer<DocumentFileSystemSaveTask>();
+
+    // Entries that haven't changed since the last save are copied raw from the
+    // archive we saved to (or loaded from) last. Everything else is copied into the
+    // snapshot, which is usually just a few entries that were edited since.
+    const EntryStamps cleanEntries = d->cleanEntries();
+    const QStringList entries = d->folderEntries();
+    for(const QString &entry : entries)
+    {
+        // Headers are written afresh by performSave()
+        if(entry == QStringLiteral("_header.json") || entry == BinaryHeader::fileName())
+            continue;
+
+        const QFileInfo fi( d->folder->filePath(entry) );
+        const DocumentFileSystemData::EntryStamp stamp = DocumentFileSystemData::stamp(fi);
+        task->entryStamps.insert(entry, stamp);
+
+        auto it = cleanEntries.constFind(entry);
+        if(it != cleanEntries.constEnd() && it.value() == stamp)
+        {
+            task->cleanEntries.insert(entry, stamp);
+            continue;
+        }
+
+        const QFileInfo snapshotFi( task->snapshot->filePath(entry) );
+        if( !QDir().mkpath(snapshotFi.absolutePath()) || !QFile::copy(fi.absoluteFilePath(), snapshotFi.absoluteFilePath()) )
+        {
+            qInfo("Could not copy '%s' for saving.", qPrintable(entry));
+            return QSharedPointer<DocumentFileSystemSaveTask>();
+        }
+
+        task->snapshotGenerations.insert(entry, d->entryGenerations.value(entry));
+    }
+
+    return task;
+}
+
+bool DocumentFileSystem::writeHeaders(const QSharedPointer<DocumentFileSystemSaveTask> &task, const QByteArray &header, const QByteArray &binaryHeader)
+{
+    if(task.isNull() || task->snapshot.isNull())
         return false;
 
-    file.write(*::DocumentFileSystemMaker);
+    task->header = header;
+    task->binaryHeader = binaryHeader;
 
-    QDataStream ds(&file);
-    if( !this->pack(ds) )
-    {
-        file.close();
-        QFile::remove(fileName);
+    QSaveFile headerFile( DocumentFileSystem::headerFilePath(task) );
+    if( !headerFile.open(QFile::WriteOnly) )
+        return false;
+
+    headerFile.write(header);
+    if( !headerFile.commit() )
         return false;
+
+    if(!binaryHeader.isEmpty())
+    {
+        QSaveFile binaryHeaderFile( DocumentFileSystem::binaryHeaderFilePath(task) );
+        if( !binaryHeaderFile.open(QFile::WriteOnly) )
+            return false;
+
+        binaryHeaderFile.write(binaryHeader);
+        if( !binaryHeaderFile.commit() )
+            return false;
     }
 
-    file.close();
     return true;
-#else
-    // Starting with 0.5.5 Scrite documents are basically ZIP files.
-    const QString headerFileName = d->folder->filePath(QStringLiteral("_header.json"));
-    QSaveFile headerFile(headerFileName);
-    if( !headerFile.open(QFile::WriteOnly) )
+}
+
+QString DocumentFileSystem::headerFilePath(const QSharedPointer<DocumentFileSystemSaveTask> &task)
+{
+    if(task.isNull() || task->snapshot.isNull())
+        return QString();
+
+    return task->snapshot->filePath(QStringLiteral("_header.json"));
+}
+
+QString DocumentFileSystem::binaryHeaderFilePath(const QSharedPointer<DocumentFileSystemSaveTask> &task)
+{
+    if(task.isNull() || task->snapshot.isNull())
+        return QString();
+
+    return task->snapshot->filePath(BinaryHeader::fileName());
+}
+
+bool DocumentFileSystem::performSave(const QSharedPointer<DocumentFileSystemSaveTask> &task)
+{
+    if(task.isNull() || task->snapshot.isNull())
         return false;
 
-    headerFile.write(d->header);
-    if( !headerFile.commit() )
+    task->success = false;
+
+    // Starting with 0.5.5 Scrite documents are basically ZIP files, with the
+    // document in _header.json.
+    if( QFileInfo(DocumentFileSystem::headerFilePath(task)).size() <= 0 )
         return false;
 
     const QString tmpFileName = QStandardPaths::writableLocation(QStandardPaths::TempLocation) +
@@ -341,24 +1019,116 @@ bool DocumentFileSystem::save(const QString &fileName)
                                  QStringLiteral("_temp.scrite");
 
     const QFileInfo fileInfo(tmpFileName);
-    bool success = doZip(fileInfo, *d->folder);
 
-    if(success && QFile::exists(tmpFileName) && QFileInfo(tmpFileName).size() > 0)
+    // Entries that were never extracted, and clean entries, are copied from the archive
+    // we loaded from. If it was changed by someone else after prepareSave(), then those
+    // entries must still be the same. Otherwise this save fails, and the next one
+    // extracts whatever it can from the archive before saving.
+    if( (!task->lazyEntries.isEmpty() || !task->cleanEntries.isEmpty()) &&
+        !(DocumentFileSystemData::stamp(QFileInfo(task->archiveFileName)) == task->archiveStamp) )
     {
-        if(QFile::exists(fileName))
-            success &= QFile::remove(fileName);
+        const DocumentFileSystemData::ArchiveDirectory currentDirectory = DocumentFileSystemData::readArchiveDirectory(task->archiveFileName);
+        QStringList entries = task->lazyEntries.toList();
+        entries += task->cleanEntries.keys();
+        for(const QString &entry : qAsConst(entries))
+        {
+            const auto it = currentDirectory.constFind(entry);
+            if(it == currentDirectory.constEnd() || !(it.value() == task->archiveDirectory.value(entry)))
+            {
+                qInfo("Could not save, because %s was modified", qPrintable(task->archiveFileName));
+                return false;
+            }
+        }
+    }
+
+    // Entries in the snapshot are compressed, clean entries and entries that were
+    // never extracted are copied raw from the archive we saved to (or loaded from)
+    // last. If any of that doesn't work out, the save fails.
+    bool success = doZip(fileInfo, *task->snapshot, task->archiveFileName, task->cleanEntries, task->lazyEntries, task->comment);
+
+    // QSaveFile flushes the new contents to disk and then atomically replaces
+    // the target file. So the previously saved file remains intact until the
+    // very end, even if we crash or fail midway.
+    success &= QFileInfo(tmpFileName).size() > 0;
+    if(success)
+    {
+        QFile srcFile(tmpFileName);
+        QSaveFile dstFile(task->fileName);
+        success = srcFile.open(QFile::ReadOnly) && dstFile.open(QFile::WriteOnly);
         if(success)
-            success &= QFile::copy(tmpFileName, fileName);
-        QFile::remove(tmpFileName);
+        {
+            const int bufferLength = 65535;
+            char buffer[bufferLength];
+            while(success && !srcFile.atEnd())
+            {
+                const qint64 nrBytes = srcFile.read(buffer, bufferLength);
+                success = nrBytes >= 0 && dstFile.write(buffer, nrBytes) == nrBytes;
+            }
+
+            success = success ? dstFile.commit() : false;
+        }
     }
 
+    QFile::remove(tmpFileName);
+
+    if(success)
+        task->savedDirectory = DocumentFileSystemData::readArchiveDirectory(task->fileName);
+
+    task->success = success;
     return success;
-#endif
+}
+
+bool DocumentFileSystem::finishSave(const QSharedPointer<DocumentFileSystemSaveTask> &task)
+{
+    if(task.isNull())
+        return false;
+
+    // If the DFS was reset while the save was happening, then there is nothing
+    // left to update here.
+    if(task->folder != d->folder)
+        return task->success;
+
+    d->header = task->header;
+    d->binaryHeader = task->binaryHeader;
+
+    if(task->success)
+    {
+        // Entries that were extracted while we were saving are identical to the
+        // ones copied raw into the new archive.
+        EntryStamps entryStamps = task->entryStamps;
+        for(const QString &entry : qAsConst(task->lazyEntries))
+        {
+            if(!d->lazyEntries.contains(entry) && d->entryStamps.contains(entry))
+                entryStamps.insert(entry, d->entryStamps.value(entry));
+        }
+
+        d->archiveFileName = QFileInfo(task->fileName).absoluteFilePath();
+        d->archiveStamp = DocumentFileSystemData::stamp(QFileInfo(d->archiveFileName));
+        d->archiveDirectory = task->savedDirectory;
+        d->entryStamps = entryStamps;
+
+        // Entries changed after they were copied into the snapshot remain dirty.
+        for(auto it = task->snapshotGenerations.constBegin(); it != task->snapshotGenerations.constEnd(); ++it)
+        {
+            if(d->entryGenerations.value(it.key()) == it.value())
+                d->dirtyEntries.remove(it.key());
+        }
+    }
+    else
+    {
+        // The previous archive may be why the save failed, so the next save
+        // doesn't count on copying anything raw from it.
+        d->entryStamps.clear();
+    }
+
+    return task->success;
 }
 
 void DocumentFileSystem::setHeader(const QByteArray &header)
 {
+    // A binary header, if any, would no longer match the new header.
     d->header = header;
+    d->binaryHeader.clear();
 }
 
 QByteArray DocumentFileSystem::header() const
@@ -366,6 +1136,42 @@ QByteArray DocumentFileSystem::header() const
     return d->header;
 }
 
+void DocumentFileSystem::setBinaryHeader(const QByteArray &header)
+{
+    d->binaryHeader = header;
+}
+
+QByteArray DocumentFileSystem::binaryHeader() const
+{
+    return d->binaryHeader;
+}
+
+void DocumentFileSystem::setMetaData(const QJsonObject &metaData)
+{
+    d->metaData = metaData;
+}
+
+QJsonObject DocumentFileSystem::metaData() const
+{
+    return d->metaData;
+}
+
+QJsonObject DocumentFileSystem::readMetaData(const QString &fileName)
+{
+    // Only the end of central directory record is looked at, to get to the comment.
+    QuaZip qzip(fileName);
+    if( !qzip.open(QuaZip::mdUnzip) )
+        return QJsonObject();
+
+    const QString comment = qzip.getComment();
+    qzip.close();
+
+    if(comment.isEmpty())
+        return QJsonObject();
+
+    return QJsonDocument::fromJson(comment.toLatin1()).object();
+}
+
 QFile *DocumentFileSystem::open(const QString &path, QFile::OpenMode mode)
 {
     if(path.isEmpty())
@@ -382,6 +1188,9 @@ QFile *DocumentFileSystem::open(const QString &path, QFile::OpenMode mode)
         return nullptr;
     }
 
+    if(mode & QIODevice::WriteOnly)
+        d->markDirty(completePath);
+
     return  file;
 }
 
@@ -412,14 +1221,27 @@ bool DocumentFileSystem::write(const QString &path, const QByteArray &bytes)
         return false;
 
     const QString completePath = this->absolutePath(path, true);
+
     DocumentFile file(completePath, this);
     if( !file.open(QFile::WriteOnly) )
         return false;
 
     file.write(bytes);
+    d->markDirty(completePath);
     return true;
 }
 
+QImage DocumentFileSystem::readImage(const QString &path)
+{
+    QImage ret;
+
+    const DocumentFileMapping mapping(this, path);
+    if(!mapping.bytes().isEmpty())
+        ret.loadFromData(mapping.bytes());
+
+    return ret;
+}
+
 QString DocumentFileSystem::add(const QString &fileName, const QString &ns)
 {
     if(fileName.isEmpty())
@@ -439,6 +1261,7 @@ QString DocumentFileSystem::add(const QString &fileName, const QString &ns)
     {
         QFile copiedFile(absPath);
         copiedFile.setPermissions(QFileDevice::ReadOwner|QFileDevice::WriteOwner|QFileDevice::ReadUser|QFileDevice::WriteUser|QFileDevice::ReadGroup|QFileDevice::WriteGroup|QFileDevice::ReadOther|QFileDevice::WriteOther);
+        d->markDirty(absPath);
         return path;
     }
 
@@ -464,6 +1287,7 @@ QString DocumentFileSystem::duplicate(const QString &fileName, const QString &ns
     {
         QFile copiedFile(absPath);
         copiedFile.setPermissions(QFileDevice::ReadOwner|QFileDevice::WriteOwner|QFileDevice::ReadUser|QFileDevice::WriteUser|QFileDevice::ReadGroup|QFileDevice::WriteGroup|QFileDevice::ReadOther|QFileDevice::WriteOther);
+        d->markDirty(absPath);
         return path;
     }
 
@@ -476,7 +1300,15 @@ bool DocumentFileSystem::remove(const QString &path)
     if(path.isEmpty())
         return false;
 
+    // Entries that were never extracted need not be extracted just to be removed.
+    if(d->isLazyEntry(path))
+    {
+        d->forgetEntry(d->folder->filePath(d->entryName(path)));
+        return true;
+    }
+
     const QString completePath = this->absolutePath(path);
+    d->forgetEntry(completePath);
     return QFile::remove(completePath);
 }
 
@@ -488,12 +1320,19 @@ QString DocumentFileSystem::absolutePath(const QString &path, bool mkpath) const
     if(QDir::isAbsolutePath(path))
     {
         if( path.startsWith(d->folder->path()) )
+        {
+            d->extractLazyEntry(path);
+            this->reportLostEntries();
             return path;
+        }
 
         return QString();
     }
 
     const QString ret = d->folder->filePath(path);
+    d->extractLazyEntry(ret);
+    this->reportLostEntries();
+
     const QFileInfo fi(ret);
     if(!fi.exists() && mkpath)
     {
@@ -504,6 +1343,27 @@ QString DocumentFileSystem::absolutePath(const QString &path, bool mkpath) const
     return ret;
 }
 
+void DocumentFileSystem::reportLostEntries() const
+{
+    if(d->lostEntries.isEmpty())
+        return;
+
+    const QStringList entries = d->lostEntries;
+    d->lostEntries.clear();
+    emit const_cast<DocumentFileSystem*>(this)->entriesLost(d->archiveFileName, entries);
+}
+
+QString DocumentFileSystem::lazyAbsolutePath(const QString &path) const
+{
+    if(path.isEmpty())
+        return QString();
+
+    if(QDir::isAbsolutePath(path))
+        return path.startsWith(d->folder->path()) ? path : QString();
+
+    return d->folder->filePath(path);
+}
+
 QString DocumentFileSystem::relativePath(const QString &path) const
 {
     if(path.isEmpty())
@@ -529,6 +1389,9 @@ bool DocumentFileSystem::exists(const QString &path) const
     if(path.isEmpty())
         return false;
 
+    if(d->isLazyEntry(path))
+        return true;
+
     const QString completePath = this->absolutePath(path);
     return QFile::exists(completePath);
 }
@@ -574,6 +1437,8 @@ QString DocumentFileSystem::addFile(const QString &srcFile, const QString &dstPa
     if( !QFile::copy(srcFile, dstPath) )
         return QString();
 
+    d->markDirty(absDstPath);
+
     // That's it
     return this->relativePath(absDstPath);
 }
@@ -584,7 +1449,21 @@ QString DocumentFileSystem::addImage(const QString &srcFile, const QString &dstP
     if( this->contains(srcFile) )
         return QDir::isAbsolutePath(srcFile) ? this->relativePath(srcFile) : this->absolutePath(srcFile);
 
-    const QImage image(srcFile);
+    // Decode straight out of a mapping of the source file, rather than having
+    // QImageReader copy it through a read buffer.
+    QImage image;
+    QFile file(srcFile);
+    if( file.open(QFile::ReadOnly) && file.size() > 0 && file.size() <= INT_MAX )
+    {
+        const uchar *data = file.map(0, file.size());
+        if(data != nullptr)
+            image.loadFromData(data, int(file.size()));
+        file.close();
+    }
+
+    if(image.isNull())
+        image.load(srcFile);
+
     return this->addImage(image, dstPath, scaleTo, replaceIfExists);
 }
 
@@ -606,6 +1485,7 @@ QString DocumentFileSystem::addImage(const QImage &srcImage, const QString &dstP
         if( QFile::exists(absDstPath) )
             QFile::remove(absDstPath);
 
+        d->forgetEntry(absDstPath);
         return QString();
     }
 
@@ -627,6 +1507,7 @@ QString DocumentFileSystem::addImage(const QImage &srcImage, const QString &dstP
 
     const QString suffix = QFileInfo(absDstPath).suffix().toUpper();
     const bool ret = imageToSave.save(absDstPath, qPrintable(suffix));
+    d->markDirty(absDstPath);
     return ret ? this->relativePath(absDstPath) : QString();
 }
 
@@ -728,3 +1609,35 @@ void DocumentFile::onAboutToClose()
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+
+DocumentFileMapping::DocumentFileMapping(DocumentFileSystem *fileSystem, const QString &path)
+{
+    if(fileSystem == nullptr || path.isEmpty())
+        return;
+
+    const QString completePath = fileSystem->absolutePath(path);
+    const QFileInfo fi(completePath);
+    if( !fi.exists() || !fi.isFile() || fi.size() <= 0 )
+        return;
+
+    m_file.setFileName(completePath);
+    if( !m_file.open(QFile::ReadOnly) )
+        return;
+
+    const uchar *data = fi.size() <= INT_MAX ? m_file.map(0, fi.size()) : nullptr;
+    if(data != nullptr)
+        m_bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(data), int(fi.size()));
+    else
+    {
+        m_bytes = m_file.readAll();
+        m_file.close();
+    }
+}
+
+DocumentFileMapping::~DocumentFileMapping()
+{
+    // Closing the file unmaps it.
+    m_bytes.clear();
+    m_file.close();
+}
@@ -20,8 +20,11 @@
 #include <QSize>
 #include <QImage>
 #include <QFileInfo>
+#include <QJsonObject>
+#include <QSharedPointer>
 
 class DocumentFile;
+struct DocumentFileSystemSaveTask;
 
 struct DocumentFileSystemData;
 class DocumentFileSystem : public QObject
@@ -37,22 +40,59 @@ public:
     enum Format { UnknownFormat, ScriteFormat, ZipFormat };
 
     void reset();
+
+    // Only the headers of a ZIP document are extracted by load(). Every other
+    // entry is extracted the first time it is asked for through open(), read(),
+    // absolutePath() or fileInfo().
     bool load(const QString &fileName, Format *format=nullptr);
     bool save(const QString &fileName);
 
+    // Save can also be carried out in three steps, so that the bulk of the work
+    // happens on a background thread. prepareSave() and finishSave() must be called
+    // from the thread that owns this object, performSave() from any thread.
+    // prepareSave() takes copies of entries that changed since the last save, so
+    // the DFS can be used as usual while performSave() is in progress.
+    // Headers must be put into the save task before performSave(), either through
+    // writeHeaders() or by writing (streaming) them into the header files of the task.
+    // After a save whose headers were streamed, header() and binaryHeader() are empty.
+    QSharedPointer<DocumentFileSystemSaveTask> prepareSave(const QString &fileName);
+    static bool writeHeaders(const QSharedPointer<DocumentFileSystemSaveTask> &task, const QByteArray &header, const QByteArray &binaryHeader=QByteArray());
+    static QString headerFilePath(const QSharedPointer<DocumentFileSystemSaveTask> &task);
+    static QString binaryHeaderFilePath(const QSharedPointer<DocumentFileSystemSaveTask> &task);
+    static bool performSave(const QSharedPointer<DocumentFileSystemSaveTask> &task);
+    bool finishSave(const QSharedPointer<DocumentFileSystemSaveTask> &task);
+
     void setHeader(const QByteArray &header);
     QByteArray header() const;
 
+    // Optional header in BinaryHeader format, saved alongside the JSON header.
+    void setBinaryHeader(const QByteArray &header);
+    QByteArray binaryHeader() const;
+
+    // A small JSON object saved as the comment of the ZIP archive, which can be
+    // read back by readMetaData() without extracting anything from the archive.
+    void setMetaData(const QJsonObject &metaData);
+    QJsonObject metaData() const;
+    static QJsonObject readMetaData(const QString &fileName);
+
     QFile *open(const QString &path, QFile::OpenMode mode=QFile::ReadOnly);
 
     QByteArray read(const QString &path);
     bool write(const QString &path, const QByteArray &bytes);
 
+    // See DocumentFileMapping for a zero-copy alternative to read().
+    QImage readImage(const QString &path);
+
     QString add(const QString &fileName, const QString &ns=QString());
     QString duplicate(const QString &fileName, const QString &ns=QString());
     bool remove(const QString &path);
 
     QString absolutePath(const QString &path, bool mkpath=false) const;
+
+    // Same as absolutePath(), except that a file which was not extracted from the
+    // archive yet is left there. Pass the path through absolutePath() before reading
+    // the file.
+    QString lazyAbsolutePath(const QString &path) const;
     QString relativePath(const QString &path) const;
     bool contains(const QString &path) const;
 
@@ -68,7 +108,13 @@ public:
     void cleanup();
     Q_SIGNAL void auction(const QString &path, int *claims);
 
+    // Emitted when entries that were not extracted yet can no longer be extracted,
+    // because someone else changed, moved or deleted the archive they were in.
+    Q_SIGNAL void entriesLost(const QString &archiveFileName, const QStringList &entries);
+
 private:
+    void reportLostEntries() const;
+
     bool pack(QDataStream &ds);
     bool unpack(QDataStream &ds);
 
@@ -91,4 +137,22 @@ private:
     DocumentFileSystem *m_fileSystem = nullptr;
 };
 
+// Zero-copy alternative to DocumentFileSystem::read(). The file is mapped into
+// memory for as long as this object lives, and bytes() refers to the mapping
+// without owning it. So the bytes must not be used once this object is gone.
+// Files that cannot be mapped are read into bytes() instead.
+class DocumentFileMapping
+{
+public:
+    DocumentFileMapping(DocumentFileSystem *fileSystem, const QString &path);
+    ~DocumentFileMapping();
+
+    QByteArray bytes() const { return m_bytes; }
+
+private:
+    Q_DISABLE_COPY(DocumentFileMapping)
+    QFile m_file;
+    QByteArray m_bytes;
+};
+
 #endif // DOCUMENTFILESYSTEM_H
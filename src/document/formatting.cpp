@@ -29,6 +29,7 @@
 #include <QTextBlockUserData>
 #include <QClipboard>
 #include <QMimeData>
+#include <QAtomicInt>
 #include <QJsonDocument>
 
 struct ParagraphMetrics
@@ -66,16 +67,25 @@ struct ParagraphMetrics
     }
 };
 
+// Each change to a format gets a number that no other format in the process has,
+// so that the number alone can tell one formatting apart from another.
+static int nextFormatRevision()
+{
+    static QAtomicInt revision;
+    return revision.fetchAndAddOrdered(1) + 1;
+}
+
 static const int IsWordMisspelledProperty = QTextCharFormat::UserProperty+100;
-static const int WordSuggestionsProperty = IsWordMisspelledProperty+1;
 
 SceneElementFormat::SceneElementFormat(SceneElement::Type type, ScreenplayFormat *parent)
                    : QObject(parent),
                      m_font(parent->defaultFont()),
                      m_format(parent),
-                     m_elementType(type)
+                     m_elementType(type),
+                     m_revision(nextFormatRevision())
 {
     QObject::connect(this, &SceneElementFormat::elementFormatChanged, [this]() {
+        m_revision = nextFormatRevision();
         this->markAsModified();
         m_lastCreatedBlockFormatPageWidth = -1;
         m_lastCreatedCharFormatPageWidth = -1;
@@ -500,7 +510,17 @@ void ScreenplayPageLayout::configure(QTextDocument *document) const
     const QMarginsF pixelMargins = stdResolution ? m_margins : m_pageLayout.marginsPixels(qt_defaultDpi());
     const QSizeF pageSize = stdResolution ? m_paperRect.size() : m_pageLayout.pageSize().sizePixels(qt_defaultDpi());
 
-    document->setPageSize(pageSize);
+    // Both of these lay out the whole document again, and setting the root frame format
+    // also reports the whole document as changed; even if nothing actually changed.
+    if(document->pageSize() != pageSize)
+        document->setPageSize(pageSize);
+
+    const QTextFrameFormat rootFormat = document->rootFrame()->frameFormat();
+    if(qFuzzyCompare(rootFormat.topMargin(), pixelMargins.top()) &&
+       qFuzzyCompare(rootFormat.bottomMargin(), pixelMargins.bottom()) &&
+       qFuzzyCompare(rootFormat.leftMargin(), pixelMargins.left()) &&
+       qFuzzyCompare(rootFormat.rightMargin(), pixelMargins.right()))
+        return;
 
     QTextFrameFormat format;
     format.setTopMargin(pixelMargins.top());
@@ -598,7 +618,13 @@ ScreenplayFormat::ScreenplayFormat(QObject *parent)
         m_elementFormats.append(elementFormat);
     }
 
+    m_revision = nextFormatRevision();
+    auto bumpRevision = [this]() { m_revision = nextFormatRevision(); };
+    connect(this, &ScreenplayFormat::screenChanged, bumpRevision);
+    connect(this, &ScreenplayFormat::fontZoomLevelIndexChanged, bumpRevision);
+
     connect(this, &ScreenplayFormat::formatChanged, [this]() {
+        m_revision = nextFormatRevision();
         this->markAsModified();
     });
 
@@ -1472,7 +1498,6 @@ void SceneDocumentBinder::setCursorPosition(int val)
 
         const QTextCharFormat format = cursor.charFormat();
         this->setWordUnderCursorIsMisspelled(format.property(IsWordMisspelledProperty).toBool());
-        this->setSpellingSuggestions(format.property(WordSuggestionsProperty).toStringList());
         m_textFormat->updateFromFormat(format);
     }
 
@@ -1635,9 +1660,6 @@ public:
     bool isMisspelled() const {
         return this->charFormatProperty(IsWordMisspelledProperty).toBool();
     }
-    QStringList suggestions() const {
-        return this->charFormatProperty(WordSuggestionsProperty).toStringList();
-    }
     QVariant charFormatProperty(int prop) const {
         if(this->word().isEmpty())
             return QVariant();
@@ -1653,7 +1675,6 @@ public:
         QTextCharFormat format;
         format.setBackground(Qt::NoBrush);
         format.setProperty(IsWordMisspelledProperty, false);
-        format.setProperty(WordSuggestionsProperty, QStringList());
         this->mergeCharFormat(format);
         this->removeSelectedText();
         this->insertText(word);
@@ -1671,11 +1692,28 @@ QStringList SceneDocumentBinder::spellingSuggestionsForWordAt(int position) cons
 
     SpellCheckCursor cursor(this->document(), position);
     if(cursor.isMisspelled())
-        return cursor.suggestions();
+        return SpellCheckService::suggestions(cursor.word());
 
     return QStringList();
 }
 
+void SceneDocumentBinder::requestSpellingSuggestionsForWordAt(int position)
+{
+    if(this->document() == nullptr || m_initializingDocument || position < 0)
+        return;
+
+    SpellCheckCursor cursor(this->document(), position);
+    if(!cursor.isMisspelled())
+    {
+        emit spellingSuggestionsForWordAtAvailable(position, QStringList());
+        return;
+    }
+
+    SpellCheckService::suggestionsAsync(cursor.word(), this, [=](const QStringList &suggestions) {
+        emit spellingSuggestionsForWordAtAvailable(position, suggestions);
+    });
+}
+
 void SceneDocumentBinder::replaceWordAt(int position, const QString &with)
 {
     if(this->document() == nullptr || m_initializingDocument || position < 0)
@@ -1686,7 +1724,6 @@ void SceneDocumentBinder::replaceWordAt(int position, const QString &with)
         return;
 
     cursor.replace(with);
-    this->setSpellingSuggestions(QStringList());
     this->setWordUnderCursorIsMisspelled(false);
 }
 
@@ -1702,7 +1739,6 @@ void SceneDocumentBinder::addWordAtPositionToDictionary(int position)
     if(SpellCheckService::addToDictionary(cursor.word()))
     {
         cursor.resetCharFormat();
-        this->setSpellingSuggestions(QStringList());
         this->setWordUnderCursorIsMisspelled(false);
     }
 }
@@ -1718,7 +1754,6 @@ void SceneDocumentBinder::addWordAtPositionToIgnoreList(int position)
 
     ScriteDocument::instance()->addToSpellCheckIgnoreList(cursor.word());
     cursor.resetCharFormat();
-    this->setSpellingSuggestions(QStringList());
     this->setWordUnderCursorIsMisspelled(false);
 }
 
@@ -1972,8 +2007,6 @@ void SceneDocumentBinder::highlightBlock(const QString &text)
             if(!fragment.isValid())
                 continue;
 
-            spellingErrorFormat.setProperty(WordSuggestionsProperty, fragment.suggestions());
-
             if(fragment.length() > 0)
             {
                 cursor.setPosition(block.position() + fragment.start());
@@ -2600,15 +2633,6 @@ void SceneDocumentBinder::setCompletionPrefix(const QString &val)
     emit completionPrefixChanged();
 }
 
-void SceneDocumentBinder::setSpellingSuggestions(const QStringList &val)
-{
-    if(m_spellingSuggestions == val)
-        return;
-
-    m_spellingSuggestions = val;
-    emit spellingSuggestionsChanged();
-}
-
 void SceneDocumentBinder::setWordUnderCursorIsMisspelled(bool val)
 {
     if(m_wordUnderCursorIsMisspelled == val)
@@ -154,6 +154,9 @@ public:
 
     void resetToDefaults();
 
+    // Changes whenever anything that goes into createBlockFormat() or createCharFormat() changes.
+    int revision() const { return m_revision; }
+
 private:
     friend class ScreenplayFormat;
     SceneElementFormat(SceneElement::Type type=SceneElement::Action, ScreenplayFormat *parent=nullptr);
@@ -173,6 +176,7 @@ private:
     Qt::Alignment m_textAlignment = Qt::AlignLeft;
     SceneElement::Type m_elementType = SceneElement::Action;
     DefaultLanguage m_defaultLanguage = Default;
+    int m_revision = 0;
 
     mutable qreal m_lastCreatedBlockFormatPageWidth = 0;
     mutable QTextBlockFormat m_lastCreatedBlockFormat;
@@ -377,6 +381,9 @@ public:
 
     void useUserSpecifiedFonts();
 
+    // Changes whenever the formatting, screen or zoom level changes.
+    int revision() const { return m_revision; }
+
 private:
     void resetScreen();
     void evaluateFontPointSizeDelta();
@@ -390,6 +397,7 @@ private:
     int m_secondsPerPage = 60;
     int   m_fontPointSizeDelta = 0;
     int m_fontZoomLevelIndex = -1;
+    int m_revision = 0;
     bool m_inTransaction = false;
     int m_nrChangesDuringTransation = 0;
     QList<int> m_fontPointSizes;
@@ -548,16 +556,16 @@ public:
     Q_INVOKABLE int cursorPositionAtBlock(int blockNumber) const;
     Q_INVOKABLE int currentBlockPosition() const;
 
-    Q_PROPERTY(QStringList spellingSuggestions READ spellingSuggestions NOTIFY spellingSuggestionsChanged)
-    QStringList spellingSuggestions() const {return m_spellingSuggestions; }
-    Q_SIGNAL void spellingSuggestionsChanged();
-
     Q_PROPERTY(bool wordUnderCursorIsMisspelled READ isWordUnderCursorIsMisspelled NOTIFY wordUnderCursorIsMisspelledChanged)
     bool isWordUnderCursorIsMisspelled() const { return m_wordUnderCursorIsMisspelled; }
     Q_SIGNAL void wordUnderCursorIsMisspelledChanged();
 
     Q_INVOKABLE QStringList spellingSuggestionsForWordAt(int position) const;
 
+    // Non-blocking variant of spellingSuggestionsForWordAt()
+    Q_INVOKABLE void requestSpellingSuggestionsForWordAt(int position);
+    Q_SIGNAL void spellingSuggestionsForWordAtAvailable(int position, const QStringList &suggestions);
+
     Q_INVOKABLE void replaceWordAt(int position, const QString &with);
     Q_INVOKABLE void replaceWordUnderCursor(const QString &with) {
         this->replaceWordAt(m_cursorPosition, with);
@@ -635,7 +643,6 @@ private:
     void setAutoCompleteHintsFor(SceneElement::Type val);
     void setAutoCompleteHints(const QStringList &val);
     void setCompletionPrefix(const QString &val);
-    void setSpellingSuggestions(const QStringList &val);
     void setWordUnderCursorIsMisspelled(bool val);
 
     void onSceneAboutToReset();
@@ -662,7 +669,6 @@ private:
     QObjectProperty<Scene> m_scene;
     ExecLaterTimer m_rehighlightTimer;
     QStringList m_autoCompleteHints;
-    QStringList m_spellingSuggestions;
     int m_currentElementCursorPosition = -1;
     bool m_wordUnderCursorIsMisspelled = false;
     ExecLaterTimer m_initializeDocumentTimer;
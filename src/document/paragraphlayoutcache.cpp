@@ -0,0 +1,121 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include "formatting.h"
+#include "paragraphlayoutcache.h"
+
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextLayout>
+#include <QTextDocument>
+#include <QMutexLocker>
+
+uint qHash(const ParagraphLayoutCache::Key &key, uint seed)
+{
+    return qHash(key.textHash, seed) ^ qHash(key.textLength) ^ qHash(key.elementType) ^
+           qHash(key.elementFormatRevision) ^ qHash(key.screenplayFormatRevision) ^
+           qHash(key.formatWidth) ^ qHash(key.layoutWidth);
+}
+
+ParagraphLayoutCache *ParagraphLayoutCache::instance()
+{
+    static ParagraphLayoutCache theInstance;
+    return &theInstance;
+}
+
+ParagraphLayoutCache::ParagraphLayoutCache()
+    : m_cache(20000)
+{
+
+}
+
+ParagraphLayoutCache::~ParagraphLayoutCache()
+{
+
+}
+
+ParagraphLayoutCache::Metrics ParagraphLayoutCache::metrics(const QString &text, const SceneElementFormat *format, qreal formatWidth, qreal layoutWidth)
+{
+    if(format == nullptr)
+        return Metrics();
+
+    Key key;
+    key.textHash = qHash(text);
+    key.textLength = text.length();
+    key.elementType = format->elementType();
+    key.elementFormatRevision = format->revision();
+    key.screenplayFormatRevision = format->format()->revision();
+    key.formatWidth = formatWidth;
+    key.layoutWidth = layoutWidth;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        const Metrics *cached = m_cache.object(key);
+        if(cached != nullptr)
+        {
+            m_hitCount.ref();
+            return *cached;
+        }
+    }
+
+    // Lay it out without holding the lock, so that other threads aren't kept waiting.
+    m_missCount.ref();
+    const Metrics ret = evaluate(text, format, formatWidth, layoutWidth);
+
+    QMutexLocker locker(&m_mutex);
+    m_cache.insert(key, new Metrics(ret));
+    return ret;
+}
+
+void ParagraphLayoutCache::setMaxEntries(int val)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.setMaxCost(val);
+}
+
+int ParagraphLayoutCache::maxEntries() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_cache.maxCost();
+}
+
+int ParagraphLayoutCache::entryCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_cache.count();
+}
+
+void ParagraphLayoutCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.clear();
+    m_hitCount.store(0);
+    m_missCount.store(0);
+}
+
+ParagraphLayoutCache::Metrics ParagraphLayoutCache::evaluate(const QString &text, const SceneElementFormat *format, qreal formatWidth, qreal layoutWidth)
+{
+    QTextDocument document;
+    document.setDocumentMargin(0);
+    document.setTextWidth(layoutWidth);
+
+    QTextCursor cursor(&document);
+    cursor.setBlockFormat(format->createBlockFormat(&formatWidth));
+    cursor.setCharFormat(format->createCharFormat(&formatWidth));
+    cursor.insertText(text);
+
+    Metrics ret;
+    ret.height = document.size().height();
+    ret.lineCount = document.firstBlock().layout()->lineCount();
+    return ret;
+}
@@ -0,0 +1,96 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef PARAGRAPHLAYOUTCACHE_H
+#define PARAGRAPHLAYOUTCACHE_H
+
+#include <QCache>
+#include <QMutex>
+#include <QString>
+#include <QAtomicInt>
+
+class SceneElementFormat;
+
+/**
+ * Remembers how tall a paragraph of text is, once laid out with a SceneElementFormat
+ * in a given width. Entries are keyed by a hash of the text, the element type, the
+ * revisions of the element format and its screenplay format, and the widths. So any
+ * change to formatting simply stops matching older entries, which then age out of the
+ * cache in least-recently-used order.
+ *
+ * The cache is shared by the whole process and can be used from any thread.
+ *
+ * SceneSizeHintItem is the only consumer. ScreenplayTextDocument and SceneDocumentBinder
+ * render their paragraphs through QTextDocumentLayout, which cannot take cached metrics.
+ * ScreenplayTextDocument::lengthInPixels() and lengthInPages() measure frames, whose
+ * heights include gaps left at page breaks, so they don't use the cache either.
+ * Application::paragraphLayoutCacheInfo() reports how well the cache is doing.
+ */
+class ParagraphLayoutCache
+{
+public:
+    static ParagraphLayoutCache *instance();
+    ~ParagraphLayoutCache();
+
+    struct Metrics
+    {
+        int lineCount = 0;
+        qreal height = 0; // includes the paragraph's top margin
+    };
+
+    // formatWidth is passed on to SceneElementFormat::createBlockFormat() and
+    // createCharFormat(), while the paragraph is laid out in layoutWidth.
+    Metrics metrics(const QString &text, const SceneElementFormat *format, qreal formatWidth, qreal layoutWidth);
+
+    void setMaxEntries(int val);
+    int maxEntries() const;
+
+    int entryCount() const;
+    int hitCount() const { return m_hitCount.load(); }
+    int missCount() const { return m_missCount.load(); }
+
+    void clear();
+
+private:
+    ParagraphLayoutCache();
+
+    struct Key
+    {
+        uint textHash = 0;
+        int textLength = 0;
+        int elementType = 0;
+        int elementFormatRevision = 0;
+        int screenplayFormatRevision = 0;
+        qreal formatWidth = 0;
+        qreal layoutWidth = 0;
+
+        bool operator == (const Key &other) const {
+            return textHash == other.textHash && textLength == other.textLength &&
+                   elementType == other.elementType &&
+                   elementFormatRevision == other.elementFormatRevision &&
+                   screenplayFormatRevision == other.screenplayFormatRevision &&
+                   formatWidth == other.formatWidth && layoutWidth == other.layoutWidth;
+        }
+    };
+    friend uint qHash(const Key &key, uint seed);
+
+    static Metrics evaluate(const QString &text, const SceneElementFormat *format, qreal formatWidth, qreal layoutWidth);
+
+private:
+    mutable QMutex m_mutex;
+    QCache<Key,Metrics> m_cache;
+    QAtomicInt m_hitCount;
+    QAtomicInt m_missCount;
+};
+
+#endif // PARAGRAPHLAYOUTCACHE_H
@@ -20,6 +20,7 @@
 #include "scritedocument.h"
 #include "garbagecollector.h"
 #include "qobjectserializer.h"
+#include "paragraphlayoutcache.h"
 
 #include <QUuid>
 #include <QFuture>
@@ -1912,6 +1913,27 @@ QSizeF SceneSizeHintItem::evaluateSizeHint()
         const qreal pageWidth = this->width();
     m_lock.unlock();
 
+    // Paragraphs in screenplay formats have no bottom margin, so a scene is as tall as all
+    // of its paragraphs put together. Heights of paragraphs come from the layout cache,
+    // and only those that were never laid out before in this format and width are laid out.
+    if(m_scene != nullptr && m_format != nullptr && m_scene->elementCount() > 0)
+    {
+        const qreal maxParaWidth = (pageWidth - margins.left() - margins.right()) / m_format->devicePixelRatio();
+        const qreal layoutWidth = pageWidth - margins.left() - margins.right();
+
+        ParagraphLayoutCache *layoutCache = ParagraphLayoutCache::instance();
+
+        qreal height = margins.top() + margins.bottom();
+        for(int j=0; j<m_scene->elementCount(); j++)
+        {
+            const SceneElement *para = m_scene->elementAt(j);
+            const SceneElementFormat *style = m_format->elementFormat(para->type());
+            height += layoutCache->metrics(para->text(), style, maxParaWidth, layoutWidth).height;
+        }
+
+        return QSizeF(pageWidth, height);
+    }
+
     QTextDocument document;
 
     QTextFrameFormat frameFormat;
@@ -1925,26 +1947,6 @@ QSizeF SceneSizeHintItem::evaluateSizeHint()
 
     document.setTextWidth(pageWidth);
 
-    if(m_scene != nullptr && m_format != nullptr)
-    {
-        const qreal maxParaWidth = (pageWidth - margins.left() - margins.right()) / m_format->devicePixelRatio();
-
-        QTextCursor cursor(&document);
-        for(int j=0; j<m_scene->elementCount(); j++)
-        {
-            const SceneElement *para = m_scene->elementAt(j);
-            const SceneElementFormat *style = m_format->elementFormat(para->type());
-            if(j)
-                cursor.insertBlock();
-
-            const QTextBlockFormat blockFormat = style->createBlockFormat(&maxParaWidth);
-            const QTextCharFormat charFormat = style->createCharFormat(&maxParaWidth);
-            cursor.setBlockFormat(blockFormat);
-            cursor.setCharFormat(charFormat);
-            cursor.insertText(para->text());
-        }
-    }
-
     return document.size();
 }
 
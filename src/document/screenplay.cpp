@@ -18,6 +18,8 @@
 #include "timeprofiler.h"
 #include "scritedocument.h"
 #include "garbagecollector.h"
+#include "screenplaytextdocument.h"
+#include "screenplaysearchindex.h"
 
 #include <QJsonDocument>
 #include <QScopedValueRollback>
@@ -564,6 +566,15 @@ bool Screenplay::isEmpty() const
     return allEmpty;
 }
 
+QString Screenplay::coverPagePhoto() const
+{
+    // The photo is extracted from the document only when someone asks for it.
+    if(!m_coverPagePhoto.isEmpty())
+        m_scriteDocument->fileSystem()->absolutePath(m_coverPagePhoto);
+
+    return m_coverPagePhoto;
+}
+
 void Screenplay::setCoverPagePhoto(const QString &val)
 {
     HourGlass hourGlass;
@@ -1794,41 +1805,30 @@ void Screenplay::setActiveScene(Scene *val)
 
 QJsonArray Screenplay::search(const QString &text, int flags) const
 {
-    HourGlass hourGlass;
+    if(m_searchIndex == nullptr)
+        m_searchIndex = new ScreenplaySearchIndex(const_cast<Screenplay*>(this));
 
     QJsonArray ret;
 
-    const int nrScenes = m_elements.size();
-    for(int i=0; i<nrScenes; i++)
-    {
-        Scene *scene = m_elements.at(i)->scene();
-        if(scene == nullptr)
-            continue;
-
-        int sceneResultIndex = 0;
+    const QList<ScreenplaySearchIndex::Hit> hits = m_searchIndex->find(text, flags);
 
-        const int nrElements = scene->elementCount();
-        for(int j=0; j<nrElements; j++)
+    int sceneIndex = -1;
+    int sceneResultIndex = 0;
+    for(const ScreenplaySearchIndex::Hit &hit : hits)
+    {
+        if(hit.sceneIndex != sceneIndex)
         {
-            SceneElement *element = scene->elementAt(j);
-
-            const QJsonArray results = element->find(text, flags);
-            if(!results.isEmpty())
-            {
-                for(int r=0; r<results.size(); r++)
-                {
-                    const QJsonObject result = results.at(r).toObject();
-
-                    QJsonObject item;
-                    item.insert("sceneIndex", i);
-                    item.insert("elementIndex", j);
-                    item.insert("sceneResultIndex", sceneResultIndex++);
-                    item.insert("from", result.value("from"));
-                    item.insert("to", result.value("to"));
-                    ret.append(item);
-                }
-            }
+            sceneIndex = hit.sceneIndex;
+            sceneResultIndex = 0;
         }
+
+        QJsonObject item;
+        item.insert("sceneIndex", hit.sceneIndex);
+        item.insert("elementIndex", hit.elementIndex);
+        item.insert("sceneResultIndex", sceneResultIndex++);
+        item.insert("from", hit.from);
+        item.insert("to", hit.to);
+        ret.append(item);
     }
 
     return ret;
@@ -1838,6 +1838,10 @@ int Screenplay::replace(const QString &text, const QString &replacementText, int
 {
     HourGlass hourGlass;
 
+    // Text documents showing this screenplay reload all affected scenes together,
+    // once we are done replacing.
+    ScreenplayTextDocumentUpdate update(this);
+
     int counter = 0;
 
     const int nrScenes = m_elements.size();
@@ -1891,10 +1895,12 @@ void Screenplay::serializeToJson(QJsonObject &json) const
 
 void Screenplay::deserializeFromJson(const QJsonObject &)
 {
-    const QString cpPhotoPath = m_scriteDocument->fileSystem()->absolutePath(coverPagePhotoPath);
-    if( QFile::exists(cpPhotoPath) )
+    // The photo is extracted from the document when it is first asked for, see
+    // coverPagePhoto().
+    DocumentFileSystem *dfs = m_scriteDocument->fileSystem();
+    if( dfs->exists(coverPagePhotoPath) )
     {
-        m_coverPagePhoto = cpPhotoPath;
+        m_coverPagePhoto = dfs->lazyAbsolutePath(coverPagePhotoPath);
         emit coverPagePhotoChanged();
     }
 
@@ -26,6 +26,7 @@
 class Screenplay;
 class ScriteDocument;
 class AbstractImporter;
+class ScreenplaySearchIndex;
 class AbstractScreenplaySubsetReport;
 
 class ScreenplayElement : public QObject, public Modifiable, public QObjectSerializer::Interface
@@ -269,7 +270,7 @@ public:
     Q_PROPERTY(QString coverPagePhoto READ coverPagePhoto NOTIFY coverPagePhotoChanged STORED false)
     Q_INVOKABLE void setCoverPagePhoto(const QString &val);
     Q_INVOKABLE void clearCoverPagePhoto();
-    QString coverPagePhoto() const { return m_coverPagePhoto; }
+    QString coverPagePhoto() const;
     Q_SIGNAL void coverPagePhotoChanged();
 
     enum CoverPagePhotoSize { SmallCoverPhoto, MediumCoverPhoto, LargeCoverPhoto };
@@ -426,6 +427,7 @@ private:
 
     ExecLaterTimer m_updateBreakTitlesTimer;
     ExecLaterTimer m_sceneNumberEvaluationTimer;
+    mutable ScreenplaySearchIndex *m_searchIndex = nullptr;
 };
 
 /**
@@ -0,0 +1,137 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include "screenplaysearchindex.h"
+#include "screenplay.h"
+#include "searchengine.h"
+
+ScreenplaySearchIndex::ScreenplaySearchIndex(Screenplay *parent)
+    : QObject(parent),
+      m_screenplay(parent)
+{
+
+}
+
+ScreenplaySearchIndex::~ScreenplaySearchIndex()
+{
+
+}
+
+QList<ScreenplaySearchIndex::Hit> ScreenplaySearchIndex::find(const QString &phrase, int givenFlags)
+{
+    QList<Hit> ret;
+    if(phrase.isEmpty())
+        return ret;
+
+    this->sync();
+
+    const SearchEngine::SearchFlags flags(givenFlags);
+    const Qt::CaseSensitivity cs = flags.testFlag(SearchEngine::SearchCaseSensitively) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+
+    // Resolves a paragraph to the screenplay elements showing its scene, and
+    // adds one hit for each of them.
+    QHash<SceneElement*,int> elementIndexes;
+    auto addHits = [&](SceneElement *element, int from, int to) {
+        Scene *scene = element->scene();
+        if(scene == nullptr)
+            return;
+
+        auto it = elementIndexes.find(element);
+        if(it == elementIndexes.end())
+            it = elementIndexes.insert(element, scene->indexOfElement(element));
+        if(it.value() < 0)
+            return;
+
+        const QList<int> sceneIndexes = m_sceneIndexes.values(scene);
+        for(int sceneIndex : sceneIndexes)
+        {
+            Hit hit;
+            hit.sceneIndex = sceneIndex;
+            hit.elementIndex = it.value();
+            hit.from = from;
+            hit.to = to;
+            ret << hit;
+        }
+    };
+
+    const QVector< TextSearchIndex<SceneElement*>::Match > matches = m_index.find(phrase, cs, flags.testFlag(SearchEngine::SearchWholeWords));
+    for(const TextSearchIndex<SceneElement*>::Match &match : matches)
+        addHits(match.key, match.from, match.to);
+
+    std::sort(ret.begin(), ret.end(), [](const Hit &a, const Hit &b) {
+        if(a.sceneIndex != b.sceneIndex)
+            return a.sceneIndex < b.sceneIndex;
+        if(a.elementIndex != b.elementIndex)
+            return a.elementIndex < b.elementIndex;
+        return a.from < b.from;
+    });
+
+    return ret;
+}
+
+void ScreenplaySearchIndex::sync()
+{
+    // Scenes may have been added, removed or moved around in the screenplay since
+    // the last search. Figuring that out is cheap compared to indexing, so we
+    // simply look at all of them and only index paragraphs we haven't seen before.
+    m_sceneIndexes.clear();
+
+    const int nrScenes = m_screenplay->elementCount();
+    for(int i=0; i<nrScenes; i++)
+    {
+        Scene *scene = m_screenplay->elementAt(i)->scene();
+        if(scene == nullptr)
+            continue;
+
+        m_sceneIndexes.insert(scene, i);
+
+        const int nrElements = scene->elementCount();
+        for(int j=0; j<nrElements; j++)
+        {
+            SceneElement *element = scene->elementAt(j);
+            if(m_index.contains(element) || m_dirtyElements.contains(element))
+                continue;
+
+            connect(element, &SceneElement::textChanged, this, &ScreenplaySearchIndex::onElementTextChanged);
+            connect(element, &SceneElement::aboutToDelete, this, &ScreenplaySearchIndex::onElementAboutToDelete);
+            m_dirtyElements += element;
+        }
+    }
+
+    Q_FOREACH(SceneElement *element, m_dirtyElements)
+        this->indexElement(element);
+    m_dirtyElements.clear();
+}
+
+void ScreenplaySearchIndex::indexElement(SceneElement *element)
+{
+    m_index.insert(element, element->text());
+}
+
+void ScreenplaySearchIndex::unindexElement(SceneElement *element)
+{
+    m_index.remove(element);
+}
+
+void ScreenplaySearchIndex::onElementTextChanged()
+{
+    SceneElement *element = qobject_cast<SceneElement*>(this->sender());
+    if(element != nullptr)
+        m_dirtyElements += element;
+}
+
+void ScreenplaySearchIndex::onElementAboutToDelete(SceneElement *element)
+{
+    this->unindexElement(element);
+    m_dirtyElements.remove(element);
+}
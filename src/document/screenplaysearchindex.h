@@ -0,0 +1,67 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef SCREENPLAYSEARCHINDEX_H
+#define SCREENPLAYSEARCHINDEX_H
+
+#include <QSet>
+#include <QHash>
+#include <QObject>
+
+#include "textsearchindex.h"
+
+class Scene;
+class Screenplay;
+class SceneElement;
+
+/**
+ * Inverted index of words in all paragraphs of all scenes in a screenplay.
+ *
+ * Paragraphs are indexed the first time the screenplay is searched. After that only
+ * paragraphs whose text changed are indexed again, just before the next search.
+ */
+class ScreenplaySearchIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    ScreenplaySearchIndex(Screenplay *parent);
+    ~ScreenplaySearchIndex();
+
+    struct Hit
+    {
+        int sceneIndex = -1;   // index of the ScreenplayElement showing the scene
+        int elementIndex = -1; // index of the paragraph within the scene
+        int from = -1;
+        int to = -1;
+    };
+
+    // Occurrences of the phrase, anywhere in the text of paragraphs. Flags are
+    // SearchEngine::SearchFlags. Hits are in screenplay order.
+    QList<Hit> find(const QString &phrase, int flags=0);
+
+private:
+    void sync();
+    void indexElement(SceneElement *element);
+    void unindexElement(SceneElement *element);
+    void onElementTextChanged();
+    void onElementAboutToDelete(SceneElement *element);
+
+private:
+    Screenplay *m_screenplay = nullptr;
+    TextSearchIndex<SceneElement*> m_index;
+    QSet<SceneElement*> m_dirtyElements;
+    QMultiHash<Scene*,int> m_sceneIndexes;
+};
+
+#endif // SCREENPLAYSEARCHINDEX_H
@@ -18,6 +18,7 @@
 #include "imageprinter.h"
 #include "timeprofiler.h"
 #include "printerobject.h"
+#include "progressreport.h"
 #include "scritedocument.h"
 #include "garbagecollector.h"
 #include "screenplaytextdocument.h"
@@ -27,6 +28,7 @@
 #include <QDate>
 #include <QtMath>
 #include <QtDebug>
+#include <QThread>
 #include <QPainter>
 #include <QDateTime>
 #include <QQmlEngine>
@@ -37,6 +39,7 @@
 #include <QPaintEngine>
 #include <QJsonDocument>
 #include <QTextCharFormat>
+#include <QtConcurrentRun>
 #include <QTextBlockFormat>
 #include <QPropertyAnimation>
 #include <QTextBlockUserData>
@@ -68,12 +71,32 @@ public:
             m_element->isModified(&m_elementModificationTime);
     }
 
+    // Copies whatever the print layout passes need out of the scene element,
+    // so that they can run without touching the live model.
+    void snapshot();
+
+    // Block data doesn't survive QTextDocument::clone(). Blocks of a document that is
+    // cloned for print layout carry the index of their snapshot in this property.
+    enum { SnapshotIndexProperty = QTextFormat::UserProperty+200 };
+
+    struct TextRun
+    {
+        QString text;
+        QString fontFamily;
+    };
+    QList<TextRun> characterElementTextRuns() const { return m_characterElementTextRuns; }
+
     static ScreenplayParagraphBlockData *get(const QTextBlock &block);
     static ScreenplayParagraphBlockData *get(QTextBlockUserData *userData);
 
 private:
     const SceneElement *m_element = nullptr;
     mutable int m_elementModificationTime = 0;
+    bool m_snapshot = false;
+    bool m_firstElementInScene = false;
+    SceneElement::Type m_elementType = SceneElement::Heading;
+    QString m_characterElementText;
+    QList<TextRun> m_characterElementTextRuns;
 };
 
 ScreenplayParagraphBlockData::ScreenplayParagraphBlockData(const SceneElement *element)
@@ -90,6 +113,8 @@ bool ScreenplayParagraphBlockData::contains(const SceneElement *other) const
 
 SceneElement::Type ScreenplayParagraphBlockData::elementType() const
 {
+    if(m_snapshot)
+        return m_elementType;
     return m_element ? m_element->type() : SceneElement::Heading;
 }
 
@@ -100,6 +125,8 @@ QString ScreenplayParagraphBlockData::elementText() const
 
 bool ScreenplayParagraphBlockData::isFirstElementInScene() const
 {
+    if(m_snapshot)
+        return m_firstElementInScene;
     if(m_element)
         return m_element->scene()->elementAt(0) == m_element;
     return false;
@@ -126,10 +153,36 @@ const SceneElement *ScreenplayParagraphBlockData::getCharacterElement() const
 
 QString ScreenplayParagraphBlockData::getCharacterElementText() const
 {
+    if(m_snapshot)
+        return m_characterElementText;
     const SceneElement *element = this->getCharacterElement();
     return element ? element->formattedText() : QString();
 }
 
+void ScreenplayParagraphBlockData::snapshot()
+{
+    if(m_snapshot)
+        return;
+
+    m_elementType = this->elementType();
+    m_firstElementInScene = this->isFirstElementInScene();
+    m_characterElementText = this->getCharacterElementText();
+
+    const QList<TransliterationEngine::Boundary> items = TransliterationEngine::instance()->evaluateBoundaries(m_characterElementText);
+    Q_FOREACH(TransliterationEngine::Boundary item, items)
+    {
+        if(item.string.isEmpty())
+            continue;
+
+        TextRun run;
+        run.text = item.string;
+        run.fontFamily = TransliterationEngine::instance()->languageFont(item.language).family();
+        m_characterElementTextRuns.append(run);
+    }
+
+    m_snapshot = true;
+}
+
 ScreenplayParagraphBlockData *ScreenplayParagraphBlockData::get(const QTextBlock &block)
 {
     return get(block.userData());
@@ -146,22 +199,46 @@ ScreenplayParagraphBlockData *ScreenplayParagraphBlockData::get(QTextBlockUserDa
 
 ///////////////////////////////////////////////////////////////////////////////
 
-class ScreenplayTextDocumentUpdate
+static QList<ScreenplayTextDocument*> &screenplayTextDocuments()
 {
-public:
-    ScreenplayTextDocumentUpdate(ScreenplayTextDocument *document)
-        : m_document(document) {
-        if(m_document)
-            m_document->setUpdating(true);
-    }
-    ~ScreenplayTextDocumentUpdate() {
-        if(m_document)
-            m_document->setUpdating(false);
+    static QList<ScreenplayTextDocument*> ret;
+    return ret;
+}
+
+ScreenplayTextDocumentUpdate::ScreenplayTextDocumentUpdate(ScreenplayTextDocument *document)
+    : m_document(document)
+{
+    if(m_document)
+        m_document->setUpdating(true);
+}
+
+ScreenplayTextDocumentUpdate::ScreenplayTextDocumentUpdate(const Screenplay *screenplay)
+{
+    if(screenplay == nullptr)
+        return;
+
+    const QList<ScreenplayTextDocument*> documents = ::screenplayTextDocuments();
+    for(ScreenplayTextDocument *document : documents)
+    {
+        if(document->screenplay() != screenplay)
+            continue;
+
+        document->beginBatchUpdate();
+        m_batchedDocuments << document;
     }
+}
 
-private:
-    ScreenplayTextDocument *m_document = nullptr;
-};
+ScreenplayTextDocumentUpdate::~ScreenplayTextDocumentUpdate()
+{
+    if(m_document)
+        m_document->setUpdating(false);
+
+    for(const QPointer<ScreenplayTextDocument> &document : qAsConst(m_batchedDocuments))
+    {
+        if(!document.isNull())
+            document->endBatchUpdate();
+    }
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -189,10 +266,19 @@ ScreenplayTextDocument::ScreenplayTextDocument(QTextDocument *document, QObject
 
 ScreenplayTextDocument::~ScreenplayTextDocument()
 {
+    ::screenplayTextDocuments().removeOne(this);
+
     m_sceneResetTimer.stop();
     m_loadScreenplayTimer.stop();
     m_pageBoundaryEvalTimer.stop();
 
+    if(m_printLayoutWatcher != nullptr)
+    {
+        this->cancelPrintLayout();
+        m_printLayoutWatcher->waitForFinished();
+        delete m_printLayoutWatcher->result().document;
+    }
+
     if(m_textDocument != nullptr && m_textDocument->parent() == this)
         m_textDocument->setUndoRedoEnabled(true);
 }
@@ -202,11 +288,18 @@ void ScreenplayTextDocument::setTextDocument(QTextDocument *val)
     if(m_textDocument != nullptr && m_textDocument == val)
         return;
 
-    if(m_textDocument != nullptr && m_textDocument->parent() == this)
-        delete m_textDocument;
+    if(m_textDocument != nullptr)
+    {
+        if(m_textDocument->parent() == this)
+            delete m_textDocument;
+        else
+            disconnect(m_textDocument, &QTextDocument::contentsChange, this, &ScreenplayTextDocument::onTextDocumentContentsChange);
+    }
 
     m_textDocument = val ? val : new QTextDocument(this);
     m_textDocument->setUndoRedoEnabled(false);
+    connect(m_textDocument, &QTextDocument::contentsChange, this, &ScreenplayTextDocument::onTextDocumentContentsChange);
+    this->invalidatePageBoundaries();
     this->loadScreenplayLater();
 
     emit textDocumentChanged();
@@ -268,6 +361,8 @@ void ScreenplayTextDocument::resetTextDocument()
 {
     m_textDocument = new QTextDocument(this);
     m_textDocument->setUndoRedoEnabled(false);
+    connect(m_textDocument, &QTextDocument::contentsChange, this, &ScreenplayTextDocument::onTextDocumentContentsChange);
+    this->invalidatePageBoundaries();
     this->loadScreenplayLater();
     emit textDocumentChanged();
 }
@@ -549,8 +644,9 @@ QList< QPair<int,int> > ScreenplayTextDocument::pageBreaksFor(ScreenplayElement
     if(element == m_screenplay->elementAt(0))
         checkAndAdd(sceneHeadingStart, 1);
 
-    // Now loop through all pages and gather all pages that lie within the scene boundaries
-    for(int i=0; i<m_pageBoundaries.count(); i++)
+    // Now loop through all pages and gather all pages that lie within the scene boundaries,
+    // starting with the page on which the scene begins.
+    for(int i=qMax(this->pageIndexOf(sceneHeadingStart),0); i<m_pageBoundaries.count(); i++)
     {
         const QPair<int,int> pgBoundary = m_pageBoundaries.at(i);
         if(pgBoundary.first > paragraphEnd)
@@ -567,9 +663,24 @@ qreal ScreenplayTextDocument::lengthInPixels(ScreenplayElement *from, Screenplay
     if(from == nullptr)
         return 0;
 
+    // Once page boundaries are settled, lengths come straight out of the length index
+    if(m_lengthIndex->isValid())
+    {
+        const int fromRow = m_lengthIndex->indexOf(from);
+        const int toRow = to ? m_lengthIndex->indexOf(to) : fromRow;
+        if(fromRow >= 0 && toRow >= 0)
+            return m_lengthIndex->lengthInPixels(fromRow, toRow);
+    }
+
     const int fromIndex = from->elementIndex();
     const int toIndex   = to ? to->elementIndex() : fromIndex;
 
+    // Until then, frames that end before the first edit still have the length that the
+    // index has for them, and only the rest are measured. Paragraph heights from the
+    // layout cache don't add up to frame heights, because frame heights include gaps
+    // left at page breaks, so they aren't used here.
+    QAbstractTextDocumentLayout *layout = m_textDocument->documentLayout();
+
     qreal ret = 0;
     for(int i=fromIndex; i<=toIndex; i++)
     {
@@ -578,8 +689,11 @@ qreal ScreenplayTextDocument::lengthInPixels(ScreenplayElement *from, Screenplay
         if(frame == nullptr)
             return 0;
 
-        QAbstractTextDocumentLayout *layout = m_textDocument->documentLayout();
-        ret += layout->frameBoundingRect(frame).height();
+        const ScreenplayLengthIndex::Item *item = m_lengthIndex->item(element);
+        if(item != nullptr && item->hasFrame && m_pagination.dirtyFrom > 0 && frame->lastPosition() < m_pagination.dirtyFrom)
+            ret += item->length;
+        else
+            ret += layout->frameBoundingRect(frame).height();
     }
 
     return ret;
@@ -625,6 +739,22 @@ void ScreenplayTextDocument::syncNow()
     this->loadScreenplay();
 }
 
+void ScreenplayTextDocument::syncInBackground()
+{
+    if(m_printLayoutWatcher != nullptr)
+        return;
+
+    // Only documents we own can be replaced by their laid out copy.
+    {
+        QScopedValueRollback<bool> layoutInBackground(m_layoutInBackground, m_textDocument->parent() == this);
+        this->syncNow();
+    }
+
+    // Nothing was left for the background, so we are done already.
+    if(m_printLayoutWatcher == nullptr)
+        emit printLayoutFinished();
+}
+
 /*
 This function is experiemental, which is the reason why we dont make it accessible via a button
 or menu option on the GUI. This function can be invoked only from the scripting interface, which
@@ -959,8 +1089,12 @@ void ScreenplayTextDocument::timerEvent(QTimerEvent *event)
 
 void ScreenplayTextDocument::init()
 {
+    m_lengthIndex = new ScreenplayLengthIndex(this);
+    ::screenplayTextDocuments().append(this);
+
     if(m_textDocument == nullptr)
         m_textDocument = new QTextDocument(this);
+    connect(m_textDocument, &QTextDocument::contentsChange, this, &ScreenplayTextDocument::onTextDocumentContentsChange);
 
 #ifdef DISPLAY_DOCUMENT_IN_TEXTEDIT
     m_sceneFrameFormat.setBorderStyle(QTextFrameFormat::BorderStyle_Solid);
@@ -1062,6 +1196,29 @@ inline void polishFontsAndInsertTextAtCursor(QTextCursor &cursor, const QString
 #include <QTextEdit>
 #endif // DISPLAY_DOCUMENT_IN_TEXTEDIT
 
+void ScreenplayTextDocument::beginBatchUpdate()
+{
+    if(m_batchUpdateDepth++ > 0)
+        return;
+
+    m_sceneResetTimer.stop();
+}
+
+void ScreenplayTextDocument::endBatchUpdate()
+{
+    if(m_batchUpdateDepth == 0 || --m_batchUpdateDepth > 0)
+        return;
+
+    m_sceneResetTimer.stop();
+    this->processSceneResetList();
+
+    if(m_syncEnabled)
+    {
+        m_pageBoundaryEvalTimer.stop();
+        this->evaluatePageBoundaries();
+    }
+}
+
 void ScreenplayTextDocument::loadScreenplay()
 {
 #ifdef DISPLAY_DOCUMENT_IN_TEXTEDIT
@@ -1098,6 +1255,7 @@ void ScreenplayTextDocument::loadScreenplay()
     m_textDocument->setProperty("#characterImageResourceUrls", QVariant());
     m_sceneResetTimer.stop();
     m_pageBoundaryEvalTimer.stop();
+    this->invalidatePageBoundaries();
 
     if(m_screenplay == nullptr)
         return;
@@ -1112,7 +1270,9 @@ void ScreenplayTextDocument::loadScreenplay()
     m_formatting->pageLayout()->configure(m_textDocument);
     m_textDocument->setIndentWidth(10);
 
-    if(m_sceneNumbers || (m_purpose == ForPrinting && m_syncEnabled) || m_sceneIcons)
+    // Documents laid out in the background are never laid out while they are being
+    // built, which is why handlers are registered with the copy that gets laid out.
+    if(!m_layoutInBackground && (m_sceneNumbers || (m_purpose == ForPrinting && m_syncEnabled) || m_sceneIcons))
     {
         ScreenplayTextObjectInterface *toi = m_textDocument->findChild<ScreenplayTextObjectInterface*>();
         if(toi == nullptr)
@@ -1143,7 +1303,7 @@ void ScreenplayTextDocument::loadScreenplay()
     if(m_titlePage)
     {
         ScreenplayTitlePageObjectInterface *tpoi = m_textDocument->findChild<ScreenplayTitlePageObjectInterface*>();
-        if(tpoi == nullptr)
+        if(tpoi == nullptr && !m_layoutInBackground)
         {
             tpoi = new ScreenplayTitlePageObjectInterface(m_textDocument);
             m_textDocument->documentLayout()->registerHandler(ScreenplayTitlePageObjectInterface::Kind, tpoi);
@@ -1204,11 +1364,24 @@ void ScreenplayTextDocument::loadScreenplay()
         cursor.insertText(element->breakTitle());
     };
 
+    m_printLayoutCancelled.storeRelease(0);
+    if(m_progressReport != nullptr)
+        m_progressReport->setProgressStep((m_purpose == ForPrinting ? 0.5 : 1.0)/qreal(m_screenplay->elementCount()));
+
     const int fsi = m_screenplay->firstSceneIndex();
     for(int i=0; i<m_screenplay->elementCount(); i++)
     {
         const ScreenplayElement *element = m_screenplay->elementAt(i);
 
+        if(m_progressReport != nullptr)
+        {
+            m_progressReport->setProgressText( QString("Formatting %1 of %2").arg(i+1).arg(m_screenplay->elementCount()) );
+            m_progressReport->tick();
+
+            if(this->isPrintLayoutCancelled())
+                break;
+        }
+
         if(!m_printEachSceneOnANewPage)
         {
             if(hasEpisdoes && element->elementType() == ScreenplayElement::BreakElementType && element->breakType() == Screenplay::Episode)
@@ -1290,316 +1463,1011 @@ void ScreenplayTextDocument::loadScreenplay()
         injection->inject(cursor, AbstractScreenplayTextDocumentInjectionInterface::AfterLastScene);
 
     this->includeMoreAndContdMarkers();
-    this->evaluatePageBoundariesLater();
+
+    // Page boundaries of documents being laid out in the background are evaluated
+    // once the layout is done.
+    if(m_printLayoutWatcher == nullptr)
+        this->evaluatePageBoundariesLater();
 }
 
-void ScreenplayTextDocument::includeMoreAndContdMarkers()
+struct ScreenplayPrintLayoutParams
 {
-    if(m_purpose != ForPrinting/* || m_syncEnabled*/)
-        return;
-
-    /**
-      When we print a screenplay, we expect it to do the following
-
-      1. Slug line or Scene Heading cannot come on the last line of the page
-      2. Character name cannot be on the last line of the page
-      3. If only one line of the dialogue can be squeezed into the last line of the page, then
-         we must move it to the next page along with the charactername.
-      4. If a dialogue spans across page break, then we must insert MORE and CONT'D markers, with character name.
-      */
-    const ScreenplayPageLayout *pageLayout = m_formatting->pageLayout();
-    const QMarginsF pageMargins = pageLayout->margins();
-    const QFont defaultFont = m_formatting->defaultFont();
-
-    m_textDocument->setDefaultFont(defaultFont);
-    pageLayout->configure(m_textDocument);
-
-    QAbstractTextDocumentLayout *layout = m_textDocument->documentLayout();
-    QTextCursor endCursor(m_textDocument);
-    endCursor.movePosition(QTextCursor::End);
+    bool titlePage = false;
+    int nrCharsPerDialogLine = 0;
+    QTextBlockFormat characterBlockFormat;
+    QTextCharFormat characterCharFormat;
+    QTextBlockFormat dialogueBlockFormat;
+    QTextCharFormat dialogueCharFormat;
+    QTextCharFormat contdMarkerFormat;
+    QHash<int,QTextCharFormat> moreMarkerFormats;
+};
 
-    int nrPages = m_textDocument->pageCount();
-    int pageIndex = m_titlePage ? 1 : 0;
+// Configures the document for printing and captures everything the layout passes need,
+// including a snapshot of each paragraph's scene element. Must be called from the thread
+// that owns the screenplay and its formatting.
+static ScreenplayPrintLayoutParams preparePrintLayout(QTextDocument *document, const ScreenplayFormat *format, bool titlePage)
+{
+    ScreenplayPrintLayoutParams params;
 
-    QRectF paperRect = pageLayout->paperRect();
+    const ScreenplayPageLayout *pageLayout = format->pageLayout();
+    document->setDefaultFont(format->defaultFont());
+    pageLayout->configure(document);
 
-    auto insertPageBreakAfter = [](const QTextBlock &block) {
-        QTextBlockFormat blockFormat;
-        blockFormat.setPageBreakPolicy(QTextBlockFormat::PageBreak_AlwaysAfter);
-        QTextCursor cursor(block);
-        cursor.setPosition(block.position());
-        cursor.setPosition(block.position()+block.length()-1, QTextCursor::KeepAnchor);
-        cursor.mergeBlockFormat(blockFormat);
-        cursor.clearSelection();
-    };
+    params.titlePage = titlePage;
 
-    const ScreenplayFormat *format = m_formatting;
     const SceneElementFormat *characterFormat = format->elementFormat(SceneElement::Character);
     const SceneElementFormat *dialogueFormat = format->elementFormat(SceneElement::Dialogue);
     const QFontMetricsF dialogFontMetrics(dialogueFormat->font());
-    const int nrCharsPerDialogLine = int(qCeil((pageLayout->contentWidth()-pageLayout->leftMargin()-pageLayout->rightMargin()-dialogueFormat->leftMargin()-dialogueFormat->rightMargin())/dialogFontMetrics.averageCharWidth()));
-
-    auto insertMarkers = [=](const QTextBlock &block) {
-        ScreenplayParagraphBlockData *blockData = ScreenplayParagraphBlockData::get(block);
-        if(blockData == nullptr)
-            return;
-
-        const QString characterName = blockData ? blockData->getCharacterElementText() : QString();
-        if(characterName.isEmpty())
-            return;
-
-        SceneElementFormat *elementFormat = format->elementFormat(blockData->elementType());
-        const QFont font = elementFormat->font();
-
-        QTextCursor cursor(block);
-        cursor.setPosition(block.position()+block.length()-1, QTextCursor::KeepAnchor);
-
-        const QTextBlockFormat restoreBlockFormat = cursor.blockFormat();
-        const QTextCharFormat restoreCharFormat = cursor.charFormat();
-
-        QTextBlockFormat pageBreakFormat;
-        pageBreakFormat.setPageBreakPolicy(QTextBlockFormat::PageBreak_AlwaysAfter);
-        cursor.mergeBlockFormat(pageBreakFormat);
-        cursor.clearSelection();
+    params.nrCharsPerDialogLine = int(qCeil((pageLayout->contentWidth()-pageLayout->leftMargin()-pageLayout->rightMargin()-dialogueFormat->leftMargin()-dialogueFormat->rightMargin())/dialogFontMetrics.averageCharWidth()));
+
+    params.characterBlockFormat = characterFormat->createBlockFormat();
+    params.characterBlockFormat.setTopMargin(0);
+    params.characterCharFormat = characterFormat->createCharFormat();
+    params.dialogueBlockFormat = dialogueFormat->createBlockFormat();
+    params.dialogueCharFormat = dialogueFormat->createCharFormat();
+
+    params.contdMarkerFormat.setObjectType(ScreenplayTextObjectInterface::Kind);
+    params.contdMarkerFormat.setFont(characterFormat->font());
+    params.contdMarkerFormat.setForeground(characterFormat->textColor());
+    params.contdMarkerFormat.setProperty(ScreenplayTextObjectInterface::TypeProperty, ScreenplayTextObjectInterface::ContdMarkerType);
+    params.contdMarkerFormat.setProperty(ScreenplayTextObjectInterface::DataProperty, QStringLiteral(" (CONT'D)"));
+
+    const QList<SceneElement::Type> markedTypes = QList<SceneElement::Type>() << SceneElement::Dialogue << SceneElement::Parenthetical;
+    Q_FOREACH(SceneElement::Type type, markedTypes)
+    {
+        const SceneElementFormat *elementFormat = format->elementFormat(type);
 
         QTextCharFormat moreMarkerFormat;
         moreMarkerFormat.setObjectType(ScreenplayTextObjectInterface::Kind);
-        moreMarkerFormat.setFont(font);
+        moreMarkerFormat.setFont(elementFormat->font());
         moreMarkerFormat.setForeground(elementFormat->textColor());
         moreMarkerFormat.setProperty(ScreenplayTextObjectInterface::TypeProperty, ScreenplayTextObjectInterface::MoreMarkerType);
         moreMarkerFormat.setProperty(ScreenplayTextObjectInterface::DataProperty, QStringLiteral("  (MORE)"));
-        cursor.insertText(QString(QChar::ObjectReplacementCharacter), moreMarkerFormat);
-
-        QTextBlockFormat characterBlockFormat = characterFormat->createBlockFormat();
-        QTextCharFormat characterCharFormat = characterFormat->createCharFormat();
-        characterBlockFormat.setTopMargin(0);
-        cursor.insertBlock(characterBlockFormat, characterCharFormat);
-        // cursor.insertText(characterName);
-        if(m_purpose == ForDisplay)
-            cursor.insertText(characterName);
-        else
-            polishFontsAndInsertTextAtCursor(cursor, characterName);
-
-        QTextCharFormat contdMarkerFormat;
-        contdMarkerFormat.setObjectType(ScreenplayTextObjectInterface::Kind);
-        contdMarkerFormat.setFont(characterFormat->font());
-        contdMarkerFormat.setForeground(characterFormat->textColor());
-        contdMarkerFormat.setProperty(ScreenplayTextObjectInterface::TypeProperty, ScreenplayTextObjectInterface::ContdMarkerType);
-        contdMarkerFormat.setProperty(ScreenplayTextObjectInterface::DataProperty, QStringLiteral(" (CONT'D)"));
-        cursor.insertText(QString(QChar::ObjectReplacementCharacter), contdMarkerFormat);
-    };
+        params.moreMarkerFormats.insert(type, moreMarkerFormat);
+    }
 
-    while(pageIndex < nrPages)
+    QTextBlock block = document->firstBlock();
+    while(block.isValid())
     {
-        paperRect = QRectF(0, pageIndex*paperRect.height(), paperRect.width(), paperRect.height());
-        const QRectF contentsRect = paperRect.adjusted(pageMargins.left(), pageMargins.top(), -pageMargins.right(), -pageMargins.bottom());
-        const int lastPosition = pageIndex == nrPages-1 ? endCursor.position() : layout->hitTest(contentsRect.bottomRight(), Qt::FuzzyHit);
+        ScreenplayParagraphBlockData *blockData = ScreenplayParagraphBlockData::get(block);
+        if(blockData)
+            blockData->snapshot();
+        block = block.next();
+    }
 
-        QTextCursor cursor(m_textDocument);
-        cursor.setPosition(lastPosition-1);
+    return params;
+}
 
-        QTextBlock block = cursor.block();
-        ScreenplayParagraphBlockData *blockData = ScreenplayParagraphBlockData::get(block);
-        if(blockData == nullptr)
-        {
-            block = block.previous();
-            blockData = ScreenplayParagraphBlockData::get(block);
-        }
+/**
+  When we print a screenplay, we expect it to do the following
+
+  1. Slug line or Scene Heading cannot come on the last line of the page
+  2. Character name cannot be on the last line of the page
+  3. If only one line of the dialogue can be squeezed into the last line of the page, then
+     we must move it to the next page along with the charactername.
+  4. If a dialogue spans across page break, then we must insert MORE and CONT'D markers, with character name.
+
+  Inserting a page break or a marker into the document invalidates its layout from that point
+  onwards, so asking the document where each page ends after every such change costs one
+  layout of the rest of the document per page.
+
+  ScreenplayPageBreaker lays the document out just once, measures lines of every paragraph
+  and the space between paragraphs, and fills pages with those measurements the same way
+  QTextDocumentLayout would. When a page calls for a break or a MORE/CONT'D split, only the
+  paragraphs from that point are placed again. The changes it decides upon are applied to
+  the document in one batch, after the last page has been evaluated.
+  */
+class ScreenplayPageBreaker
+{
+public:
+    ScreenplayPageBreaker(QTextDocument *document, const ScreenplayPrintLayoutParams &params);
+    ~ScreenplayPageBreaker();
 
-        if(blockData)
-        {
-            switch(blockData->elementType())
-            {
-            case SceneElement::Character: {
-                const SceneElement *element = blockData->element();
-                if(element->scene()->elementAt(0) == element)
-                    block = block.previous();
-                insertPageBreakAfter(block.previous());
-                } break;
-            case SceneElement::Heading:
-                insertPageBreakAfter(block.previous());
-                break;
-            case SceneElement::Transition:
-            case SceneElement::Shot:
-            case SceneElement::Action:
-                break; // do nothing for these
-            case SceneElement::Parenthetical: {
-                QTextBlock previousBlock = block.previous();
-                ScreenplayParagraphBlockData *previousBlockData = ScreenplayParagraphBlockData::get(previousBlock);
-                if(previousBlockData) {
-                    if(previousBlockData->elementType() == SceneElement::Character) {
-                        previousBlock = previousBlock.previous();
-                        insertPageBreakAfter(previousBlock);
-                    } else if(previousBlockData->elementType() == SceneElement::Dialogue) {
-                        insertMarkers(previousBlock);
-                    }
-                }
-                } break;
-            case SceneElement::Dialogue:
-                if(block.position()+block.length()-1 > lastPosition) {
-                    const QString blockText = block.text();
-                    const SceneElement *dialogElement = blockData->element();
-
-                    cursor.movePosition(QTextCursor::StartOfBlock, QTextCursor::KeepAnchor, 1);
-
-                    QString blockTextPart1 = cursor.selectedText();
-                    blockTextPart1.chop(nrCharsPerDialogLine);
-                    while(blockTextPart1.length() && !blockTextPart1.at(blockTextPart1.length()-1).isSpace())
-                        blockTextPart1.chop(1);
-                    blockTextPart1.chop(1);
-
-                    // if(blockTextPart1.length() < nrCharsPerDialogLine) {
-                    if(blockTextPart1.isEmpty()) {
-                        QTextBlock previousBlock = block.previous();
-                        ScreenplayParagraphBlockData *previousBlockData = ScreenplayParagraphBlockData::get(previousBlock);
-                        if(previousBlockData->elementType() == SceneElement::Character) {
-                            if(previousBlockData->isFirstElementInScene())
-                                previousBlock = previousBlock.previous();
-                            insertPageBreakAfter(previousBlock.previous());
-                            break;
-                        }
-                    }
+    // Returns false if it was cancelled before evaluating all pages.
+    bool evaluate(const QAtomicInt *cancelled, const std::function<void(int,int)> &progress);
+    void apply();
 
-                    QString blockTextPart2 = blockTextPart1.isEmpty() ? blockText :
-                                             blockText.mid(blockTextPart1.length()+1);
-                                             // Why +1? Because we want to skip the space
-                                             // between blockTextPart1 & blockTextPart2.
+private:
+    struct Line
+    {
+        int start = 0;
+        int length = 0;
+        qreal height = 0;
+        qreal advance = 0;
+        int page = 0;
+    };
 
-                    cursor.clearSelection();
-                    cursor.select(QTextCursor::BlockUnderCursor);
-                    cursor.removeSelectedText();
+    struct Paragraph
+    {
+        QTextBlock block; // invalid for the CONT'D paragraphs we add
+        int from = 0;     // range of text in block that this paragraph holds
+        int to = 0;
+        ScreenplayParagraphBlockData *data = nullptr;
+        int spacingType = -1;
+        QTextBlockFormat format;
+        bool firstInFrame = false;
+        bool frameBreakBefore = false;
+        qreal frameTopMargin = 0;
+        bool hasSpace = false;
+        qreal space = 0;
+        bool hasBreakSpace = false;
+        qreal breakSpace = 0;
+        QVector<Line> lines;
+        int startPage = 0;
+        qreal startY = 0;
+        int endPage = 0;
+
+        int length() const { return to-from; }
+        QString text() const { return block.text().mid(from, to-from); }
+        int elementType() const { return data ? data->elementType() : -1; }
+    };
 
-                    QTextBlockFormat dialogBlockFormat = dialogueFormat->createBlockFormat();
-                    QTextCharFormat dialogCharFormat = dialogueFormat->createCharFormat();
-                    cursor.insertBlock(dialogBlockFormat, dialogCharFormat);
-                    if(m_purpose == ForDisplay)
-                        cursor.insertText(blockTextPart1);
-                    else
-                        polishFontsAndInsertTextAtCursor(cursor, blockTextPart1);
-                    block = cursor.block();
-                    block.setUserData(new ScreenplayParagraphBlockData(dialogElement));
+    struct Decision
+    {
+        enum Kind { PageBreakAfter, Markers, SplitDialogue };
+        Kind kind = PageBreakAfter;
+        int position = 0;
+        bool dropSpace = false;
+        QTextFormat::PageBreakFlags headPolicy = QTextFormat::PageBreak_Auto;
+        QTextFormat::PageBreakFlags sourcePolicy = QTextFormat::PageBreak_Auto;
+    };
 
-                    cursor.insertBlock(dialogBlockFormat, dialogCharFormat);
-                    if(m_purpose == ForDisplay)
-                        cursor.insertText(blockTextPart2);
-                    else
-                        polishFontsAndInsertTextAtCursor(cursor, blockTextPart2);
-                    block = cursor.block();
-                    block.setUserData(new ScreenplayParagraphBlockData(dialogElement));
+    void measureDocument();
+    QVector<Line> measure(const QTextBlockFormat &format, const std::function<void(QTextCursor&)> &fill);
+    QVector<Line> measure(const Paragraph &para, const QTextCharFormat &markerFormat=QTextCharFormat());
 
-                    insertMarkers(block.previous());
-                }
-                break;
-            }
-        }
+    bool isPageBreakBefore(int index) const;
+    qreal spaceBefore(int index, bool afterPageBreak) const;
+    void place(int index);
+    void rewind(int index);
 
-        nrPages = layout->pageCount();
-        ++pageIndex;
+    void evaluatePage(int pageIndex);
+    void breakAfter(int index, int pageIndex);
+    void includeMarkers(int index);
+    void addMarkers(int index);
+    void splitDialogue(int index, int at, bool dropSpace);
+
+    void insertPageBreakAfter(const QTextBlock &block);
+    void insertMarkers(const QTextBlock &block);
+
+    static int spacingKey(int previousType, int type, bool firstInFrame) {
+        return ((previousType+2) << 16) | ((type+2) << 1) | (firstInFrame ? 1 : 0);
     }
-}
 
-void ScreenplayTextDocument::loadScreenplayLater()
+private:
+    QTextDocument *m_document = nullptr;
+    const ScreenplayPrintLayoutParams &m_params;
+    QTextDocument m_scratchDocument;
+    QTextFrameFormat m_rootFrameFormat;
+    qreal m_pageHeight = 0;
+    qreal m_contentsHeight = 0;
+    int m_initialPageCount = 0;
+    int m_pageCount = 0;
+
+    QList<Paragraph> m_paragraphs;
+    QHash<int,qreal> m_spaces;
+    QHash<int,qreal> m_breakSpaces;
+    QList<Decision> m_decisions;
+
+    int m_next = 0;
+    int m_page = 0;
+    qreal m_y = 0;
+};
+
+ScreenplayPageBreaker::ScreenplayPageBreaker(QTextDocument *document, const ScreenplayPrintLayoutParams &params)
+    : m_document(document), m_params(params)
 {
-    if(m_textDocument != nullptr)
-        m_textDocument->clear();
+    m_rootFrameFormat = document->rootFrame()->frameFormat();
+    m_pageHeight = document->pageSize().height();
+    m_contentsHeight = m_pageHeight - m_rootFrameFormat.topMargin() - m_rootFrameFormat.bottomMargin();
 
-    if(m_syncEnabled)
-    {
-        this->disconnectFromScreenplaySignals();
-        this->disconnectFromScreenplayFormatSignals();
+    // Paragraphs we split or mark are measured in here, without touching the document.
+    m_scratchDocument.setDefaultFont(document->defaultFont());
+    m_scratchDocument.setDocumentMargin(document->documentMargin());
+    m_scratchDocument.setDefaultTextOption(document->defaultTextOption());
+    m_scratchDocument.setTextWidth(document->pageSize().width());
 
-        const bool updateWasScheduled = m_loadScreenplayTimer.isActive();
-        m_loadScreenplayTimer.start(50, this);
-        if(!updateWasScheduled)
-            emit updateScheduled();
-    }
+    ScreenplayTextObjectInterface *toi = document->findChild<ScreenplayTextObjectInterface*>();
+    if(toi != nullptr)
+        m_scratchDocument.documentLayout()->registerHandler(ScreenplayTextObjectInterface::Kind, toi);
+
+    this->measureDocument();
 }
 
-void ScreenplayTextDocument::resetScreenplay()
+ScreenplayPageBreaker::~ScreenplayPageBreaker()
 {
-    m_screenplay = nullptr;
-    this->loadScreenplayLater();
-    emit screenplayChanged();
+
 }
 
-void ScreenplayTextDocument::connectToScreenplaySignals()
+bool ScreenplayPageBreaker::evaluate(const QAtomicInt *cancelled, const std::function<void(int,int)> &progress)
 {
-    if(m_screenplay == nullptr || !m_syncEnabled || m_connectedToScreenplaySignals)
-        return;
-
-    connect(m_screenplay, &Screenplay::elementMoved, this, &ScreenplayTextDocument::onSceneMoved);
-    connect(m_screenplay, &Screenplay::modelReset, this, &ScreenplayTextDocument::onScreenplayReset);
-    connect(m_screenplay, &Screenplay::elementRemoved, this, &ScreenplayTextDocument::onSceneRemoved);
-    connect(m_screenplay, &Screenplay::elementInserted, this, &ScreenplayTextDocument::onSceneInserted);
-    connect(m_screenplay, &Screenplay::activeSceneChanged, this, &ScreenplayTextDocument::onActiveSceneChanged);
-    connect(m_screenplay, &Screenplay::modelAboutToBeReset, this, &ScreenplayTextDocument::onScreenplayAboutToReset);
+    m_next = 0;
+    m_page = 0;
+    m_y = 0;
+    m_decisions.clear();
 
-    for(int i=0; i<m_screenplay->elementCount(); i++)
+    int pageIndex = m_params.titlePage ? 1 : 0;
+    while(1)
     {
-        ScreenplayElement *element = m_screenplay->elementAt(i);
-        Scene *scene = element->scene();
-        if(scene == nullptr)
-            continue;
-
-        this->connectToSceneSignals(scene);
-    }
+        if(cancelled != nullptr && cancelled->loadAcquire())
+            return false;
 
-    this->onActiveSceneChanged();
-
-    m_connectedToScreenplaySignals = true;
-}
+        // Place paragraphs until we know where pageIndex ends
+        while(m_next < m_paragraphs.size() && (m_next == 0 || m_paragraphs.at(m_next-1).endPage <= pageIndex))
+            this->place(m_next++);
 
-void ScreenplayTextDocument::connectToScreenplayFormatSignals()
-{
-    if(m_formatting == nullptr || !m_syncEnabled || m_connectedToFormattingSignals)
-        return;
+        m_pageCount = m_page+1;
+        if(pageIndex >= m_pageCount)
+            break;
 
-    connect(m_formatting, &ScreenplayFormat::defaultFontChanged, this, &ScreenplayTextDocument::onDefaultFontChanged);
-    connect(m_formatting, &ScreenplayFormat::screenChanged, this, &ScreenplayTextDocument::onFormatScreenChanged);
-    connect(m_formatting, &ScreenplayFormat::fontPointSizeDeltaChanged, this, &ScreenplayTextDocument::onFormatFontPointSizeDeltaChanged);
+        if(progress)
+            progress(pageIndex, qMax(m_pageCount, m_initialPageCount));
 
-    for(int i=SceneElement::Min; i<=SceneElement::Max; i++)
-    {
-        SceneElementFormat *elementFormat = m_formatting->elementFormat(i);
-        connect(elementFormat, &SceneElementFormat::elementFormatChanged, this, &ScreenplayTextDocument::onElementFormatChanged);
+        this->evaluatePage(pageIndex);
+        ++pageIndex;
     }
 
-    m_connectedToFormattingSignals = true;
+    return true;
 }
 
-void ScreenplayTextDocument::disconnectFromScreenplaySignals()
+void ScreenplayPageBreaker::apply()
 {
-    if(m_screenplay == nullptr || !m_connectedToScreenplaySignals)
-        return;
+    // Changes are applied from the end of the document towards its beginning, so that
+    // positions recorded against the unchanged document remain valid throughout.
+    std::stable_sort(m_decisions.begin(), m_decisions.end(), [](const Decision &a, const Decision &b) {
+        return a.position > b.position;
+    });
 
-    disconnect(m_screenplay, &Screenplay::elementMoved, this, &ScreenplayTextDocument::onSceneMoved);
-    disconnect(m_screenplay, &Screenplay::modelReset, this, &ScreenplayTextDocument::onScreenplayReset);
-    disconnect(m_screenplay, &Screenplay::elementRemoved, this, &ScreenplayTextDocument::onSceneRemoved);
-    disconnect(m_screenplay, &Screenplay::elementInserted, this, &ScreenplayTextDocument::onSceneInserted);
-    disconnect(m_screenplay, &Screenplay::activeSceneChanged, this, &ScreenplayTextDocument::onActiveSceneChanged);
-    disconnect(m_screenplay, &Screenplay::modelAboutToBeReset, this, &ScreenplayTextDocument::onScreenplayAboutToReset);
+    QTextCursor editCursor(m_document);
+    editCursor.beginEditBlock();
 
-    for(int i=0; i<m_screenplay->elementCount(); i++)
+    Q_FOREACH(Decision decision, m_decisions)
     {
-        ScreenplayElement *element = m_screenplay->elementAt(i);
-        Scene *scene = element->scene();
-        if(scene == nullptr)
+        QTextBlock block = m_document->findBlock(decision.position);
+        if(!block.isValid())
             continue;
 
-        this->disconnectFromSceneSignals(scene);
+        switch(decision.kind)
+        {
+        case Decision::PageBreakAfter:
+            this->insertPageBreakAfter(block);
+            break;
+        case Decision::Markers:
+            this->insertMarkers(block);
+            break;
+        case Decision::SplitDialogue: {
+            ScreenplayParagraphBlockData *blockData = ScreenplayParagraphBlockData::get(block);
+            if(blockData == nullptr)
+                break;
+
+            // Split the paragraph in place, so that both parts keep the fonts they were
+            // formatted with. Page breaks added to this block by decisions that come later
+            // in the document belong to the second part.
+            const ScreenplayParagraphBlockData dialogBlockData(*blockData);
+            const QTextFormat::PageBreakFlags pageBreakPolicy = block.blockFormat().pageBreakPolicy();
+
+            QTextBlockFormat tailFormat = m_params.dialogueBlockFormat;
+            if(pageBreakPolicy != decision.sourcePolicy)
+                tailFormat.setPageBreakPolicy(pageBreakPolicy);
+
+            QTextCursor cursor(m_document);
+            cursor.setPosition(decision.position);
+            if(decision.dropSpace)
+                cursor.setPosition(decision.position+1, QTextCursor::KeepAnchor);
+            cursor.insertBlock(tailFormat, m_params.dialogueCharFormat);
+
+            block = cursor.block();
+            block.setUserData(new ScreenplayParagraphBlockData(dialogBlockData));
+            block.previous().setUserData(new ScreenplayParagraphBlockData(dialogBlockData));
+
+            QTextBlockFormat headFormat;
+            headFormat.setPageBreakPolicy(decision.headPolicy);
+            QTextCursor headCursor(block.previous());
+            headCursor.mergeBlockFormat(headFormat);
+
+            this->insertMarkers(block.previous());
+            } break;
+        }
     }
 
-    m_connectedToScreenplaySignals = false;
+    editCursor.endEditBlock();
 }
 
-void ScreenplayTextDocument::disconnectFromScreenplayFormatSignals()
+void ScreenplayPageBreaker::measureDocument()
 {
-    if(m_formatting == nullptr || !m_connectedToFormattingSignals)
-        return;
+    QAbstractTextDocumentLayout *layout = m_document->documentLayout();
+    m_initialPageCount = m_document->pageCount();
 
-    disconnect(m_formatting, &ScreenplayFormat::defaultFontChanged, this, &ScreenplayTextDocument::onDefaultFontChanged);
-    disconnect(m_formatting, &ScreenplayFormat::screenChanged, this, &ScreenplayTextDocument::onFormatScreenChanged);
-    disconnect(m_formatting, &ScreenplayFormat::fontPointSizeDeltaChanged, this, &ScreenplayTextDocument::onFormatFontPointSizeDeltaChanged);
+    const qreal contentsTop = m_rootFrameFormat.topMargin();
+    int previousPage = -1;
+    qreal previousBottom = 0;
+
+    QTextBlock block = m_document->firstBlock();
+    while(block.isValid())
+    {
+        Paragraph para;
+        para.block = block;
+        para.to = block.length()-1;
+        para.data = ScreenplayParagraphBlockData::get(block);
+        para.spacingType = para.elementType();
+        para.format = block.blockFormat();
+
+        QTextFrame *frame = QTextCursor(block).currentFrame();
+        if(frame != nullptr && frame != m_document->rootFrame() && frame->firstPosition() == block.position())
+        {
+            const QTextFrameFormat frameFormat = frame->frameFormat();
+            para.firstInFrame = true;
+            para.frameTopMargin = frameFormat.topMargin();
+            para.frameBreakBefore = frameFormat.pageBreakPolicy() & QTextFormat::PageBreak_AlwaysBefore;
+        }
+
+        const QRectF blockRect = layout->blockBoundingRect(block);
+        const QTextLayout *blockLayout = block.layout();
+        QVector<qreal> lineY;
+        for(int i=0; i<blockLayout->lineCount(); i++)
+        {
+            const QTextLine textLine = blockLayout->lineAt(i);
+            const qreal y = blockRect.top() + textLine.y();
+
+            Line line;
+            line.start = textLine.textStart();
+            line.length = textLine.textLength();
+            line.height = para.format.lineHeight(textLine.height(), 1.0);
+            line.advance = line.height;
+            line.page = int(y/m_pageHeight);
+            lineY.append(y - line.page*m_pageHeight - contentsTop);
+
+            if(i > 0 && para.lines.last().page == line.page)
+                para.lines.last().advance = lineY.at(i) - lineY.at(i-1);
+
+            para.lines.append(line);
+        }
+
+        const int index = m_paragraphs.size();
+        m_paragraphs.append(para);
+
+        if(!para.lines.isEmpty())
+        {
+            Paragraph &p = m_paragraphs.last();
+            const int previousType = index > 0 ? m_paragraphs.at(index-1).spacingType : -1;
+            if(index == 0 || this->isPageBreakBefore(index))
+            {
+                p.hasBreakSpace = true;
+                p.breakSpace = lineY.first();
+                m_breakSpaces.insert(spacingKey(-1, p.spacingType, p.firstInFrame), p.breakSpace);
+            }
+            else if(previousPage == p.lines.first().page)
+            {
+                p.hasSpace = true;
+                p.space = lineY.first() - previousBottom;
+                m_spaces.insert(spacingKey(previousType, p.spacingType, p.firstInFrame), p.space);
+            }
+
+            previousPage = p.lines.last().page;
+            previousBottom = lineY.last() + p.lines.last().height;
+        }
+
+        block = block.next();
+    }
+}
+
+QVector<ScreenplayPageBreaker::Line> ScreenplayPageBreaker::measure(const QTextBlockFormat &format, const std::function<void (QTextCursor &)> &fill)
+{
+    m_scratchDocument.clear();
+    m_scratchDocument.rootFrame()->setFrameFormat(m_rootFrameFormat);
+
+    QTextCursor cursor(&m_scratchDocument);
+    cursor.setBlockFormat(format);
+    fill(cursor);
+    m_scratchDocument.documentLayout()->documentSize();
+
+    QVector<Line> lines;
+    const QTextLayout *layout = m_scratchDocument.firstBlock().layout();
+    for(int i=0; i<layout->lineCount(); i++)
+    {
+        const QTextLine textLine = layout->lineAt(i);
+
+        Line line;
+        line.start = textLine.textStart();
+        line.length = textLine.textLength();
+        line.height = format.lineHeight(textLine.height(), 1.0);
+        line.advance = i+1 < layout->lineCount() ? layout->lineAt(i+1).y() - textLine.y() : line.height;
+        lines.append(line);
+    }
+
+    return lines;
+}
+
+QVector<ScreenplayPageBreaker::Line> ScreenplayPageBreaker::measure(const Paragraph &para, const QTextCharFormat &markerFormat)
+{
+    return this->measure(para.format, [&](QTextCursor &cursor) {
+        if(para.length() > 0)
+        {
+            QTextCursor source(para.block);
+            source.setPosition(para.block.position()+para.from);
+            source.setPosition(para.block.position()+para.to, QTextCursor::KeepAnchor);
+            cursor.insertFragment(source.selection());
+        }
+
+        if(markerFormat.objectType() == ScreenplayTextObjectInterface::Kind)
+            cursor.insertText(QString(QChar::ObjectReplacementCharacter), markerFormat);
+    });
+}
+
+bool ScreenplayPageBreaker::isPageBreakBefore(int index) const
+{
+    const Paragraph &para = m_paragraphs.at(index);
+    if(para.frameBreakBefore || (para.format.pageBreakPolicy() & QTextFormat::PageBreak_AlwaysBefore))
+        return true;
+
+    return index > 0 && (m_paragraphs.at(index-1).format.pageBreakPolicy() & QTextFormat::PageBreak_AlwaysAfter);
+}
+
+qreal ScreenplayPageBreaker::spaceBefore(int index, bool afterPageBreak) const
+{
+    // Space measured for this paragraph is used as is. Paragraphs that were pushed to a new
+    // page in the initial layout, or whose neighbours have changed since, get the space
+    // measured elsewhere between paragraphs of the same kind.
+    const Paragraph &para = m_paragraphs.at(index);
+    if(afterPageBreak)
+    {
+        if(para.hasBreakSpace)
+            return para.breakSpace;
+
+        const int key = spacingKey(-1, para.spacingType, para.firstInFrame);
+        if(m_breakSpaces.contains(key))
+            return m_breakSpaces.value(key);
+
+        return para.format.topMargin() + para.frameTopMargin;
+    }
+
+    if(para.hasSpace)
+        return para.space;
+
+    const Paragraph *previous = index > 0 ? &m_paragraphs.at(index-1) : nullptr;
+    const int key = spacingKey(previous ? previous->spacingType : -1, para.spacingType, para.firstInFrame);
+    if(m_spaces.contains(key))
+        return m_spaces.value(key);
+
+    return (previous ? previous->format.bottomMargin() : 0) + para.format.topMargin() + para.frameTopMargin;
+}
+
+void ScreenplayPageBreaker::place(int index)
+{
+    Paragraph &para = m_paragraphs[index];
+    para.startPage = m_page;
+    para.startY = m_y;
+
+    if(index == 0)
+        m_y = this->spaceBefore(index, true);
+    else if(this->isPageBreakBefore(index))
+    {
+        ++m_page;
+        m_y = this->spaceBefore(index, true);
+    }
+    else
+        m_y += this->spaceBefore(index, false);
+
+    for(Line &line : para.lines)
+    {
+        if(m_y > 0 && m_y + line.height > m_contentsHeight)
+        {
+            ++m_page;
+            m_y = 0;
+        }
+
+        line.page = m_page;
+        m_y += line.advance;
+    }
+
+    para.endPage = m_page;
+}
+
+void ScreenplayPageBreaker::rewind(int index)
+{
+    if(index >= m_paragraphs.size())
+        return;
+
+    const Paragraph &para = m_paragraphs.at(index);
+    m_next = index;
+    m_page = para.startPage;
+    m_y = para.startY;
+}
+
+void ScreenplayPageBreaker::evaluatePage(int pageIndex)
+{
+    // Find the paragraph and offset at which pageIndex ends
+    int index = -1;
+    int offset = 0;
+    if(m_next == m_paragraphs.size() && pageIndex == m_page)
+    {
+        index = m_paragraphs.size()-1;
+        offset = m_paragraphs.last().length();
+    }
+    else
+    {
+        for(int i=m_next-1; i>=0 && index<0; i--)
+        {
+            const Paragraph &para = m_paragraphs.at(i);
+            for(int j=para.lines.size()-1; j>=0; j--)
+            {
+                const Line &line = para.lines.at(j);
+                if(line.page == pageIndex)
+                {
+                    index = i;
+                    offset = line.start + line.length;
+                    break;
+                }
+            }
+
+            if(!para.lines.isEmpty() && para.lines.first().page < pageIndex)
+                break;
+        }
+    }
+
+    if(index < 0)
+        return;
+
+    // The paragraph holding the last character on the page.
+    int current = offset > 0 ? index : index-1;
+    if(current >= 0 && m_paragraphs.at(current).data == nullptr)
+        --current;
+    if(current < 0 || m_paragraphs.at(current).data == nullptr)
+        return;
+
+    const Paragraph &para = m_paragraphs.at(current);
+    switch(para.elementType())
+    {
+    case SceneElement::Character:
+        this->breakAfter(para.data->isFirstElementInScene() ? current-2 : current-1, pageIndex);
+        break;
+    case SceneElement::Heading:
+        this->breakAfter(current-1, pageIndex);
+        break;
+    case SceneElement::Transition:
+    case SceneElement::Shot:
+    case SceneElement::Action:
+        break; // do nothing for these
+    case SceneElement::Parenthetical:
+        if(current > 0) {
+            const Paragraph &previous = m_paragraphs.at(current-1);
+            if(previous.elementType() == SceneElement::Character)
+                this->breakAfter(current-2, pageIndex);
+            else if(previous.elementType() == SceneElement::Dialogue)
+                this->includeMarkers(current-1);
+        }
+        break;
+    case SceneElement::Dialogue:
+        if(current == index && para.length() > offset) {
+            QString textPart1 = para.text().left(offset-1);
+            textPart1.chop(m_params.nrCharsPerDialogLine);
+            while(textPart1.length() && !textPart1.at(textPart1.length()-1).isSpace())
+                textPart1.chop(1);
+            textPart1.chop(1);
+
+            if(textPart1.isEmpty() && current > 0) {
+                const Paragraph &previous = m_paragraphs.at(current-1);
+                if(previous.elementType() == SceneElement::Character) {
+                    this->breakAfter(previous.data->isFirstElementInScene() ? current-3 : current-2, pageIndex);
+                    break;
+                }
+            }
+
+            this->splitDialogue(current, textPart1.length(), !textPart1.isEmpty());
+        }
+        break;
+    }
+}
+
+void ScreenplayPageBreaker::breakAfter(int index, int pageIndex)
+{
+    if(index < 0)
+        return;
+
+    // We only push paragraphs from the end of pageIndex to the next page. A break that
+    // would have to go into an earlier page is left out.
+    Paragraph &para = m_paragraphs[index];
+    if(!para.block.isValid() || para.lines.isEmpty() || para.lines.last().page != pageIndex)
+        return;
+
+    para.format.setPageBreakPolicy(QTextFormat::PageBreak_AlwaysAfter);
+
+    Decision decision;
+    decision.kind = Decision::PageBreakAfter;
+    decision.position = para.block.position() + para.to;
+    m_decisions.append(decision);
+
+    this->rewind(index+1);
+}
+
+void ScreenplayPageBreaker::includeMarkers(int index)
+{
+    const Paragraph &para = m_paragraphs.at(index);
+    if(!para.block.isValid() || para.data == nullptr || para.data->getCharacterElementText().isEmpty())
+        return;
+
+    Decision decision;
+    decision.kind = Decision::Markers;
+    decision.position = para.block.position() + para.to;
+    m_decisions.append(decision);
+
+    this->addMarkers(index);
+    this->rewind(index);
+}
+
+void ScreenplayPageBreaker::addMarkers(int index)
+{
+    Paragraph &para = m_paragraphs[index];
+    para.format.setPageBreakPolicy(QTextFormat::PageBreak_AlwaysAfter);
+    para.lines = this->measure(para, m_params.moreMarkerFormats.value(para.elementType()));
+
+    const ScreenplayParagraphBlockData *blockData = para.data;
+
+    Paragraph contd;
+    contd.spacingType = SceneElement::Character;
+    contd.format = m_params.characterBlockFormat;
+    contd.hasBreakSpace = true;
+    contd.breakSpace = contd.format.topMargin();
+    contd.lines = this->measure(contd.format, [=](QTextCursor &cursor) {
+        cursor.setCharFormat(m_params.characterCharFormat);
+        Q_FOREACH(ScreenplayParagraphBlockData::TextRun run, blockData->characterElementTextRuns())
+        {
+            QTextCharFormat format;
+            format.setFontFamily(run.fontFamily);
+            cursor.mergeCharFormat(format);
+            cursor.insertText(run.text);
+        }
+        cursor.insertText(QString(QChar::ObjectReplacementCharacter), m_params.contdMarkerFormat);
+    });
+    m_paragraphs.insert(index+1, contd);
+
+    if(index+2 < m_paragraphs.size())
+        m_paragraphs[index+2].hasSpace = false;
+}
+
+void ScreenplayPageBreaker::splitDialogue(int index, int at, bool dropSpace)
+{
+    const Paragraph para = m_paragraphs.at(index);
+
+    Decision decision;
+    decision.kind = Decision::SplitDialogue;
+    decision.position = para.block.position() + para.from + at;
+    decision.dropSpace = dropSpace;
+    decision.headPolicy = para.format.pageBreakPolicy();
+    decision.sourcePolicy = para.block.blockFormat().pageBreakPolicy();
+    m_decisions.append(decision);
+
+    Paragraph head = para;
+    head.to = para.from + at;
+    head.lines = this->measure(head);
+
+    Paragraph tail = para;
+    tail.from = head.to + (dropSpace ? 1 : 0);
+    tail.format = m_params.dialogueBlockFormat;
+    tail.firstInFrame = false;
+    tail.frameBreakBefore = false;
+    tail.frameTopMargin = 0;
+    tail.hasSpace = false;
+    tail.hasBreakSpace = false;
+    tail.lines = this->measure(tail);
+
+    m_paragraphs[index] = head;
+    m_paragraphs.insert(index+1, tail);
+
+    if(para.data != nullptr && !para.data->getCharacterElementText().isEmpty())
+        this->addMarkers(index);
+
+    this->rewind(index);
+}
+
+void ScreenplayPageBreaker::insertPageBreakAfter(const QTextBlock &block)
+{
+    QTextBlockFormat blockFormat;
+    blockFormat.setPageBreakPolicy(QTextBlockFormat::PageBreak_AlwaysAfter);
+    QTextCursor cursor(block);
+    cursor.setPosition(block.position());
+    cursor.setPosition(block.position()+block.length()-1, QTextCursor::KeepAnchor);
+    cursor.mergeBlockFormat(blockFormat);
+    cursor.clearSelection();
+}
+
+void ScreenplayPageBreaker::insertMarkers(const QTextBlock &block)
+{
+    ScreenplayParagraphBlockData *blockData = ScreenplayParagraphBlockData::get(block);
+    if(blockData == nullptr)
+        return;
+
+    const QString characterName = blockData->getCharacterElementText();
+    if(characterName.isEmpty())
+        return;
+
+    QTextCursor cursor(block);
+    cursor.setPosition(block.position()+block.length()-1, QTextCursor::KeepAnchor);
+
+    QTextBlockFormat pageBreakFormat;
+    pageBreakFormat.setPageBreakPolicy(QTextBlockFormat::PageBreak_AlwaysAfter);
+    cursor.mergeBlockFormat(pageBreakFormat);
+    cursor.clearSelection();
+
+    cursor.insertText(QString(QChar::ObjectReplacementCharacter), m_params.moreMarkerFormats.value(blockData->elementType()));
+
+    cursor.insertBlock(m_params.characterBlockFormat, m_params.characterCharFormat);
+    Q_FOREACH(ScreenplayParagraphBlockData::TextRun run, blockData->characterElementTextRuns())
+    {
+        QTextCharFormat format;
+        format.setFontFamily(run.fontFamily);
+        cursor.mergeCharFormat(format);
+        cursor.insertText(run.text);
+    }
+
+    cursor.insertText(QString(QChar::ObjectReplacementCharacter), m_params.contdMarkerFormat);
+}
+
+// tools/pagebreakcheck compiles this file along with the hit testing page breaker that
+// ScreenplayPageBreaker replaced, and sets this to it, so that it can compare page breaks
+// decided by both. It is never set in Scrite itself.
+static int (*referencePageBreaker)(QTextDocument *document, const ScreenplayPrintLayoutParams &params,
+                                   const QAtomicInt *cancelled, const std::function<void(int,int)> &progress) = nullptr;
+
+// Works only with the document and the params, so it can be run on any thread that
+// owns the document. Returns the number of pages in the document.
+static int includeMoreAndContdMarkers(QTextDocument *document, const ScreenplayPrintLayoutParams &params,
+                                      const QAtomicInt *cancelled, const std::function<void(int,int)> &progress)
+{
+    if(referencePageBreaker != nullptr)
+        return referencePageBreaker(document, params, cancelled, progress);
+
+    ScreenplayPageBreaker pageBreaker(document, params);
+    if(pageBreaker.evaluate(cancelled, progress))
+        pageBreaker.apply();
+
+    return document->pageCount();
+}
+
+void ScreenplayTextDocument::includeMoreAndContdMarkers()
+{
+    if(m_purpose != ForPrinting/* || m_syncEnabled*/)
+        return;
+
+    const ScreenplayPrintLayoutParams params = ::preparePrintLayout(m_textDocument, m_formatting, m_titlePage);
+
+    if(!m_layoutInBackground)
+    {
+        ::includeMoreAndContdMarkers(m_textDocument, params, &m_printLayoutCancelled, nullptr);
+        return;
+    }
+
+    /**
+      The document was built without being laid out even once, which is quick. Layout passes
+      run in a background job, on a clone of the document that nothing else refers to. Block
+      data doesn't survive cloning, so each paragraph carries the index of its snapshot in a
+      block format property, from which the job attaches block data to the clone again.
+      */
+    QList<ScreenplayParagraphBlockData> paragraphs;
+    QTextCursor cursor(m_textDocument);
+    QTextBlock block = m_textDocument->firstBlock();
+    while(block.isValid())
+    {
+        const ScreenplayParagraphBlockData *blockData = ScreenplayParagraphBlockData::get(block);
+        if(blockData != nullptr)
+        {
+            QTextBlockFormat format;
+            format.setProperty(ScreenplayParagraphBlockData::SnapshotIndexProperty, paragraphs.size());
+            cursor.setPosition(block.position());
+            cursor.mergeBlockFormat(format);
+            paragraphs.append(*blockData);
+        }
+        block = block.next();
+    }
+
+    // Dynamic properties are read by QTextDocumentPagedPrinter for header and footer fields.
+    QTextDocument *document = m_textDocument->clone();
+    const QList<QByteArray> propertyNames = m_textDocument->dynamicPropertyNames();
+    for(const QByteArray &propertyName : propertyNames)
+        document->setProperty(propertyName, m_textDocument->property(propertyName));
+
+    // The job takes the clone over to its own thread, and hands it back when done.
+    document->moveToThread(nullptr);
+
+    // Progress is reported on our thread, because this object outlives the job, while
+    // the progress report it has been given may not.
+    auto reportProgress = [this](int pageIndex, int pageCount) {
+        QMetaObject::invokeMethod(this, [=]() {
+            ProgressReport *progressReport = m_progressReport;
+            if(progressReport == nullptr)
+                return;
+            progressReport->setProgressText( QString("Laying out page %1 of %2").arg(pageIndex+1).arg(pageCount) );
+            progressReport->setProgressStep(0.5/qreal(qMax(pageCount,1)));
+            progressReport->tick();
+        }, Qt::QueuedConnection);
+    };
+
+    QThread *documentThread = this->thread();
+    const bool titlePage = m_titlePage;
+    const QAtomicInt *cancelled = &m_printLayoutCancelled;
+    QFuture<PrintLayoutResult> future = QtConcurrent::run([=]() -> PrintLayoutResult {
+        document->moveToThread(QThread::currentThread());
+
+        ScreenplayTextObjectInterface *toi = new ScreenplayTextObjectInterface(document);
+        document->documentLayout()->registerHandler(ScreenplayTextObjectInterface::Kind, toi);
+        if(titlePage)
+        {
+            ScreenplayTitlePageObjectInterface *tpoi = new ScreenplayTitlePageObjectInterface(document);
+            document->documentLayout()->registerHandler(ScreenplayTitlePageObjectInterface::Kind, tpoi);
+        }
+
+        QTextBlock block = document->firstBlock();
+        while(block.isValid())
+        {
+            const QVariant index = block.blockFormat().property(ScreenplayParagraphBlockData::SnapshotIndexProperty);
+            if(index.isValid() && index.toInt() >= 0 && index.toInt() < paragraphs.size())
+                block.setUserData(new ScreenplayParagraphBlockData(paragraphs.at(index.toInt())));
+            block = block.next();
+        }
+
+        PrintLayoutResult result;
+        result.document = document;
+        result.pageCount = ::includeMoreAndContdMarkers(document, params, cancelled, reportProgress);
+        document->moveToThread(documentThread);
+        return result;
+    });
+
+    m_printLayoutWatcher = new QFutureWatcher<PrintLayoutResult>(this);
+    connect(m_printLayoutWatcher, &QFutureWatcherBase::finished, this, &ScreenplayTextDocument::onPrintLayoutFinished);
+    m_printLayoutWatcher->setFuture(future);
+}
+
+void ScreenplayTextDocument::onPrintLayoutFinished()
+{
+    if(m_printLayoutWatcher == nullptr)
+        return;
+
+    const PrintLayoutResult result = m_printLayoutWatcher->result();
+    m_printLayoutWatcher->deleteLater();
+    m_printLayoutWatcher = nullptr;
+
+    if(this->isPrintLayoutCancelled() || m_textDocument == nullptr)
+    {
+        delete result.document;
+        emit printLayoutFinished();
+        return;
+    }
+
+    // The laid out copy takes the place of the document we built. Frames of scenes
+    // are at the same place in both documents, so they get registered with the copy.
+    const QList<QTextFrame*> builtFrames = m_textDocument->rootFrame()->childFrames();
+    const QList<QTextFrame*> copiedFrames = result.document->rootFrame()->childFrames();
+    for(ElementFrame &elementFrame : m_elementFrames)
+    {
+        if(elementFrame.frame == nullptr)
+            continue;
+
+        disconnect(elementFrame.frame, &QTextFrame::destroyed, this, &ScreenplayTextDocument::onTextFrameDestroyed);
+        const int index = builtFrames.size() == copiedFrames.size() ? builtFrames.indexOf(elementFrame.frame) : -1;
+        elementFrame.frame = index < 0 ? nullptr : copiedFrames.at(index);
+        if(elementFrame.frame != nullptr)
+            connect(elementFrame.frame, &QTextFrame::destroyed, this, &ScreenplayTextDocument::onTextFrameDestroyed);
+    }
+
+    disconnect(m_textDocument, &QTextDocument::contentsChange, this, &ScreenplayTextDocument::onTextDocumentContentsChange);
+    if(m_textDocument->parent() == this)
+        delete m_textDocument;
+
+    result.document->setParent(this);
+    result.document->setUndoRedoEnabled(false);
+    m_textDocument = result.document;
+    connect(m_textDocument, &QTextDocument::contentsChange, this, &ScreenplayTextDocument::onTextDocumentContentsChange);
+    emit textDocumentChanged();
+
+    this->setPageCount(result.pageCount);
+    this->invalidatePageBoundaries();
+    this->evaluatePageBoundariesLater();
+
+    emit printLayoutFinished();
+}
+
+void ScreenplayTextDocument::loadScreenplayLater()
+{
+    if(m_textDocument != nullptr)
+        m_textDocument->clear();
+
+    if(m_syncEnabled)
+    {
+        this->disconnectFromScreenplaySignals();
+        this->disconnectFromScreenplayFormatSignals();
+
+        const bool updateWasScheduled = m_loadScreenplayTimer.isActive();
+        m_loadScreenplayTimer.start(50, this);
+        if(!updateWasScheduled)
+            emit updateScheduled();
+    }
+}
+
+void ScreenplayTextDocument::resetScreenplay()
+{
+    m_screenplay = nullptr;
+    this->loadScreenplayLater();
+    emit screenplayChanged();
+}
+
+void ScreenplayTextDocument::connectToScreenplaySignals()
+{
+    if(m_screenplay == nullptr || !m_syncEnabled || m_connectedToScreenplaySignals)
+        return;
+
+    connect(m_screenplay, &Screenplay::elementMoved, this, &ScreenplayTextDocument::onSceneMoved);
+    connect(m_screenplay, &Screenplay::modelReset, this, &ScreenplayTextDocument::onScreenplayReset);
+    connect(m_screenplay, &Screenplay::elementRemoved, this, &ScreenplayTextDocument::onSceneRemoved);
+    connect(m_screenplay, &Screenplay::elementInserted, this, &ScreenplayTextDocument::onSceneInserted);
+    connect(m_screenplay, &Screenplay::activeSceneChanged, this, &ScreenplayTextDocument::onActiveSceneChanged);
+    connect(m_screenplay, &Screenplay::modelAboutToBeReset, this, &ScreenplayTextDocument::onScreenplayAboutToReset);
+
+    for(int i=0; i<m_screenplay->elementCount(); i++)
+    {
+        ScreenplayElement *element = m_screenplay->elementAt(i);
+        Scene *scene = element->scene();
+        if(scene == nullptr)
+            continue;
+
+        this->connectToSceneSignals(scene);
+    }
+
+    this->onActiveSceneChanged();
+
+    m_connectedToScreenplaySignals = true;
+}
+
+void ScreenplayTextDocument::connectToScreenplayFormatSignals()
+{
+    if(m_formatting == nullptr || !m_syncEnabled || m_connectedToFormattingSignals)
+        return;
+
+    connect(m_formatting, &ScreenplayFormat::defaultFontChanged, this, &ScreenplayTextDocument::onDefaultFontChanged);
+    connect(m_formatting, &ScreenplayFormat::screenChanged, this, &ScreenplayTextDocument::onFormatScreenChanged);
+    connect(m_formatting, &ScreenplayFormat::fontPointSizeDeltaChanged, this, &ScreenplayTextDocument::onFormatFontPointSizeDeltaChanged);
+
+    for(int i=SceneElement::Min; i<=SceneElement::Max; i++)
+    {
+        SceneElementFormat *elementFormat = m_formatting->elementFormat(i);
+        connect(elementFormat, &SceneElementFormat::elementFormatChanged, this, &ScreenplayTextDocument::onElementFormatChanged);
+    }
+
+    m_connectedToFormattingSignals = true;
+}
+
+void ScreenplayTextDocument::disconnectFromScreenplaySignals()
+{
+    if(m_screenplay == nullptr || !m_connectedToScreenplaySignals)
+        return;
+
+    disconnect(m_screenplay, &Screenplay::elementMoved, this, &ScreenplayTextDocument::onSceneMoved);
+    disconnect(m_screenplay, &Screenplay::modelReset, this, &ScreenplayTextDocument::onScreenplayReset);
+    disconnect(m_screenplay, &Screenplay::elementRemoved, this, &ScreenplayTextDocument::onSceneRemoved);
+    disconnect(m_screenplay, &Screenplay::elementInserted, this, &ScreenplayTextDocument::onSceneInserted);
+    disconnect(m_screenplay, &Screenplay::activeSceneChanged, this, &ScreenplayTextDocument::onActiveSceneChanged);
+    disconnect(m_screenplay, &Screenplay::modelAboutToBeReset, this, &ScreenplayTextDocument::onScreenplayAboutToReset);
+
+    for(int i=0; i<m_screenplay->elementCount(); i++)
+    {
+        ScreenplayElement *element = m_screenplay->elementAt(i);
+        Scene *scene = element->scene();
+        if(scene == nullptr)
+            continue;
+
+        this->disconnectFromSceneSignals(scene);
+    }
+
+    m_connectedToScreenplaySignals = false;
+}
+
+void ScreenplayTextDocument::disconnectFromScreenplayFormatSignals()
+{
+    if(m_formatting == nullptr || !m_connectedToFormattingSignals)
+        return;
+
+    disconnect(m_formatting, &ScreenplayFormat::defaultFontChanged, this, &ScreenplayTextDocument::onDefaultFontChanged);
+    disconnect(m_formatting, &ScreenplayFormat::screenChanged, this, &ScreenplayTextDocument::onFormatScreenChanged);
+    disconnect(m_formatting, &ScreenplayFormat::fontPointSizeDeltaChanged, this, &ScreenplayTextDocument::onFormatFontPointSizeDeltaChanged);
 
     for(int i=SceneElement::Min; i<=SceneElement::Max; i++)
     {
@@ -1671,11 +2539,12 @@ void ScreenplayTextDocument::onSceneRemoved(ScreenplayElement *element, int inde
     Q_UNUSED(index)
     Q_ASSERT_X(m_updating == false, "ScreenplayTextDocument", "Document was updating while new scene was removed.");
 
+    QTextFrame *frame = this->findTextFrame(element);
+    this->removeTextFrameSlot(element);
+
     Scene *scene = element->scene();
     if(scene == nullptr)
         return;
-
-    QTextFrame *frame = this->findTextFrame(element);
 #ifdef QT_NO_DEBUG
     if(frame == nullptr)
         return;
@@ -1689,7 +2558,6 @@ void ScreenplayTextDocument::onSceneRemoved(ScreenplayElement *element, int inde
     cursor.movePosition(QTextCursor::Up);
     cursor.setPosition(frame->lastPosition(), QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    this->removeTextFrame(element);
 
     if(m_sceneResetList.removeOne(scene))
         m_sceneResetTimer.start(100, this);
@@ -1704,6 +2572,8 @@ void ScreenplayTextDocument::onSceneInserted(ScreenplayElement *element, int ind
 {
     Q_ASSERT_X(m_updating == false, "ScreenplayTextDocument", "Document was updating while new scene was inserted.");
 
+    this->insertTextFrameSlot(element, index);
+
     Scene *scene = element->scene();
     if(scene == nullptr)
         return;
@@ -1830,6 +2700,12 @@ void ScreenplayTextDocument::onSceneElementChanged(SceneElement *para, Scene::Sc
         return; // This can happen when the paragraph is not part of the scene text, but
                 // it exists as a way to capture a mute-character in the scene.
 
+    if(m_batchUpdateDepth > 0)
+    {
+        this->addToSceneResetList(scene);
+        return;
+    }
+
     ScreenplayTextDocumentUpdate update(this);
 
     const SceneElementContentChange lastParaChange = para->lastContentChange();
@@ -1942,11 +2818,13 @@ void ScreenplayTextDocument::onDefaultFontChanged()
 
 void ScreenplayTextDocument::onFormatScreenChanged()
 {
+    this->invalidatePageBoundaries();
     this->evaluatePageBoundariesLater();
 }
 
 void ScreenplayTextDocument::onFormatFontPointSizeDeltaChanged()
 {
+    this->invalidatePageBoundaries();
     this->evaluatePageBoundariesLater();
 }
 
@@ -2026,14 +2904,11 @@ void ScreenplayTextDocument::evaluateCurrentPageAndPosition()
         block = block.next();
 
     const int cursorPosition = m_activeScene->cursorPosition() + block.position();
-    for(int i=0; i<m_pageBoundaries.size(); i++)
+    const int pageIndex = this->pageIndexOf(cursorPosition);
+    if(pageIndex >= 0)
     {
-        const QPair<int,int> pgBoundary = m_pageBoundaries.at(i);
-        if(cursorPosition >= pgBoundary.first-1 && cursorPosition < pgBoundary.second)
-        {
-            this->setCurrentPageAndPosition(i+1, qreal(cursorPosition)/qreal(documentLength));
-            return;
-        }
+        this->setCurrentPageAndPosition(pageIndex+1, qreal(cursorPosition)/qreal(documentLength));
+        return;
     }
 
     // If we are here, then the cursor position was not found anywhere in the pageBoundaries.
@@ -2046,10 +2921,14 @@ void ScreenplayTextDocument::evaluatePageBoundaries()
     // NOTE: Please do not call this function from anywhere other than
     // timerEvent(), while handling m_pageBoundaryEvalTimer
     QList< QPair<int,int> > pgBoundaries;
+    int dirtyFrom = 0, convergedAt = -1;
 
     if(m_formatting != nullptr && m_textDocument != nullptr && m_screenplay != nullptr)
     {
-        m_textDocument->setDefaultFont(m_formatting->defaultFont());
+        // Neither of these touch the document unless the font or page geometry changed.
+        // Otherwise they would report the whole document as changed on every run.
+        if(m_textDocument->defaultFont() != m_formatting->defaultFont())
+            m_textDocument->setDefaultFont(m_formatting->defaultFont());
         m_formatting->pageLayout()->configure(m_textDocument);
 
         const ScreenplayPageLayout *pageLayout = m_formatting->pageLayout();
@@ -2059,37 +2938,91 @@ void ScreenplayTextDocument::evaluatePageBoundaries()
         QAbstractTextDocumentLayout *layout = m_textDocument->documentLayout();
 
         const int endCursorPosition = m_textDocument->characterCount()-1;
+        const int pageCount = m_textDocument->pageCount();
 
-        qreal fpageCount = 0.1;
+        // Any change in page geometry or font moves every page boundary
+        if(m_pagination.paperRect != paperRect || m_pagination.margins != pageMargins ||
+           m_pagination.defaultFont != m_textDocument->defaultFont())
+        {
+            m_pagination.paperRect = paperRect;
+            m_pagination.margins = pageMargins;
+            m_pagination.defaultFont = m_textDocument->defaultFont();
+            m_pagination.dirtyFrom = 0;
+        }
+        dirtyFrom = m_pagination.dirtyFrom;
 
-        const int pageCount = m_textDocument->pageCount();
+        // Pages before the one on which the first edited block begins are left as they
+        // were. We step back one more page, because lines of a paragraph that straddles
+        // the page break can re-flow into the previous page.
         int pageIndex = 0;
+        if(m_pagination.dirtyFrom < 0)
+            pageIndex = m_pageBoundaries.size() == pageCount ? pageCount : 0;
+        else if(m_pagination.dirtyFrom > 0)
+        {
+            const QTextBlock dirtyBlock = m_textDocument->findBlock(m_pagination.dirtyFrom);
+            const int dirtyPosition = dirtyBlock.isValid() ? dirtyBlock.position() : m_pagination.dirtyFrom;
+            const int dirtyPageIndex = this->pageIndexOf(dirtyPosition);
+            if(dirtyPageIndex >= 0)
+                pageIndex = qMax(dirtyPageIndex-1, 0);
+            else if(!m_pageBoundaries.isEmpty() && dirtyPosition >= m_pageBoundaries.last().first)
+                pageIndex = qMax(m_pageBoundaries.size()-2, 0);
+        }
+        pageIndex = qMin(pageIndex, pageCount);
+        pgBoundaries = m_pageBoundaries.mid(0, pageIndex);
+
+        // Once a page comes out the same as it did in the previous run (after accounting
+        // for the characters added or removed), all pages after it will be the same too.
+        auto reuseRemainingPages = [=,&pgBoundaries,&convergedAt](int fromPageIndex) {
+            const QPair<int,int> newBoundary = pgBoundaries.last();
+            if(m_pagination.dirtyFrom <= 0 || m_pageBoundaries.size() != pageCount || newBoundary.first <= m_pagination.dirtyTo)
+                return false;
+
+            const QPair<int,int> oldBoundary = m_pageBoundaries.at(fromPageIndex-1);
+            if(oldBoundary.first+m_pagination.delta != newBoundary.first || oldBoundary.second+m_pagination.delta != newBoundary.second)
+                return false;
+
+            for(int i=fromPageIndex; i<pageCount; i++)
+            {
+                const QPair<int,int> pgBoundary = m_pageBoundaries.at(i);
+                pgBoundaries << qMakePair(pgBoundary.first+m_pagination.delta, i == pageCount-1 ? endCursorPosition : pgBoundary.second+m_pagination.delta);
+            }
+            convergedAt = newBoundary.first;
+            return true;
+        };
+
         while(pageIndex < pageCount)
         {
-            paperRect = QRectF(0, pageIndex*paperRect.height(), paperRect.width(), paperRect.height());
-            const QRectF contentsRect = paperRect.adjusted(pageMargins.left(), pageMargins.top(), -pageMargins.right(), -pageMargins.bottom());
+            const QRectF pageRect(0, pageIndex*paperRect.height(), paperRect.width(), paperRect.height());
+            const QRectF contentsRect = pageRect.adjusted(pageMargins.left(), pageMargins.top(), -pageMargins.right(), -pageMargins.bottom());
             const int firstPosition = pgBoundaries.isEmpty() ? layout->hitTest(contentsRect.topLeft(), Qt::FuzzyHit) : pgBoundaries.last().second+1;
             const int lastPosition = pageIndex == pageCount-1 ? endCursorPosition : layout->hitTest(contentsRect.bottomRight(), Qt::FuzzyHit);
             pgBoundaries << qMakePair(firstPosition, lastPosition >= 0 ? lastPosition : endCursorPosition);
 
             ++pageIndex;
 
-            if(pageIndex == pageCount)
+            if(pageIndex < pageCount && reuseRemainingPages(pageIndex))
+                break;
+        }
+
+        qreal fpageCount = 0.1;
+        if(pageCount > 0)
+        {
+            const QRectF lastPageRect(0, (pageCount-1)*paperRect.height(), paperRect.width(), paperRect.height());
+            const QRectF contentsRect = lastPageRect.adjusted(pageMargins.left(), pageMargins.top(), -pageMargins.right(), -pageMargins.bottom());
+
+            ScreenplayElement *lastElement = m_screenplay->elementAt(m_screenplay->elementCount()-1);
+            if(lastElement == nullptr)
+                fpageCount = 0.01;
+            else
             {
-                ScreenplayElement *lastElement = m_screenplay->elementAt(m_screenplay->elementCount()-1);
-                if(lastElement == nullptr)
-                    fpageCount = 0.01;
+                QTextFrame *lastFrame = this->findTextFrame(lastElement);
+                if(lastFrame == nullptr)
+                    fpageCount = pageCount;
                 else
                 {
-                    QTextFrame *lastFrame = this->findTextFrame(lastElement);
-                    if(lastFrame == nullptr)
-                        fpageCount = pageCount;
-                    else
-                    {
-                        const QRectF lastFrameRect = layout->frameBoundingRect(lastFrame);
-                        fpageCount = pageCount-1;
-                        fpageCount += (lastFrameRect.bottom() - contentsRect.top())/contentsRect.height();
-                    }
+                    const QRectF lastFrameRect = layout->frameBoundingRect(lastFrame);
+                    fpageCount = pageCount-1;
+                    fpageCount += (lastFrameRect.bottom() - contentsRect.top())/contentsRect.height();
                 }
             }
         }
@@ -2097,9 +3030,17 @@ void ScreenplayTextDocument::evaluatePageBoundaries()
         this->setPageCount(fpageCount);
     }
 
-    m_pageBoundaries = pgBoundaries;
-    emit pageBoundariesChanged();
+    m_pagination.dirtyFrom = pgBoundaries.isEmpty() ? 0 : -1;
+    m_pagination.dirtyTo = 0;
+    m_pagination.delta = 0;
+
+    if(m_pageBoundaries != pgBoundaries)
+    {
+        m_pageBoundaries = pgBoundaries;
+        emit pageBoundariesChanged();
+    }
 
+    this->updateLengthIndex(dirtyFrom, convergedAt);
     this->evaluateCurrentPageAndPosition();
 }
 
@@ -2108,6 +3049,103 @@ void ScreenplayTextDocument::evaluatePageBoundariesLater()
     m_pageBoundaryEvalTimer.start(500, this);
 }
 
+void ScreenplayTextDocument::invalidatePageBoundaries()
+{
+    m_pagination.dirtyFrom = 0;
+    m_pagination.dirtyTo = 0;
+    m_pagination.delta = 0;
+    m_lengthIndex->invalidate();
+}
+
+void ScreenplayTextDocument::updateLengthIndex(int dirtyFrom, int convergedAt)
+{
+    QList<ScreenplayLengthIndex::Item> items;
+    qreal pageLength = 0;
+
+    if(m_screenplay != nullptr && m_textDocument != nullptr)
+    {
+        const QTextFrameFormat rootFrameFormat = m_textDocument->rootFrame()->frameFormat();
+        pageLength = m_textDocument->pageSize().height() - rootFrameFormat.topMargin() - rootFrameFormat.bottomMargin();
+
+        QAbstractTextDocumentLayout *layout = m_textDocument->documentLayout();
+
+        const int nrElements = m_screenplay->elementCount();
+        items.reserve(nrElements);
+        for(int i=0; i<nrElements; i++)
+        {
+            ScreenplayElement *element = m_screenplay->elementAt(i);
+
+            ScreenplayLengthIndex::Item item;
+            item.element = element;
+
+            QTextFrame *frame = this->findTextFrame(element);
+            if(frame != nullptr)
+            {
+                const int firstPosition = frame->firstPosition();
+                const int lastPosition = frame->lastPosition();
+
+                // Layout of frames that end before the edit, or begin after the point from
+                // where pagination came out the same as before, has not changed. Frame heights
+                // include the gap across page breaks, so nothing in between can be reused.
+                const ScreenplayLengthIndex::Item *prevItem = dirtyFrom == 0 ? nullptr : m_lengthIndex->item(element);
+                const bool unchanged = dirtyFrom < 0 || lastPosition < dirtyFrom || (convergedAt >= 0 && firstPosition >= convergedAt);
+                if(prevItem != nullptr && prevItem->hasFrame && unchanged)
+                    item.length = prevItem->length;
+                else
+                    item.length = layout->frameBoundingRect(frame).height();
+
+                item.hasFrame = true;
+                item.firstPage = this->pageIndexOf(firstPosition)+1;
+                item.lastPage = this->pageIndexOf(lastPosition)+1;
+            }
+
+            items << item;
+        }
+    }
+
+    m_lengthIndex->update(items, pageLength);
+}
+
+void ScreenplayTextDocument::onTextDocumentContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    m_lengthIndex->invalidate();
+
+    if(m_pagination.dirtyFrom == 0)
+        return;
+
+    // Accumulate the edited range, in terms of current positions, so that page
+    // boundaries from the previous run can be matched against new ones.
+    const int delta = charsAdded - charsRemoved;
+    if(m_pagination.dirtyFrom < 0)
+    {
+        m_pagination.dirtyFrom = position;
+        m_pagination.dirtyTo = position + charsAdded;
+    }
+    else
+    {
+        m_pagination.dirtyFrom = qMin(m_pagination.dirtyFrom, position);
+        if(m_pagination.dirtyTo >= position)
+            m_pagination.dirtyTo = qMax(m_pagination.dirtyTo + delta, position + charsAdded);
+        else
+            m_pagination.dirtyTo = position + charsAdded;
+    }
+    m_pagination.delta += delta;
+}
+
+int ScreenplayTextDocument::pageIndexOf(int position) const
+{
+    // Page boundaries are contiguous and sorted, so we can look up the page
+    // containing a position by binary search.
+    auto it = std::lower_bound(m_pageBoundaries.constBegin(), m_pageBoundaries.constEnd(), position,
+                               [](const QPair<int,int> &pgBoundary, int pos) {
+        return pgBoundary.second <= pos;
+    });
+    if(it == m_pageBoundaries.constEnd() || position < it->first-1)
+        return -1;
+
+    return int(std::distance(m_pageBoundaries.constBegin(), it));
+}
+
 void ScreenplayTextDocument::formatAllBlocks()
 {
     if(m_screenplay == nullptr || m_formatting == nullptr || m_updating || !m_componentComplete || m_textDocument == nullptr || m_textDocument->isEmpty())
@@ -2528,59 +3566,111 @@ void ScreenplayTextDocument::formatBlock(const QTextBlock &block, const QString
         cursor.insertText(text);
 }
 
-void ScreenplayTextDocument::removeTextFrame(const ScreenplayElement *element)
+void ScreenplayTextDocument::insertTextFrameSlot(const ScreenplayElement *element, int index)
 {
-    this->registerTextFrame(element, nullptr);
+    if(this->textFrameSlotOf(element) >= 0)
+        return;
+
+    ElementFrame elementFrame;
+    elementFrame.element = element;
+    m_elementFrames.insert(qBound(0, index, m_elementFrames.size()), elementFrame);
 }
 
-void ScreenplayTextDocument::registerTextFrame(const ScreenplayElement *element, QTextFrame *frame)
+void ScreenplayTextDocument::removeTextFrameSlot(const ScreenplayElement *element)
+{
+    const int slot = this->textFrameSlotOf(element);
+    if(slot < 0)
+        return;
+
+    QTextFrame *frame = m_elementFrames.at(slot).frame;
+    if(frame != nullptr)
+        disconnect(frame, &QTextFrame::destroyed, this, &ScreenplayTextDocument::onTextFrameDestroyed);
+
+    m_elementFrames.remove(slot);
+}
+
+int ScreenplayTextDocument::textFrameSlotOf(const ScreenplayElement *element) const
 {
-    QTextFrame *existingFrame = m_elementFrameMap.value(element, nullptr);
-    if(existingFrame != nullptr && existingFrame != frame)
+    if(element == nullptr)
+        return -1;
+
+    // Element indexes are evaluated lazily by the screenplay, so right after a scene
+    // is inserted or removed they can be off by one for scenes that come after it.
+    const int hint = element->elementIndex();
+    for(int slot : { hint, hint+1, hint-1 })
     {
-        m_elementFrameMap.remove(element);
-        m_frameElementMap.remove(existingFrame);
-        disconnect(existingFrame, &QTextFrame::destroyed, this, &ScreenplayTextDocument::onTextFrameDestroyed);
+        if(slot >= 0 && slot < m_elementFrames.size() && m_elementFrames.at(slot).element == element)
+            return slot;
     }
 
-    if(frame != nullptr)
+    for(int slot=0; slot<m_elementFrames.size(); slot++)
     {
-        m_elementFrameMap[element] = frame;
-        m_frameElementMap[frame] = element;
-        connect(frame, &QTextFrame::destroyed, this, &ScreenplayTextDocument::onTextFrameDestroyed);
+        if(m_elementFrames.at(slot).element == element)
+            return slot;
     }
+
+    return -1;
 }
 
-QTextFrame *ScreenplayTextDocument::findTextFrame(const ScreenplayElement *element) const
+void ScreenplayTextDocument::registerTextFrame(const ScreenplayElement *element, QTextFrame *frame)
 {
-    QTextFrame *frame = m_elementFrameMap.value(element, nullptr);
+    const int slot = this->textFrameSlotOf(element);
+    if(slot < 0)
+        return;
+
+    ElementFrame &elementFrame = m_elementFrames[slot];
+    if(elementFrame.frame == frame)
+        return;
+
+    if(elementFrame.frame != nullptr)
+        disconnect(elementFrame.frame, &QTextFrame::destroyed, this, &ScreenplayTextDocument::onTextFrameDestroyed);
+
+    elementFrame.frame = frame;
+
     if(frame != nullptr)
-    {
-        const ScreenplayElement *frameElement = m_frameElementMap.value(frame, nullptr);
-        if(frameElement == element)
-            return frame;
-    }
+        connect(frame, &QTextFrame::destroyed, this, &ScreenplayTextDocument::onTextFrameDestroyed);
+}
 
-    return nullptr;
+QTextFrame *ScreenplayTextDocument::findTextFrame(const ScreenplayElement *element) const
+{
+    const int slot = this->textFrameSlotOf(element);
+    return slot < 0 ? nullptr : m_elementFrames.at(slot).frame;
 }
 
 void ScreenplayTextDocument::onTextFrameDestroyed(QObject *object)
 {
-    const ScreenplayElement *element = m_frameElementMap.value(object, nullptr);
-    if(element != nullptr)
-        m_frameElementMap.remove(object);
-
-    m_elementFrameMap.remove(element);
+    for(ElementFrame &elementFrame : m_elementFrames)
+    {
+        if(elementFrame.frame == object)
+        {
+            elementFrame.frame = nullptr;
+            break;
+        }
+    }
 }
 
 void ScreenplayTextDocument::clearTextFrames()
 {
-    m_elementFrameMap.clear();
+    for(const ElementFrame &elementFrame : qAsConst(m_elementFrames))
+    {
+        if(elementFrame.frame != nullptr)
+            disconnect(elementFrame.frame, &QTextFrame::destroyed, this, &ScreenplayTextDocument::onTextFrameDestroyed);
+    }
+    m_elementFrames.clear();
+
+    // One slot for each element in the screenplay, breaks included, so that slots line up
+    // with element indexes. Frames of scenes are registered as they get loaded.
+    if(m_screenplay == nullptr)
+        return;
 
-    QList<QObject*> textFrames = m_frameElementMap.keys();
-    Q_FOREACH(QObject *textFrame, textFrames)
-        disconnect(textFrame, &QTextFrame::destroyed, this, &ScreenplayTextDocument::onTextFrameDestroyed);
-    m_frameElementMap.clear();
+    m_elementFrames.reserve(m_screenplay->elementCount());
+    for(int i=0; i<m_screenplay->elementCount(); i++)
+    {
+        const ScreenplayElement *element = m_screenplay->elementAt(i);
+        ElementFrame elementFrame;
+        elementFrame.element = element;
+        m_elementFrames.append(elementFrame);
+    }
 }
 
 void ScreenplayTextDocument::addToSceneResetList(Scene *scene)
@@ -2591,7 +3681,8 @@ void ScreenplayTextDocument::addToSceneResetList(Scene *scene)
     if(!m_sceneResetList.contains(scene))
         m_sceneResetList.append(scene);
 
-    if(m_sceneResetList.isEmpty())
+    // The list is processed when the batch ends
+    if(m_batchUpdateDepth > 0)
         return;
 
     m_sceneResetTimer.start(100, this);
@@ -2606,19 +3697,14 @@ void ScreenplayTextDocument::addToSceneResetList(Scene *scene)
                 ScreenplayElement *e = m_screenplay->elementAt(si);
                 if(e)
                 {
-                    int fblocks = 0;
-
-                    QTextFrame *f = m_elementFrameMap.value(e, nullptr);
+                    QTextFrame *f = this->findTextFrame(e);
                     if(f)
                     {
-                        const int lastPosition = f->lastPosition();
-                        QTextCursor cursor = f->firstCursorPosition();
-                        while(cursor.currentFrame() && cursor.currentFrame() == f && cursor.position() <= lastPosition)
-                        {
-                            ++fblocks;
-                            if(!cursor.movePosition(QTextCursor::NextBlock))
-                                break;
-                        }
+                        // Scene frames don't nest, so the blocks in a frame are
+                        // numbered contiguously.
+                        const QTextBlock firstBlock = m_textDocument->findBlock(f->firstPosition());
+                        const QTextBlock lastBlock = m_textDocument->findBlock(f->lastPosition());
+                        const int fblocks = lastBlock.blockNumber() - firstBlock.blockNumber() + 1;
 
                         nrBlocks += qAbs(s->elementCount()-fblocks);
                     }
@@ -2646,6 +3732,11 @@ void ScreenplayTextDocument::processSceneResetList()
     QList<Scene*> scenes = m_sceneResetList;
     m_sceneResetList.clear();
 
+    // Edits made within an edit block are laid out once, when the block ends,
+    // instead of once for every frame removed and reloaded below.
+    QTextCursor editBlockCursor(m_textDocument);
+    editBlockCursor.beginEditBlock();
+
     while(!scenes.isEmpty())
     {
         Scene *scene = scenes.takeFirst();
@@ -2679,6 +3770,8 @@ void ScreenplayTextDocument::processSceneResetList()
         this->connectToSceneSignals(scene);
     }
 
+    editBlockCursor.endEditBlock();
+
     this->evaluatePageBoundariesLater();
 }
 
@@ -2691,6 +3784,191 @@ void ScreenplayTextDocument::resetInjection()
 
 ///////////////////////////////////////////////////////////////////////////////
 
+ScreenplayLengthIndex::ScreenplayLengthIndex(QObject *parent)
+    : QAbstractListModel(parent)
+{
+    m_offsets << 0;
+    m_framelessCounts << 0;
+
+    connect(this, &ScreenplayLengthIndex::modelReset, this, &ScreenplayLengthIndex::countChanged);
+}
+
+ScreenplayLengthIndex::~ScreenplayLengthIndex()
+{
+
+}
+
+qreal ScreenplayLengthIndex::lengthInPixels(int fromRow, int toRow) const
+{
+    if(fromRow < 0 || toRow >= m_items.size() || fromRow > toRow)
+        return 0;
+
+    // Just like ScreenplayTextDocument::lengthInPixels(), a range that has an element
+    // without a frame in it has no length.
+    if(m_framelessCounts.at(toRow+1) != m_framelessCounts.at(fromRow))
+        return 0;
+
+    return m_offsets.at(toRow+1) - m_offsets.at(fromRow);
+}
+
+qreal ScreenplayLengthIndex::lengthInPages(int fromRow, int toRow) const
+{
+    if( qFuzzyIsNull(m_pageLength) )
+        return 0;
+
+    return this->lengthInPixels(fromRow, toRow) / m_pageLength;
+}
+
+qreal ScreenplayLengthIndex::pixelOffset(int row) const
+{
+    if(row < 0 || row >= m_offsets.size())
+        return 0;
+
+    return m_offsets.at(row);
+}
+
+int ScreenplayLengthIndex::firstPage(int row) const
+{
+    return row < 0 || row >= m_items.size() ? 0 : m_items.at(row).firstPage;
+}
+
+int ScreenplayLengthIndex::lastPage(int row) const
+{
+    return row < 0 || row >= m_items.size() ? 0 : m_items.at(row).lastPage;
+}
+
+int ScreenplayLengthIndex::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_items.size();
+}
+
+QVariant ScreenplayLengthIndex::data(const QModelIndex &index, int role) const
+{
+    if(index.row() < 0 || index.row() >= m_items.size())
+        return QVariant();
+
+    const int row = index.row();
+    const Item &item = m_items.at(row);
+    switch(role)
+    {
+    case ScreenplayElementRole:
+        return QVariant::fromValue<QObject*>(item.element);
+    case PixelOffsetRole:
+        return m_offsets.at(row);
+    case PixelLengthRole:
+        return item.length;
+    case PageOffsetRole:
+        return qFuzzyIsNull(m_pageLength) ? 0 : m_offsets.at(row) / m_pageLength;
+    case PageLengthRole:
+        return qFuzzyIsNull(m_pageLength) ? 0 : item.length / m_pageLength;
+    case FirstPageRole:
+        return item.firstPage;
+    case LastPageRole:
+        return item.lastPage;
+    default:
+        break;
+    }
+
+    return QVariant();
+}
+
+QHash<int, QByteArray> ScreenplayLengthIndex::roleNames() const
+{
+    QHash<int,QByteArray> roles;
+    roles[ScreenplayElementRole] = "screenplayElement";
+    roles[PixelOffsetRole] = "pixelOffset";
+    roles[PixelLengthRole] = "pixelLength";
+    roles[PageOffsetRole] = "pageOffset";
+    roles[PageLengthRole] = "pageLength";
+    roles[FirstPageRole] = "firstPage";
+    roles[LastPageRole] = "lastPage";
+    return roles;
+}
+
+const ScreenplayLengthIndex::Item *ScreenplayLengthIndex::item(const ScreenplayElement *element) const
+{
+    const int row = m_rows.value(element, -1);
+    return row < 0 ? nullptr : &m_items.at(row);
+}
+
+void ScreenplayLengthIndex::update(const QList<Item> &items, qreal pageLength)
+{
+    bool sameElements = items.size() == m_items.size();
+    for(int i=0; i<items.size() && sameElements; i++)
+        sameElements = items.at(i).element == m_items.at(i).element;
+
+    // Offsets of all rows after the first one whose length changed move with it,
+    // whereas a change in page span is confined to the rows that changed.
+    int firstChangedRow = -1, lastChangedRow = -1;
+    bool lengthChanged = false;
+    if(sameElements)
+    {
+        for(int i=0; i<items.size(); i++)
+        {
+            const Item &a = items.at(i);
+            const Item &b = m_items.at(i);
+            const bool rowLengthChanged = a.hasFrame != b.hasFrame || a.length != b.length;
+            if(rowLengthChanged || a.firstPage != b.firstPage || a.lastPage != b.lastPage)
+            {
+                if(firstChangedRow < 0)
+                    firstChangedRow = i;
+                lastChangedRow = i;
+                lengthChanged |= rowLengthChanged;
+            }
+        }
+
+        if(lengthChanged)
+            lastChangedRow = items.size()-1;
+    }
+    else
+        this->beginResetModel();
+
+    m_items = items;
+
+    m_rows.clear();
+    m_rows.reserve(m_items.size());
+    m_offsets.resize(m_items.size()+1);
+    m_framelessCounts.resize(m_items.size()+1);
+    for(int i=0; i<m_items.size(); i++)
+    {
+        const Item &item = m_items.at(i);
+        m_rows.insert(item.element, i);
+        m_offsets[i+1] = m_offsets.at(i) + (item.hasFrame ? item.length : 0);
+        m_framelessCounts[i+1] = m_framelessCounts.at(i) + (item.hasFrame ? 0 : 1);
+    }
+
+    const bool pageLengthChanged = m_pageLength != pageLength;
+    m_pageLength = pageLength;
+
+    if(!sameElements)
+        this->endResetModel();
+    else if(pageLengthChanged && !m_items.isEmpty())
+        emit dataChanged(this->index(0), this->index(m_items.size()-1));
+    else if(firstChangedRow >= 0)
+        emit dataChanged(this->index(firstChangedRow), this->index(lastChangedRow));
+
+    if(pageLengthChanged)
+        emit pageLengthChanged();
+
+    this->setValid(true);
+}
+
+void ScreenplayLengthIndex::invalidate()
+{
+    this->setValid(false);
+}
+
+void ScreenplayLengthIndex::setValid(bool val)
+{
+    if(m_valid == val)
+        return;
+
+    m_valid = val;
+    emit validChanged();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 ScreenplayElementPageBreaks::ScreenplayElementPageBreaks(QObject *parent)
     : QObject(parent),
       m_screenplayElement(this, "screenplayElement"),
@@ -2936,7 +4214,9 @@ void ScreenplayTitlePageObjectInterface::drawObject(QPainter *painter, const QRe
 
     if(!coverPageImageScreenplay->coverPagePhoto().isEmpty())
     {
-        QImage photo(coverPageImageScreenplay->coverPagePhoto());
+        ScriteDocument *scriteDocument = coverPageImageScreenplay->scriteDocument();
+        const QString photoPath = coverPageImageScreenplay->coverPagePhoto();
+        QImage photo = scriteDocument ? scriteDocument->fileSystem()->readImage(photoPath) : QImage(photoPath);
         QRectF photoRect = photo.rect();
         QSizeF photoSize = photoRect.size();
 
@@ -16,8 +16,12 @@
 
 #include <QTime>
 #include <QtMath>
+#include <QPointer>
+#include <QAtomicInt>
 #include <QTextDocument>
+#include <QFutureWatcher>
 #include <QQmlParserStatus>
+#include <QAbstractListModel>
 #include <QPagedPaintDevice>
 #include <QQuickTextDocument>
 #include <QSequentialAnimationGroup>
@@ -29,6 +33,81 @@
 #include "qobjectproperty.h"
 
 class ScreenplayTextDocument;
+
+/**
+ * Prefix sums of the height and page span of each screenplay element's frame,
+ * refreshed whenever page boundaries are evaluated. Length queries over a range
+ * of elements are constant time once the index is valid.
+ */
+class ScreenplayLengthIndex : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    ~ScreenplayLengthIndex();
+
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+    int count() const { return m_items.size(); }
+    Q_SIGNAL void countChanged();
+
+    // The index goes invalid as soon as the document is edited, and is valid
+    // again once page boundaries have been evaluated for the edit.
+    Q_PROPERTY(bool valid READ isValid NOTIFY validChanged)
+    bool isValid() const { return m_valid; }
+    Q_SIGNAL void validChanged();
+
+    Q_PROPERTY(qreal pageLength READ pageLength NOTIFY pageLengthChanged)
+    qreal pageLength() const { return m_pageLength; }
+    Q_SIGNAL void pageLengthChanged();
+
+    Q_INVOKABLE int indexOf(ScreenplayElement *element) const { return m_rows.value(element, -1); }
+    Q_INVOKABLE qreal lengthInPixels(int fromRow, int toRow) const;
+    Q_INVOKABLE qreal lengthInPages(int fromRow, int toRow) const;
+    Q_INVOKABLE qreal pixelOffset(int row) const;
+    Q_INVOKABLE int firstPage(int row) const;
+    Q_INVOKABLE int lastPage(int row) const;
+
+    // QAbstractItemModel interface
+    enum Roles
+    {
+        ScreenplayElementRole = Qt::UserRole,
+        PixelOffsetRole,
+        PixelLengthRole,
+        PageOffsetRole,
+        PageLengthRole,
+        FirstPageRole,
+        LastPageRole
+    };
+    int rowCount(const QModelIndex &parent) const;
+    QVariant data(const QModelIndex &index, int role) const;
+    QHash<int,QByteArray> roleNames() const;
+
+private:
+    friend class ScreenplayTextDocument;
+    ScreenplayLengthIndex(QObject *parent=nullptr);
+
+    struct Item
+    {
+        QPointer<ScreenplayElement> element;
+        bool hasFrame = false;
+        qreal length = 0;
+        int firstPage = 0;  // 1 based, 0 when not known
+        int lastPage = 0;
+    };
+    const Item *item(const ScreenplayElement *element) const;
+    void update(const QList<Item> &items, qreal pageLength);
+    void invalidate();
+    void setValid(bool val);
+
+private:
+    bool m_valid = false;
+    qreal m_pageLength = 0;
+    QList<Item> m_items;
+    QVector<qreal> m_offsets;       // total length of rows before each row, and of all rows at the end
+    QVector<int> m_framelessCounts; // number of rows without a frame, likewise
+    QHash<const ScreenplayElement*,int> m_rows;
+};
+
 class AbstractScreenplayTextDocumentInjectionInterface
 {
 public:
@@ -64,6 +143,7 @@ private:
 Q_DECLARE_INTERFACE(AbstractScreenplayTextDocumentInjectionInterface, AbstractScreenplayTextDocumentInjectionInterface_iid)
 
 class QQmlEngine;
+class ProgressReport;
 class ScreenplayTextDocumentUpdate;
 class ScreenplayTextDocument : public QObject,
                                public QQmlParserStatus
@@ -197,6 +277,13 @@ public:
 
     Q_INVOKABLE void print(QObject *printerObject);
 
+    // Loading progress is reported here, if set.
+    void setProgressReport(ProgressReport *val) { m_progressReport = val; }
+    ProgressReport *progressReport() const { return m_progressReport; }
+
+    Q_INVOKABLE void cancelPrintLayout() { m_printLayoutCancelled.storeRelease(1); }
+    bool isPrintLayoutCancelled() const { return m_printLayoutCancelled.loadAcquire() != 0; }
+
     QList< QPair<int,int> > pageBreaksFor(ScreenplayElement *element) const;
 
     QList< QPair<int,int> > pageBoundaries() const { return m_pageBoundaries; }
@@ -205,6 +292,9 @@ public:
     Q_INVOKABLE qreal lengthInPixels(ScreenplayElement *from, ScreenplayElement *to=nullptr) const;
     Q_INVOKABLE qreal lengthInPages(ScreenplayElement *from, ScreenplayElement *to=nullptr) const;
 
+    Q_PROPERTY(ScreenplayLengthIndex* lengthIndex READ lengthIndex CONSTANT)
+    ScreenplayLengthIndex* lengthIndex() const { return m_lengthIndex; }
+
     Q_PROPERTY(QObject* injection READ injection WRITE setInjection NOTIFY injectionChanged RESET resetInjection)
     void setInjection(QObject* val);
     QObject* injection() const { return m_injection; }
@@ -212,6 +302,14 @@ public:
 
     void syncNow();
 
+    // Same as syncNow(), except that layout passes of documents meant for printing run in
+    // a background job, on a copy of the document. Once they are done, the copy replaces
+    // textDocument() and printLayoutFinished() is emitted. Documents set from outside are
+    // laid out right away, because they cannot be replaced.
+    Q_INVOKABLE void syncInBackground();
+    bool isPrintLayoutInProgress() const { return m_printLayoutWatcher != nullptr; }
+    Q_SIGNAL void printLayoutFinished();
+
     Q_INVOKABLE void superImposeStructure(const QJsonObject &model);
 
     Q_INVOKABLE void reload();
@@ -238,8 +336,14 @@ private:
     void resetTextDocument();
     void resetQQTextDocument();
 
+    // Scene updates received during a batch are queued and applied together,
+    // with a single relayout, when the outermost batch ends.
+    void beginBatchUpdate();
+    void endBatchUpdate();
+
     void loadScreenplay();
     void includeMoreAndContdMarkers();
+    void onPrintLayoutFinished();
     void loadScreenplayLater();
     void resetScreenplay();
 
@@ -286,12 +390,18 @@ private:
     void evaluateCurrentPageAndPosition();
     void evaluatePageBoundaries();
     void evaluatePageBoundariesLater();
+    void invalidatePageBoundaries();
+    void updateLengthIndex(int dirtyFrom, int convergedAt);
+    void onTextDocumentContentsChange(int position, int charsRemoved, int charsAdded);
+    int pageIndexOf(int position) const;
     void formatAllBlocks();
     bool updateFromScreenplayElement(const ScreenplayElement *element);
     void loadScreenplayElement(const ScreenplayElement *element, QTextCursor &cursor);
     void formatBlock(const QTextBlock &block, const QString &text=QString());
 
-    void removeTextFrame(const ScreenplayElement *element);
+    void insertTextFrameSlot(const ScreenplayElement *element, int index);
+    void removeTextFrameSlot(const ScreenplayElement *element);
+    int textFrameSlotOf(const ScreenplayElement *element) const;
     void registerTextFrame(const ScreenplayElement *element, QTextFrame *frame);
     QTextFrame *findTextFrame(const ScreenplayElement *element) const;
     void onTextFrameDestroyed(QObject *object);
@@ -324,6 +434,7 @@ private:
     QList<Scene*> m_sceneResetList;
     ExecLaterTimer m_sceneResetTimer;
     bool m_sceneResetHasTriggeredUpdateScheduled = false;
+    int m_batchUpdateDepth = 0;
     bool m_printEachSceneOnANewPage = false;
     bool m_printEachActOnANewPage = false;
     bool m_includeActBreaks = false;
@@ -331,19 +442,65 @@ private:
     QStringList m_highlightDialoguesOf;
     ExecLaterTimer m_pageBoundaryEvalTimer;
     QTextFrameFormat m_sceneFrameFormat;
+    QAtomicInt m_printLayoutCancelled;
+    ProgressReport *m_progressReport = nullptr;
+    bool m_layoutInBackground = false;
+    struct PrintLayoutResult
+    {
+        QTextDocument *document = nullptr;
+        int pageCount = 0;
+    };
+    QFutureWatcher<PrintLayoutResult> *m_printLayoutWatcher = nullptr;
     QObjectProperty<QObject> m_injection;
     bool m_connectedToScreenplaySignals = false;
     bool m_connectedToFormattingSignals = false;
     QPagedPaintDevice::PageSize m_paperSize = QPagedPaintDevice::Letter;
     QList< QPair<int,int> > m_pageBoundaries;
+    ScreenplayLengthIndex *m_lengthIndex = nullptr;
+
+    // Pagination state carried over from the previous evaluatePageBoundaries()
+    // run, so that an edit re-paginates only from the page it lands on.
+    struct PaginationState
+    {
+        QFont defaultFont;
+        QRectF paperRect;
+        QMarginsF margins;
+        int dirtyFrom = 0;  // -1 when clean, 0 when all pages must be evaluated
+        int dirtyTo = 0;    // end of the edited range, in current positions
+        int delta = 0;      // characters added minus removed since the last run
+    } m_pagination;
     QObjectProperty<Screenplay> m_screenplay;
     friend class ScreenplayTextDocumentUpdate;
     QObjectProperty<QTextDocument> m_textDocument;
     QObjectProperty<ScreenplayFormat> m_formatting;
     ModificationTracker m_screenplayModificationTracker;
     ModificationTracker m_formattingModificationTracker;
-    QMap<QObject *, const ScreenplayElement*> m_frameElementMap;
-    QMap<const ScreenplayElement*, QTextFrame*> m_elementFrameMap;
+
+    // Text frames of screenplay elements, one slot for each element in the screenplay.
+    // This is addressed by ScreenplayElement::elementIndex(). Breaks have no frame.
+    struct ElementFrame
+    {
+        const ScreenplayElement *element = nullptr;
+        QTextFrame *frame = nullptr;
+    };
+    QVector<ElementFrame> m_elementFrames;
+};
+
+class ScreenplayTextDocumentUpdate
+{
+public:
+    // Marks the document as updating for the lifetime of this object
+    ScreenplayTextDocumentUpdate(ScreenplayTextDocument *document);
+
+    // Batches scene updates in all documents showing the screenplay, for the lifetime
+    // of this object. Use this around changes that touch several scenes at once.
+    ScreenplayTextDocumentUpdate(const Screenplay *screenplay);
+
+    ~ScreenplayTextDocumentUpdate();
+
+private:
+    ScreenplayTextDocument *m_document = nullptr;
+    QList< QPointer<ScreenplayTextDocument> > m_batchedDocuments;
 };
 
 class ScreenplayElementPageBreaks : public QObject
@@ -18,6 +18,8 @@
 #include "hourglass.h"
 #include "aggregation.h"
 #include "application.h"
+#include "binaryheader.h"
+#include "documentbackupstore.h"
 #include "pdfexporter.h"
 #include "odtexporter.h"
 #include "htmlexporter.h"
@@ -62,11 +64,18 @@ ScriteDocumentBackups::ScriteDocumentBackups(QObject *parent)
     m_reloadTimer.setSingleShot(true);
     m_reloadTimer.setInterval(50);
     connect(&m_reloadTimer, &QTimer::timeout, this, &ScriteDocumentBackups::reloadBackupFileInformation);
+
+    m_metaDataCacheSaveTimer.setSingleShot(true);
+    m_metaDataCacheSaveTimer.setInterval(1000);
+    connect(&m_metaDataCacheSaveTimer, &QTimer::timeout, this, &ScriteDocumentBackups::saveMetaDataCache);
+
+    m_metaDataThreadPool.setMaxThreadCount( qBound(1, QThread::idealThreadCount()/2, 4) );
 }
 
 ScriteDocumentBackups::~ScriteDocumentBackups()
 {
-
+    if(m_metaDataCacheSaveTimer.isActive())
+        this->saveMetaDataCache();
 }
 
 QJsonObject ScriteDocumentBackups::at(int index) const
@@ -263,19 +272,38 @@ void ScriteDocumentBackups::reloadBackupFileInformation()
      * done.
      */
     QFuture<QFileInfoList> future = QtConcurrent::run([=]() -> QFileInfoList {
-        return m_backupFilesDir.entryInfoList({QStringLiteral("*.scrite")}, QDir::Files, QDir::Time);
+        return m_backupFilesDir.entryInfoList({QStringLiteral("*.scrite"), QStringLiteral("*.") + DocumentBackupStore::fileSuffix()}, QDir::Files, QDir::Time);
     });
     QFutureWatcher<QFileInfoList> *futureWatcher = new QFutureWatcher<QFileInfoList>(this);
     futureWatcher->setObjectName(futureWatcherName);
     connect(futureWatcher, &QFutureWatcher<QFileInfoList>::finished, [=]() {
         futureWatcher->deleteLater();
 
+        this->loadMetaDataCache();
+
         this->beginResetModel();
         m_backupFiles = future.result();
-        m_metaDataList.resize(m_backupFiles.size());
+        m_metaDataList = QVector<MetaData>(m_backupFiles.size());
+        for(int i=0; i<m_backupFiles.size(); i++)
+        {
+            const QFileInfo &fi = m_backupFiles.at(i);
+            const QJsonObject cached = m_metaDataCache.value(fi.absoluteFilePath()).toObject();
+            if( cached.value(QStringLiteral("size")).toDouble() != double(fi.size()) ||
+                cached.value(QStringLiteral("lastModified")).toDouble() != double(fi.lastModified().toMSecsSinceEpoch()) )
+                continue;
+
+            MetaData &metaData = m_metaDataList[i];
+            metaData.structureElementCount = cached.value(QStringLiteral("structureElementCount")).toInt();
+            metaData.screenplayElementCount = cached.value(QStringLiteral("screenplayElementCount")).toInt();
+            metaData.loaded = true;
+        }
         this->endResetModel();
 
         emit countChanged();
+
+        // Backups that are not in the cache are scanned right away, a few at a time.
+        for(int i=0; i<m_metaDataList.size(); i++)
+            this->loadMetaData(i);
     });
     futureWatcher->setFuture(future);
 }
@@ -285,21 +313,47 @@ void ScriteDocumentBackups::loadMetaData(int row)
     if(row < 0 || row >= m_backupFiles.size())
         return;
 
+    if(m_metaDataList.at(row).loaded || m_metaDataList.at(row).loading)
+        return;
+
+    m_metaDataList[row].loading = true;
+
     const QString futureWatcherName = QStringLiteral("loadMetaDataFuture");
 
     const QFileInfo fi = m_backupFiles.at(row);
     const QString fileName = fi.absoluteFilePath();
 
-    QFuture<MetaData> future = QtConcurrent::run([](const QString &fileName) -> MetaData {
+    QFuture<MetaData> future = QtConcurrent::run(&m_metaDataThreadPool, [](const QString &fileName) -> MetaData {
         MetaData ret;
 
-        DocumentFileSystem dfs;
-        if( !dfs.load(fileName) ) {
+        // Documents saved by newer versions carry the counts we need as
+        // meta-data, which is read without extracting anything.
+        const QJsonObject metaData = DocumentBackupStore::isBackup(fileName) ?
+                    DocumentBackupStore::readMetaData(fileName) :
+                    DocumentFileSystem::readMetaData(fileName);
+        if(metaData.contains(QStringLiteral("structureElementCount")))
+        {
+            ret.structureElementCount = metaData.value(QStringLiteral("structureElementCount")).toInt();
+            ret.screenplayElementCount = metaData.value(QStringLiteral("screenplayElementCount")).toInt();
+            ret.loaded = true;
+            return ret;
+        }
+
+        QByteArray header;
+        if(DocumentBackupStore::isBackup(fileName))
+            header = DocumentBackupStore::read(fileName, QStringLiteral("_header.json"));
+        else {
+            DocumentFileSystem dfs;
+            if( dfs.load(fileName) )
+                header = dfs.header();
+        }
+
+        if(header.isEmpty()) {
             ret.loaded = true;
             return ret;
         }
 
-        const QJsonDocument jsonDoc = QJsonDocument::fromJson(dfs.header());
+        const QJsonDocument jsonDoc = QJsonDocument::fromJson(header);
         const QJsonObject docObj = jsonDoc.object();
 
         const QJsonObject structure = docObj.value(QStringLiteral("structure")).toObject();
@@ -319,7 +373,16 @@ void ScriteDocumentBackups::loadMetaData(int row)
         if(row < 0 || row >= m_metaDataList.size())
             return;
 
-        m_metaDataList.replace(row, future.result());
+        const MetaData metaData = future.result();
+        m_metaDataList.replace(row, metaData);
+
+        QJsonObject cached;
+        cached.insert(QStringLiteral("size"), double(fi.size()));
+        cached.insert(QStringLiteral("lastModified"), double(fi.lastModified().toMSecsSinceEpoch()));
+        cached.insert(QStringLiteral("structureElementCount"), metaData.structureElementCount);
+        cached.insert(QStringLiteral("screenplayElementCount"), metaData.screenplayElementCount);
+        m_metaDataCache.insert(fileName, cached);
+        m_metaDataCacheSaveTimer.start();
 
         const QModelIndex index = this->index(row, 0);
         emit dataChanged(index, index);
@@ -329,6 +392,46 @@ void ScriteDocumentBackups::loadMetaData(int row)
     connect(this, &ScriteDocumentBackups::modelAboutToBeReset, futureWatcher, &QObject::deleteLater);
 }
 
+void ScriteDocumentBackups::loadMetaDataCache()
+{
+    if(m_metaDataCacheLoaded)
+        return;
+
+    m_metaDataCacheLoaded = true;
+
+    QFile file( QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).absoluteFilePath(QStringLiteral("backups_metadata.json")) );
+    if(file.open(QFile::ReadOnly))
+        m_metaDataCache = QJsonDocument::fromJson(file.readAll()).object();
+}
+
+void ScriteDocumentBackups::saveMetaDataCache()
+{
+    m_metaDataCacheSaveTimer.stop();
+
+    // Forget about backups from the current folder that no longer exist.
+    if(!m_backupFiles.isEmpty())
+    {
+        const QString backupFilesDirPath = m_backupFilesDir.absolutePath() + QStringLiteral("/");
+        QSet<QString> backupFilePaths;
+        for(const QFileInfo &fi : qAsConst(m_backupFiles))
+            backupFilePaths += fi.absoluteFilePath();
+
+        const QStringList cachedFilePaths = m_metaDataCache.keys();
+        for(const QString &cachedFilePath : cachedFilePaths)
+        {
+            if(cachedFilePath.startsWith(backupFilesDirPath) && !backupFilePaths.contains(cachedFilePath))
+                m_metaDataCache.remove(cachedFilePath);
+        }
+    }
+
+    const QDir appDataDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+    QDir().mkpath(appDataDir.absolutePath());
+
+    QFile file( appDataDir.absoluteFilePath(QStringLiteral("backups_metadata.json")) );
+    if(file.open(QFile::WriteOnly))
+        file.write( QJsonDocument(m_metaDataCache).toJson() );
+}
+
 void ScriteDocumentBackups::clear()
 {
     delete m_fsWatcher;
@@ -420,6 +523,10 @@ ScriteDocument::ScriteDocument(QObject *parent)
     connect(this, &ScriteDocument::fileNameChanged, [=]() {
         m_documentBackupsModel.setDocumentFilePath( m_fileName );
     });
+    connect(&m_docFileSystem, &DocumentFileSystem::entriesLost, [=](const QString &archiveFileName, const QStringList &entries) {
+        m_errorReport->setErrorMessage( QStringLiteral("%1 was changed outside of Scrite, so %2 attached file(s) could no longer be read from it: %3")
+                                        .arg(QFileInfo(archiveFileName).fileName()).arg(entries.size()).arg(entries.join(QStringLiteral(", "))) );
+    });
 
     const QVariant ase = Application::instance()->settings()->value("AutoSave/autoSaveEnabled");
     this->setAutoSave( ase.isValid() ? ase.toBool() : m_autoSave );
@@ -433,7 +540,12 @@ ScriteDocument::ScriteDocument(QObject *parent)
 
 ScriteDocument::~ScriteDocument()
 {
+    // Let the file that is being written to disk be complete
+    if(m_saveTask.watcher != nullptr)
+        m_saveTask.watcher->waitForFinished();
 
+    if(!m_restoredBackupFileName.isEmpty())
+        QFile::remove(m_restoredBackupFileName);
 }
 
 void ScriteDocument::setLocked(bool val)
@@ -681,6 +793,8 @@ void ScriteDocument::reset()
 {
     HourGlass hourGlass;
 
+    this->waitForSaveTaskToFinish();
+
     m_connectors.clear();
 
     if(m_structure != nullptr)
@@ -713,6 +827,12 @@ void ScriteDocument::reset()
     UndoStack::clearAllStacks();
     m_docFileSystem.reset();
 
+    if(!m_restoredBackupFileName.isEmpty())
+    {
+        QFile::remove(m_restoredBackupFileName);
+        m_restoredBackupFileName.clear();
+    }
+
     this->setSessionId( QUuid::createUuid().toString() );
     this->setReadOnly(false);
     this->setLocked(false);
@@ -805,7 +925,27 @@ bool ScriteDocument::openAnonymously(const QString &fileName)
 
     this->setBusyMessage("Loading ...");
     this->reset();
-    const bool ret = this->load(fileName);
+
+    // Backups in the DocumentBackupStore have to be put together into a
+    // document first. That document is kept around while it is open, because
+    // its entries are extracted from it lazily.
+    bool ret = false;
+    if(DocumentBackupStore::isBackup(fileName))
+    {
+        const QString restoredFileName = QStandardPaths::writableLocation(QStandardPaths::TempLocation) +
+                QStringLiteral("/scrite_backup_") + QString::number(QDateTime::currentMSecsSinceEpoch()) +
+                QStringLiteral(".scrite");
+        if(DocumentBackupStore::restore(fileName, restoredFileName))
+        {
+            m_restoredBackupFileName = restoredFileName;
+            ret = this->load(restoredFileName);
+        }
+        else
+            m_errorReport->setErrorMessage( QStringLiteral("Couldn't restore backup \"") + QFileInfo(fileName).baseName() + QStringLiteral("\"") );
+    }
+    else
+        ret = this->load(fileName);
+
     this->setModified(false);
     this->clearBusyMessage();
 
@@ -821,6 +961,12 @@ void ScriteDocument::saveAs(const QString &givenFileName)
     QString fileName = this->polishFileName(givenFileName.trimmed());
     fileName = Application::instance()->sanitiseFileName(fileName);
 
+    if(m_saveTask.watcher != nullptr)
+    {
+        this->queueSave(fileName, false);
+        return;
+    }
+
     m_errorReport->clear();
 
     if(!this->runSaveSanityChecks(fileName))
@@ -833,46 +979,67 @@ void ScriteDocument::saveAs(const QString &givenFileName)
 
     emit aboutToSave();
 
-    const QJsonObject json = QObjectSerializer::toJson(this);
-    const QByteArray bytes = QJsonDocument(json).toJson();
-    m_docFileSystem.setHeader(bytes);
-
-    const bool success = m_docFileSystem.save(fileName);
+    // Lets the backups panel show these counts without extracting the document.
+    QJsonObject metaData;
+    metaData.insert(QStringLiteral("structureElementCount"), m_structure->elementCount());
+    metaData.insert(QStringLiteral("screenplayElementCount"), m_screenplay->elementCount());
+    m_docFileSystem.setMetaData(metaData);
+
+    // The headers are a snapshot of the document, which is all that the background
+    // thread needs along with the snapshot of entries. Both the JSON and CBOR headers
+    // are streamed out of the object tree in one walk, straight into files of the save
+    // task. So neither a QJsonObject tree nor the header bytes are ever held in memory
+    // whole. Any change made to the document from here on will mark it as modified
+    // once again.
+    const QSharedPointer<DocumentFileSystemSaveTask> dfsTask = m_docFileSystem.prepareSave(fileName);
+    bool headersWritten = false;
+    if(!dfsTask.isNull())
+    {
+        QFile headerFile( DocumentFileSystem::headerFilePath(dfsTask) );
+        QFile binaryHeaderFile( DocumentFileSystem::binaryHeaderFilePath(dfsTask) );
+        if(headerFile.open(QFile::WriteOnly) && binaryHeaderFile.open(QFile::WriteOnly))
+        {
+            headersWritten = binaryHeaderFile.write(BinaryHeader::streamBegin()) > 0 &&
+                             QObjectSerializer::toJsonAndCbor(this, &headerFile, &binaryHeaderFile) &&
+                             binaryHeaderFile.write(BinaryHeader::streamEnd()) > 0;
+        }
+    }
 
-    if(!success)
+    if(!headersWritten)
     {
+        m_docFileSystem.finishSave(dfsTask);
         m_errorReport->setErrorMessage( QStringLiteral("Couldn't save document \"") + fileName + QStringLiteral("\"") );
-        emit justSaved();
         m_progressReport->finish();
         if(!m_autoSaveMode)
             this->clearBusyMessage();
         return;
     }
 
-#ifndef QT_NO_DEBUG
-    {
-        const QFileInfo fi(fileName);
-        const QString fileName2 = fi.absolutePath() + "/" + fi.baseName() + ".json";
-        QFile file2(fileName2);
-        file2.open(QFile::WriteOnly);
-        file2.write(bytes);
-    }
-#endif
-
-    this->setFileName(fileName);
-    this->setCreatedOnThisComputer(true);
-
-    emit justSaved();
-
     m_modified = false;
     emit modifiedChanged();
 
-    m_progressReport->finish();
+    m_saveTask.fileName = fileName;
+    m_saveTask.autoSaveMode = m_autoSaveMode;
+    m_saveTask.dfsTask = dfsTask;
 
-    this->setReadOnly(false);
+    QFuture<bool> future = QtConcurrent::run([dfsTask,fileName]() -> bool {
+#ifndef QT_NO_DEBUG
+        {
+            const QFileInfo fi(fileName);
+            const QString fileName2 = fi.absolutePath() + "/" + fi.baseName() + ".json";
+            QFile::remove(fileName2);
+            QFile::copy(DocumentFileSystem::headerFilePath(dfsTask), fileName2);
+        }
+#else
+        Q_UNUSED(fileName)
+#endif
 
-    if(!m_autoSaveMode)
-        this->clearBusyMessage();
+        return DocumentFileSystem::performSave(dfsTask);
+    });
+
+    m_saveTask.watcher = new QFutureWatcher<bool>(this);
+    connect(m_saveTask.watcher, &QFutureWatcher<bool>::finished, this, &ScriteDocument::onSaveTaskFinished);
+    m_saveTask.watcher->setFuture(future);
 }
 
 void ScriteDocument::save()
@@ -885,6 +1052,12 @@ void ScriteDocument::save()
     if(!this->runSaveSanityChecks(m_fileName))
         return;
 
+    if(m_saveTask.watcher != nullptr)
+    {
+        this->queueSave(m_fileName, true);
+        return;
+    }
+
     QFileInfo fi(m_fileName);
     if(fi.exists())
     {
@@ -900,8 +1073,18 @@ void ScriteDocument::save()
             return now - then;
         };
 
+        // Backups taken by older versions are complete copies of the document,
+        // newer ones are manifests in the DocumentBackupStore.
+        auto removeBackup = [](const QFileInfo &fi) {
+            if(DocumentBackupStore::isBackup(fi.absoluteFilePath()))
+                DocumentBackupStore::remove(fi.absoluteFilePath());
+            else
+                QFile::remove(fi.absoluteFilePath());
+        };
+
         const QDir backupDir(backupDirPath);
-        QFileInfoList backupEntries = backupDir.entryInfoList(QStringList() << QStringLiteral("*.scrite"), QDir::Files, QDir::Name);
+        const QStringList backupFilters = {QStringLiteral("*.scrite"), QStringLiteral("*.") + DocumentBackupStore::fileSuffix()};
+        QFileInfoList backupEntries = backupDir.entryInfoList(backupFilters, QDir::Files, QDir::Name);
         const bool firstBackup = backupEntries.isEmpty();
         if(!backupEntries.isEmpty())
         {
@@ -909,19 +1092,20 @@ void ScriteDocument::save()
             while(backupEntries.size() > maxBackups-1)
             {
                 const QFileInfo oldestEntry = backupEntries.takeFirst();
-                QFile::remove(oldestEntry.absoluteFilePath());
+                removeBackup(oldestEntry);
             }
 
             const QFileInfo latestEntry = backupEntries.takeLast();
-            if(latestEntry.suffix() == QStringLiteral("scrite"))
-            {
-                if(timeGapInSeconds(latestEntry) < 60)
-                    QFile::remove(latestEntry.absoluteFilePath());
-            }
+            if(timeGapInSeconds(latestEntry) < 60)
+                removeBackup(latestEntry);
         }
 
-        const QString backupFileName = backupDirPath + "/" + fi.baseName() + " [" + QString::number(now) + "].scrite";
-        const bool backupSuccessful = QFile::copy(m_fileName, backupFileName);
+        // Only entries that are not already in the backup store get copied into it.
+        // Documents that are not ZIP files are copied whole, like before.
+        const QString backupFileName = backupDirPath + "/" + fi.baseName() + " [" + QString::number(now) + "]";
+        bool backupSuccessful = DocumentBackupStore::backup(m_fileName, backupFileName + "." + DocumentBackupStore::fileSuffix());
+        if(!backupSuccessful)
+            backupSuccessful = QFile::copy(m_fileName, backupFileName + ".scrite");
 
         if(firstBackup && backupSuccessful)
             m_documentBackupsModel.loadBackupFileInformation();
@@ -1308,6 +1492,72 @@ void ScriteDocument::timerEvent(QTimerEvent *event)
     QObject::timerEvent(event);
 }
 
+void ScriteDocument::onSaveTaskFinished()
+{
+    if(m_saveTask.watcher == nullptr)
+        return;
+
+    const SaveTask task = m_saveTask;
+    m_saveTask = SaveTask();
+
+    disconnect(task.watcher, nullptr, this, nullptr);
+    task.watcher->deleteLater();
+
+    const bool success = m_docFileSystem.finishSave(task.dfsTask) && task.watcher->result();
+    if(!success)
+    {
+        m_errorReport->setErrorMessage( QStringLiteral("Couldn't save document \"") + task.fileName + QStringLiteral("\"") );
+        this->setModified(true);
+        emit justSaved();
+        m_progressReport->finish();
+        if(!task.autoSaveMode)
+            this->clearBusyMessage();
+    }
+    else
+    {
+        this->setFileName(task.fileName);
+        this->setCreatedOnThisComputer(true);
+
+        emit justSaved();
+
+        m_progressReport->finish();
+
+        this->setReadOnly(false);
+
+        if(!task.autoSaveMode)
+            this->clearBusyMessage();
+    }
+
+    if(!m_pendingSave.fileName.isEmpty())
+    {
+        const PendingSave pendingSave = m_pendingSave;
+        m_pendingSave = PendingSave();
+
+        QScopedValueRollback<bool> autoSave(m_autoSaveMode, pendingSave.autoSaveMode);
+        if(pendingSave.backup && pendingSave.fileName == m_fileName)
+            this->save();
+        else
+            this->saveAs(pendingSave.fileName);
+    }
+}
+
+void ScriteDocument::queueSave(const QString &fileName, bool backup)
+{
+    m_pendingSave.fileName = fileName;
+    m_pendingSave.backup = backup;
+    m_pendingSave.autoSaveMode &= m_autoSaveMode;
+}
+
+void ScriteDocument::waitForSaveTaskToFinish()
+{
+    // Saving a coalesced request may begin yet another save task, so we loop.
+    while(m_saveTask.watcher != nullptr)
+    {
+        m_saveTask.watcher->waitForFinished();
+        this->onSaveTaskFinished();
+    }
+}
+
 bool ScriteDocument::runSaveSanityChecks(const QString &givenFileName)
 {
     const QString fileName = givenFileName.trimmed();
@@ -1578,9 +1828,22 @@ bool ScriteDocument::load(const QString &fileName)
         ScriteDocument *m_document;
     } loadCleanup(this);
 
-    const QJsonDocument jsonDoc = format == DocumentFileSystem::ZipFormat ?
-                                  QJsonDocument::fromJson(m_docFileSystem.header()) :
-                                  QJsonDocument::fromBinaryData(m_docFileSystem.header());
+    // Documents saved by newer versions of Scrite carry a binary header, which
+    // is deserialized straight from CBOR, without ever building a JSON tree of the
+    // whole document. We fallback to the JSON header if the binary header is
+    // missing or cannot be understood.
+    QCborMap cbor;
+    if(format == DocumentFileSystem::ZipFormat)
+        cbor = BinaryHeader::toCborMap(m_docFileSystem.binaryHeader());
+
+    QJsonObject json;
+    if(cbor.isEmpty())
+    {
+        const QJsonDocument jsonDoc = format == DocumentFileSystem::ZipFormat ?
+                                      QJsonDocument::fromJson(m_docFileSystem.header()) :
+                                      QJsonDocument::fromBinaryData(m_docFileSystem.header());
+        json = jsonDoc.object();
+    }
 
 #ifndef QT_NO_DEBUG
     {
@@ -1588,18 +1851,17 @@ bool ScriteDocument::load(const QString &fileName)
         const QString fileName2 = fi.absolutePath() + "/" + fi.baseName() + ".json";
         QFile file2(fileName2);
         file2.open(QFile::WriteOnly);
-        file2.write(jsonDoc.toJson());
+        file2.write(QJsonDocument(cbor.isEmpty() ? json : cbor.toJsonObject()).toJson());
     }
 #endif
 
-    const QJsonObject json = jsonDoc.object();
-    if(json.isEmpty())
+    if(json.isEmpty() && cbor.isEmpty())
     {
         m_errorReport->setErrorMessage( QStringLiteral("%1 is not a Scrite document.").arg(fileName) );
         return false;
     }
 
-    const QJsonObject metaInfo = json.value("meta").toObject();
+    const QJsonObject metaInfo = cbor.isEmpty() ? json.value("meta").toObject() : cbor.value(QStringLiteral("meta")).toMap().toJsonObject();
     if(metaInfo.value("appName").toString().toLower() != qApp->applicationName().toLower())
     {
         m_errorReport->setErrorMessage(QStringLiteral("Scrite document '%1' was created using an unrecognised app.").arg(fileName));
@@ -1624,7 +1886,7 @@ bool ScriteDocument::load(const QString &fileName)
     loadCleanup.begin();
 
     UndoStack::ignoreUndoCommands = true;
-    const bool ret = QObjectSerializer::fromJson(json, this);
+    const bool ret = cbor.isEmpty() ? QObjectSerializer::fromJson(json, this) : QObjectSerializer::fromCbor(cbor, this);
     if(m_screenplay->currentElementIndex() == 0)
         m_screenplay->setCurrentElementIndex(-1);
     UndoStack::ignoreUndoCommands = false;
@@ -17,6 +17,8 @@
 #include <QDir>
 #include <QObject>
 #include <QJsonArray>
+#include <QThreadPool>
+#include <QFutureWatcher>
 
 #include "screenplay.h"
 #include "structure.h"
@@ -120,10 +122,14 @@ private:
     void loadMetaData(int row);
     void clear();
 
+    void loadMetaDataCache();
+    void saveMetaDataCache();
+
 private:
     struct MetaData
     {
         bool loaded = false;
+        bool loading = false;
         int structureElementCount = 0;
         int screenplayElementCount = 0;
         QJsonObject toJson() const;
@@ -135,6 +141,13 @@ private:
     QFileInfoList m_backupFiles;
     QVector<MetaData> m_metaDataList;
     QFileSystemWatcher *m_fsWatcher = nullptr;
+
+    // Meta-data is loaded from a few backups at a time, and cached across
+    // sessions against the size & modification time of each backup file.
+    QThreadPool m_metaDataThreadPool;
+    QJsonObject m_metaDataCache;
+    bool m_metaDataCacheLoaded = false;
+    QTimer m_metaDataCacheSaveTimer;
 };
 
 class ScriteDocument : public QObject, public QObjectSerializer::Interface
@@ -309,6 +322,8 @@ protected:
 
 private:
     bool runSaveSanityChecks(const QString &fileName);
+    void onSaveTaskFinished();
+    void waitForSaveTaskToFinish();
     void setReadOnly(bool val);
     void setLoading(bool val);
     void prepareAutoSave();
@@ -376,6 +391,29 @@ private:
     ExecLaterTimer m_evaluateStructureElementSequenceTimer;
     bool m_syncingStructureScreenplayCurrentIndex = false;
 
+    // Only the JSON snapshot of the document is taken on the main thread while saving,
+    // encoding & writing happens in the background. Save requests that arrive while
+    // one is in progress are coalesced into a single save of the latest file name.
+    // It is an auto-save only if all requests were, and it takes a backup first if
+    // the latest request was made through save().
+    struct SaveTask
+    {
+        QString fileName;
+        bool autoSaveMode = false;
+        QFutureWatcher<bool> *watcher = nullptr;
+        QSharedPointer<DocumentFileSystemSaveTask> dfsTask;
+    } m_saveTask;
+    struct PendingSave
+    {
+        QString fileName;
+        bool backup = false;
+        bool autoSaveMode = true;
+    } m_pendingSave;
+    void queueSave(const QString &fileName, bool backup);
+
+    // Document put together from a DocumentBackupStore backup, while it is open.
+    QString m_restoredBackupFileName;
+
     ErrorReport *m_errorReport = new ErrorReport(this);
     ProgressReport *m_progressReport = new ProgressReport(this);
 };
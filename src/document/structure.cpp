@@ -15,6 +15,7 @@
 #include "structure.h"
 #include "application.h"
 #include "timeprofiler.h"
+#include "searchengine.h"
 #include "scritedocument.h"
 #include "garbagecollector.h"
 
@@ -1140,6 +1141,16 @@ void Character::setVisibleOnNotebook(bool val)
     emit visibleOnNotebookChanged();
 }
 
+QStringList Character::photos() const
+{
+    // Photos are extracted from the document only when someone asks for them.
+    DocumentFileSystem *dfs = m_structure->scriteDocument()->fileSystem();
+    for(const QString &photo : m_photos)
+        dfs->absolutePath(photo);
+
+    return m_photos;
+}
+
 void Character::setPhotos(const QStringList &val)
 {
     if(m_photos == val || !m_photos.isEmpty())
@@ -1498,15 +1509,12 @@ void Character::deserializeFromJson(const QJsonObject &json)
         if( QDir::isAbsolutePath(path) )
             continue;
 
-        path = dfs->absolutePath(path);
-        if( path.isEmpty() || !QFile::exists(path) )
+        // Photos are extracted from the document when they are first asked for,
+        // see photos().
+        if( !dfs->exists(path) )
             continue;
 
-        QImage image(path);
-        if(image.isNull())
-            continue;
-
-        photoPaths.append(path);
+        photoPaths.append( dfs->lazyAbsolutePath(path) );
     }
 
     if(m_photos != photoPaths)
@@ -4025,9 +4033,45 @@ void Structure::updateCharacterNames()
         std::sort(names.begin(), names.end());
 
     m_characterNames = names;
+    m_characterNameIndex.clear();
+    m_characterNameSearchKey.clear();
+    m_characterNameSearchResult.clear();
     emit characterNamesChanged();
 }
 
+QStringList Structure::searchCharacterNames(const QString &text, int flags) const
+{
+    if(text.isEmpty())
+        return QStringList();
+
+    // Search agents in the notebook ask for this once for each name they show, so
+    // we answer all of them from the result of one query on the index.
+    const QString searchKey = QString::number(flags) + QStringLiteral(":") + text;
+    if(searchKey == m_characterNameSearchKey)
+        return m_characterNameSearchResult;
+
+    if(m_characterNameIndex.isEmpty())
+    {
+        for(const QString &name : m_characterNames)
+            m_characterNameIndex.insert(name, name);
+    }
+
+    const SearchEngine::SearchFlags searchFlags(flags);
+    const Qt::CaseSensitivity cs = searchFlags.testFlag(SearchEngine::SearchCaseSensitively) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    const QVector< TextSearchIndex<QString>::Match > matches = m_characterNameIndex.find(text, cs, searchFlags.testFlag(SearchEngine::SearchWholeWords));
+
+    QStringList names;
+    for(const TextSearchIndex<QString>::Match &match : matches)
+    {
+        if(names.isEmpty() || names.last() != match.key)
+            names << match.key;
+    }
+
+    m_characterNameSearchKey = searchKey;
+    m_characterNameSearchResult = names;
+    return names;
+}
+
 void Structure::updateCharacterNamesLater()
 {
     m_updateCharacterNamesTimer.start(0, this);
@@ -20,6 +20,7 @@
 #include "execlatertimer.h"
 #include "modelaggregator.h"
 #include "qobjectproperty.h"
+#include "textsearchindex.h"
 #include "abstractshapeitem.h"
 #include "objectlistpropertymodel.h"
 
@@ -371,7 +372,7 @@ public:
 
     Q_PROPERTY(QStringList photos READ photos WRITE setPhotos NOTIFY photosChanged STORED false)
     void setPhotos(const QStringList &val);
-    QStringList photos() const { return m_photos; }
+    QStringList photos() const;
     Q_SIGNAL void photosChanged();
 
     Q_INVOKABLE void addPhoto(const QString &photoPath);
@@ -648,6 +649,9 @@ public:
     Q_SIGNAL void characterCountChanged();
 
     Q_INVOKABLE QStringList allCharacterNames() const { return m_characterNames; }
+
+    // Names of characters in which text is found. Flags are SearchEngine::SearchFlags.
+    Q_INVOKABLE QStringList searchCharacterNames(const QString &text, int flags=0) const;
     Q_INVOKABLE QJsonArray detectCharacters() const;
     Q_INVOKABLE Character *addCharacter(const QString &name);
     Q_INVOKABLE void addCharacters(const QStringList &names);
@@ -855,6 +859,9 @@ private:
     ExecLaterTimer m_updateCharacterNamesTimer;
     CharacterElementMap m_characterElementMap;
     QStringList m_characterNames;
+    mutable TextSearchIndex<QString> m_characterNameIndex;
+    mutable QString m_characterNameSearchKey;
+    mutable QStringList m_characterNameSearchResult;
 
     static void staticAppendAnnotation(QQmlListProperty<Annotation> *list, Annotation *ptr);
     static void staticClearAnnotations(QQmlListProperty<Annotation> *list);
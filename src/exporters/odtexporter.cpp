@@ -41,7 +41,11 @@ bool OdtExporter::doExport(QIODevice *device)
 {
     const qreal pageWidth = 0; // pdfWriter.width();
     QTextDocument textDocument;
-    this->AbstractTextDocumentExporter::generate(&textDocument, pageWidth);
+    if( !this->AbstractTextDocumentExporter::generate(&textDocument, pageWidth) )
+    {
+        this->error()->setErrorMessage("ODT export was cancelled.");
+        return false;
+    }
 
     QTextDocumentWriter writer;
     writer.setFormat("ODF");
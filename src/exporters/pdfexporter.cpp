@@ -117,6 +117,32 @@ void PdfExporter::setComment(const QString &val)
 }
 
 bool PdfExporter::doExport(QIODevice *device)
+{
+    const qreal pageWidth = 0; // pdfWriter.width();
+    QTextDocument textDocument;
+    if( !this->AbstractTextDocumentExporter::generate(&textDocument, pageWidth) )
+    {
+        this->error()->setErrorMessage("PDF export was cancelled.");
+        return false;
+    }
+
+    return this->printDocument(&textDocument, device);
+}
+
+void PdfExporter::doExportLater(QIODevice *device)
+{
+    this->AbstractTextDocumentExporter::generateLater([=](QTextDocument *textDocument) {
+        if(textDocument == nullptr)
+        {
+            this->finishExport(false);
+            return;
+        }
+
+        this->finishExport( this->printDocument(textDocument, device) );
+    });
+}
+
+bool PdfExporter::printDocument(QTextDocument *textDocument, QIODevice *device)
 {
     Screenplay *screenplay = this->document()->screenplay();
     ScreenplayFormat *format = this->document()->printFormat();
@@ -155,17 +181,14 @@ bool PdfExporter::doExport(QIODevice *device)
         pdfDevice = qprinter.data();
     }
 
-    const qreal pageWidth = pdfDevice->width();
-    QTextDocument textDocument;
-    this->AbstractTextDocumentExporter::generate(&textDocument, pageWidth);    
-    textDocument.setProperty("#comment", m_comment);
-    textDocument.setProperty("#watermark", m_watermark);
+    textDocument->setProperty("#comment", m_comment);
+    textDocument->setProperty("#watermark", m_watermark);
 
     QTextDocumentPagedPrinter printer;
     printer.header()->setVisibleFromPageOne(false);
     printer.footer()->setVisibleFromPageOne(false);
     printer.watermark()->setVisibleFromPageOne(false);
-    bool success = printer.print(&textDocument, pdfDevice);
+    bool success = printer.print(textDocument, pdfDevice);
 
     if(!qprinter.isNull())
     {
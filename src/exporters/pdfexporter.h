@@ -89,8 +89,12 @@ public:
 
 protected:
     bool doExport(QIODevice *device); // AbstractExporter interface
+    void doExportLater(QIODevice *device); // AbstractExporter interface
     QString polishFileName(const QString &fileName) const; // AbstractDeviceIO interface
 
+private:
+    bool printDocument(QTextDocument *textDocument, QIODevice *device);
+
 private:
     QString m_comment;
     QString m_watermark;
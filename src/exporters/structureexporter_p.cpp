@@ -817,7 +817,7 @@ StructureUrlAnnotation::StructureUrlAnnotation(const Annotation *annotation)
     }
     else
     {
-        QPixmap pixmap(imagePath);
+        QPixmap pixmap = QPixmap::fromImage( document->fileSystem()->readImage(imagePath) );
         pixmap = pixmap.scaled(imageRect.size().toSize(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
 
         QGraphicsPixmapItem *pixmapItem = new QGraphicsPixmapItem(contentItem);
@@ -911,7 +911,7 @@ StructureImageAnnotation::StructureImageAnnotation(const Annotation *annotation)
     }
     else
     {
-        QPixmap pixmap(imagePath);
+        QPixmap pixmap = QPixmap::fromImage( document->fileSystem()->readImage(imagePath) );
 
         QSize pixmapSize = pixmap.size();
         pixmapSize.scale(imageRect.size().toSize(), Qt::KeepAspectRatio);
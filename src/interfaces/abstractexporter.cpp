@@ -49,6 +49,47 @@ QJsonObject AbstractExporter::configurationFormInfo() const
 }
 
 bool AbstractExporter::write()
+{
+    QFile file;
+    if( !this->beginExport(file) )
+        return false;
+
+    const bool ret = this->doExport(&file);
+    this->progress()->finish();
+
+    GarbageCollector::instance()->add(this);
+
+    return ret;
+}
+
+void AbstractExporter::writeLater()
+{
+    if(m_laterFile.isOpen())
+        return;
+
+    if( !this->beginExport(m_laterFile) )
+    {
+        emit finished(false);
+        return;
+    }
+
+    this->doExportLater(&m_laterFile);
+}
+
+void AbstractExporter::finishExport(bool success)
+{
+    if(!m_laterFile.isOpen())
+        return;
+
+    m_laterFile.close();
+    this->progress()->finish();
+
+    GarbageCollector::instance()->add(this);
+
+    emit finished(success);
+}
+
+bool AbstractExporter::beginExport(QFile &file)
 {
     QString fileName = this->fileName();
     ScriteDocument *document = this->document();
@@ -67,7 +108,7 @@ bool AbstractExporter::write()
         return false;
     }
 
-    QFile file(fileName);
+    file.setFileName(fileName);
     if( !file.open(QFile::WriteOnly) )
     {
         this->error()->setErrorMessage( QString("Could not open file '%1' for writing.").arg(fileName) );
@@ -79,10 +120,5 @@ bool AbstractExporter::write()
     this->progress()->setProgressText( QString("Generating \"%1\"").arg(classInfo.value()));
 
     this->progress()->start();
-    const bool ret = this->doExport(&file);
-    this->progress()->finish();
-
-    GarbageCollector::instance()->add(this);
-
-    return ret;
+    return true;
 }
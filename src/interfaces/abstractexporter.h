@@ -18,6 +18,8 @@
 #include "garbagecollector.h"
 #include "transliteration.h"
 
+#include <QFile>
+
 class AbstractExporter : public AbstractDeviceIO
 {
     Q_OBJECT
@@ -59,17 +61,35 @@ public:
 
     Q_INVOKABLE bool write();
 
+    // Same as write(), except that exporters which can generate their output in the
+    // background return right away. finished() is emitted once the file is written.
+    Q_INVOKABLE void writeLater();
+    Q_SIGNAL void finished(bool success);
+
+    // Cancels an export started by writeLater(), if the exporter can do that and it
+    // is still in progress. finished() is then emitted with success set to false.
+    Q_INVOKABLE virtual void cancel() { }
+
     Q_INVOKABLE void discard() { GarbageCollector::instance()->add(this); }
 
 protected:
     AbstractExporter(QObject *parent=nullptr);
     virtual bool doExport(QIODevice *device) = 0;
 
+    // Exporters that generate their output in the background reimplement this
+    // to start doing so, and call finishExport() once they are done.
+    virtual void doExportLater(QIODevice *device) { this->finishExport(this->doExport(device)); }
+    void finishExport(bool success);
+
     QMap<TransliterationEngine::Language,bool> languageBundleMap() const {
         return m_languageBundleMap;
     }
 
 private:
+    bool beginExport(QFile &file);
+
+private:
+    QFile m_laterFile;
     QMap<TransliterationEngine::Language,bool> m_languageBundleMap;
 };
 
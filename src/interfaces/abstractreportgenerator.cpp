@@ -168,6 +168,10 @@ bool AbstractReportGenerator::generate()
 
     QTextDocument textDocument;
 
+    // Reports may remove printed pages from the document, see printCompletePages().
+    // There is no point in keeping whatever they remove in the undo stack.
+    textDocument.setUndoRedoEnabled(false);
+
     textDocument.setDefaultFont(format->defaultFont());
     textDocument.setProperty("#title", screenplay->title());
     textDocument.setProperty("#subtitle", screenplay->subtitle());
@@ -180,33 +184,14 @@ bool AbstractReportGenerator::generate()
     textDocument.setProperty("#comment", m_comment);
     textDocument.setProperty("#watermark", m_watermark);
 
-    const QMetaObject *mo = this->metaObject();
-    const QMetaClassInfo classInfo = mo->classInfo(mo->indexOfClassInfo("Title"));
-    this->progress()->setProgressText( QString("Generating \"%1\"").arg(classInfo.value()));
-
-    this->progress()->start();
-    const bool ret = this->doGenerate(&textDocument);
-
-    if(!ret)
-    {
-        this->progress()->finish();
-        return ret;
-    }
+    // PDF devices are created before the report is generated, so that reports can
+    // print pages while they are still being generated.
+    QScopedPointer<QPdfWriter> qpdfWriter;
+    QScopedPointer<QPrinter> qprinter;
+    QTextDocumentPagedPrinter printer;
 
-    if(m_format == OpenDocumentFormat)
-    {
-        QTextDocumentWriter writer;
-        writer.setFormat("ODF");
-        writer.setDevice(&file);
-        this->configureWriter(&writer, &textDocument);
-        writer.write(&textDocument);
-    }
-    else
+    if(m_format == AdobePDF)
     {
-        QScopedPointer<QPdfWriter> qpdfWriter;
-        QScopedPointer<QPrinter> qprinter;
-        QPagedPaintDevice *pdfDevice = nullptr;
-
         if(usePdfWriter)
         {
             qpdfWriter.reset(new QPdfWriter(&file));
@@ -215,9 +200,7 @@ bool AbstractReportGenerator::generate()
             qpdfWriter->setCreator(qApp->applicationName() + QStringLiteral(" ") + qApp->applicationVersion() + QStringLiteral(" PdfWriter"));
             format->pageLayout()->configure(qpdfWriter.data());
             qpdfWriter->setPageMargins(QMarginsF(0.2,0.1,0.2,0.1), QPageLayout::Inch);
-            this->configureWriter(qpdfWriter.data(), &textDocument);
-
-            pdfDevice = qpdfWriter.data();
+            m_pdfWriter = qpdfWriter.data();
         }
         else
         {
@@ -231,22 +214,45 @@ bool AbstractReportGenerator::generate()
             qprinter->setCreator(qApp->applicationName() + QStringLiteral(" ") + qApp->applicationVersion() + QStringLiteral(" Printer"));
             format->pageLayout()->configure(qprinter.data());
             qprinter->setPageMargins(QMarginsF(0.2,0.1,0.2,0.1), QPageLayout::Inch);
-            this->configureWriter(qprinter.data(), &textDocument);
-
-            pdfDevice = qprinter.data();
+            m_pdfPrinter = qprinter.data();
         }
 
-        QTextDocumentPagedPrinter printer;
         printer.header()->setVisibleFromPageOne(true);
         printer.footer()->setVisibleFromPageOne(true);
         printer.watermark()->setVisibleFromPageOne(true);
-        this->configureTextDocumentPrinter(&printer, &textDocument);
-        printer.print(&textDocument, pdfDevice);
+        m_pagedPrinter = &printer;
     }
 
+    const QMetaObject *mo = this->metaObject();
+    const QMetaClassInfo classInfo = mo->classInfo(mo->indexOfClassInfo("Title"));
+    this->progress()->setProgressText( QString("Generating \"%1\"").arg(classInfo.value()));
+
+    this->progress()->start();
+    const bool ret = this->doGenerate(&textDocument);
+
+    if(ret)
+    {
+        if(m_format == OpenDocumentFormat)
+        {
+            QTextDocumentWriter writer;
+            writer.setFormat("ODF");
+            writer.setDevice(&file);
+            this->configureWriter(&writer, &textDocument);
+            writer.write(&textDocument);
+        }
+        else if(printer.isPrinting() || this->beginPrinting(&textDocument))
+            printer.printPages(&textDocument, true);
+    }
+
+    printer.end();
+    m_pagedPrinter = nullptr;
+    m_pdfWriter = nullptr;
+    m_pdfPrinter = nullptr;
+
     this->progress()->finish();
 
-    GarbageCollector::instance()->add(this);
+    if(ret)
+        GarbageCollector::instance()->add(this);
 
     return ret;
 }
@@ -284,6 +290,35 @@ QString AbstractReportGenerator::polishFileName(const QString &fileName) const
     return fileName;
 }
 
+bool AbstractReportGenerator::printCompletePages(QTextDocument *textDocument)
+{
+    if(m_pagedPrinter == nullptr)
+        return false;
+
+    if(!m_pagedPrinter->isPrinting() && !this->beginPrinting(textDocument))
+        return false;
+
+    return m_pagedPrinter->printPages(textDocument);
+}
+
+bool AbstractReportGenerator::beginPrinting(QTextDocument *textDocument)
+{
+    QPagedPaintDevice *pdfDevice = nullptr;
+    if(m_pdfWriter != nullptr)
+    {
+        this->configureWriter(m_pdfWriter, textDocument);
+        pdfDevice = m_pdfWriter;
+    }
+    else if(m_pdfPrinter != nullptr)
+    {
+        this->configureWriter(m_pdfPrinter, textDocument);
+        pdfDevice = m_pdfPrinter;
+    }
+
+    this->configureTextDocumentPrinter(m_pagedPrinter, textDocument);
+    return m_pagedPrinter->begin(pdfDevice, textDocument);
+}
+
 bool AbstractReportGenerator::usePdfWriter() const
 {
     const bool val = Application::instance()->settings()->value(QStringLiteral("PdfExport/usePdfDriver"), true).toBool();
@@ -87,6 +87,11 @@ protected:
     virtual void configureWriter(QPrinter *, const QTextDocument *) const { }
     virtual void configureTextDocumentPrinter(QTextDocumentPagedPrinter *, const QTextDocument *) { }
 
+    // Reports that are written top to bottom can call this from doGenerate() every now
+    // and then. When generating a PDF, pages that are complete are printed right away
+    // and removed from the document. Returns false if nothing could be printed.
+    bool printCompletePages(QTextDocument *textDocument);
+
     virtual bool canDirectPrintToPdf() const { return false; }
     virtual bool directPrintToPdf(QPdfWriter *) { return false; }
     virtual bool directPrintToPdf(QPrinter *) { return false; }
@@ -94,10 +99,16 @@ protected:
     virtual bool canDirectExportToOdf() const { return false; }
     virtual bool directExportToOdf(QIODevice *) { return false; }
 
+private:
+    bool beginPrinting(QTextDocument *textDocument);
+
 private:
     Format m_format = AdobePDF;
     QString m_comment;
     QString m_watermark;
+    QPdfWriter *m_pdfWriter = nullptr;
+    QPrinter *m_pdfPrinter = nullptr;
+    QTextDocumentPagedPrinter *m_pagedPrinter = nullptr;
 };
 
 #endif // ABSTRACTREPORTGENERATOR_H
@@ -52,30 +52,62 @@ void AbstractTextDocumentExporter::setIncludeSceneContents(bool val)
     emit includeSceneContentsChanged();
 }
 
-void AbstractTextDocumentExporter::generate(QTextDocument *textDoc, const qreal pageWidth)
+void AbstractTextDocumentExporter::cancel()
+{
+    if(m_generator != nullptr)
+        m_generator->cancelPrintLayout();
+}
+
+bool AbstractTextDocumentExporter::generate(QTextDocument *textDoc, const qreal pageWidth)
 {
     Q_UNUSED(pageWidth)
 
     ScreenplayTextDocument stDoc;
-    stDoc.setTitlePage(this->generateTitlePage());
-    stDoc.setSceneNumbers(this->isIncludeSceneNumbers());
-    stDoc.setSceneIcons(this->isIncludeSceneIcons());
-    stDoc.setListSceneCharacters(m_listSceneCharacters);
-    stDoc.setIncludeSceneSynopsis(m_includeSceneSynopsis);
-    stDoc.setPrintEachSceneOnANewPage(this->isPrintEachSceneOnANewPage());
-    stDoc.setPrintEachActOnANewPage(this->isPrintEachActOnANewPage());
-    stDoc.setIncludeActBreaks(this->isIncludeActBreaks());
-    stDoc.setSyncEnabled(false);
-    if(this->isExportForPrintingPurpose() || (this->usePageBreaks() && m_includeSceneContents))
-        stDoc.setPurpose(ScreenplayTextDocument::ForPrinting);
-    else
-        stDoc.setPurpose(ScreenplayTextDocument::ForDisplay);
-    stDoc.setScreenplay(this->document()->screenplay());
-    stDoc.setFormatting(this->document()->printFormat());
-    stDoc.setTitlePageIsCentered(this->document()->screenplay()->isTitlePageIsCentered());
+    this->configure(&stDoc);
     stDoc.setTextDocument(textDoc);
-    stDoc.setInjection(this);
+
+    m_generator = &stDoc;
     stDoc.syncNow();
+    m_generator = nullptr;
+
+    return !stDoc.isPrintLayoutCancelled();
+}
+
+void AbstractTextDocumentExporter::generateLater(const std::function<void(QTextDocument*)> &done)
+{
+    ScreenplayTextDocument *stDoc = new ScreenplayTextDocument(this);
+    this->configure(stDoc);
+
+    m_generator = stDoc;
+    connect(stDoc, &ScreenplayTextDocument::printLayoutFinished, this, [=]() {
+        if(m_generator == stDoc)
+            m_generator = nullptr;
+        done(stDoc->isPrintLayoutCancelled() ? nullptr : stDoc->textDocument());
+        stDoc->deleteLater();
+    }, Qt::QueuedConnection);
+    stDoc->syncInBackground();
+}
+
+void AbstractTextDocumentExporter::configure(ScreenplayTextDocument *stDoc)
+{
+    stDoc->setTitlePage(this->generateTitlePage());
+    stDoc->setSceneNumbers(this->isIncludeSceneNumbers());
+    stDoc->setSceneIcons(this->isIncludeSceneIcons());
+    stDoc->setListSceneCharacters(m_listSceneCharacters);
+    stDoc->setIncludeSceneSynopsis(m_includeSceneSynopsis);
+    stDoc->setPrintEachSceneOnANewPage(this->isPrintEachSceneOnANewPage());
+    stDoc->setPrintEachActOnANewPage(this->isPrintEachActOnANewPage());
+    stDoc->setIncludeActBreaks(this->isIncludeActBreaks());
+    stDoc->setSyncEnabled(false);
+    if(this->isExportForPrintingPurpose() || (this->usePageBreaks() && m_includeSceneContents))
+        stDoc->setPurpose(ScreenplayTextDocument::ForPrinting);
+    else
+        stDoc->setPurpose(ScreenplayTextDocument::ForDisplay);
+    stDoc->setScreenplay(this->document()->screenplay());
+    stDoc->setFormatting(this->document()->printFormat());
+    stDoc->setTitlePageIsCentered(this->document()->screenplay()->isTitlePageIsCentered());
+    stDoc->setInjection(this);
+    stDoc->setProgressReport(this->progress());
 }
 
 bool AbstractTextDocumentExporter::filterSceneElement() const
@@ -17,6 +17,8 @@
 #include "abstractexporter.h"
 #include "screenplaytextdocument.h"
 
+#include <functional>
+
 class AbstractTextDocumentExporter : public AbstractExporter,
                                      public AbstractScreenplayTextDocumentInjectionInterface
 {
@@ -58,17 +60,29 @@ public:
 
     bool requiresConfiguration() const { return true; }
 
+    // Cancels generation of the text document, if one is in progress.
+    void cancel();
+
 protected:
     AbstractTextDocumentExporter(QObject *parent=nullptr);
-    void generate(QTextDocument *textDocument, const qreal pageWidth);
+    bool generate(QTextDocument *textDocument, const qreal pageWidth);
+
+    // Generates the text document with layout passes running in the background, and
+    // calls done() with it once they are finished. The document passed to done() is
+    // null if generation was cancelled, and is deleted once done() returns.
+    void generateLater(const std::function<void(QTextDocument*)> &done);
 
     // AbstractScreenplayTextDocumentInjectionInterface interface
     bool filterSceneElement() const;
 
+private:
+    void configure(ScreenplayTextDocument *stDoc);
+
 private:
     bool m_listSceneCharacters = false;
     bool m_includeSceneSynopsis = false;
     bool m_includeSceneContents = true;
+    ScreenplayTextDocument *m_generator = nullptr;
 };
 
 #endif // ABSTRACTTEXTDOCUMENTEXPORTER_H
@@ -17,11 +17,13 @@
 #include <QDir>
 #include <QBuffer>
 #include <QtDebug>
+#include <QThread>
 #include <QPicture>
 #include <QDateTime>
 #include <QQmlEngine>
 #include <QPainterPath>
 #include <QPaintEngine>
+#include <QtConcurrentRun>
 
 class ImagePrinterImageProvider : public QObject, public QQuickImageProvider
 {
@@ -124,10 +126,16 @@ ImagePrinter::ImagePrinter(QObject *parent)
 
     this->setObjectName( QStringLiteral("imagePrinter") );
     connect(this, &QObject::objectNameChanged, this, &ImagePrinter::pagesChanged); // because all pageUrls will change
+
+    m_pageImageCache.setMaxCost(256*1024);
+    m_prefetchThreadPool.setMaxThreadCount( qBound(1, QThread::idealThreadCount()/2, 2) );
 }
 
 ImagePrinter::~ImagePrinter()
 {
+    m_prefetchThreadPool.clear();
+    m_prefetchThreadPool.waitForDone();
+
     emit aboutToDelete(this);
 
     m_pageImagesData.clear();
@@ -170,15 +178,105 @@ QImage ImagePrinter::pageImageAt(int index)
     if(index < 0 || index >= m_pageImagesData.size())
         return QImage();
 
+    const qreal scale = m_scale;
+    const PageImageKey key = qMakePair(index, scale);
+
+    {
+        QMutexLocker lock(&m_pageImageCacheLock);
+        const QImage *cachedImage = m_pageImageCache.object(key);
+        if(cachedImage != nullptr)
+        {
+            m_pageImageCacheHits.ref();
+            return *cachedImage;
+        }
+    }
+
+    m_pageImageCacheMisses.ref();
+
+    const int generation = m_pageImageCacheGeneration.loadAcquire();
+    const QImage image = this->renderPageImage(index, scale);
+    if(!image.isNull())
+    {
+        QMutexLocker lock(&m_pageImageCacheLock);
+        if(generation == m_pageImageCacheGeneration.loadAcquire())
+            m_pageImageCache.insert(key, new QImage(image), image.sizeInBytes()/1024);
+    }
+
+    // Pages on either side are likely to be asked for next
+    this->prefetchPageImages(index-2, index+2);
+
+    return image;
+}
+
+void ImagePrinter::setPageImageCacheLimit(int val)
+{
+    val = qMax(val, 0);
+
+    QMutexLocker lock(&m_pageImageCacheLock);
+    if(m_pageImageCache.maxCost() == val*1024)
+        return;
+
+    m_pageImageCache.setMaxCost(val*1024);
+    lock.unlock();
+
+    emit pageImageCacheLimitChanged();
+}
+
+int ImagePrinter::pageImageCacheLimit() const
+{
+    QMutexLocker lock(&m_pageImageCacheLock);
+    return m_pageImageCache.maxCost()/1024;
+}
+
+void ImagePrinter::prefetchPageImages(int fromIndex, int toIndex)
+{
+    const int nrPages = this->pageCount();
+    fromIndex = qMax(fromIndex, 0);
+    toIndex = qMin(toIndex, nrPages-1);
+
+    const qreal scale = m_scale;
+    const int generation = m_pageImageCacheGeneration.loadAcquire();
+
+    QMutexLocker lock(&m_pageImageCacheLock);
+    for(int i=fromIndex; i<=toIndex; i++)
+    {
+        const PageImageKey key = qMakePair(i, scale);
+        if(m_pageImageCache.contains(key) || m_pageImagesBeingPrefetched.contains(key))
+            continue;
+
+        m_pageImagesBeingPrefetched += key;
+
+        QtConcurrent::run(&m_prefetchThreadPool, [=]() {
+            const QImage image = this->renderPageImage(key.first, key.second);
+
+            QMutexLocker lock(&m_pageImageCacheLock);
+            m_pageImagesBeingPrefetched -= key;
+            if(!image.isNull() && generation == m_pageImageCacheGeneration.loadAcquire())
+                m_pageImageCache.insert(key, new QImage(image), image.sizeInBytes()/1024);
+        });
+    }
+}
+
+qreal ImagePrinter::pageImageCacheHitRatio() const
+{
+    const int hits = m_pageImageCacheHits.loadAcquire();
+    const int total = hits + m_pageImageCacheMisses.loadAcquire();
+    return total > 0 ? qreal(hits)/qreal(total) : 0;
+}
+
+QImage ImagePrinter::renderPageImage(int index, qreal scale)
+{
     QReadLocker lock(&m_pageImagesDataLock);
+    if(index < 0 || index >= m_pageImagesData.size())
+        return QImage();
 
     const QByteArray bytes = m_pageImagesData.at(index);
 
     QPicture picture;
     picture.setData(bytes.data(), bytes.size());
 
-    QImage image(m_pageSize*m_scale, QImage::Format_ARGB32);
-    image.setDevicePixelRatio(m_scale);
+    QImage image(m_pageSize*scale, QImage::Format_ARGB32);
+    image.setDevicePixelRatio(scale);
     image.fill(Qt::white);
 
     QPainter paint(&image);
@@ -188,6 +286,15 @@ QImage ImagePrinter::pageImageAt(int index)
     return image;
 }
 
+void ImagePrinter::clearPageImageCache()
+{
+    // Images that are being rendered in the background right now are for
+    // pages that no longer exist, they shouldn't make it into the cache.
+    QMutexLocker lock(&m_pageImageCacheLock);
+    m_pageImageCacheGeneration.ref();
+    m_pageImageCache.clear();
+}
+
 QString ImagePrinter::pageUrl(int index) const
 {
     return "image://" + ImagePrinterImageProvider::urlNamespace() + "/" +
@@ -202,7 +309,10 @@ void ImagePrinter::clear()
         return;
 
     this->beginResetModel();
+    m_pageImagesDataLock.lockForWrite();
     m_pageImagesData.clear();
+    m_pageImagesDataLock.unlock();
+    this->clearPageImageCache();
     this->endResetModel();
 }
 
@@ -363,7 +473,10 @@ void ImagePrinter::begin()
     m_pageSize = this->pageLayout().pageSize().sizePixels(resolution);
 
     m_templatePageImage = QImage(m_pageSize.width(), m_pageSize.height(), QImage::Format_ARGB32);
+    m_pageImagesDataLock.lockForWrite();
     m_pageImagesData.clear();
+    m_pageImagesDataLock.unlock();
+    this->clearPageImageCache();
 }
 
 void ImagePrinter::end()
@@ -14,7 +14,12 @@
 #ifndef PRINTTOIMAGE_H
 #define PRINTTOIMAGE_H
 
+#include <QSet>
+#include <QCache>
+#include <QMutex>
 #include <QObject>
+#include <QAtomicInt>
+#include <QThreadPool>
 #include <QReadWriteLock>
 #include <QQmlParserStatus>
 #include <QPagedPaintDevice>
@@ -67,6 +72,19 @@ public:
     QImage pageImageAt(int index); // this function is non-const on purpose.
     Q_INVOKABLE QString pageUrl(int index) const;
 
+    // Rendered page images are cached, upto this many mega-bytes
+    Q_PROPERTY(int pageImageCacheLimit READ pageImageCacheLimit WRITE setPageImageCacheLimit NOTIFY pageImageCacheLimitChanged)
+    void setPageImageCacheLimit(int val);
+    int pageImageCacheLimit() const;
+    Q_SIGNAL void pageImageCacheLimitChanged();
+
+    // Renders images of pages in the given range into the cache, in the background.
+    Q_INVOKABLE void prefetchPageImages(int fromIndex, int toIndex);
+
+    Q_INVOKABLE int pageImageCacheHitCount() const { return m_pageImageCacheHits.loadAcquire(); }
+    Q_INVOKABLE int pageImageCacheMissCount() const { return m_pageImageCacheMisses.loadAcquire(); }
+    Q_INVOKABLE qreal pageImageCacheHitRatio() const;
+
     Q_INVOKABLE void clear();
 
     Q_PROPERTY(bool printing READ isPrinting WRITE setPrinting NOTIFY printingChanged)
@@ -107,6 +125,8 @@ private:
     void begin();
     void end();
     void capturePrintedPageImage();
+    QImage renderPageImage(int index, qreal scale);
+    void clearPageImageCache();
 
 private:
     friend class ImagePrinterEngine;
@@ -119,6 +139,17 @@ private:
     QReadWriteLock m_pageImagesDataLock;
     mutable QImage m_templatePageImage;
     mutable ImagePrinterEngine *m_engine = nullptr;
+
+    // Page images keyed by page index and scale. The cost of each image is its
+    // size in kilo-bytes.
+    typedef QPair<int,qreal> PageImageKey;
+    QCache<PageImageKey,QImage> m_pageImageCache;
+    QSet<PageImageKey> m_pageImagesBeingPrefetched;
+    mutable QMutex m_pageImageCacheLock;
+    QAtomicInt m_pageImageCacheGeneration;
+    QAtomicInt m_pageImageCacheHits;
+    QAtomicInt m_pageImageCacheMisses;
+    QThreadPool m_prefetchThreadPool;
 };
 
 #endif // PRINTTOIMAGE_H
@@ -22,6 +22,7 @@
 #include <QDateTime>
 #include <QSettings>
 #include <QTextBlock>
+#include <QTextCursor>
 #include <QPaintEngine>
 #include <QAbstractTextDocumentLayout>
 
@@ -363,42 +364,66 @@ QTextDocumentPagedPrinter::~QTextDocumentPagedPrinter()
 // my own print() implementation and it always sucked in stellar proportions.
 Q_DECL_IMPORT int qt_defaultDpi();
 
-template <class T>
-struct Pointer
+bool QTextDocumentPagedPrinter::print(QTextDocument *document, QPagedPaintDevice *printer)
 {
-    Pointer(T **ptr) : m_ptr(ptr) { }
-    ~Pointer() { *m_ptr = nullptr; }
+    if(!this->begin(printer, document))
+        return false;
 
-private:
-    T **m_ptr;
-};
+    const QSizeF pageSize = document->pageSize();
+    const bool documentPaginated = pageSize.isValid() && !pageSize.isNull() && int(pageSize.height()) != INT_MAX;
 
-bool QTextDocumentPagedPrinter::print(QTextDocument *document, QPagedPaintDevice *printer)
-{
-    Pointer<QTextDocument> td(&m_textDocument);
-    Pointer<QPagedPaintDevice> pr(&m_printer);
-    m_textDocument = document;
-    m_printer = printer;
+    bool success = false;
+    if(documentPaginated)
+    {
+        // Documents generated using ScreenplayTextDocument will come paginated.
+        success = this->printPages(document, true);
+    }
+    else
+    {
+        // Reports generated using AbstractReportGenerator are not paginated. They
+        // have to be laid out for the printer, which we do on a clone so that the
+        // document given to us is left alone. Reports that are large enough to
+        // worry about memory stream their pages through printPages() instead.
+        QScopedPointer<QTextDocument> clonedDoc(document->clone());
+        for (QTextBlock srcBlock = document->firstBlock(), dstBlock = clonedDoc->firstBlock();
+             srcBlock.isValid() && dstBlock.isValid();
+             srcBlock = srcBlock.next(), dstBlock = dstBlock.next())
+        {
+            dstBlock.layout()->setFormats(srcBlock.layout()->formats());
+        }
+
+        success = this->printPages(clonedDoc.data(), true);
+    }
+
+    this->end();
 
+    return success;
+}
+
+bool QTextDocumentPagedPrinter::begin(QPagedPaintDevice *printer, const QTextDocument *fieldsDocument)
+{
     m_errorReport->clear();
 
-    if(m_textDocument == nullptr)
+    if(fieldsDocument == nullptr)
     {
         m_errorReport->setErrorMessage("No document to print.");
         return false;
     }
 
-    if(m_printer == nullptr)
+    if(printer == nullptr)
     {
         m_errorReport->setErrorMessage("No printer to print.");
         return false;
     }
 
-    if(!printer)
+    if(!m_painter.isNull())
+    {
+        m_errorReport->setErrorMessage("Printing is already in progress.");
         return false;
+    }
 
-    const QSizeF pageSize = document->pageSize();
-    bool documentPaginated = pageSize.isValid() && !pageSize.isNull() && int(pageSize.height()) != INT_MAX;
+    const QSizeF pageSize = fieldsDocument->pageSize();
+    const bool documentPaginated = pageSize.isValid() && !pageSize.isNull() && int(pageSize.height()) != INT_MAX;
 
     QPagedPaintDevice::Margins m = printer->margins();
     if (!documentPaginated && m.left == 0. && m.right == 0. && m.top == 0. && m.bottom == 0.)
@@ -407,25 +432,79 @@ bool QTextDocumentPagedPrinter::print(QTextDocument *document, QPagedPaintDevice
         printer->setMargins(m);
     }
 
-    QPainter painter(printer);
-    if (!painter.isActive())
+    m_painter.reset(new QPainter(printer));
+    if (!m_painter->isActive())
+    {
+        m_painter.reset();
         return false;
+    }
+
+    m_printer = printer;
+    m_pagesPrinted = 0;
+
+    // Lets configure the header and footer fields before we actually go ahead and print.
+    m_fieldMap.clear();
+    m_fieldMap[HeaderFooter::AppName] = Application::instance()->applicationName();
+    m_fieldMap[HeaderFooter::AppVersion] = Application::instance()->applicationVersion();
+    m_fieldMap[HeaderFooter::Title] = fieldsDocument->property("#title").toString();
+    m_fieldMap[HeaderFooter::Subtitle] = fieldsDocument->property("#subtitle").toString();
+    m_fieldMap[HeaderFooter::Author] = fieldsDocument->property("#author").toString();
+    m_fieldMap[HeaderFooter::Contact] = fieldsDocument->property("#contact").toString();
+    m_fieldMap[HeaderFooter::Version] = fieldsDocument->property("#version").toString();
+    m_fieldMap[HeaderFooter::Email] = fieldsDocument->property("#email").toString();
+    m_fieldMap[HeaderFooter::Phone] = fieldsDocument->property("#phone").toString();
+    m_fieldMap[HeaderFooter::Website] = fieldsDocument->property("#website").toString();
+    m_fieldMap[HeaderFooter::Comment] = fieldsDocument->property("#comment").toString();
+    m_fieldMap[HeaderFooter::Watermark] = fieldsDocument->property("#watermark").toString();
+    m_fieldMap[HeaderFooter::Date] = QDate::currentDate().toString(Qt::SystemLocaleShortDate);
+    m_fieldMap[HeaderFooter::Time] = QTime::currentTime().toString(Qt::SystemLocaleShortDate);
+    m_fieldMap[HeaderFooter::DateTime] = QDateTime::currentDateTime().toString(Qt::SystemLocaleShortDate);
+
+    const QString watermarkText = m_fieldMap.value(HeaderFooter::Watermark);
+    if(!watermarkText.isEmpty())
+        m_watermark->setText(watermarkText);
 
-    const QTextDocument *doc = document;
-    QScopedPointer<QTextDocument> clonedDoc;
-    (void)doc->documentLayout(); // make sure that there is a layout
+    m_progressReport->start();
+
+    return true;
+}
+
+bool QTextDocumentPagedPrinter::printPages(QTextDocument *document, bool lastPart)
+{
+    if(m_painter.isNull())
+    {
+        m_errorReport->setErrorMessage("Printing has not begun.");
+        return false;
+    }
+
+    if(document == nullptr)
+    {
+        m_errorReport->setErrorMessage("No document to print.");
+        return false;
+    }
+
+    QPagedPaintDevice *printer = m_printer;
+    QPainter &painter = *m_painter;
+
+    const QSizeF pageSize = document->pageSize();
+    bool documentPaginated = pageSize.isValid() && !pageSize.isNull() && int(pageSize.height()) != INT_MAX;
+
+    // Paginated documents belong to whoever paginated them, so we cannot take
+    // printed pages out of them. They are printed in one go.
+    if(documentPaginated && !lastPart)
+        return true;
+
+    QAbstractTextDocumentLayout *layout = document->documentLayout(); // make sure that there is a layout
 
     QRectF body = QRectF(QPointF(0, 0), pageSize);
     QPair<qreal,qreal> contentScale = qMakePair(1.0, 1.0);
 
     if (documentPaginated)
     {
-        // Documents generated using ScreenplayTextDocument will come paginated.
-
         qreal sourceDpiX = qt_defaultDpi();
         qreal sourceDpiY = sourceDpiX;
 
-        QPaintDevice *dev = doc->documentLayout()->paintDevice();
+        QPaintDevice *dev = layout->paintDevice();
         if (dev)
         {
             sourceDpiX = dev->logicalDpiX();
@@ -449,29 +528,24 @@ bool QTextDocumentPagedPrinter::print(QTextDocument *document, QPagedPaintDevice
     }
     else
     {
-        // Reports generated using AbstractReportGenerator are not paginated.
-
-        doc = document->clone(this);
-        clonedDoc.reset(const_cast<QTextDocument *>(doc));
-
-        for (QTextBlock srcBlock = document->firstBlock(), dstBlock = clonedDoc->firstBlock();
-             srcBlock.isValid() && dstBlock.isValid();
-             srcBlock = srcBlock.next(), dstBlock = dstBlock.next())
-        {
-            dstBlock.layout()->setFormats(srcBlock.layout()->formats());
-        }
-
-        QAbstractTextDocumentLayout *layout = doc->documentLayout();
-        layout->setPaintDevice(painter.device());
+        // The document is laid out for the printer. Each of these changes lays out
+        // the whole document again, so they are made only when the document
+        // is not already laid out for the printer.
+        if(layout->paintDevice() != painter.device())
+            layout->setPaintDevice(painter.device());
 
         // We dont have to do this because we do not use any custom handlers in Scrite.
         // layout->d_func()->handlers = documentLayout()->d_func()->handlers;
 
         int dpiy = painter.device()->logicalDpiY();
         int margin = int(((2/2.54)*dpiy)); // 2 cm margins
-        QTextFrameFormat fmt = doc->rootFrame()->frameFormat();
-        fmt.setMargin(margin);
-        doc->rootFrame()->setFrameFormat(fmt);
+        QTextFrameFormat fmt = document->rootFrame()->frameFormat();
+        if(!qFuzzyCompare(fmt.topMargin(), qreal(margin)) || !qFuzzyCompare(fmt.bottomMargin(), qreal(margin)) ||
+           !qFuzzyCompare(fmt.leftMargin(), qreal(margin)) || !qFuzzyCompare(fmt.rightMargin(), qreal(margin)))
+        {
+            fmt.setMargin(margin);
+            document->rootFrame()->setFrameFormat(fmt);
+        }
 
         body = QRectF(0, 0, printer->width(), printer->height());
 
@@ -482,99 +556,162 @@ bool QTextDocumentPagedPrinter::print(QTextDocument *document, QPagedPaintDevice
         //                         + QFontMetrics(doc->defaultFont(), p.device()).ascent()
         //                         + 5 * dpiy / 72.0);
 
-        clonedDoc->setPageSize(body.size());
+        if(document->pageSize() != body.size())
+            document->setPageSize(body.size());
     }
 
     // At this point we are ready to print as far as QTextDocument is concerned.
+    const int pageCount = document->pageCount();
+
+    // Unless this is the last part, only pages that are complete are printed. A page is
+    // complete once something begins on a page after it. Content on and after the last
+    // page may still change, so the document is cut at the first top level block that
+    // reaches into it. Everything above that block is printed and then removed from the
+    // document. The block itself moves to the top of the next page.
+    int nrPages = pageCount;
+    qreal lastPageBottom = -1;
+    QTextBlock cutBlock;
+    if(!lastPart)
+    {
+        if(pageCount < 2)
+            return true;
 
-    // Lets configure the headers and footers before we actually go ahead and print.
-    QMap<HeaderFooter::Field,QString> fieldMap;
-    fieldMap[HeaderFooter::AppName] = Application::instance()->applicationName();
-    fieldMap[HeaderFooter::AppVersion] = Application::instance()->applicationVersion();
-    fieldMap[HeaderFooter::Title] = document->property("#title").toString();
-    fieldMap[HeaderFooter::Subtitle] = document->property("#subtitle").toString();
-    fieldMap[HeaderFooter::Author] = document->property("#author").toString();
-    fieldMap[HeaderFooter::Contact] = document->property("#contact").toString();
-    fieldMap[HeaderFooter::Version] = document->property("#version").toString();
-    fieldMap[HeaderFooter::Email] = document->property("#email").toString();
-    fieldMap[HeaderFooter::Phone] = document->property("#phone").toString();
-    fieldMap[HeaderFooter::Website] = document->property("#website").toString();
-    fieldMap[HeaderFooter::Comment] = document->property("#comment").toString();
-    fieldMap[HeaderFooter::Watermark] = document->property("#watermark").toString();
-    fieldMap[HeaderFooter::Date] = QDate::currentDate().toString(Qt::SystemLocaleShortDate);
-    fieldMap[HeaderFooter::Time] = QTime::currentTime().toString(Qt::SystemLocaleShortDate);
-    fieldMap[HeaderFooter::DateTime] = QDateTime::currentDateTime().toString(Qt::SystemLocaleShortDate);
-    fieldMap[HeaderFooter::PageNumber] = QString::number(doc->pageCount()) + ".  ";
-    fieldMap[HeaderFooter::PageNumberOfCount] = QString::number(doc->pageCount()) + "/" + QString::number(doc->pageCount()) + "  ";
-
-    // Here is where we got to figure out the header, footer and watermark rectangles
-    const QTextFrameFormat fmt = doc->rootFrame()->frameFormat();
-    const qreal topMargin = fmt.topMargin() * contentScale.second;
-    const qreal leftMargin = fmt.leftMargin() * contentScale.first;
-    const qreal rightMargin = fmt.rightMargin() * contentScale.first;
-    const qreal bottomMargin = fmt.bottomMargin() * contentScale.second;
-    const qreal padding = 0;
-
-    m_headerRect = QRectF(0, 0, printer->width(), printer->height());
-    m_footerRect = m_headerRect;
-
-    m_headerRect.setLeft(leftMargin);
-    m_headerRect.setBottom(topMargin - padding);
-    m_headerRect.setRight(printer->width() - rightMargin);
-
-    m_footerRect.setTop(printer->height() - bottomMargin + padding);
-    m_footerRect.setLeft(leftMargin);
-    m_footerRect.setRight(printer->width() - rightMargin);
-
-    m_header->setFont(doc->defaultFont());
-    m_footer->setFont(doc->defaultFont());
-    m_header->prepare(fieldMap, m_headerRect, printer);
-    m_footer->prepare(fieldMap, m_footerRect, printer);
-
-    const QString watermarkText = fieldMap.value(HeaderFooter::Watermark);
-    if(!watermarkText.isEmpty())
-        m_watermark->setText(watermarkText);
+        const qreal lastPageTop = (pageCount-1) * body.height();
+
+        QTextBlock previousBlock;
+        QTextFrame::iterator it = document->rootFrame()->begin();
+        while(!it.atEnd())
+        {
+            QTextFrame *frame = it.currentFrame();
+            const QTextBlock block = it.currentBlock();
+            const QRectF rect = frame ? layout->frameBoundingRect(frame) : layout->blockBoundingRect(block);
+            if(rect.bottom() > lastPageTop)
+            {
+                // Tables and other frames are not split. They move to the next page
+                // along with the block just before them.
+                cutBlock = frame ? previousBlock : block;
+                break;
+            }
+
+            if(frame == nullptr)
+                previousBlock = block;
+            ++it;
+        }
 
-    // We are now ready to print.
-    const int fromPageNr = 1;
-    const int toPageNr = doc->pageCount();
+        if(!cutBlock.isValid() || cutBlock == document->firstBlock())
+            return true;
 
-    m_progressReport->start();
-    m_progressReport->setProgressStep(1/qreal(doc->pageCount()+1));
-    int pageNr = fromPageNr;
+        lastPageBottom = layout->blockBoundingRect(cutBlock).top();
+
+        // The page on which the cut block begins is printed too, unless nothing
+        // else is on it.
+        nrPages = int(lastPageBottom / body.height());
+        const qreal contentTop = nrPages * body.height() + document->rootFrame()->frameFormat().topMargin() + cutBlock.blockFormat().topMargin();
+        if(lastPageBottom > contentTop + 1)
+            ++nrPages;
+
+        if(nrPages == 0)
+            return true;
+    }
+
+    // Header, footer and watermark rectangles are figured out from the first document.
+    if(m_pagesPrinted == 0)
+    {
+        // Column widths in headers and footers are worked out from the text they
+        // will show. The page count is not known yet if pages are streamed.
+        const QString nrPagesText = lastPart ? QString::number(pageCount) : QStringLiteral("9999");
+        m_fieldMap[HeaderFooter::PageNumber] = nrPagesText + ".  ";
+        m_fieldMap[HeaderFooter::PageNumberOfCount] = nrPagesText + "/" + nrPagesText + "  ";
+
+        const QTextFrameFormat fmt = document->rootFrame()->frameFormat();
+        const qreal topMargin = fmt.topMargin() * contentScale.second;
+        const qreal leftMargin = fmt.leftMargin() * contentScale.first;
+        const qreal rightMargin = fmt.rightMargin() * contentScale.first;
+        const qreal bottomMargin = fmt.bottomMargin() * contentScale.second;
+        const qreal padding = 0;
+
+        m_headerRect = QRectF(0, 0, printer->width(), printer->height());
+        m_footerRect = m_headerRect;
+
+        m_headerRect.setLeft(leftMargin);
+        m_headerRect.setBottom(topMargin - padding);
+        m_headerRect.setRight(printer->width() - rightMargin);
+
+        m_footerRect.setTop(printer->height() - bottomMargin + padding);
+        m_footerRect.setLeft(leftMargin);
+        m_footerRect.setRight(printer->width() - rightMargin);
+
+        m_header->setFont(document->defaultFont());
+        m_footer->setFont(document->defaultFont());
+        m_header->prepare(m_fieldMap, m_headerRect, printer);
+        m_footer->prepare(m_fieldMap, m_footerRect, printer);
+    }
+
+    // The total page count is known only if the whole document is printed in one go.
+    // Otherwise, page numbers are printed without it.
+    const int totalPageCount = lastPart && m_pagesPrinted == 0 ? pageCount : 0;
+
+    m_progressReport->setProgressStep(1/qreal(nrPages+1));
 
     const bool isPdfDevice = printer->paintEngine()->type() == QPaintEngine::Pdf;
 
-    // Print away!
-    while (pageNr <= toPageNr)
+    // Print away! Each page goes out to the device as soon as it is painted.
+    bool success = true;
+    for(int pageNr=1; pageNr<=nrPages; pageNr++)
     {
+        if(m_pagesPrinted > 0 && !m_printer->newPage())
+        {
+            success = false;
+            break;
+        }
+
+        ++m_pagesPrinted;
+
         if(isPdfDevice)
-            this->printHeaderFooterWatermark(pageNr, toPageNr, &painter, doc, body);
+            this->printHeaderFooterWatermark(m_pagesPrinted, totalPageCount, &painter, document, body);
 
         painter.save();
         painter.scale(contentScale.first, contentScale.second);
         if(!isPdfDevice)
-            this->printHeaderFooterWatermark(pageNr, toPageNr, &painter, doc, body);
-        this->printPageContents(pageNr, toPageNr, &painter, doc, body);
+            this->printHeaderFooterWatermark(m_pagesPrinted, totalPageCount, &painter, document, body);
+        this->printPageContents(pageNr, pageCount, &painter, document, body, pageNr == nrPages ? lastPageBottom : -1);
         painter.restore();
 
         m_progressReport->tick();
+    }
 
-        if(pageNr < toPageNr)
-        {
-            if(!m_printer->newPage())
-                break;
-        }
-
-        ++pageNr;
+    if(success && cutBlock.isValid())
+    {
+        // Printed content is removed, and the block we cut at becomes the first block
+        // of the document. Undo history would hold on to everything removed here.
+        document->setUndoRedoEnabled(false);
+
+        const QTextBlockFormat blockFormat = cutBlock.blockFormat();
+        const QTextCharFormat blockCharFormat = cutBlock.charFormat();
+
+        QTextCursor cursor(document);
+        cursor.setPosition(cutBlock.position(), QTextCursor::KeepAnchor);
+        cursor.removeSelectedText();
+        cursor.setBlockFormat(blockFormat);
+        cursor.setBlockCharFormat(blockCharFormat);
     }
 
+    return success;
+}
+
+void QTextDocumentPagedPrinter::end()
+{
+    if(m_painter.isNull())
+        return;
+
+    m_painter->end();
+    m_painter.reset();
+    m_printer = nullptr;
+
     // All done!
     m_header->finish();
     m_footer->finish();
     m_progressReport->finish();
-
-    return true;
 }
 
 void QTextDocumentPagedPrinter::loadSettings(HeaderFooter *header, HeaderFooter *footer, Watermark *watermark)
@@ -634,14 +771,16 @@ void QTextDocumentPagedPrinter::loadSettings(HeaderFooter *header, HeaderFooter
     }
 }
 
-void QTextDocumentPagedPrinter::printPageContents(int pageNr, int pageCount, QPainter *painter, const QTextDocument *doc, const QRectF &body)
+void QTextDocumentPagedPrinter::printPageContents(int pageNr, int pageCount, QPainter *painter, const QTextDocument *doc, const QRectF &body, qreal contentBottom)
 {
     Q_UNUSED(pageCount)
 
     painter->save();
 
     painter->translate(body.left(), body.top() - (pageNr - 1) * body.height());
-    const QRectF pageRect(0, (pageNr - 1) * body.height(), body.width(), body.height());
+    QRectF pageRect(0, (pageNr - 1) * body.height(), body.width(), body.height());
+    if(contentBottom >= 0)
+        pageRect.setBottom( qMin(pageRect.bottom(), contentBottom) );
 
     QAbstractTextDocumentLayout *layout = doc->documentLayout();
     QAbstractTextDocumentLayout::PaintContext ctx;
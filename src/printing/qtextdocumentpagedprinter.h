@@ -17,6 +17,7 @@
 #include <QColor>
 #include <QEvent>
 #include <QObject>
+#include <QPainter>
 #include <QTextDocument>
 #include <QPagedPaintDevice>
 
@@ -215,10 +216,20 @@ public:
 
     Q_INVOKABLE bool print(QTextDocument *document, QPagedPaintDevice *device);
 
+    // Prints a document while it is still being written. Call printPages() every now
+    // and then as content is added, and once more with lastPart set when it is done.
+    // Pages that are complete go out to the device right away and their content is
+    // removed from the document, so the document never grows much beyond a page.
+    // Header and footer fields are picked from the document passed to begin().
+    bool begin(QPagedPaintDevice *device, const QTextDocument *fieldsDocument);
+    bool printPages(QTextDocument *document, bool lastPart=false);
+    void end();
+    bool isPrinting() const { return !m_painter.isNull(); }
+
     static void loadSettings(HeaderFooter *header, HeaderFooter *footer, Watermark *watermark);
 
 private:
-    void printPageContents(int pageNr, int pageCount, QPainter *painter, const QTextDocument *doc, const QRectF &body);
+    void printPageContents(int pageNr, int pageCount, QPainter *painter, const QTextDocument *doc, const QRectF &body, qreal contentBottom=-1);
     void printHeaderFooterWatermark(int pageNr, int pageCount, QPainter *painter, const QTextDocument *doc, const QRectF &body);
 
 private:
@@ -228,7 +239,9 @@ private:
     ErrorReport *m_errorReport = new ErrorReport(this);
     ProgressReport *m_progressReport = new ProgressReport(this);
     QPagedPaintDevice* m_printer = nullptr;
-    QTextDocument* m_textDocument = nullptr;
+    QScopedPointer<QPainter> m_painter;
+    QMap<HeaderFooter::Field,QString> m_fieldMap;
+    int m_pagesPrinted = 0;
     QRectF m_headerRect;
     QRectF m_footerRect;
 };
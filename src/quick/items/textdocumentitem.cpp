@@ -13,36 +13,34 @@
 
 #include "textdocumentitem.h"
 
-#include <QImage>
 #include <QTimer>
+#include <QtMath>
 #include <QPainter>
+#include <QTextBlock>
+#include <QSGTexture>
 #include <QQuickWindow>
-#include <QQuickPaintedItem>
+#include <QSGSimpleTextureNode>
 #include <QAbstractTextDocumentLayout>
 
-class TextDocumentViewportItem : public QQuickPaintedItem
+static const qreal TileHeight = 512;    // in item coordinates
+static const qint64 MaxCachedTileBytes = 64*1024*1024;
+
+class TextDocumentTilesNode : public QSGNode
 {
 public:
-    TextDocumentViewportItem(TextDocumentItem *parent);
-    ~TextDocumentViewportItem();
-
-    void setViewportImage(const QImage &image) {
-        m_image = image;
-        this->update();
-    }
-    QImage viewportImage() const { return m_image; }
-
-    // QQuickPaintedItem interface
-    void paint(QPainter *painter);
+    TextDocumentTilesNode() { }
+    ~TextDocumentTilesNode() { qDeleteAll(m_textures); }
 
-private:
-    QImage m_image;
+    // Textures outlive the child nodes that show them, so tiles that scroll
+    // out of view and back in are not uploaded again.
+    QHash<int,QSGTexture*> m_textures;
+    QHash<int,int> m_textureGenerations;
 };
 
 TextDocumentItem::TextDocumentItem(QQuickItem *parent)
     : QQuickItem(parent)
 {
-    this->setFlag(ItemHasContents, false);
+    this->setFlag(ItemHasContents, true);
 
     m_documentChangeHandler = new QTimer(this);
     m_documentChangeHandler->setInterval(0);
@@ -53,9 +51,6 @@ TextDocumentItem::TextDocumentItem(QQuickItem *parent)
     m_viewportUpdateHandler->setInterval(0);
     m_viewportUpdateHandler->setSingleShot(true);
     connect(m_viewportUpdateHandler, &QTimer::timeout, this, &TextDocumentItem::updateViewport);
-
-    m_viewportItem = new TextDocumentViewportItem(this);
-    m_viewportItem->setVisible(false);
 }
 
 TextDocumentItem::~TextDocumentItem()
@@ -71,6 +66,7 @@ void TextDocumentItem::setDocument(QTextDocument *val)
     if(m_document)
     {
         m_document->disconnect(m_documentChangeHandler);
+        m_document->disconnect(this);
         if(m_document->parent() == this)
             m_document->deleteLater();
     }
@@ -78,8 +74,15 @@ void TextDocumentItem::setDocument(QTextDocument *val)
     m_document = val;
     emit documentChanged();
 
+    m_tiles.clear();
+    m_dirtyFrom = -1;
+    m_dirtyTo = -1;
+
     if(m_document)
+    {
         connect(m_document, SIGNAL(contentsChanged()), m_documentChangeHandler, SLOT(start()));
+        connect(m_document, &QTextDocument::contentsChange, this, &TextDocumentItem::onDocumentContentsChange);
+    }
 
     m_documentChangeHandler->start();
 }
@@ -125,58 +128,147 @@ void TextDocumentItem::setVerticalPadding(qreal val)
     emit verticalPaddingChanged();
 }
 
+QSGNode *TextDocumentItem::updatePaintNode(QSGNode *oldNode, QQuickItem::UpdatePaintNodeData *nodeData)
+{
+    Q_UNUSED(nodeData)
+
+    TextDocumentTilesNode *rootNode = static_cast<TextDocumentTilesNode*>(oldNode);
+    if(rootNode == nullptr)
+        rootNode = new TextDocumentTilesNode;
+
+    while(QSGNode *childNode = rootNode->firstChild())
+    {
+        rootNode->removeChildNode(childNode);
+        delete childNode;
+    }
+
+    // Drop textures of tiles that have since been evicted or re-rendered
+    QList<int> staleTextures;
+    for(auto it = rootNode->m_textures.constBegin(); it != rootNode->m_textures.constEnd(); ++it)
+    {
+        const auto tile = m_tiles.constFind(it.key());
+        if(tile == m_tiles.constEnd() || tile->generation != rootNode->m_textureGenerations.value(it.key()))
+            staleTextures << it.key();
+    }
+    for(int index : qAsConst(staleTextures))
+    {
+        delete rootNode->m_textures.take(index);
+        rootNode->m_textureGenerations.remove(index);
+    }
+
+    QQuickWindow *window = this->window();
+    if(window == nullptr)
+        return rootNode;
+
+    bool tilesLost = false;
+    for(int index : qAsConst(m_visibleTiles))
+    {
+        const auto tile = m_tiles.find(index);
+        if(tile == m_tiles.end())
+            continue;
+
+        // Images are let go of once they are uploaded, so tiles whose textures are gone
+        // along with the node that held them have to be rendered again.
+        QSGTexture *texture = rootNode->m_textures.value(index, nullptr);
+        if(texture == nullptr && tile->image.isNull())
+        {
+            m_tiles.erase(tile);
+            tilesLost = true;
+            continue;
+        }
+
+        if(texture == nullptr)
+        {
+            texture = window->createTextureFromImage(tile->image);
+            rootNode->m_textures.insert(index, texture);
+            rootNode->m_textureGenerations.insert(index, tile->generation);
+            tile->image = QImage();
+        }
+
+        QSGSimpleTextureNode *tileNode = new QSGSimpleTextureNode;
+        tileNode->setFlag(QSGNode::OwnedByParent);
+        tileNode->setTexture(texture);
+        tileNode->setOwnsTexture(false);
+        tileNode->setFiltering(QSGTexture::Linear);
+        tileNode->setRect( QRectF(QPointF(m_tileX, index*m_tileSize.height()), m_tileSize) );
+        rootNode->appendChildNode(tileNode);
+    }
+
+    if(tilesLost)
+        QMetaObject::invokeMethod(m_viewportUpdateHandler, "start", Qt::QueuedConnection);
+
+    return rootNode;
+}
+
 void TextDocumentItem::updateViewport()
 {
     if(m_document == nullptr)
     {
-        m_viewportItem->setVisible(false);
+        m_visibleTiles.clear();
+        this->update();
         return;
     }
 
     const qreal maxViewportDim = 4000.0 / m_documentScale;
 
     const qreal contentY = (m_flickable == nullptr ? 0 : m_flickable->property("contentY").toDouble()) - m_verticalPadding;
+    const qreal viewportHeight = m_flickable == nullptr ? this->height() : (m_flickable->height()+m_verticalPadding);
 
-    const qreal x = 0;
-    const qreal y = contentY / m_documentScale;
-    const qreal width = qMin(m_document->textWidth(), maxViewportDim);
-    const qreal height = (qMin(m_flickable == nullptr ? this->height() : (m_flickable->height()+m_verticalPadding), maxViewportDim)) / m_documentScale;
-    const QRectF rect(x, y, width, height);
-    if(rect.isEmpty())
+    const qreal width = qMin(m_document->textWidth(), maxViewportDim) * m_documentScale;
+    const qreal dpr = this->window() ? this->window()->devicePixelRatio() : 1.0;
+    const QSizeF tileSize(width, TileHeight);
+    if(tileSize.isEmpty() || viewportHeight <= 0)
     {
-        m_viewportItem->setVisible(false);
+        m_visibleTiles.clear();
+        this->update();
         return;
     }
 
-    const qreal dpr = this->window() ? this->window()->devicePixelRatio() : 1.0;
-    const QSizeF viewportSize(width*m_documentScale, height*m_documentScale);
-
-    QImage image( (viewportSize*dpr).toSize(), QImage::Format_ARGB32 );
-    image.setDevicePixelRatio(dpr);
-    image.fill(Qt::transparent);
-
-    QPainter paint;
-    paint.begin(&image);
-    paint.scale(m_documentScale, m_documentScale);
-    paint.translate(-x, -y);
-    paint.setRenderHint(QPainter::Antialiasing);
-    paint.setRenderHint(QPainter::TextAntialiasing);
-
-    QAbstractTextDocumentLayout *layout = m_document->documentLayout();
-
-    QAbstractTextDocumentLayout::PaintContext ctx;
-    ctx.clip = rect;
-    layout->draw(&paint, ctx);
-
-    paint.end();
+    // Tiles rendered for another scale, width or device pixel ratio are of no use
+    if(m_tileSize != tileSize || !qFuzzyCompare(m_tileDpr, dpr) || !qFuzzyCompare(m_tileScale, m_documentScale))
+    {
+        m_tiles.clear();
+        m_tileSize = tileSize;
+        m_tileDpr = dpr;
+        m_tileScale = m_documentScale;
+    }
+    m_tileX = qMax((this->width()-width)/2, 0.0);
+
+    const int nrTiles = qCeil(this->height() / TileHeight);
+    const int firstTile = qBound(0, qFloor(qMax(contentY,0.0) / TileHeight), qMax(nrTiles-1,0));
+    const int lastTile = qBound(0, qFloor((contentY+viewportHeight) / TileHeight), qMax(nrTiles-1,0));
+
+    // Tiles right above and below the viewport are rendered ahead of time, so
+    // that they are ready by the time they are scrolled into view.
+    const int firstNeededTile = qMax(firstTile-1,0);
+    const int lastNeededTile = qMin(lastTile+1,nrTiles-1);
+    m_visibleTiles.clear();
+    for(int i=firstNeededTile; i<=lastNeededTile; i++)
+    {
+        if(!m_tiles.contains(i))
+            this->renderTile(i);
+        m_tiles[i].lastUsed = ++m_tileUsageCounter;
+        if(i >= firstTile && i <= lastTile)
+            m_visibleTiles << i;
+    }
 
-    m_viewportItem->setViewportImage(image);
+    // Evict tiles that were used the least recently, once they take up more memory
+    // than we allow. Tiles around the viewport are kept, whatever their size.
+    const QSize tilePixelSize = (m_tileSize*m_tileDpr).toSize();
+    const qint64 tileBytes = qMax(qint64(tilePixelSize.width())*qint64(tilePixelSize.height())*4, qint64(1));
+    const int maxCachedTiles = qMax(int(MaxCachedTileBytes/tileBytes), lastNeededTile-firstNeededTile+1);
+    while(m_tiles.size() > maxCachedTiles)
+    {
+        auto lru = m_tiles.begin();
+        for(auto it = m_tiles.begin(); it != m_tiles.end(); ++it)
+        {
+            if(it->lastUsed < lru->lastUsed)
+                lru = it;
+        }
+        m_tiles.erase(lru);
+    }
 
-    m_viewportItem->setX( qMax((this->width()-viewportSize.width())/2, 0.0) );
-    m_viewportItem->setY( contentY );
-    m_viewportItem->setWidth( viewportSize.width() );
-    m_viewportItem->setHeight( viewportSize.height() );
-    m_viewportItem->setVisible(true);
+    this->update();
 }
 
 void TextDocumentItem::onDocumentChanged()
@@ -185,28 +277,91 @@ void TextDocumentItem::onDocumentChanged()
     {
         this->setWidth(0);
         this->setHeight(0);
-        m_viewportItem->setVisible(false);
+        m_tiles.clear();
+        m_visibleTiles.clear();
+        this->update();
         return;
     }
 
     if(m_document->textWidth() == 0)
         m_document->setTextWidth(this->width());
+
+    const qreal oldHeight = this->height();
     this->setHeight(m_document->size().height() * m_documentScale);
+
+    if(m_dirtyFrom >= 0)
+    {
+        // Only tiles that show the changed blocks need to be rendered again, unless
+        // the change moved everything after it.
+        QAbstractTextDocumentLayout *layout = m_document->documentLayout();
+        const QTextBlock fromBlock = m_document->findBlock(m_dirtyFrom);
+        const QTextBlock toBlock = m_document->findBlock(m_dirtyTo);
+        const qreal fromY = fromBlock.isValid() ? layout->blockBoundingRect(fromBlock).top() * m_documentScale : 0;
+        const qreal toY = toBlock.isValid() && qFuzzyCompare(oldHeight, this->height()) ? layout->blockBoundingRect(toBlock).bottom() * m_documentScale : -1;
+        this->invalidateTiles(fromY, toY);
+
+        m_dirtyFrom = -1;
+        m_dirtyTo = -1;
+    }
+
     this->updateViewport();
 }
 
-TextDocumentViewportItem::TextDocumentViewportItem(TextDocumentItem *parent)
-    : QQuickPaintedItem(parent)
+void TextDocumentItem::onDocumentContentsChange(int position, int charsRemoved, int charsAdded)
 {
-
+    if(m_dirtyFrom < 0)
+    {
+        m_dirtyFrom = position;
+        m_dirtyTo = position + charsAdded;
+    }
+    else
+    {
+        const int delta = charsAdded - charsRemoved;
+        m_dirtyTo = m_dirtyTo >= position ? qMax(m_dirtyTo + delta, position + charsAdded) : position + charsAdded;
+        m_dirtyFrom = qMin(m_dirtyFrom, position);
+    }
 }
 
-TextDocumentViewportItem::~TextDocumentViewportItem()
+void TextDocumentItem::invalidateTiles(qreal fromY, qreal toY)
 {
-
+    // A negative toY invalidates all tiles from fromY till the end
+    auto it = m_tiles.begin();
+    while(it != m_tiles.end())
+    {
+        const qreal tileTop = it.key() * TileHeight;
+        const qreal tileBottom = tileTop + TileHeight;
+        if(tileBottom >= fromY && (toY < 0 || tileTop <= toY))
+            it = m_tiles.erase(it);
+        else
+            ++it;
+    }
 }
 
-void TextDocumentViewportItem::paint(QPainter *painter)
+void TextDocumentItem::renderTile(int index)
 {
-    painter->drawImage(0, 0, m_image);
+    Tile tile;
+    tile.generation = ++m_tileGeneration;
+
+    const QRectF rect(0, index*TileHeight/m_documentScale, m_tileSize.width()/m_documentScale, TileHeight/m_documentScale);
+
+    tile.image = QImage( (m_tileSize*m_tileDpr).toSize(), QImage::Format_ARGB32_Premultiplied );
+    tile.image.setDevicePixelRatio(m_tileDpr);
+    tile.image.fill(Qt::transparent);
+
+    QPainter paint;
+    paint.begin(&tile.image);
+    paint.scale(m_documentScale, m_documentScale);
+    paint.translate(-rect.x(), -rect.y());
+    paint.setRenderHint(QPainter::Antialiasing);
+    paint.setRenderHint(QPainter::TextAntialiasing);
+
+    QAbstractTextDocumentLayout *layout = m_document->documentLayout();
+
+    QAbstractTextDocumentLayout::PaintContext ctx;
+    ctx.clip = rect;
+    layout->draw(&paint, ctx);
+
+    paint.end();
+
+    m_tiles.insert(index, tile);
 }
@@ -14,10 +14,11 @@
 #ifndef TEXTDOCUMENTITEM_H
 #define TEXTDOCUMENTITEM_H
 
+#include <QHash>
+#include <QImage>
 #include <QQuickItem>
 #include <QTextDocument>
 
-class TextDocumentViewportItem;
 class TextDocumentItem : public QQuickItem
 {
     Q_OBJECT
@@ -46,9 +47,16 @@ public:
     qreal verticalPadding() const { return m_verticalPadding; }
     Q_SIGNAL void verticalPaddingChanged();
 
+protected:
+    // QQuickItem interface
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *nodeData);
+
 private:
     void updateViewport();
     void onDocumentChanged();
+    void onDocumentContentsChange(int position, int charsRemoved, int charsAdded);
+    void invalidateTiles(qreal fromY, qreal toY);
+    void renderTile(int index);
 
 private:
     qreal m_documentScale = 1.0;
@@ -57,7 +65,25 @@ private:
     QTextDocument* m_document = nullptr;
     QTimer *m_viewportUpdateHandler = nullptr;
     QTimer *m_documentChangeHandler = nullptr;
-    TextDocumentViewportItem *m_viewportItem = nullptr;
+
+    // The document is rendered in tiles of fixed height, which are kept around
+    // and reused while scrolling, until the part of document they show changes.
+    struct Tile
+    {
+        QImage image;       // null once uploaded to a texture
+        int generation = 0;
+        int lastUsed = 0;
+    };
+    QHash<int,Tile> m_tiles;
+    QList<int> m_visibleTiles;
+    int m_tileGeneration = 0;
+    int m_tileUsageCounter = 0;
+    QSizeF m_tileSize;          // in item coordinates
+    qreal m_tileDpr = 1.0;
+    qreal m_tileScale = 1.0;    // documentScale the tiles were rendered at
+    qreal m_tileX = 0;
+    int m_dirtyFrom = -1;       // document positions changed since the last update
+    int m_dirtyTo = -1;
 };
 
 #endif // TEXTDOCUMENTITEM_H
@@ -12,6 +12,7 @@
 ****************************************************************************/
 
 #include "hourglass.h"
+#include "textmatcher.h"
 #include "searchengine.h"
 
 #include <QSet>
@@ -171,20 +172,14 @@ void SearchAgent::onSearchRequest(const QString &string)
         return;
 
     QTextDocument *document = m_textDocument->textDocument();
-    QTextDocument::FindFlags flags;
+    SearchEngine::SearchFlags flags;
     if(m_engine != nullptr)
-        flags &= int(m_engine->searchFlags());
-
-    QTextCursor cursor(document);
-    while(1)
-    {
-        cursor = document->find(string, cursor, flags);
-        if(cursor.isNull())
-            break;
+        flags = m_engine->searchFlags();
 
-        m_textDocumentSearchResults << qMakePair<int,int>(cursor.selectionStart(),cursor.selectionEnd());
-        cursor.setPosition(cursor.selectionEnd());
-    }
+    // Positions in plain text are the same as cursor positions in the document
+    m_textDocumentSearchResults = SearchEngine::rangesOf(string, document->toPlainText(), int(flags));
+    for(QPair<int,int> &result : m_textDocumentSearchResults)
+        result.second += 1;
 
     this->setSearchResultCount(m_textDocumentSearchResults.size());
 }
@@ -199,7 +194,8 @@ void SearchAgent::onClearSearchRequest()
 SearchEngine::SearchEngine(QObject *parent)
     :QObject(parent),
       m_searchTimer("SearchEngine.m_searchTimer"),
-      m_searchAgentSortTimer("SearchEngine.m_searchAgentSortTimer")
+      m_searchAgentSortTimer("SearchEngine.m_searchAgentSortTimer"),
+      m_searchNextAgentTimer("SearchEngine.m_searchNextAgentTimer")
 {
 
 }
@@ -242,7 +238,7 @@ void SearchEngine::setSearchString(const QString &val)
 {
     if(m_searchString == val)
     {
-        if(m_searchResults.isEmpty())
+        if(m_searchResults.isEmpty() && !this->isSearching())
             this->doSearchLater();
         return;
     }
@@ -269,6 +265,9 @@ void SearchEngine::replaceAll(const QString &string)
 {
     HourGlass hourGlass;
 
+    // Replacing changes the text that is yet to be searched.
+    this->cancelSearch();
+
     if(m_searchResults.isEmpty())
         return;
 
@@ -320,12 +319,6 @@ void SearchEngine::cycleSearchResult()
 
 QJsonArray SearchEngine::indexesOf(const QString &of, const QString &in, int givenFlags)
 {
-    SearchEngine::SearchFlags flags(givenFlags);
-    Qt::CaseSensitivity cs = Qt::CaseInsensitive;
-
-    if(flags.testFlag(SearchEngine::SearchCaseSensitively))
-        cs = Qt::CaseSensitive;
-
     auto createResultItem = [](int from, int to) {
         QJsonObject item;
         item.insert("from", from);
@@ -334,27 +327,26 @@ QJsonArray SearchEngine::indexesOf(const QString &of, const QString &in, int giv
     };
 
     QJsonArray ret;
-    int from = 0;
-    while(1)
-    {
-        int pos = in.indexOf(of, from, cs);
-        if(pos < 0)
-            break;
 
-        if(flags.testFlag(SearchEngine::SearchWholeWords))
-        {
-            if(pos + of.length() >= in.length() || in.at(pos+of.length()).isSpace())
-                ret.append( createResultItem(pos,pos+of.length()-1) );
-        }
-        else
-            ret.append( createResultItem(pos,pos+of.length()-1) );
-
-        from = pos + of.length();
-    }
+    const QList< QPair<int,int> > ranges = SearchEngine::rangesOf(of, in, givenFlags);
+    for(const QPair<int,int> &range : ranges)
+        ret.append( createResultItem(range.first, range.second) );
 
     return ret;
 }
 
+QList< QPair<int,int> > SearchEngine::rangesOf(const QString &of, const QString &in, int givenFlags)
+{
+    SearchEngine::SearchFlags flags(givenFlags);
+    Qt::CaseSensitivity cs = Qt::CaseInsensitive;
+
+    if(flags.testFlag(SearchEngine::SearchCaseSensitively))
+        cs = Qt::CaseSensitive;
+
+    const TextMatcher matcher(of, cs, flags.testFlag(SearchEngine::SearchWholeWords));
+    return matcher.ranges(in).toList();
+}
+
 QString SearchEngine::createMarkupText(const QString &text, int from, int to, const QBrush &bg, const QBrush &fg)
 {
     QString ret = text;
@@ -376,6 +368,12 @@ void SearchEngine::timerEvent(QTimerEvent *event)
         m_searchTimer.stop();
         this->doSearch();
     }
+
+    if(event->timerId() == m_searchNextAgentTimer.timerId())
+    {
+        m_searchNextAgentTimer.stop();
+        this->searchNextAgent();
+    }
 }
 
 void SearchEngine::addSearchAgent(SearchAgent *ptr)
@@ -448,7 +446,7 @@ int SearchEngine::staticSearchAgentCount(QQmlListProperty<SearchAgent> *list)
 
 void SearchEngine::doSearch()
 {
-    HourGlass hourGlass;
+    this->cancelSearch();
 
     if(!m_searchResults.isEmpty())
     {        
@@ -478,14 +476,53 @@ void SearchEngine::doSearch()
         m_searchAgentSortTimer.stop();
     }
 
-    if(m_searchString.isEmpty())
+    if(m_searchString.isEmpty() || m_searchAgents.isEmpty())
         return;
 
     Q_FOREACH(SearchAgent *agent, m_searchAgents)
+        m_pendingSearchAgents << agent;
+
+    m_progressReport->start();
+    m_progressReport->setProgressStepFromCount(m_pendingSearchAgents.size());
+    emit searchingChanged();
+
+    // The first agent is searched right away, so that its results show up
+    // without waiting for the rest.
+    this->searchNextAgent();
+}
+
+void SearchEngine::doSearchLater()
+{
+    m_searchTimer.start(0, this);
+}
+
+void SearchEngine::searchNextAgent()
+{
+    if(m_pendingSearchAgents.isEmpty())
+        return;
+
+    const QPointer<SearchAgent> agent = m_pendingSearchAgents.first();
+    if(agent.isNull())
     {
-        // Ask the agent to perform search
-        agent->searchRequest(m_searchString);
+        this->acceptSearchResults(nullptr);
+        return;
+    }
+
+    // Agents answer searchRequest() right away; those bound to a text document
+    // search it themselves, in SearchAgent::onSearchRequest().
+    agent->searchRequest(m_searchString);
+    this->acceptSearchResults(agent);
+}
 
+void SearchEngine::searchNextAgentLater()
+{
+    m_searchNextAgentTimer.start(0, this);
+}
+
+void SearchEngine::acceptSearchResults(SearchAgent *agent)
+{
+    if(agent != nullptr && m_searchAgents.contains(agent))
+    {
         // Collect search results
         const int nrResults = agent->searchResultCount();
         for(int i=0; i<nrResults; i++)
@@ -495,17 +532,40 @@ void SearchEngine::doSearch()
         }
 
         agent->setCurrentSearchResultIndex(-1);
+
+        if(nrResults > 0)
+        {
+            emit searchResultCountChanged();
+
+            if(m_currentSearchResultIndex < 0)
+                this->setCurrentSearchResultIndex(0);
+        }
     }
 
-    emit searchResultCountChanged();
+    if(!m_pendingSearchAgents.isEmpty())
+        m_pendingSearchAgents.removeFirst();
 
-    if(!m_searchResults.isEmpty())
-        this->setCurrentSearchResultIndex(0);
+    m_progressReport->tick();
+
+    if(m_pendingSearchAgents.isEmpty())
+    {
+        m_progressReport->finish();
+        emit searchingChanged();
+    }
+    else
+        this->searchNextAgentLater();
 }
 
-void SearchEngine::doSearchLater()
+void SearchEngine::cancelSearch()
 {
-    m_searchTimer.start(0, this);
+    m_searchNextAgentTimer.stop();
+
+    if(!m_pendingSearchAgents.isEmpty())
+    {
+        m_pendingSearchAgents.clear();
+        m_progressReport->finish();
+        emit searchingChanged();
+    }
 }
 
 void SearchEngine::setCurrentSearchResultIndex(int val)
@@ -719,20 +779,11 @@ void TextDocumentSearch::doSearch(const QString &string)
     if(string.isEmpty())
         return;
 
+    // Positions in plain text are the same as cursor positions in the document
     QTextDocument *document = m_textDocument->textDocument();
-    QTextDocument::FindFlags flags;
-    flags &= int(m_searchFlags);
-
-    QTextCursor cursor(document);
-    while(1)
-    {
-        cursor = document->find(string, cursor, flags);
-        if(cursor.isNull())
-            break;
-
-        m_searchResults << qMakePair<int,int>(cursor.selectionStart(),cursor.selectionEnd());
-        cursor.setPosition(cursor.selectionEnd());
-    }
+    m_searchResults = SearchEngine::rangesOf(string, document->toPlainText(), int(m_searchFlags));
+    for(QPair<int,int> &result : m_searchResults)
+        result.second += 1;
 
     m_searchString = string;
     emit searchStringChanged();
@@ -15,6 +15,7 @@
 #define SEARCHENGINE_H
 
 #include <QObject>
+#include <QPointer>
 #include <QJsonArray>
 #include <QQmlEngine>
 #include <QQuickTextDocument>
@@ -118,6 +119,7 @@ public:
         SearchWholeWords      = 0x00004
     };
     Q_DECLARE_FLAGS(SearchFlags, SearchFlag)
+    Q_FLAG(SearchFlags)
     Q_PROPERTY(SearchFlags searchFlags READ searchFlags WRITE setSearchFlags NOTIFY searchFlagsChanged)
     void setSearchFlags(SearchFlags val);
     SearchFlags searchFlags() const { return m_searchFlags; }
@@ -144,6 +146,12 @@ public:
     int currentSearchResultIndex() const { return m_currentSearchResultIndex; }
     Q_SIGNAL void currentSearchResultIndexChanged();
 
+    // True while agents are still being searched. Results stream in as each agent
+    // is done, so searchResultCount may grow while this is true.
+    Q_PROPERTY(bool searching READ isSearching NOTIFY searchingChanged)
+    bool isSearching() const { return !m_pendingSearchAgents.isEmpty(); }
+    Q_SIGNAL void searchingChanged();
+
     Q_INVOKABLE void replace(const QString &string);
     Q_INVOKABLE void replaceAll(const QString &string);
 
@@ -153,6 +161,7 @@ public:
     Q_INVOKABLE void cycleSearchResult();
 
     static QJsonArray indexesOf(const QString &of, const QString &in, int flags);
+    static QList< QPair<int,int> > rangesOf(const QString &of, const QString &in, int flags);
     static QString createMarkupText(const QString &text, int from, int to, const QBrush &bg, const QBrush &fg);
 
 protected:
@@ -168,6 +177,10 @@ private:
 
     void doSearch();
     void doSearchLater();
+    void searchNextAgent();
+    void searchNextAgentLater();
+    void acceptSearchResults(SearchAgent *agent);
+    void cancelSearch();
     void setCurrentSearchResultIndex(int val);
 
 private:
@@ -181,6 +194,12 @@ private:
     ExecLaterTimer m_searchAgentSortTimer;
     QList<SearchAgent *> m_searchAgents;
     QList< QPair<SearchAgent*,int> > m_searchResults;
+
+    // Agents yet to be searched for m_searchString. They are searched one after the
+    // other, each in its own event-loop turn, so that typing in the search bar can
+    // cancel a search midway.
+    ExecLaterTimer m_searchNextAgentTimer;
+    QList< QPointer<SearchAgent> > m_pendingSearchAgents;
 };
 
 class TextDocumentSearch : public QObject
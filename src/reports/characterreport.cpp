@@ -139,7 +139,83 @@ bool CharacterReport::doGenerate(QTextDocument *textDocument)
     }
     this->progress()->tick();
 
-    const int reportSummaryPosition = cursor.position();
+    // Report Summary
+    {
+        // Counts are taken up front, so that the summary can be written before the
+        // detail. That way pages can be printed while the detail is being written.
+        QMap<QString,int> dialogCount;
+        QMap<QString,int> sceneCount;
+
+        const int nrScreenplayElements = screenplay->elementCount();
+        for(int i=0; i<nrScreenplayElements; i++)
+        {
+            const Scene *scene = screenplay->elementAt(i)->scene();
+            if(scene == nullptr)
+                continue;
+
+            bool sceneHasSaidCharacters = false;
+            for(const QString &characterName : qAsConst(m_characterNames))
+            {
+                if( scene->characterNames().contains(characterName) )
+                {
+                    sceneCount[characterName] = sceneCount.value(characterName,0)+1;
+                    sceneHasSaidCharacters = true;
+                }
+            }
+
+            if(!sceneHasSaidCharacters)
+                continue;
+
+            const int nrElements = scene->elementCount();
+            for(int j=0; j<nrElements; j++)
+            {
+                const SceneElement *element = scene->elementAt(j);
+                if(element->type() != SceneElement::Character)
+                    continue;
+
+                const QString characterName = element->formattedText().section('(', 0, 0).trimmed();
+                if(m_characterNames.contains(characterName))
+                    dialogCount[characterName] = dialogCount.value(characterName,0)+1;
+            }
+        }
+
+        QTextBlockFormat blockFormat = defaultBlockFormat;
+        blockFormat.setAlignment(Qt::AlignLeft);
+        blockFormat.setTopMargin(20);
+
+        QTextCharFormat charFormat = defaultCharFormat;
+        charFormat.setFontPointSize(20);
+        charFormat.setFontCapitalization(QFont::AllUppercase);
+        charFormat.setFontWeight(QFont::Bold);
+        charFormat.setFontItalic(true);
+
+        cursor.insertBlock(blockFormat, charFormat);
+        cursor.insertText("SUMMARY:");
+
+        blockFormat = defaultBlockFormat;
+        blockFormat.setIndent(1);
+
+        QMap<QString,int>::const_iterator it = dialogCount.constBegin();
+        QMap<QString,int>::const_iterator end = dialogCount.constEnd();
+        while(it != end)
+        {
+            const int nrScenes = sceneCount.value(it.key(), 1);
+
+            charFormat = defaultCharFormat;
+            charFormat.setFontWeight(QFont::Bold);
+            charFormat.setFontCapitalization(QFont::AllUppercase);
+
+            cursor.insertBlock(blockFormat, charFormat);
+            cursor.insertText(it.key());
+
+            charFormat = defaultCharFormat;
+            cursor.setCharFormat(charFormat);
+            cursor.insertText(" speaks " + QString::number(it.value()) + " times and is present in " + QString::number(nrScenes) + " scene(s).");
+
+            ++it;
+        }
+    }
+    this->progress()->tick();
 
     if(m_includeNotes)
     {
@@ -237,8 +313,7 @@ bool CharacterReport::doGenerate(QTextDocument *textDocument)
         }
     }
 
-    QMap<QString,int> dialogCount;
-    QMap<QString,int> sceneCount;
+    bool dialoguesWritten = false;
 
     // Report Detail
     {
@@ -270,13 +345,11 @@ bool CharacterReport::doGenerate(QTextDocument *textDocument)
             {
                 if( scene->characterNames().contains(characterName) )
                 {
-                    sceneCount[characterName] = sceneCount.value(characterName,0)+1;
-
                     if(sceneInfoWritten == false && m_includeSceneHeadings)
                     {
                         // Write Scene Information First
                         QTextBlockFormat blockFormat = defaultBlockFormat;
-                        if(!dialogCount.isEmpty())
+                        if(dialoguesWritten)
                             blockFormat.setTopMargin(20);
 
                         QTextCharFormat charFormat = defaultCharFormat;
@@ -373,7 +446,7 @@ bool CharacterReport::doGenerate(QTextDocument *textDocument)
                             }
                         }
 
-                        dialogCount[characterName] = dialogCount.value(characterName,0)+1;
+                        dialoguesWritten = true;
                     }
                 }
             }
@@ -395,50 +468,11 @@ bool CharacterReport::doGenerate(QTextDocument *textDocument)
 
             cursor.movePosition(QTextCursor::End);
             this->progress()->tick();
-        }
-    }
-
-    // Report Summary
-    {
-        cursor.setPosition(reportSummaryPosition);
-
-        QTextBlockFormat blockFormat = defaultBlockFormat;
-        blockFormat.setAlignment(Qt::AlignLeft);
-        blockFormat.setTopMargin(20);
-
-        QTextCharFormat charFormat = defaultCharFormat;
-        charFormat.setFontPointSize(20);
-        charFormat.setFontCapitalization(QFont::AllUppercase);
-        charFormat.setFontWeight(QFont::Bold);
-        charFormat.setFontItalic(true);
-
-        cursor.insertBlock(blockFormat, charFormat);
-        cursor.insertText("SUMMARY:");
-
-        blockFormat = defaultBlockFormat;
-        blockFormat.setIndent(1);
-
-        QMap<QString,int>::const_iterator it = dialogCount.constBegin();
-        QMap<QString,int>::const_iterator end = dialogCount.constEnd();
-        while(it != end)
-        {
-            const int nrScenes = sceneCount.value(it.key(), 1);
 
-            charFormat = defaultCharFormat;
-            charFormat.setFontWeight(QFont::Bold);
-            charFormat.setFontCapitalization(QFont::AllUppercase);
-
-            cursor.insertBlock(blockFormat, charFormat);
-            cursor.insertText(it.key());
-
-            charFormat = defaultCharFormat;
-            cursor.setCharFormat(charFormat);
-            cursor.insertText(" speaks " + QString::number(it.value()) + " times and is present in " + QString::number(nrScenes) + " scene(s).");
-
-            ++it;
+            // Pages filled up so far can go out to the PDF right away
+            this->printCompletePages(textDocument);
         }
     }
-    this->progress()->tick();
 
     return true;
 }
@@ -176,6 +176,9 @@ bool LocationReport::doGenerate(QTextDocument *textDocument)
             }
         }
 
+        // Pages filled up so far can go out to the PDF right away
+        this->printCompletePages(textDocument);
+
         ++it;
     }
 
@@ -0,0 +1,96 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include "binaryheader.h"
+
+#include <QCborMap>
+#include <QCborValue>
+#include <QCborStreamWriter>
+
+static const QString formatKey = QStringLiteral("format");
+static const QString versionKey = QStringLiteral("version");
+static const QString documentKey = QStringLiteral("document");
+static const QString formatName = QStringLiteral("ScriteBinaryHeader");
+
+QString BinaryHeader::fileName()
+{
+    return QStringLiteral("_header.cbor");
+}
+
+QByteArray BinaryHeader::fromJson(const QJsonObject &json)
+{
+    if(json.isEmpty())
+        return QByteArray();
+
+    QCborMap map;
+    map.insert(formatKey, formatName);
+    map.insert(versionKey, int(Version));
+    map.insert(documentKey, QCborMap::fromJsonObject(json));
+    return map.toCborValue().toCbor();
+}
+
+QByteArray BinaryHeader::streamBegin()
+{
+    // The map is of indefinite length, streamEnd() terminates it.
+    QByteArray ret;
+    QCborStreamWriter writer(&ret);
+    writer.startMap();
+    writer.append(formatKey);
+    writer.append(formatName);
+    writer.append(versionKey);
+    writer.append(qint64(Version));
+    writer.append(documentKey);
+    return ret;
+}
+
+QByteArray BinaryHeader::streamEnd()
+{
+    static const char cborBreak = char(0xff);
+    return QByteArray(1, cborBreak);
+}
+
+QJsonObject BinaryHeader::toJson(const QByteArray &bytes, bool *ok)
+{
+    return BinaryHeader::toCborMap(bytes, ok).toJsonObject();
+}
+
+QCborMap BinaryHeader::toCborMap(const QByteArray &bytes, bool *ok)
+{
+    if(ok)
+        *ok = false;
+
+    if(bytes.isEmpty())
+        return QCborMap();
+
+    QCborParserError error;
+    const QCborValue value = QCborValue::fromCbor(bytes, &error);
+    if(error.error != QCborError::NoError || !value.isMap())
+        return QCborMap();
+
+    const QCborMap map = value.toMap();
+    if(map.value(formatKey).toString() != formatName)
+        return QCborMap();
+
+    const qint64 version = map.value(versionKey).toInteger(-1);
+    if(version < 1 || version > Version)
+        return QCborMap();
+
+    const QCborValue document = map.value(documentKey);
+    if(!document.isMap())
+        return QCborMap();
+
+    if(ok)
+        *ok = true;
+
+    return document.toMap();
+}
@@ -0,0 +1,54 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef BINARYHEADER_H
+#define BINARYHEADER_H
+
+#include <QCborMap>
+#include <QByteArray>
+#include <QJsonObject>
+
+/**
+ * Parsing _header.json and walking the resulting JSON tree accounts for much of the
+ * time spent in loading large documents. So, along with _header.json we also store
+ * the same header in CBOR form, which is far quicker to parse.
+ *
+ * The binary header is a CBOR map that looks like
+ *
+ *     { "format": "ScriteBinaryHeader", "version": 1, "document": { ... } }
+ *
+ * where document is the very same object that is stored in _header.json. Loaders
+ * must always be prepared to fallback to _header.json, if the binary header is
+ * missing, or is of a version that they don't understand.
+ */
+class BinaryHeader
+{
+public:
+    enum { Version = 1 };
+
+    static QString fileName();
+
+    static QByteArray fromJson(const QJsonObject &json);
+
+    // A binary header can also be streamed, by writing streamBegin(), followed by
+    // the document object in CBOR, followed by streamEnd().
+    static QByteArray streamBegin();
+    static QByteArray streamEnd();
+    static QJsonObject toJson(const QByteArray &bytes, bool *ok=nullptr);
+
+    // The document object, as it is in CBOR. Loaders should prefer this over
+    // toJson(), which converts the whole document into JSON.
+    static QCborMap toCborMap(const QByteArray &bytes, bool *ok=nullptr);
+};
+
+#endif // BINARYHEADER_H
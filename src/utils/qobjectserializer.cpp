@@ -14,13 +14,21 @@
 #include "qobjectserializer.h"
 
 #include <QtDebug>
+#include <QSet>
+#include <QHash>
+#include <QMutex>
 #include <QStack>
 #include <QColor>
+#include <QVector>
+#include <QSharedPointer>
 #include <QMetaType>
 #include <QMetaEnum>
 #include <QMetaObject>
 #include <QMetaProperty>
 #include <QMetaClassInfo>
+#include <QIODevice>
+#include <QCborArray>
+#include <QCborValue>
 #include <QJsonDocument>
 #include <QQmlListProperty>
 #include <QQmlListReference>
@@ -138,52 +146,90 @@ const QObjectSerializer::Helper *ObjectSerializerHelperRegistry::findHelper(int
 
 Q_GLOBAL_STATIC(ObjectSerializerHelperRegistry, Helpers)
 
-void QObjectSerializer::registerHelper(QObjectSerializer::Helper *helper)
+/**
+ * Figuring out which properties of a class must be serialized, and how, requires
+ * walking its meta-object hierarchy, examining each property and looking up helpers.
+ * The outcome of all that is the same for every instance of a class, so we compute
+ * it once per QMetaObject and cache it as a SerializationPlan. Only the checks that
+ * depend on the instance (Interface::canSerialize()) are carried out per object.
+ */
+struct SerializationPlan
 {
-    if( ::Helpers()->contains(helper) )
-        return;
+    enum PropertyKind
+    {
+        QQmlListPropertyKind,
+        EnumPropertyKind,
+        FlagPropertyKind,
+        QObjectPropertyKind,
+        ValuePropertyKind
+    };
 
-    ::Helpers()->append(helper);
-}
+    struct Property
+    {
+        PropertyKind kind = ValuePropertyKind;
+        const QMetaObject *metaObject = nullptr;
+        QMetaProperty property;
+        QString name;
+        QVariant defaultValue;
+        QByteArray className; // for QObjectPropertyKind only
+        const QMetaObject *classMetaObject = nullptr; // for QObjectPropertyKind only
+        const QObjectSerializer::Helper *helper = nullptr;
+    };
 
-QObjectSerializer::Helper::~Helper()
+    // Properties in the order of declaration, starting from the base most class.
+    QVector<Property> properties;
+};
+
+class SerializationPlans
 {
-    ::Helpers()->removeOne(this);
-}
+public:
+    SerializationPlans() { }
+    ~SerializationPlans() { }
 
-QObjectSerializer::Interface::~Interface()
+    QSharedPointer<const SerializationPlan> plan(const QObject *object);
+    void clear();
+
+private:
+    QSharedPointer<const SerializationPlan> createPlan(const QObject *object) const;
+
+private:
+    QMutex m_mutex;
+    QHash<const QMetaObject*, QSharedPointer<const SerializationPlan> > m_plans;
+};
+
+QSharedPointer<const SerializationPlan> SerializationPlans::plan(const QObject *object)
 {
+    const QMetaObject *mo = object->metaObject();
 
+    QMutexLocker locker(&m_mutex);
+    QSharedPointer<const SerializationPlan> ret = m_plans.value(mo);
+    if(ret.isNull())
+    {
+        ret = this->createPlan(object);
+        m_plans.insert(mo, ret);
+    }
+
+    return ret;
 }
 
-QJsonObject QObjectSerializer::toJson(const QObject *object)
+void SerializationPlans::clear()
 {
-    QJsonObject ret;
-    if( object == nullptr )
-        return ret;
+    QMutexLocker locker(&m_mutex);
+    m_plans.clear();
+}
 
-    QObjectSerializer::Interface *interface = qobject_cast<QObjectSerializer::Interface*>(object);
-    if(interface != nullptr)
-        interface->prepareForSerialization();
+QSharedPointer<const SerializationPlan> SerializationPlans::createPlan(const QObject *object) const
+{
+    SerializationPlan *plan = new SerializationPlan;
 
     QStack<const QMetaObject*> metaObjects;
-    QStringList classNames;
     const QMetaObject *mo = object->metaObject();
     while(mo)
     {
         metaObjects.push(mo);
-        if(interface != nullptr && interface->canSerialize(mo, QMetaProperty()) == false)
-        {
-            mo = mo->superClass();
-            continue;
-        }
-
-        classNames << QString::fromLatin1(mo->className());
         mo = mo->superClass();
     }
 
-    // ret.insert("_class", classNames.join(","));
-
     const QVariantMap defaultProperties = QObjectSerializer::cacheDefaultPropertyValues(object, true);
 
     while(!metaObjects.isEmpty())
@@ -194,8 +240,6 @@ QJsonObject QObjectSerializer::toJson(const QObject *object)
         for(int i=mo->propertyOffset(); i<nrProperties; i++)
         {
             const QMetaProperty prop = mo->property(i);
-            if(interface != nullptr && interface->canSerialize(mo, prop) == false)
-                continue;
 
 #ifdef QT_WIDGETS_LIB
             // QGraphicsObject::parent property returns a parent QGraphicsObject.
@@ -230,104 +274,147 @@ QJsonObject QObjectSerializer::toJson(const QObject *object)
             if( !prop.isWritable() && !isQObjectPointer && !isQQmlListProperty )
                 continue;
 
-            const QString propName = QString::fromLatin1(prop.name());
-            const QVariant defaultPropValue = defaultProperties.value(propName);
-            QVariant propValue = prop.read(object);
+            SerializationPlan::Property planProp;
+            planProp.metaObject = mo;
+            planProp.property = prop;
+            planProp.name = QString::fromLatin1(prop.name());
+            planProp.defaultValue = defaultProperties.value(planProp.name);
 
             if(isQQmlListProperty)
+                planProp.kind = SerializationPlan::QQmlListPropertyKind;
+            else if(prop.isEnumType())
+                planProp.kind = SerializationPlan::EnumPropertyKind;
+            else if(prop.isFlagType())
+                planProp.kind = SerializationPlan::FlagPropertyKind;
+            else if(isQObjectPointer)
+            {
+                planProp.kind = SerializationPlan::QObjectPropertyKind;
+                planProp.className = QByteArray(prop.typeName()).replace('*', "");
+                planProp.classMetaObject = QMetaType::metaObjectForType(prop.userType());
+            }
+            else
             {
-                QJsonArray list;
+                planProp.kind = SerializationPlan::ValuePropertyKind;
+                planProp.helper = ::Helpers()->findHelper(prop.userType());
+            }
 
-                QQmlListReference listRef(const_cast<QObject*>(object), prop.name());
-                for(int i=0; i<listRef.count(); i++)
-                {
-                    const QObject *listItem = listRef.at(i);
-                    if(listItem == nullptr)
-                        continue;
+            plan->properties.append(planProp);
+        }
+    }
 
-                    QJsonObject item = QObjectSerializer::toJson(listItem);
-                    list.append(item);
-                }
+    return QSharedPointer<const SerializationPlan>(plan);
+}
 
-                ret.insert(propName, list);
-            }
-            else if(prop.isEnumType())
-            {
-                const QMetaEnum propEnum = prop.enumerator();
-                propValue = QString::fromLatin1( propEnum.valueToKey(propValue.toInt()) );
-                if(defaultPropValue == propValue.toString())
-                    continue;
+Q_GLOBAL_STATIC(SerializationPlans, Plans)
 
-                ret.insert( propName, propValue.toString() );
-            }
-            else if(prop.isFlagType())
-            {
-                const QMetaEnum propEnum = prop.enumerator();
-                propValue = QString::fromLatin1( propEnum.valueToKeys(propValue.toInt()) );
-                if(defaultPropValue == propValue.toString())
-                    continue;
+void QObjectSerializer::registerHelper(QObjectSerializer::Helper *helper)
+{
+    if( ::Helpers()->contains(helper) )
+        return;
 
-                ret.insert(propName, propValue.toString());
-            }
-            else if(propType.flags() & QMetaType::PointerToQObject)
-            {
-                propValue.convert(QMetaType::QObjectStar);
+    ::Helpers()->append(helper);
 
-                const QObject *propObject = propValue.value<QObject*>();
-                if(propObject != nullptr)
-                {
-                    const QJsonObject propJson = QObjectSerializer::toJson(propObject);
-                    if(!propJson.isEmpty())
-                        ret.insert(propName, propJson);
-                }
-            }
-            else if( propValue.userType() == QMetaType::QJsonValue )
-            {
-                const QJsonValue propJsonValue = propValue.toJsonValue();
-                if( defaultPropValue.toJsonValue() == propValue.toJsonValue() )
-                    continue;
+    // Plans hold on to helpers they have resolved, they need to be worked out again.
+    ::Plans()->clear();
+}
 
-                ret.insert( propName, propJsonValue );
-            }
-            else if( propValue.userType() == QMetaType::QJsonObject )
-            {
-                const QJsonObject propJsonObject = propValue.toJsonObject();
-                if( defaultPropValue.toJsonObject() == propJsonObject )
-                    continue;
+QObjectSerializer::Helper::~Helper()
+{
+    ::Helpers()->removeOne(this);
 
-                ret.insert( propName, propJsonObject );
-            }
-            else if( propValue.userType() == QMetaType::QJsonArray )
-            {
-                const QJsonArray propJsonArray = propValue.toJsonArray();
-                if( defaultPropValue.toJsonArray() == propJsonArray )
-                    continue;
+    if(!::Plans.isDestroyed())
+        ::Plans()->clear();
+}
 
-                ret.insert( propName, propJsonArray );
-            }
-            else
-            {
-                const QObjectSerializer::Helper *helper = ::Helpers()->findHelper(prop.userType());
-                if(helper == nullptr)
-                {
-                    if(propValue == defaultPropValue)
-                        continue;
+QObjectSerializer::Interface::~Interface()
+{
 
-                    ret.insert(propName, QJsonValue::fromVariant(propValue));
-                }
-                else
-                {
-                    const QJsonValue propJsonValue = helper->toJson(propValue);
-                    if(propJsonValue == defaultPropValue.toJsonValue())
-                        continue;
+}
 
-                    ret.insert(propName, propJsonValue);
-                }
-            }
+// Evaluates enum, flag and value properties. Returns false if the property
+// holds its default value and must therefore be left out of the JSON.
+static bool scalarPropertyToJson(const QObject *object, const SerializationPlan::Property &planProp, QJsonValue &ret)
+{
+    const QMetaProperty &prop = planProp.property;
+    const QVariant &defaultPropValue = planProp.defaultValue;
+
+    switch(planProp.kind)
+    {
+    case SerializationPlan::EnumPropertyKind: {
+        const QMetaEnum propEnum = prop.enumerator();
+        const QString propValue = QString::fromLatin1( propEnum.valueToKey(prop.read(object).toInt()) );
+        if(defaultPropValue == propValue)
+            return false;
+
+        ret = propValue;
+        } return true;
+    case SerializationPlan::FlagPropertyKind: {
+        const QMetaEnum propEnum = prop.enumerator();
+        const QString propValue = QString::fromLatin1( propEnum.valueToKeys(prop.read(object).toInt()) );
+        if(defaultPropValue == propValue)
+            return false;
+
+        ret = propValue;
+        } return true;
+    case SerializationPlan::ValuePropertyKind: {
+        const QVariant propValue = prop.read(object);
+        if( propValue.userType() == QMetaType::QJsonValue )
+        {
+            const QJsonValue propJsonValue = propValue.toJsonValue();
+            if( defaultPropValue.toJsonValue() == propJsonValue )
+                return false;
+
+            ret = propJsonValue;
+        }
+        else if( propValue.userType() == QMetaType::QJsonObject )
+        {
+            const QJsonObject propJsonObject = propValue.toJsonObject();
+            if( defaultPropValue.toJsonObject() == propJsonObject )
+                return false;
+
+            ret = propJsonObject;
         }
+        else if( propValue.userType() == QMetaType::QJsonArray )
+        {
+            const QJsonArray propJsonArray = propValue.toJsonArray();
+            if( defaultPropValue.toJsonArray() == propJsonArray )
+                return false;
+
+            ret = propJsonArray;
+        }
+        else if(planProp.helper == nullptr)
+        {
+            if(propValue == defaultPropValue)
+                return false;
+
+            ret = QJsonValue::fromVariant(propValue);
+        }
+        else
+        {
+            const QJsonValue propJsonValue = planProp.helper->toJson(propValue);
+            if(propJsonValue == defaultPropValue.toJsonValue())
+                return false;
+
+            ret = propJsonValue;
+        }
+        } return true;
+    default:
+        break;
     }
 
+    return false;
+}
+
+static const QObject *qobjectPropertyValue(const QObject *object, const SerializationPlan::Property &planProp)
+{
+    QVariant propValue = planProp.property.read(object);
+    propValue.convert(QMetaType::QObjectStar);
+    return propValue.value<QObject*>();
+}
+
 #ifdef SERIALIZE_DYNAMIC_PROPERTIES
+static void dynamicPropertiesToJson(const QObject *object, QJsonObject &ret)
+{
     const QList<QByteArray> dynPropNames = object->dynamicPropertyNames();
     Q_FOREACH(QByteArray propName, dynPropNames)
     {
@@ -336,6 +423,66 @@ QJsonObject QObjectSerializer::toJson(const QObject *object)
         const QJsonValue value = QJsonValue::fromVariant(propValue);
         ret.insert(key, value);
     }
+}
+#endif
+
+QJsonObject QObjectSerializer::toJson(const QObject *object)
+{
+    QJsonObject ret;
+    if( object == nullptr )
+        return ret;
+
+    QObjectSerializer::Interface *interface = qobject_cast<QObjectSerializer::Interface*>(object);
+    if(interface != nullptr)
+        interface->prepareForSerialization();
+
+    const QSharedPointer<const SerializationPlan> plan = ::Plans()->plan(object);
+    for(const SerializationPlan::Property &planProp : plan->properties)
+    {
+        const QMetaProperty &prop = planProp.property;
+        if(interface != nullptr && interface->canSerialize(planProp.metaObject, prop) == false)
+            continue;
+
+        const QString &propName = planProp.name;
+
+        switch(planProp.kind)
+        {
+        case SerializationPlan::QQmlListPropertyKind: {
+            QJsonArray list;
+
+            QQmlListReference listRef(const_cast<QObject*>(object), prop.name());
+            const int nrItems = listRef.count();
+            for(int i=0; i<nrItems; i++)
+            {
+                const QObject *listItem = listRef.at(i);
+                if(listItem == nullptr)
+                    continue;
+
+                QJsonObject item = QObjectSerializer::toJson(listItem);
+                list.append(item);
+            }
+
+            ret.insert(propName, list);
+            } break;
+        case SerializationPlan::QObjectPropertyKind: {
+            const QObject *propObject = ::qobjectPropertyValue(object, planProp);
+            if(propObject != nullptr)
+            {
+                const QJsonObject propJson = QObjectSerializer::toJson(propObject);
+                if(!propJson.isEmpty())
+                    ret.insert(propName, propJson);
+            }
+            } break;
+        default: {
+            QJsonValue propJsonValue;
+            if( ::scalarPropertyToJson(object, planProp, propJsonValue) )
+                ret.insert(propName, propJsonValue);
+            } break;
+        }
+    }
+
+#ifdef SERIALIZE_DYNAMIC_PROPERTIES
+    ::dynamicPropertiesToJson(object, ret);
 #endif
 
     if(interface != nullptr)
@@ -344,154 +491,619 @@ QJsonObject QObjectSerializer::toJson(const QObject *object)
     return ret;
 }
 
-bool QObjectSerializer::fromJson(const QJsonObject &json, QObject *object, QObjectFactory *factory)
+/**
+ * Writes the same bytes that QJsonDocument(QObjectSerializer::toJson(object)).toJson()
+ * would produce, without building the whole JSON tree first. Only scalar values
+ * of one object are held in memory at any point; nested objects and object lists
+ * are written out as they are visited.
+ *
+ * The same walk can also write the CBOR form of the object, ie. what
+ * QCborValue::fromJsonValue(toJson(object)).toCbor() would decode to. Objects and
+ * lists are written as indefinite length CBOR maps and arrays, so that they can be
+ * streamed without knowing their size up front.
+ *
+ * Interface::serializeToJson() is still given a QJsonObject, but it only holds
+ * the object's own scalar properties and null placeholders for nested ones.
+ * Implementations may add, replace or remove keys; placeholders they leave
+ * untouched are streamed.
+ */
+class JsonStreamWriter
 {
-    if(object == nullptr)
-        return false;
+public:
+    JsonStreamWriter(QIODevice *device, QIODevice *cborDevice=nullptr) : m_json(device), m_cbor(cborDevice) { }
+    ~JsonStreamWriter() { }
 
-    if(json.isEmpty())
-        return false;
+    bool writeDocument(const QObject *object);
+
+private:
+    void writeMembers(const QObject *object, int indent);
+    void writeObjectList(const QObject *object, const SerializationPlan::Property &planProp, int indent);
+    void writeValue(const QJsonValue &value, int indent);
+    void writeString(const QString &string) { this->write(escapedString(string)); }
+    static QByteArray escapedString(const QString &string);
+
+    void write(const char *bytes) { m_json.write(QByteArray::fromRawData(bytes, int(qstrlen(bytes)))); }
+    void write(const QByteArray &bytes) { m_json.write(bytes); }
+    void writeCbor(const QByteArray &bytes) { if(m_cbor.isActive()) m_cbor.write(bytes); }
+    void writeCbor(quint8 byte) { this->writeCbor(QByteArray(1, char(byte))); }
+    static QByteArray cborHead(quint8 majorType, quint64 value);
+    static QByteArray cborString(const QString &string);
+
+    // Bytes pushed as pending are only written once something else gets
+    // written after them. This lets us open a nested object speculatively
+    // and drop it, key and all, if it turns out to be empty.
+    void pushPending(const QByteArray &bytes, const QByteArray &cborBytes) {
+        m_json.pushPending(bytes);
+        if(m_cbor.isActive())
+            m_cbor.pushPending(cborBytes);
+    }
+    bool popPending() {
+        if(m_cbor.isActive())
+            m_cbor.popPending();
+        return m_json.popPending();
+    }
+
+    static QByteArray indentString(int indent) { return QByteArray(4*indent, ' '); }
+
+    enum { CborMapStart = 0xbf, CborArrayStart = 0x9f, CborBreak = 0xff };
 
+private:
+    class Sink
+    {
+    public:
+        Sink(QIODevice *device) : m_device(device) { }
+        ~Sink() { }
+
+        bool isActive() const { return m_device != nullptr; }
+
+        void pushPending(const QByteArray &bytes) { m_pending.append(bytes); }
+        bool popPending();
+
+        void write(const QByteArray &bytes);
+        bool flush();
+
+    private:
+        QIODevice *m_device = nullptr;
+        QByteArray m_buffer;
+        QVector<QByteArray> m_pending;
+        bool m_error = false;
+    };
+
+    Sink m_json;
+    Sink m_cbor;
+};
+
+bool JsonStreamWriter::writeDocument(const QObject *object)
+{
+    this->write("{\n");
+    this->writeCbor(CborMapStart);
+    if(object != nullptr)
+        this->writeMembers(object, 1);
+    this->write("}\n");
+    this->writeCbor(CborBreak);
+
+    const bool cborFlushed = m_cbor.isActive() ? m_cbor.flush() : true;
+    return m_json.flush() && cborFlushed;
+}
+
+void JsonStreamWriter::writeMembers(const QObject *object, int indent)
+{
     QObjectSerializer::Interface *interface = qobject_cast<QObjectSerializer::Interface*>(object);
     if(interface != nullptr)
-        interface->prepareForDeserialization();
+        interface->prepareForSerialization();
 
-    QStack<const QMetaObject*> metaObjects;
-    QStringList classNames;
-    const QMetaObject *mo = object->metaObject();
-    while(mo)
+    QJsonObject json;
+    QHash<QString, const SerializationPlan::Property*> nestedProperties;
+
+    const QSharedPointer<const SerializationPlan> plan = ::Plans()->plan(object);
+    for(const SerializationPlan::Property &planProp : plan->properties)
     {
-        metaObjects.push(mo);
-        if(interface != nullptr && interface->canSerialize(mo, QMetaProperty()) == false)
+        if(interface != nullptr && interface->canSerialize(planProp.metaObject, planProp.property) == false)
+            continue;
+
+        switch(planProp.kind)
         {
-            mo = mo->superClass();
+        case SerializationPlan::QQmlListPropertyKind:
+            json.insert(planProp.name, QJsonValue());
+            nestedProperties.insert(planProp.name, &planProp);
+            break;
+        case SerializationPlan::QObjectPropertyKind:
+            if(::qobjectPropertyValue(object, planProp) != nullptr)
+            {
+                json.insert(planProp.name, QJsonValue());
+                nestedProperties.insert(planProp.name, &planProp);
+            }
+            break;
+        default: {
+            QJsonValue propJsonValue;
+            if( ::scalarPropertyToJson(object, planProp, propJsonValue) )
+                json.insert(planProp.name, propJsonValue);
+            } break;
+        }
+    }
+
+#ifdef SERIALIZE_DYNAMIC_PROPERTIES
+    ::dynamicPropertiesToJson(object, json);
+#endif
+
+    if(interface != nullptr)
+        interface->serializeToJson(json);
+
+    // QJsonObject iterates over keys in sorted order, which is also the
+    // order in which QJsonDocument writes them out.
+    const QByteArray indentStr = indentString(indent);
+    int nrMembers = 0;
+    QJsonObject::const_iterator it = json.constBegin();
+    QJsonObject::const_iterator end = json.constEnd();
+    for(; it != end; ++it)
+    {
+        QByteArray prefix;
+        if(nrMembers > 0)
+            prefix += ",\n";
+        prefix += indentStr;
+
+        const SerializationPlan::Property *planProp = it.value().isNull() ? nestedProperties.value(it.key()) : nullptr;
+        if(planProp == nullptr)
+        {
+            this->write(prefix);
+            this->writeString(it.key());
+            this->write(": ");
+            this->writeValue(it.value(), indent);
+            if(m_cbor.isActive())
+                this->writeCbor(cborString(it.key()) + QCborValue::fromJsonValue(it.value()).toCbor());
+            ++nrMembers;
             continue;
         }
 
-        classNames << QString::fromLatin1(mo->className());
-        mo = mo->superClass();
+        if(planProp->kind == SerializationPlan::QQmlListPropertyKind)
+        {
+            this->write(prefix);
+            this->writeString(it.key());
+            this->write(": ");
+            if(m_cbor.isActive())
+                this->writeCbor(cborString(it.key()));
+            this->writeObjectList(object, *planProp, indent);
+            ++nrMembers;
+            continue;
+        }
+
+        // Nested objects whose JSON comes out empty are left out altogether,
+        // just like QObjectSerializer::toJson() does.
+        const QObject *propObject = ::qobjectPropertyValue(object, *planProp);
+        if(propObject == nullptr)
+            continue;
+
+        this->pushPending(prefix + escapedString(it.key()) + ": {\n",
+                          m_cbor.isActive() ? cborString(it.key()) + char(CborMapStart) : QByteArray());
+        this->writeMembers(propObject, indent+1);
+        if(this->popPending())
+            continue;
+
+        this->write(indentStr);
+        this->write("}");
+        this->writeCbor(CborBreak);
+        ++nrMembers;
     }
 
-    while(!metaObjects.isEmpty())
+    if(nrMembers > 0)
+        this->write("\n");
+}
+
+void JsonStreamWriter::writeObjectList(const QObject *object, const SerializationPlan::Property &planProp, int indent)
+{
+    const QByteArray itemIndentStr = indentString(indent+1);
+
+    this->write("[\n");
+    this->writeCbor(CborArrayStart);
+
+    int nrItems = 0;
+    QQmlListReference listRef(const_cast<QObject*>(object), planProp.property.name());
+    const int count = listRef.count();
+    for(int i=0; i<count; i++)
     {
-        mo = metaObjects.pop();
+        const QObject *listItem = listRef.at(i);
+        if(listItem == nullptr)
+            continue;
 
-        const int nrProperties = mo->propertyCount();
-        for(int i=mo->propertyOffset(); i<nrProperties; i++)
+        if(nrItems > 0)
+            this->write(",\n");
+        this->write(itemIndentStr);
+        this->write("{\n");
+        this->writeCbor(CborMapStart);
+        this->writeMembers(listItem, indent+2);
+        this->write(itemIndentStr);
+        this->write("}");
+        this->writeCbor(CborBreak);
+        ++nrItems;
+    }
+
+    if(nrItems > 0)
+        this->write("\n");
+
+    this->write(indentString(indent));
+    this->write("]");
+    this->writeCbor(CborBreak);
+}
+
+void JsonStreamWriter::writeValue(const QJsonValue &value, int indent)
+{
+    switch(value.type())
+    {
+    case QJsonValue::Bool:
+        this->write(value.toBool() ? "true" : "false");
+        break;
+    case QJsonValue::Double: {
+        // Same formatting as QJsonDocument::toJson()
+        const double d = value.toDouble();
+        if(qIsFinite(d))
         {
-            const QMetaProperty prop = mo->property(i);
-            if(interface != nullptr && interface->canSerialize(mo, prop) == false)
-                continue;
+            const double absd = qAbs(d);
+            this->write( QByteArray::number(d, absd == static_cast<quint64>(absd) ? 'f' : 'g', QLocale::FloatingPointShortest) );
+        }
+        else
+            this->write("null");
+        } break;
+    case QJsonValue::String:
+        this->writeString(value.toString());
+        break;
+    case QJsonValue::Array: {
+        const QJsonArray array = value.toArray();
+        const QByteArray itemIndentStr = indentString(indent+1);
+        this->write("[\n");
+        for(int i=0; i<array.size(); i++)
+        {
+            if(i > 0)
+                this->write(",\n");
+            this->write(itemIndentStr);
+            this->writeValue(array.at(i), indent+1);
+        }
+        if(!array.isEmpty())
+            this->write("\n");
+        this->write(indentString(indent));
+        this->write("]");
+        } break;
+    case QJsonValue::Object: {
+        const QJsonObject object = value.toObject();
+        const QByteArray memberIndentStr = indentString(indent+1);
+        this->write("{\n");
+        QJsonObject::const_iterator it = object.constBegin();
+        QJsonObject::const_iterator end = object.constEnd();
+        for(; it != end; ++it)
+        {
+            if(it != object.constBegin())
+                this->write(",\n");
+            this->write(memberIndentStr);
+            this->writeString(it.key());
+            this->write(": ");
+            this->writeValue(it.value(), indent+1);
+        }
+        if(!object.isEmpty())
+            this->write("\n");
+        this->write(indentString(indent));
+        this->write("}");
+        } break;
+    default:
+        this->write("null");
+        break;
+    }
+}
 
-            const QMetaType propType( prop.userType() );
+QByteArray JsonStreamWriter::escapedString(const QString &string)
+{
+    // Same escaping as QJsonDocument::toJson(): only quotes, backslashes and
+    // control characters are escaped, everything else is written as UTF-8.
+    static const char hexDigits[] = "0123456789abcdef";
+
+    QByteArray ret;
+    ret.reserve(string.length() + 2);
+    ret += '"';
+
+    const QChar *begin = string.constData();
+    const QChar *end = begin + string.length();
+    const QChar *src = begin;
+    while(src != end)
+    {
+        const ushort u = src->unicode();
+        if(u >= 0x80)
+        {
+            const QChar *runStart = src;
+            while(src != end && src->unicode() >= 0x80)
+                ++src;
+            ret += QString::fromRawData(runStart, int(src-runStart)).toUtf8();
+            continue;
+        }
 
-            static const char *objectName = "objectName";
-            if(!qstrcmp(prop.name(), objectName))
-                continue;
+        ++src;
+        if(u >= 0x20 && u != 0x22 && u != 0x5c)
+        {
+            ret += char(u);
+            continue;
+        }
 
-            if( !prop.isStored() )
-                continue;
+        ret += '\\';
+        switch(u)
+        {
+        case 0x22: ret += '"'; break;
+        case 0x5c: ret += '\\'; break;
+        case 0x08: ret += 'b'; break;
+        case 0x0c: ret += 'f'; break;
+        case 0x0a: ret += 'n'; break;
+        case 0x0d: ret += 'r'; break;
+        case 0x09: ret += 't'; break;
+        default:
+            ret += "u00";
+            ret += hexDigits[u >> 4];
+            ret += hexDigits[u & 0xf];
+            break;
+        }
+    }
 
-            const bool isQObjectPointer = (propType.flags() & QMetaType::PointerToQObject);
-            const bool isQQmlListProperty = QByteArray(prop.typeName()).startsWith("QQmlListProperty");
-            if( !prop.isWritable() && !isQObjectPointer && !isQQmlListProperty )
-                continue;
+    ret += '"';
+    return ret;
+}
 
-            const QString propName = QString::fromLatin1(prop.name());
-            if( !json.contains(propName) )
-                continue;
+QByteArray JsonStreamWriter::cborHead(quint8 majorType, quint64 value)
+{
+    // Initial byte and argument of a CBOR data item, in the shortest form
+    QByteArray ret;
+    const quint8 type = quint8(majorType << 5);
+    if(value < 24)
+        ret += char(type | quint8(value));
+    else if(value <= 0xff)
+    {
+        ret += char(type | 24);
+        ret += char(value);
+    }
+    else if(value <= 0xffff)
+    {
+        ret += char(type | 25);
+        for(int i=1; i>=0; i--)
+            ret += char(value >> (8*i));
+    }
+    else if(value <= 0xffffffffULL)
+    {
+        ret += char(type | 26);
+        for(int i=3; i>=0; i--)
+            ret += char(value >> (8*i));
+    }
+    else
+    {
+        ret += char(type | 27);
+        for(int i=7; i>=0; i--)
+            ret += char(value >> (8*i));
+    }
 
-            const QJsonValue jsonPropValue = json.value(propName);
+    return ret;
+}
 
-            if( isQQmlListProperty )
-            {
-                const QJsonArray list = jsonPropValue.toArray();
+QByteArray JsonStreamWriter::cborString(const QString &string)
+{
+    const QByteArray utf8 = string.toUtf8();
+    return cborHead(3, quint64(utf8.size())) + utf8;
+}
 
-                QQmlListReference listRef(const_cast<QObject*>(object), prop.name());
-                const bool canAddObjects = interface && interface->canSetPropertyFromObjectList(propName) && listRef.canAppend();
+bool JsonStreamWriter::Sink::popPending()
+{
+    // Returns true if the pending bytes were never written, ie. nothing was
+    // written after they were pushed.
+    if(m_pending.isEmpty())
+        return false;
 
-                QObjectFactory listItemFactory;
-                const QByteArray className(listRef.listElementType()->className());
-                listItemFactory.add(listRef.listElementType());
+    m_pending.removeLast();
+    return true;
+}
 
-                QList<QObject*> propertyObjects;
-                if(canAddObjects)
-                    propertyObjects.reserve(list.size());
-                else if(listRef.canAppend())
-                    listRef.clear();
+void JsonStreamWriter::Sink::write(const QByteArray &bytes)
+{
+    if(!m_pending.isEmpty())
+    {
+        for(const QByteArray &pending : qAsConst(m_pending))
+            m_buffer += pending;
+        m_pending.clear();
+    }
 
-                for(int i=0; i<list.size(); i++)
-                {
-                    const QJsonObject listItem = list.at(i).toObject();
-
-                    if(listRef.canAppend())
-                    {
-                        QObject *listItemObject = listItemFactory.create(className, listRef.object());
-                        QObjectSerializer::fromJson(listItem, listItemObject, factory);
-                        if(canAddObjects)
-                            propertyObjects.append(listItemObject);
-                        else
-                            listRef.append(listItemObject);
-                    }
-                    else
-                    {
-                        QObject *listItemObject = listRef.at(i);
-                        if(listItemObject == nullptr)
-                            continue;
-                        QObjectSerializer::fromJson(listItem, listItemObject, factory);
-                    }
-                }
+    m_buffer += bytes;
 
-                if(canAddObjects)
-                    interface->setPropertyFromObjectList(propName, propertyObjects);
+    static const int maxBufferSize = 256*1024;
+    if(m_buffer.size() >= maxBufferSize)
+        this->flush();
+}
 
-                continue;
-            }
+bool JsonStreamWriter::Sink::flush()
+{
+    if(m_error)
+        return false;
+
+    if(!m_buffer.isEmpty())
+    {
+        if(m_device->write(m_buffer) != m_buffer.size())
+            m_error = true;
+        m_buffer.clear();
+    }
+
+    return !m_error;
+}
+
+bool QObjectSerializer::toJson(const QObject *object, QIODevice *device)
+{
+    if(device == nullptr || !device->isWritable())
+        return false;
+
+    JsonStreamWriter writer(device);
+    return writer.writeDocument(object);
+}
+
+bool QObjectSerializer::toJsonAndCbor(const QObject *object, QIODevice *jsonDevice, QIODevice *cborDevice)
+{
+    if(jsonDevice == nullptr || !jsonDevice->isWritable())
+        return false;
+
+    if(cborDevice == nullptr || !cborDevice->isWritable())
+        return false;
+
+    JsonStreamWriter writer(jsonDevice, cborDevice);
+    return writer.writeDocument(object);
+}
 
-            if( prop.isEnumType() || prop.isFlagType() )
+#ifdef SERIALIZE_DYNAMIC_PROPERTIES
+static void dynamicPropertyFromJson(QObject *object, const QString &key, const QVariant &propValue)
+{
+    if( key.isEmpty() || key.at(0) != QChar('(') )
+        return;
+
+    const QByteArray propName = key.mid(1, key.lastIndexOf(')')-1).toLatin1();
+    if(key.endsWith('+'))
+    {
+        const QVariant existingPropValue = object->property(propName);
+        if(!existingPropValue.isValid())
+            object->setProperty(propName, propValue);
+        else
+        {
+            QVariant newPropValue;
+            switch(existingPropValue.userType())
             {
-                const QByteArray key = jsonPropValue.toString().toLatin1();
-                const QMetaEnum enumerator = prop.enumerator();
-                int value = prop.isEnumType() ? enumerator.keyToValue(key) : enumerator.keysToValue(key);
-                prop.write(object, value);
-                continue;
+            case QMetaType::Int:
+            case QMetaType::Bool:
+            case QMetaType::Double:
+            case QMetaType::QString: {
+                QVariantList list;
+                list << existingPropValue;
+                if(propValue.userType() == existingPropValue.userType())
+                    list << propValue;
+                else if(propValue.userType() == QMetaType::QStringList || propValue.userType() == QMetaType::QVariantList)
+                    list += propValue.toList();
+                newPropValue = list;
+                } break;
+            case QMetaType::QStringList: {
+                QStringList list = existingPropValue.toStringList();
+                list += propValue.toStringList();
+                newPropValue = list;
+                } break;
+            case QMetaType::QVariantMap: {
+                QVariantMap map = existingPropValue.toMap();
+                map.unite(propValue.toMap());
+                newPropValue = map;
+                } break;
+            default:
+                break;
             }
 
-            if( propType.flags() & QMetaType::PointerToQObject )
+            object->setProperty(propName, newPropValue);
+        }
+    }
+    else
+        object->setProperty(propName, propValue);
+}
+#endif
+
+bool QObjectSerializer::fromJson(const QJsonObject &json, QObject *object, QObjectFactory *factory)
+{
+    if(object == nullptr)
+        return false;
+
+    if(json.isEmpty())
+        return false;
+
+    QObjectSerializer::Interface *interface = qobject_cast<QObjectSerializer::Interface*>(object);
+    if(interface != nullptr)
+        interface->prepareForDeserialization();
+
+    const QSharedPointer<const SerializationPlan> plan = ::Plans()->plan(object);
+    for(const SerializationPlan::Property &planProp : plan->properties)
+    {
+        const QMetaProperty &prop = planProp.property;
+        if(interface != nullptr && interface->canSerialize(planProp.metaObject, prop) == false)
+            continue;
+
+        const QString &propName = planProp.name;
+        const QJsonObject::const_iterator jsonPropIt = json.constFind(propName);
+        if( jsonPropIt == json.constEnd() )
+            continue;
+
+        const QJsonValue jsonPropValue = jsonPropIt.value();
+
+        switch(planProp.kind)
+        {
+        case SerializationPlan::QQmlListPropertyKind: {
+            const QJsonArray list = jsonPropValue.toArray();
+
+            QQmlListReference listRef(const_cast<QObject*>(object), prop.name());
+            const bool canAddObjects = interface && interface->canSetPropertyFromObjectList(propName) && listRef.canAppend();
+
+            QObjectFactory listItemFactory;
+            const QByteArray className(listRef.listElementType()->className());
+            listItemFactory.add(listRef.listElementType());
+
+            QList<QObject*> propertyObjects;
+            if(canAddObjects)
+                propertyObjects.reserve(list.size());
+            else if(listRef.canAppend())
+                listRef.clear();
+
+            for(int i=0; i<list.size(); i++)
             {
-                QObjectFactory *usableFactory = factory;
-                QObjectFactory stopGapFactory;
+                const QJsonObject listItem = list.at(i).toObject();
 
-                const QVariant propValue = prop.read(object);
-                QObject *propObject = propValue.value<QObject*>();
-                if( propObject == nullptr )
+                if(listRef.canAppend())
                 {
-                    if(factory == nullptr)
-                    {
-                        stopGapFactory.add( QMetaType::metaObjectForType(prop.userType()) );
-                        usableFactory = &stopGapFactory;
-                    }
+                    QObject *listItemObject = listItemFactory.create(className, listRef.object());
+                    QObjectSerializer::fromJson(listItem, listItemObject, factory);
+                    if(canAddObjects)
+                        propertyObjects.append(listItemObject);
                     else
-                        factory->add( QMetaType::metaObjectForType(prop.userType()) );
+                        listRef.append(listItemObject);
+                }
+                else
+                {
+                    QObject *listItemObject = listRef.at(i);
+                    if(listItemObject == nullptr)
+                        continue;
+                    QObjectSerializer::fromJson(listItem, listItemObject, factory);
+                }
+            }
 
-                    if(prop.isWritable() && usableFactory != nullptr)
-                    {
-                        const QByteArray className = QByteArray(prop.typeName()).replace('*', "");
-                        propObject = usableFactory->create(className, object);
-                        if( propObject == nullptr )
-                            continue;
+            if(canAddObjects)
+                interface->setPropertyFromObjectList(propName, propertyObjects);
+            } break;
+        case SerializationPlan::EnumPropertyKind:
+        case SerializationPlan::FlagPropertyKind: {
+            const QByteArray key = jsonPropValue.toString().toLatin1();
+            const QMetaEnum enumerator = prop.enumerator();
+            int value = planProp.kind == SerializationPlan::EnumPropertyKind ? enumerator.keyToValue(key) : enumerator.keysToValue(key);
+            prop.write(object, value);
+            } break;
+        case SerializationPlan::QObjectPropertyKind: {
+            QObjectFactory *usableFactory = factory;
+            QObjectFactory stopGapFactory;
 
-                        prop.write(object, QVariant::fromValue(propObject));
-                    }
-                    else
-                        continue;
+            const QVariant propValue = prop.read(object);
+            QObject *propObject = propValue.value<QObject*>();
+            if( propObject == nullptr )
+            {
+                if(factory == nullptr)
+                {
+                    stopGapFactory.add( planProp.classMetaObject );
+                    usableFactory = &stopGapFactory;
                 }
+                else
+                    factory->add( planProp.classMetaObject );
 
-                const QJsonObject propJson = jsonPropValue.toObject();
-                QObjectSerializer::fromJson(propJson, propObject, usableFactory);
-                continue;
+                if(prop.isWritable() && usableFactory != nullptr)
+                {
+                    propObject = usableFactory->create(planProp.className, object);
+                    if( propObject == nullptr )
+                        continue;
+
+                    prop.write(object, QVariant::fromValue(propObject));
+                }
+                else
+                    continue;
             }
 
+            const QJsonObject propJson = jsonPropValue.toObject();
+            QObjectSerializer::fromJson(propJson, propObject, usableFactory);
+            } break;
+        case SerializationPlan::ValuePropertyKind:
             switch(prop.userType())
             {
             case QMetaType::QJsonValue:
@@ -507,10 +1119,8 @@ bool QObjectSerializer::fromJson(const QJsonObject &json, QObject *object, QObje
                 break;
             }
 
-            const QObjectSerializer::Helper *helper = ::Helpers()->findHelper(prop.userType());
-            const QJsonValue propJsonValue = json.value(propName);
-            const QVariant propValue = helper == nullptr ? propJsonValue.toVariant() : helper->fromJson(propJsonValue, prop.userType());
-            prop.write(object, propValue);
+            prop.write(object, planProp.helper == nullptr ? jsonPropValue.toVariant() : planProp.helper->fromJson(jsonPropValue, prop.userType()));
+            break;
         }
     }
 
@@ -519,64 +1129,186 @@ bool QObjectSerializer::fromJson(const QJsonObject &json, QObject *object, QObje
     QJsonObject::const_iterator end = json.constEnd();
     while(it != end)
     {
-        const QString key = it.key();
-        if( key.isEmpty() || key.at(0) != QChar('(') )
-        {
-            ++it;
+        ::dynamicPropertyFromJson(object, it.key(), it.value().toVariant());
+        ++it;
+    }
+#endif
+
+    if(interface != nullptr)
+        interface->deserializeFromJson(json);
+
+    return true;
+}
+
+/**
+ * Same as fromJson(), but walks the CBOR form of a JSON object directly. A document
+ * loaded from its binary header is therefore never turned into a QJsonObject tree.
+ *
+ * Scalar values are converted to QJsonValue one at a time, so that they end up in
+ * properties exactly as fromJson() would put them. Interface::deserializeFromJson()
+ * gets all members of the object, except the list and object properties that were
+ * already deserialized from CBOR. Those carry the bulk of the document.
+ */
+bool QObjectSerializer::fromCbor(const QCborMap &cbor, QObject *object, QObjectFactory *factory)
+{
+    if(object == nullptr)
+        return false;
+
+    if(cbor.isEmpty())
+        return false;
+
+    QObjectSerializer::Interface *interface = qobject_cast<QObjectSerializer::Interface*>(object);
+    if(interface != nullptr)
+        interface->prepareForDeserialization();
+
+    QSet<QString> deserializedKeys;
+
+    const QSharedPointer<const SerializationPlan> plan = ::Plans()->plan(object);
+    for(const SerializationPlan::Property &planProp : plan->properties)
+    {
+        const QMetaProperty &prop = planProp.property;
+        if(interface != nullptr && interface->canSerialize(planProp.metaObject, prop) == false)
+            continue;
+
+        const QString &propName = planProp.name;
+        const QCborMap::ConstIterator cborPropIt = cbor.constFind(propName);
+        if( cborPropIt == cbor.constEnd() )
             continue;
-        }
 
-        const QByteArray propName = key.mid(1, key.lastIndexOf(')')-1).toLatin1();
-        const QVariant propValue = it.value().toVariant();
+        const QCborValue cborPropValue = cborPropIt.value();
 
-        if(key.endsWith('+'))
+        switch(planProp.kind)
         {
-            const QVariant existingPropValue = object->property(propName);
-            if(!existingPropValue.isValid())
-                object->setProperty(propName, propValue);
-            else
+        case SerializationPlan::QQmlListPropertyKind: {
+            if(cborPropValue.isArray())
+                deserializedKeys += propName;
+
+            const QCborArray list = cborPropValue.toArray();
+
+            QQmlListReference listRef(const_cast<QObject*>(object), prop.name());
+            const bool canAddObjects = interface && interface->canSetPropertyFromObjectList(propName) && listRef.canAppend();
+
+            QObjectFactory listItemFactory;
+            const QByteArray className(listRef.listElementType()->className());
+            listItemFactory.add(listRef.listElementType());
+
+            QList<QObject*> propertyObjects;
+            if(canAddObjects)
+                propertyObjects.reserve(int(list.size()));
+            else if(listRef.canAppend())
+                listRef.clear();
+
+            for(int i=0; i<int(list.size()); i++)
             {
-                QVariant newPropValue;
-                switch(existingPropValue.userType())
+                const QCborMap listItem = list.at(i).toMap();
+
+                if(listRef.canAppend())
                 {
-                case QMetaType::Int:
-                case QMetaType::Bool:
-                case QMetaType::Double:
-                case QMetaType::QString: {
-                    QVariantList list;
-                    list << existingPropValue;
-                    if(propValue.userType() == existingPropValue.userType())
-                        list << propValue;
-                    else if(propValue.userType() == QMetaType::QStringList || propValue.userType() == QMetaType::QVariantList)
-                        list += propValue.toList();
-                    newPropValue = list;
-                    } break;
-                case QMetaType::QStringList: {
-                    QStringList list = existingPropValue.toStringList();
-                    list += propValue.toStringList();
-                    newPropValue = list;
-                    } break;
-                case QMetaType::QVariantMap: {
-                    QVariantMap map = existingPropValue.toMap();
-                    map.unite(propValue.toMap());
-                    newPropValue = map;
-                    } break;
-                default:
-                    break;
+                    QObject *listItemObject = listItemFactory.create(className, listRef.object());
+                    QObjectSerializer::fromCbor(listItem, listItemObject, factory);
+                    if(canAddObjects)
+                        propertyObjects.append(listItemObject);
+                    else
+                        listRef.append(listItemObject);
+                }
+                else
+                {
+                    QObject *listItemObject = listRef.at(i);
+                    if(listItemObject == nullptr)
+                        continue;
+                    QObjectSerializer::fromCbor(listItem, listItemObject, factory);
                 }
+            }
+
+            if(canAddObjects)
+                interface->setPropertyFromObjectList(propName, propertyObjects);
+            } break;
+        case SerializationPlan::EnumPropertyKind:
+        case SerializationPlan::FlagPropertyKind: {
+            const QByteArray key = cborPropValue.toString().toLatin1();
+            const QMetaEnum enumerator = prop.enumerator();
+            int value = planProp.kind == SerializationPlan::EnumPropertyKind ? enumerator.keyToValue(key) : enumerator.keysToValue(key);
+            prop.write(object, value);
+            } break;
+        case SerializationPlan::QObjectPropertyKind: {
+            QObjectFactory *usableFactory = factory;
+            QObjectFactory stopGapFactory;
+
+            const QVariant propValue = prop.read(object);
+            QObject *propObject = propValue.value<QObject*>();
+            if( propObject == nullptr )
+            {
+                if(factory == nullptr)
+                {
+                    stopGapFactory.add( planProp.classMetaObject );
+                    usableFactory = &stopGapFactory;
+                }
+                else
+                    factory->add( planProp.classMetaObject );
+
+                if(prop.isWritable() && usableFactory != nullptr)
+                {
+                    propObject = usableFactory->create(planProp.className, object);
+                    if( propObject == nullptr )
+                        continue;
+
+                    prop.write(object, QVariant::fromValue(propObject));
+                }
+                else
+                    continue;
+            }
 
-                object->setProperty(propName, newPropValue);
+            if(cborPropValue.isMap())
+                deserializedKeys += propName;
+
+            QObjectSerializer::fromCbor(cborPropValue.toMap(), propObject, usableFactory);
+            } break;
+        case SerializationPlan::ValuePropertyKind: {
+            const QJsonValue jsonPropValue = cborPropValue.toJsonValue();
+            switch(prop.userType())
+            {
+            case QMetaType::QJsonValue:
+                prop.write(object, QVariant::fromValue<QJsonValue>(jsonPropValue));
+                continue;
+            case QMetaType::QJsonObject:
+                prop.write(object, QVariant::fromValue<QJsonObject>(jsonPropValue.toObject()));
+                continue;
+            case QMetaType::QJsonArray:
+                prop.write(object, QVariant::fromValue<QJsonArray>(jsonPropValue.toArray()));
+                continue;
+            default:
+                break;
             }
+
+            prop.write(object, planProp.helper == nullptr ? jsonPropValue.toVariant() : planProp.helper->fromJson(jsonPropValue, prop.userType()));
+            } break;
         }
-        else
-            object->setProperty(propName, propValue);
+    }
 
+#ifdef SERIALIZE_DYNAMIC_PROPERTIES
+    QCborMap::ConstIterator it = cbor.constBegin();
+    QCborMap::ConstIterator end = cbor.constEnd();
+    while(it != end)
+    {
+        ::dynamicPropertyFromJson(object, it.key().toString(), it.value().toJsonValue().toVariant());
         ++it;
     }
 #endif
 
     if(interface != nullptr)
+    {
+        QJsonObject json;
+        QCborMap::ConstIterator it = cbor.constBegin();
+        QCborMap::ConstIterator end = cbor.constEnd();
+        for(; it != end; ++it)
+        {
+            const QString key = it.key().toString();
+            if(!deserializedKeys.contains(key))
+                json.insert(key, it.value().toJsonValue());
+        }
+
         interface->deserializeFromJson(json);
+    }
 
     return true;
 }
@@ -1034,6 +1766,9 @@ QVariantMap QObjectSerializer::cacheDefaultPropertyValues(const QObject *object,
 
     defaultPropertyValueMap.insert(className, ret);
 
+    // Plans hold on to default values, they need to be worked out again.
+    ::Plans()->clear();
+
     return ret;
 }
 
@@ -16,6 +16,8 @@
 
 #include <QMap>
 #include <QObject>
+#include <QCborMap>
+#include <QIODevice>
 #include <QJsonValue>
 #include <QJsonArray>
 #include <QJsonObject>
@@ -54,6 +56,16 @@ namespace QObjectSerializer
     QJsonObject toJson(const QObject *object);
     bool fromJson(const QJsonObject &json, QObject *object, QObjectFactory *factory=nullptr);
 
+    // Same as fromJson(), but reads the CBOR form of the JSON object
+    bool fromCbor(const QCborMap &cbor, QObject *object, QObjectFactory *factory=nullptr);
+
+    // Streams the same bytes as QJsonDocument(toJson(object)).toJson() into device
+    bool toJson(const QObject *object, QIODevice *device);
+
+    // Same as above, while also streaming the object as CBOR into cborDevice. The
+    // object tree is walked only once for both.
+    bool toJsonAndCbor(const QObject *object, QIODevice *jsonDevice, QIODevice *cborDevice);
+
     QVariantMap cacheDefaultPropertyValues(const QObject *object, bool readonly=false);
 };
 
@@ -64,6 +76,10 @@ namespace QObjectSerializer
         defaultPropertyValuesCached = true; \
     }
 
+// Lets programs that are built against more than one revision of this file, like
+// tools/serializerbench, find out whether fromCbor() is available.
+#define QOBJECTSERIALIZER_HAS_FROMCBOR
+
 Q_DECLARE_INTERFACE(QObjectSerializer::Interface, "com.prashanthudupa.QObjectSerializer.Interface/1.0")
 
 #endif // QOBJECTSERIALIZER_H
@@ -0,0 +1,139 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include "textmatcher.h"
+
+#include <cstring>
+#include <QtAlgorithms>
+#include <QScopedPointer>
+#include <QTextBoundaryFinder>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTMATCHER_USE_SSE2
+#endif
+
+TextMatcher::TextMatcher(const QString &string, Qt::CaseSensitivity cs, bool wholeWords)
+    : m_string(string),
+      m_caseSensitivity(cs),
+      m_wholeWords(wholeWords)
+{
+    m_foldedString = cs == Qt::CaseSensitive ? string : TextMatcher::fold(string);
+}
+
+TextMatcher::~TextMatcher()
+{
+
+}
+
+QVector<TextMatcher::Range> TextMatcher::ranges(const QString &text) const
+{
+    QVector<Range> ret;
+
+    const int length = m_string.length();
+    if(length == 0 || text.length() < length)
+        return ret;
+
+    QScopedPointer<QTextBoundaryFinder> wordBoundaries;
+    if(m_wholeWords)
+        wordBoundaries.reset(new QTextBoundaryFinder(QTextBoundaryFinder::Word, text));
+
+    auto isWholeWord = [&wordBoundaries,length](int pos) {
+        return wordBoundaries.isNull() || TextMatcher::isWholeWord(*wordBoundaries, pos, length);
+    };
+
+    const QString haystack = m_caseSensitivity == Qt::CaseSensitive ? text : TextMatcher::fold(text);
+
+    // Case folding doesn't change the length of text, except perhaps in some corner
+    // cases. Positions in folded text would then be off, so we let QString handle it.
+    const bool useKernel = haystack.length() == text.length() && m_foldedString.length() == length;
+
+    int from = 0;
+    while(from <= text.length()-length)
+    {
+        const int pos = useKernel ? this->next(haystack.utf16(), haystack.length(), from) : text.indexOf(m_string, from, m_caseSensitivity);
+        if(pos < 0)
+            break;
+
+        if(!isWholeWord(pos))
+        {
+            from = pos+1;
+            continue;
+        }
+
+        ret.append( qMakePair(pos, pos+length-1) );
+        from = pos+length;
+    }
+
+    return ret;
+}
+
+bool TextMatcher::isWholeWord(QTextBoundaryFinder &wordBoundaries, int from, int length)
+{
+    wordBoundaries.setPosition(from);
+    if(!wordBoundaries.isAtBoundary())
+        return false;
+
+    wordBoundaries.setPosition(from+length);
+    return wordBoundaries.isAtBoundary();
+}
+
+QString TextMatcher::fold(const QString &text)
+{
+    return text.toCaseFolded();
+}
+
+int TextMatcher::next(const ushort *text, int textLength, int from) const
+{
+    const ushort *string = m_foldedString.utf16();
+    const int length = m_foldedString.length();
+    const int lastFrom = textLength - length;
+
+    // Only positions where both the first and last characters match are compared
+    // in full. There are too few of those in natural text to matter.
+    const ushort firstChar = string[0];
+    const ushort lastChar = string[length-1];
+    const size_t middleBytes = size_t(qMax(length-2, 0)) * sizeof(ushort);
+
+    int i = from;
+
+#ifdef TEXTMATCHER_USE_SSE2
+    const __m128i firstChars = _mm_set1_epi16(short(firstChar));
+    const __m128i lastChars = _mm_set1_epi16(short(lastChar));
+    for(; i+7 <= lastFrom; i += 8)
+    {
+        const __m128i heads = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text+i));
+        const __m128i tails = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text+i+length-1));
+        const __m128i matches = _mm_and_si128(_mm_cmpeq_epi16(heads, firstChars), _mm_cmpeq_epi16(tails, lastChars));
+
+        uint mask = uint(_mm_movemask_epi8(matches));
+        while(mask)
+        {
+            const uint bit = qCountTrailingZeroBits(mask);
+            const int pos = i + int(bit/2);
+            if(std::memcmp(text+pos+1, string+1, middleBytes) == 0)
+                return pos;
+            mask &= ~(3u << bit);
+        }
+    }
+#endif
+
+    for(; i <= lastFrom; i++)
+    {
+        if(text[i] == firstChar && text[i+length-1] == lastChar &&
+           std::memcmp(text+i+1, string+1, middleBytes) == 0)
+            return i;
+    }
+
+    return -1;
+}
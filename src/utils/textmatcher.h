@@ -0,0 +1,59 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef TEXTMATCHER_H
+#define TEXTMATCHER_H
+
+#include <QPair>
+#include <QVector>
+#include <QString>
+
+class QTextBoundaryFinder;
+
+/**
+ * Finds all non-overlapping occurrences of a string in text.
+ *
+ * For case insensitive matching, the text is case-folded once up front instead of
+ * folding one character at a time while comparing. Candidate positions are found by
+ * comparing the first and last characters of the string against several characters
+ * of text at once (SSE2 where available), and only those are compared in full.
+ *
+ * Whole word matches must begin and end at word boundaries, as defined by
+ * QTextBoundaryFinder; so punctuation and non-Latin scripts are handled correctly.
+ */
+class TextMatcher
+{
+public:
+    TextMatcher(const QString &string, Qt::CaseSensitivity cs=Qt::CaseInsensitive, bool wholeWords=false);
+    ~TextMatcher();
+
+    typedef QPair<int,int> Range; // first and last character of a match
+    QVector<Range> ranges(const QString &text) const;
+
+    static QString fold(const QString &text);
+
+    // Whether length characters from the given position make up whole words. The
+    // boundary finder must be of type QTextBoundaryFinder::Word.
+    static bool isWholeWord(QTextBoundaryFinder &wordBoundaries, int from, int length);
+
+private:
+    int next(const ushort *text, int textLength, int from) const;
+
+private:
+    QString m_string;
+    QString m_foldedString;
+    Qt::CaseSensitivity m_caseSensitivity = Qt::CaseInsensitive;
+    bool m_wholeWords = false;
+};
+
+#endif // TEXTMATCHER_H
@@ -0,0 +1,250 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#ifndef TEXTSEARCHINDEX_H
+#define TEXTSEARCHINDEX_H
+
+#include <QMap>
+#include <QHash>
+#include <QVector>
+#include <QString>
+#include <QStringRef>
+#include <QScopedPointer>
+#include <QTextBoundaryFinder>
+
+#include <algorithm>
+
+#include "textmatcher.h"
+
+/**
+ * Inverted index of words in a set of texts, each of which is identified by a key.
+ * Words are stored in lower case and map to the texts and positions where they occur.
+ *
+ * A query looks for the first word of the phrase in the list of distinct words, which
+ * is far shorter than the text itself, and compares the whole phrase against the text
+ * only at positions where one of those words occur. The first word of the phrase may
+ * lie anywhere in a word of the text, so queries find exactly what a scan of the text
+ * would have found.
+ */
+template <class Key>
+class TextSearchIndex
+{
+public:
+    struct Word
+    {
+        QString text; // lower case
+        int start = -1;
+        int length = 0;
+    };
+    static QVector<Word> words(const QString &text);
+
+    struct Match
+    {
+        Key key;
+        int from = -1;
+        int to = -1;
+    };
+
+    void insert(const Key &key, const QString &text);
+    void remove(const Key &key);
+    void clear() { m_postings.clear(); m_entries.clear(); }
+
+    bool contains(const Key &key) const { return m_entries.contains(key); }
+    bool isEmpty() const { return m_entries.isEmpty(); }
+
+    // Non-overlapping occurrences of phrase, ordered by key and then by position.
+    QVector<Match> find(const QString &phrase, Qt::CaseSensitivity cs=Qt::CaseInsensitive, bool wholeWords=false) const;
+
+private:
+    struct Posting
+    {
+        Key key;
+        int start = -1; // of the word in text
+    };
+    struct Entry
+    {
+        QString text;
+        QVector<Word> words;
+    };
+    QMap< QString, QVector<Posting> > m_postings;
+    QHash< Key, Entry > m_entries;
+};
+
+template <class Key>
+QVector<typename TextSearchIndex<Key>::Word> TextSearchIndex<Key>::words(const QString &text)
+{
+    auto isWordCharacter = [](const QChar &ch) {
+        return ch.isLetterOrNumber() || ch.isMark();
+    };
+
+    QVector<Word> ret;
+    const int length = text.length();
+    int i = 0;
+    while(i < length)
+    {
+        while(i < length && !isWordCharacter(text.at(i)))
+            ++i;
+        if(i == length)
+            break;
+
+        Word word;
+        word.start = i;
+        while(i < length && isWordCharacter(text.at(i)))
+            ++i;
+        word.length = i - word.start;
+        word.text = text.mid(word.start, word.length).toLower();
+        ret << word;
+    }
+
+    return ret;
+}
+
+template <class Key>
+void TextSearchIndex<Key>::insert(const Key &key, const QString &text)
+{
+    this->remove(key);
+
+    Entry entry;
+    entry.text = text;
+    entry.words = TextSearchIndex<Key>::words(text);
+    for(const Word &word : qAsConst(entry.words))
+    {
+        Posting posting;
+        posting.key = key;
+        posting.start = word.start;
+        m_postings[word.text].append(posting);
+    }
+
+    m_entries.insert(key, entry);
+}
+
+template <class Key>
+void TextSearchIndex<Key>::remove(const Key &key)
+{
+    const Entry entry = m_entries.take(key);
+    for(const Word &word : entry.words)
+    {
+        auto it = m_postings.find(word.text);
+        if(it == m_postings.end())
+            continue;
+
+        QVector<Posting> &postings = it.value();
+        postings.erase( std::remove_if(postings.begin(), postings.end(), [key](const Posting &p) {
+            return p.key == key;
+        }), postings.end() );
+
+        if(postings.isEmpty())
+            m_postings.erase(it);
+    }
+}
+
+template <class Key>
+QVector<typename TextSearchIndex<Key>::Match> TextSearchIndex<Key>::find(const QString &phrase, Qt::CaseSensitivity cs, bool wholeWords) const
+{
+    QVector<Match> ret;
+    if(phrase.isEmpty())
+        return ret;
+
+    const QVector<Word> queryWords = TextSearchIndex<Key>::words(phrase);
+    if(queryWords.isEmpty())
+    {
+        // Phrases without any words in them cannot be looked up in the index.
+        const TextMatcher matcher(phrase, cs, wholeWords);
+        for(auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it)
+        {
+            const QVector<TextMatcher::Range> ranges = matcher.ranges(it.value().text);
+            for(const TextMatcher::Range &range : ranges)
+            {
+                Match match;
+                match.key = it.key();
+                match.from = range.first;
+                match.to = range.second;
+                ret << match;
+            }
+        }
+
+        std::sort(ret.begin(), ret.end(), [](const Match &a, const Match &b) {
+            return a.key == b.key ? a.from < b.from : a.key < b.key;
+        });
+        return ret;
+    }
+
+    // The first word of the phrase lies within a word of the text. That word must end
+    // with it if the phrase goes on after the first word, and begin with it if the phrase
+    // has something before the first word. Otherwise it can be anywhere in the word.
+    const Word &firstWord = queryWords.first();
+    const bool mustBeginWord = firstWord.start > 0;
+    const bool mustEndWord = firstWord.start + firstWord.length < phrase.length();
+
+    QVector<Match> candidates;
+    for(auto it = m_postings.constBegin(); it != m_postings.constEnd(); ++it)
+    {
+        const QString &word = it.key();
+        for(int offset = word.indexOf(firstWord.text); offset >= 0; offset = word.indexOf(firstWord.text, offset+1))
+        {
+            if(mustBeginWord && offset > 0)
+                break;
+            if(mustEndWord && offset + firstWord.text.length() != word.length())
+                continue;
+
+            for(const Posting &posting : it.value())
+            {
+                Match candidate;
+                candidate.key = posting.key;
+                candidate.from = posting.start + offset - firstWord.start;
+                candidate.to = candidate.from + phrase.length() - 1;
+                candidates << candidate;
+            }
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const Match &a, const Match &b) {
+        return a.key == b.key ? a.from < b.from : a.key < b.key;
+    });
+
+    // Now make sure that the whole phrase, including whatever separates words in it,
+    // is found at each candidate position. Matches in a text must not overlap, just
+    // like they wouldn't when scanning the text.
+    const QString *wordBoundariesText = nullptr;
+    QScopedPointer<QTextBoundaryFinder> wordBoundaries;
+    for(const Match &candidate : qAsConst(candidates))
+    {
+        const QString &text = m_entries.constFind(candidate.key).value().text;
+        if(candidate.from < 0 || candidate.to >= text.length())
+            continue;
+
+        if(!ret.isEmpty() && ret.last().key == candidate.key && candidate.from <= ret.last().to)
+            continue;
+
+        if(QStringRef(&text, candidate.from, phrase.length()).compare(phrase, cs) != 0)
+            continue;
+
+        if(wholeWords)
+        {
+            if(wordBoundariesText != &text)
+            {
+                wordBoundaries.reset(new QTextBoundaryFinder(QTextBoundaryFinder::Word, text));
+                wordBoundariesText = &text;
+            }
+
+            if(!TextMatcher::isWholeWord(*wordBoundaries, candidate.from, phrase.length()))
+                continue;
+        }
+
+        ret << candidate;
+    }
+
+    return ret;
+}
+
+#endif // TEXTSEARCHINDEX_H
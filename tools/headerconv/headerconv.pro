@@ -0,0 +1,13 @@
+QT += core
+DESTDIR = $$PWD/../../../Release/
+TARGET = headerconv
+CONFIG += console
+
+INCLUDEPATH += $$PWD/../../src/utils
+
+HEADERS += \
+    ../../src/utils/binaryheader.h
+
+SOURCES += \
+    main.cpp \
+    ../../src/utils/binaryheader.cpp
@@ -0,0 +1,105 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include <QtCore>
+
+#include "binaryheader.h"
+
+/**
+ * Scrite documents store their header in two forms: _header.json, which is what
+ * every version of Scrite understands, and _header.cbor, which is quicker to load.
+ * See BinaryHeader for details about the binary form.
+ *
+ * This program converts a header from one form to the other. It comes in handy while
+ * debugging loading issues, or for inspecting the binary header of a document. Both
+ * files can be extracted from (or put back into) a .scrite file using any ZIP tool.
+ *
+ *     headerconv --input _header.json --output _header.cbor
+ *     headerconv --input _header.cbor --output _header.json
+ *
+ * The direction of conversion is determined by the suffix of the input file.
+ */
+int main(int argc, char **argv)
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+
+    QCommandLineOption inputFileOption("input", "Name of the .json or .cbor header file to read", "input-file");
+    parser.addOption(inputFileOption);
+
+    QCommandLineOption outputFileOption("output", "Name of the converted header file to write", "output-file");
+    parser.addOption(outputFileOption);
+
+    parser.addHelpOption();
+
+    parser.process(a);
+
+    if(!parser.isSet(inputFileOption) || !parser.isSet(outputFileOption))
+    {
+        parser.showHelp(-1);
+        return -1;
+    }
+
+    const QString inputFileName = parser.value(inputFileOption);
+    QFile inputFile(inputFileName);
+    if( !inputFile.open(QFile::ReadOnly) )
+    {
+        qWarning("Cannot open file '%s' for reading.", qPrintable(inputFileName));
+        return -1;
+    }
+
+    const QByteArray inputBytes = inputFile.readAll();
+    const bool toBinary = QFileInfo(inputFileName).suffix().toLower() == QStringLiteral("json");
+
+    QByteArray outputBytes;
+    if(toBinary)
+    {
+        QJsonParseError error;
+        const QJsonDocument jsonDoc = QJsonDocument::fromJson(inputBytes, &error);
+        if(error.error != QJsonParseError::NoError || !jsonDoc.isObject())
+        {
+            qWarning("'%s' is not a valid JSON header: %s", qPrintable(inputFileName), qPrintable(error.errorString()));
+            return -1;
+        }
+
+        outputBytes = BinaryHeader::fromJson(jsonDoc.object());
+    }
+    else
+    {
+        bool ok = false;
+        const QJsonObject json = BinaryHeader::toJson(inputBytes, &ok);
+        if(!ok)
+        {
+            qWarning("'%s' is not a valid binary header.", qPrintable(inputFileName));
+            return -1;
+        }
+
+        outputBytes = QJsonDocument(json).toJson();
+    }
+
+    const QString outputFileName = parser.value(outputFileOption);
+    QFile outputFile(outputFileName);
+    if( !outputFile.open(QFile::WriteOnly) )
+    {
+        qWarning("Cannot open file '%s' for writing.", qPrintable(outputFileName));
+        return -1;
+    }
+
+    outputFile.write(outputBytes);
+    outputFile.close();
+
+    qInfo("Wrote %d bytes into '%s'.", outputBytes.size(), qPrintable(outputFileName));
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include <QtCore>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QAbstractTextDocumentLayout>
+
+#include "application.h"
+#include "scritedocument.h"
+#include "screenplaytextdocument.h"
+
+/**
+ * Lays out screenplays for printing twice, once with ScreenplayPageBreaker and once with
+ * the hit testing page breaker it replaced, and compares where pages begin. Use it as a
+ * regression check whenever ScreenplayPageBreaker is changed, by running it over a set of
+ * real screenplays.
+ *
+ *     pagebreakcheck screenplay1.scrite screenplay2.scrite ...
+ *
+ * The exit code is the number of screenplays for which page breaks differ.
+ *
+ * NOTE: Most developers will never have to build this program ever.
+ */
+
+// Defined in referencepagebreaker.cpp
+void setReferencePageBreakerEnabled(bool val);
+
+// Returns the first line of text on each page, prefixed by its page number.
+static QStringList pageBeginnings(ScriteDocument *scriteDocument, bool useReference)
+{
+    setReferencePageBreakerEnabled(useReference);
+
+    QTextDocument textDocument;
+
+    ScreenplayTextDocument stDoc;
+    stDoc.setTitlePage(true);
+    stDoc.setSceneNumbers(true);
+    stDoc.setSyncEnabled(false);
+    stDoc.setPurpose(ScreenplayTextDocument::ForPrinting);
+    stDoc.setScreenplay(scriteDocument->screenplay());
+    stDoc.setFormatting(scriteDocument->printFormat());
+    stDoc.setTitlePageIsCentered(scriteDocument->screenplay()->isTitlePageIsCentered());
+    stDoc.setTextDocument(&textDocument);
+    stDoc.syncNow();
+
+    QAbstractTextDocumentLayout *layout = textDocument.documentLayout();
+    const qreal pageHeight = textDocument.pageSize().height();
+
+    QStringList ret;
+    int lastPage = -1;
+    QTextBlock block = textDocument.firstBlock();
+    while(block.isValid())
+    {
+        const QRectF blockRect = layout->blockBoundingRect(block);
+        const QTextLayout *blockLayout = block.layout();
+        for(int i=0; i<blockLayout->lineCount(); i++)
+        {
+            const QTextLine line = blockLayout->lineAt(i);
+            const int page = int((blockRect.top() + line.y()) / pageHeight);
+            if(page == lastPage)
+                continue;
+
+            QString text = block.text().mid(line.textStart(), line.textLength()).trimmed();
+            text.replace(QChar::ObjectReplacementCharacter, QStringLiteral("[*]"));
+            ret << QStringLiteral("Page %1: %2").arg(page+1).arg(text);
+            lastPage = page;
+        }
+
+        block = block.next();
+    }
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    Application::setApplicationName(QStringLiteral("Scrite"));
+    Application::setOrganizationName(QStringLiteral("TERIFLIX"));
+    Application::setOrganizationDomain(QStringLiteral("teriflix.com"));
+
+    Application a(argc, argv, QVersionNumber(0,7,3));
+
+    QCommandLineParser parser;
+    parser.addPositionalArgument("files", "Scrite documents to lay out for printing.", "files...");
+    parser.addHelpOption();
+    parser.process(a);
+
+    const QStringList files = parser.positionalArguments();
+    if(files.isEmpty())
+        parser.showHelp(1);
+
+    ScriteDocument *scriteDocument = ScriteDocument::instance();
+
+    int nrMismatches = 0;
+    for(const QString &file : files)
+    {
+        if(!scriteDocument->openAnonymously(file))
+        {
+            qCritical("Cannot open %s", qPrintable(file));
+            ++nrMismatches;
+            continue;
+        }
+
+        QElapsedTimer timer;
+
+        timer.start();
+        const QStringList expected = pageBeginnings(scriteDocument, true);
+        const qint64 referenceTime = timer.elapsed();
+
+        timer.start();
+        const QStringList actual = pageBeginnings(scriteDocument, false);
+        const qint64 pageBreakerTime = timer.elapsed();
+
+        if(expected == actual)
+        {
+            qInfo("%s: %d pages, same page breaks. Reference %lld ms, ScreenplayPageBreaker %lld ms",
+                  qPrintable(file), expected.size(), referenceTime, pageBreakerTime);
+            continue;
+        }
+
+        ++nrMismatches;
+        qInfo("%s: %d pages with the reference, %d pages with ScreenplayPageBreaker",
+              qPrintable(file), expected.size(), actual.size());
+
+        for(int i=0; i<qMax(expected.size(), actual.size()); i++)
+        {
+            const QString e = expected.value(i);
+            const QString b = actual.value(i);
+            if(e == b)
+                continue;
+
+            qInfo("    Reference            : %s", qPrintable(e));
+            qInfo("    ScreenplayPageBreaker: %s", qPrintable(b));
+        }
+    }
+
+    return nrMismatches;
+}
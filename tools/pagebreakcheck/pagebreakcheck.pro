@@ -0,0 +1,23 @@
+# Builds Scrite's sources, less its main.cpp, along with the reference page breaker.
+SCRITE_ROOT = $$PWD/../..
+SCRITE_PRO = $$SCRITE_ROOT/scrite.pro
+
+QT += $$fromfile($$SCRITE_PRO, QT)
+DESTDIR = $$PWD/../../../Release/
+TARGET = pagebreakcheck
+CONFIG += console
+
+DEFINES += $$fromfile($$SCRITE_PRO, DEFINES)
+
+for(path, $$list($$fromfile($$SCRITE_PRO, INCLUDEPATH))): INCLUDEPATH += $$absolute_path($$path, $$SCRITE_ROOT)
+for(path, $$list($$fromfile($$SCRITE_PRO, HEADERS))): HEADERS += $$absolute_path($$path, $$SCRITE_ROOT)
+for(path, $$list($$fromfile($$SCRITE_PRO, SOURCES))): SOURCES += $$absolute_path($$path, $$SCRITE_ROOT)
+for(path, $$list($$fromfile($$SCRITE_PRO, RESOURCES))): RESOURCES += $$absolute_path($$path, $$SCRITE_ROOT)
+for(path, $$list($$fromfile($$SCRITE_PRO, OBJECTIVE_SOURCES))): OBJECTIVE_SOURCES += $$absolute_path($$path, $$SCRITE_ROOT)
+SOURCES -= $$absolute_path(main.cpp, $$SCRITE_ROOT)
+SOURCES -= $$absolute_path(src/document/screenplaytextdocument.cpp, $$SCRITE_ROOT)
+LIBS += $$fromfile($$SCRITE_PRO, LIBS)
+
+SOURCES += \
+    main.cpp \
+    referencepagebreaker.cpp
@@ -0,0 +1,185 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+/*
+ * ScreenplayPageBreaker and the page breaker below work with classes that are private to
+ * screenplaytextdocument.cpp. So this file compiles it, in place of Scrite's own copy,
+ * along with the page breaker below.
+ */
+#include "screenplaytextdocument.cpp"
+
+/**
+  This is how page breaks and MORE/CONT'D markers were decided before ScreenplayPageBreaker,
+  by asking the document where each page ends after every change made to it.
+  */
+static int includeMoreAndContdMarkersByHitTesting(QTextDocument *document, const ScreenplayPrintLayoutParams &params,
+                                                   const QAtomicInt *cancelled, const std::function<void(int,int)> &progress)
+{
+    const QTextFrameFormat rootFrameFormat = document->rootFrame()->frameFormat();
+    const QMarginsF pageMargins(rootFrameFormat.leftMargin(), rootFrameFormat.topMargin(),
+                                rootFrameFormat.rightMargin(), rootFrameFormat.bottomMargin());
+
+    QAbstractTextDocumentLayout *layout = document->documentLayout();
+    QTextCursor endCursor(document);
+    endCursor.movePosition(QTextCursor::End);
+
+    int nrPages = document->pageCount();
+    int pageIndex = params.titlePage ? 1 : 0;
+
+    QRectF paperRect(QPointF(0,0), document->pageSize());
+
+    auto insertPageBreakAfter = [](const QTextBlock &block) {
+        QTextBlockFormat blockFormat;
+        blockFormat.setPageBreakPolicy(QTextBlockFormat::PageBreak_AlwaysAfter);
+        QTextCursor cursor(block);
+        cursor.setPosition(block.position());
+        cursor.setPosition(block.position()+block.length()-1, QTextCursor::KeepAnchor);
+        cursor.mergeBlockFormat(blockFormat);
+        cursor.clearSelection();
+    };
+
+    auto insertMarkers = [&params](const QTextBlock &block) {
+        ScreenplayParagraphBlockData *blockData = ScreenplayParagraphBlockData::get(block);
+        if(blockData == nullptr)
+            return;
+
+        const QString characterName = blockData->getCharacterElementText();
+        if(characterName.isEmpty())
+            return;
+
+        QTextCursor cursor(block);
+        cursor.setPosition(block.position()+block.length()-1, QTextCursor::KeepAnchor);
+
+        QTextBlockFormat pageBreakFormat;
+        pageBreakFormat.setPageBreakPolicy(QTextBlockFormat::PageBreak_AlwaysAfter);
+        cursor.mergeBlockFormat(pageBreakFormat);
+        cursor.clearSelection();
+
+        cursor.insertText(QString(QChar::ObjectReplacementCharacter), params.moreMarkerFormats.value(blockData->elementType()));
+
+        cursor.insertBlock(params.characterBlockFormat, params.characterCharFormat);
+        Q_FOREACH(ScreenplayParagraphBlockData::TextRun run, blockData->characterElementTextRuns())
+        {
+            QTextCharFormat format;
+            format.setFontFamily(run.fontFamily);
+            cursor.mergeCharFormat(format);
+            cursor.insertText(run.text);
+        }
+
+        cursor.insertText(QString(QChar::ObjectReplacementCharacter), params.contdMarkerFormat);
+    };
+
+    while(pageIndex < nrPages)
+    {
+        if(cancelled != nullptr && cancelled->loadAcquire())
+            break;
+
+        if(progress)
+            progress(pageIndex, nrPages);
+
+        paperRect = QRectF(0, pageIndex*paperRect.height(), paperRect.width(), paperRect.height());
+        const QRectF contentsRect = paperRect.adjusted(pageMargins.left(), pageMargins.top(), -pageMargins.right(), -pageMargins.bottom());
+        const int lastPosition = pageIndex == nrPages-1 ? endCursor.position() : layout->hitTest(contentsRect.bottomRight(), Qt::FuzzyHit);
+
+        QTextCursor cursor(document);
+        cursor.setPosition(lastPosition-1);
+
+        QTextBlock block = cursor.block();
+        ScreenplayParagraphBlockData *blockData = ScreenplayParagraphBlockData::get(block);
+        if(blockData == nullptr)
+        {
+            block = block.previous();
+            blockData = ScreenplayParagraphBlockData::get(block);
+        }
+
+        if(blockData)
+        {
+            switch(blockData->elementType())
+            {
+            case SceneElement::Character:
+                if(blockData->isFirstElementInScene())
+                    block = block.previous();
+                insertPageBreakAfter(block.previous());
+                break;
+            case SceneElement::Heading:
+                insertPageBreakAfter(block.previous());
+                break;
+            case SceneElement::Transition:
+            case SceneElement::Shot:
+            case SceneElement::Action:
+                break; // do nothing for these
+            case SceneElement::Parenthetical: {
+                QTextBlock previousBlock = block.previous();
+                ScreenplayParagraphBlockData *previousBlockData = ScreenplayParagraphBlockData::get(previousBlock);
+                if(previousBlockData) {
+                    if(previousBlockData->elementType() == SceneElement::Character) {
+                        previousBlock = previousBlock.previous();
+                        insertPageBreakAfter(previousBlock);
+                    } else if(previousBlockData->elementType() == SceneElement::Dialogue) {
+                        insertMarkers(previousBlock);
+                    }
+                }
+                } break;
+            case SceneElement::Dialogue:
+                if(block.position()+block.length()-1 > lastPosition) {
+                    cursor.movePosition(QTextCursor::StartOfBlock, QTextCursor::KeepAnchor, 1);
+
+                    QString blockTextPart1 = cursor.selectedText();
+                    blockTextPart1.chop(params.nrCharsPerDialogLine);
+                    while(blockTextPart1.length() && !blockTextPart1.at(blockTextPart1.length()-1).isSpace())
+                        blockTextPart1.chop(1);
+                    blockTextPart1.chop(1);
+
+                    // if(blockTextPart1.length() < nrCharsPerDialogLine) {
+                    if(blockTextPart1.isEmpty()) {
+                        QTextBlock previousBlock = block.previous();
+                        ScreenplayParagraphBlockData *previousBlockData = ScreenplayParagraphBlockData::get(previousBlock);
+                        if(previousBlockData && previousBlockData->elementType() == SceneElement::Character) {
+                            if(previousBlockData->isFirstElementInScene())
+                                previousBlock = previousBlock.previous();
+                            insertPageBreakAfter(previousBlock.previous());
+                            break;
+                        }
+                    }
+
+                    // Split the paragraph in place, at the space between blockTextPart1 and the
+                    // rest of it, so that both parts keep the fonts they were formatted with.
+                    const ScreenplayParagraphBlockData dialogBlockData(*blockData);
+
+                    cursor.clearSelection();
+                    cursor.setPosition(block.position()+blockTextPart1.length());
+                    if(!blockTextPart1.isEmpty())
+                        cursor.setPosition(cursor.position()+1, QTextCursor::KeepAnchor);
+                    cursor.insertBlock(params.dialogueBlockFormat, params.dialogueCharFormat);
+
+                    block = cursor.block();
+                    block.setUserData(new ScreenplayParagraphBlockData(dialogBlockData));
+                    block.previous().setUserData(new ScreenplayParagraphBlockData(dialogBlockData));
+
+                    insertMarkers(block.previous());
+                }
+                break;
+            }
+        }
+
+        nrPages = layout->pageCount();
+        ++pageIndex;
+    }
+
+    return nrPages;
+}
+
+void setReferencePageBreakerEnabled(bool val)
+{
+    referencePageBreaker = val ? &includeMoreAndContdMarkersByHitTesting : nullptr;
+}
@@ -0,0 +1,154 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include <QtCore>
+
+#include "textmatcher.h"
+
+/**
+ * Compares the time taken to find all occurrences of a string in screenplay text
+ * using QString::indexOf() in a loop, which is what SearchEngine used to do, and
+ * using TextMatcher.
+ *
+ * Paragraphs are searched one at a time, just like SearchEngine does. They are
+ * read from a plain text or Fountain export of a real screenplay, one per line.
+ * If no file is given, a synthetic screenplay is used instead.
+ *
+ *     searchbench --file screenplay.fountain --string "the" --iterations 10
+ *
+ * NOTE: Most developers will never have to build this program ever.
+ */
+
+static QStringList syntheticParagraphs(int nrScenes)
+{
+    static const QStringList paragraphs = {
+        QStringLiteral("The door creaks open. A sliver of light cuts across the dusty floor."),
+        QStringLiteral("RAGHAV"),
+        QStringLiteral("I told you we should have waited until morning, but nobody ever listens to me."),
+        QStringLiteral("(whispering)"),
+        QStringLiteral("She steps inside, scanning the room, her hand never leaving the torch.")
+    };
+
+    QStringList ret;
+    for(int i=0; i<nrScenes; i++)
+    {
+        ret << QStringLiteral("INT. WAREHOUSE %1 - NIGHT").arg(i+1);
+
+        const int nrElements = 10 + i%6;
+        for(int j=0; j<nrElements; j++)
+            ret << paragraphs.at(j%paragraphs.size());
+    }
+
+    return ret;
+}
+
+static int indexOfLoop(const QString &of, const QString &in)
+{
+    int ret = 0;
+    int from = 0;
+    while(1)
+    {
+        const int pos = in.indexOf(of, from, Qt::CaseInsensitive);
+        if(pos < 0)
+            break;
+
+        ++ret;
+        from = pos + of.length();
+    }
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+
+    QCommandLineOption fileOption("file", "Plain text or Fountain file with screenplay text.", "file");
+    parser.addOption(fileOption);
+
+    QCommandLineOption stringOption("string", "String to search for. Default is \"the\".", "string");
+    parser.addOption(stringOption);
+
+    QCommandLineOption iterationsOption("iterations", "Number of times to search. Default is 10.", "count");
+    parser.addOption(iterationsOption);
+
+    parser.addHelpOption();
+
+    parser.process(a);
+
+    QStringList paragraphs;
+    if(parser.isSet(fileOption))
+    {
+        QFile file(parser.value(fileOption));
+        if(!file.open(QFile::ReadOnly))
+        {
+            qCritical("Cannot open %s", qPrintable(file.fileName()));
+            return 1;
+        }
+
+        QTextStream ts(&file);
+        ts.setCodec("utf-8");
+        paragraphs = ts.readAll().split(QChar('\n'), QString::SkipEmptyParts);
+    }
+    else
+        paragraphs = syntheticParagraphs(5000);
+
+    const QString string = parser.isSet(stringOption) ? parser.value(stringOption) : QStringLiteral("the");
+    const int nrIterations = parser.isSet(iterationsOption) ? qMax(1, parser.value(iterationsOption).toInt()) : 10;
+
+    int nrCharacters = 0;
+    for(const QString &paragraph : qAsConst(paragraphs))
+        nrCharacters += paragraph.length();
+
+    qInfo("Searching %d paragraphs (%d characters) for \"%s\", %d times.",
+          paragraphs.size(), nrCharacters, qPrintable(string), nrIterations);
+
+    QElapsedTimer timer;
+    qint64 indexOfTime = 0, matcherTime = 0, wholeWordsTime = 0;
+    for(int i=0; i<nrIterations; i++)
+    {
+        int indexOfCount = 0, matcherCount = 0, wholeWordsCount = 0;
+
+        timer.start();
+        for(const QString &paragraph : qAsConst(paragraphs))
+            indexOfCount += indexOfLoop(string, paragraph);
+        const qint64 t1 = timer.nsecsElapsed();
+
+        timer.start();
+        const TextMatcher matcher(string);
+        for(const QString &paragraph : qAsConst(paragraphs))
+            matcherCount += matcher.ranges(paragraph).size();
+        const qint64 t2 = timer.nsecsElapsed();
+
+        timer.start();
+        const TextMatcher wholeWordsMatcher(string, Qt::CaseInsensitive, true);
+        for(const QString &paragraph : qAsConst(paragraphs))
+            wholeWordsCount += wholeWordsMatcher.ranges(paragraph).size();
+        const qint64 t3 = timer.nsecsElapsed();
+
+        qInfo("  Iteration %d: indexOf %.2f ms (%d), TextMatcher %.2f ms (%d), whole words %.2f ms (%d)", i+1,
+              double(t1)/1e6, indexOfCount, double(t2)/1e6, matcherCount, double(t3)/1e6, wholeWordsCount);
+        indexOfTime += t1;
+        matcherTime += t2;
+        wholeWordsTime += t3;
+    }
+
+    qInfo("Average: indexOf %.2f ms, TextMatcher %.2f ms, whole words %.2f ms",
+          double(indexOfTime)/double(nrIterations)/1e6,
+          double(matcherTime)/double(nrIterations)/1e6,
+          double(wholeWordsTime)/double(nrIterations)/1e6);
+
+    return 0;
+}
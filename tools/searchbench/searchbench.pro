@@ -0,0 +1,13 @@
+QT += core
+DESTDIR = $$PWD/../../../Release/
+TARGET = searchbench
+CONFIG += console
+
+INCLUDEPATH += $$PWD/../../src/utils
+
+HEADERS += \
+    ../../src/utils/textmatcher.h
+
+SOURCES += \
+    main.cpp \
+    ../../src/utils/textmatcher.cpp
@@ -0,0 +1,251 @@
+/****************************************************************************
+**
+** Copyright (C) TERIFLIX Entertainment Spaces Pvt. Ltd. Bengaluru
+** Author: Prashanth N Udupa (prashanth.udupa@teriflix.com)
+**
+** This code is distributed under GPL v3. Complete text of the license
+** can be found here: https://www.gnu.org/licenses/gpl-3.0.txt
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+****************************************************************************/
+
+#include <QtCore>
+#include <QColor>
+#include <QQmlListProperty>
+
+#include "qobjectserializer.h"
+
+/**
+ * Measures the time taken by QObjectSerializer to serialize and deserialize a
+ * synthetic document, whose shape is similar to that of a Scrite document: a few
+ * thousand scenes, each with a heading and a dozen or so paragraphs.
+ *
+ * This program makes use of the public QObjectSerializer API only, so it can be
+ * built against older revisions of src/utils/qobjectserializer.cpp too. That makes
+ * it possible to compare timings before and after a change to the serializer.
+ *
+ * Loading is timed from bytes, once from JSON text and once from the CBOR form
+ * stored in binary headers, so that the two can be compared. Revisions of the
+ * serializer without QObjectSerializer::fromCbor() don't define
+ * QOBJECTSERIALIZER_HAS_FROMCBOR, and only JSON is timed against them.
+ *
+ *     serializerbench --scenes 5000 --iterations 5
+ *
+ * NOTE: Most developers will never have to build this program ever.
+ */
+
+class BenchElement : public QObject
+{
+    Q_OBJECT
+
+public:
+    Q_INVOKABLE BenchElement(QObject *parent=nullptr) : QObject(parent) { }
+    ~BenchElement() { }
+
+    enum Type { Action, Character, Dialogue, Parenthetical, Shot, Transition };
+    Q_ENUM(Type)
+
+    Q_PROPERTY(Type type READ type WRITE setType)
+    void setType(Type val) { m_type = val; }
+    Type type() const { return m_type; }
+
+    Q_PROPERTY(QString id READ id WRITE setId)
+    void setId(const QString &val) { m_id = val; }
+    QString id() const { return m_id; }
+
+    Q_PROPERTY(QString text READ text WRITE setText)
+    void setText(const QString &val) { m_text = val; }
+    QString text() const { return m_text; }
+
+    Q_PROPERTY(int cursorPosition READ cursorPosition WRITE setCursorPosition STORED false)
+    void setCursorPosition(int val) { m_cursorPosition = val; }
+    int cursorPosition() const { return m_cursorPosition; }
+
+private:
+    Type m_type = Action;
+    QString m_id;
+    QString m_text;
+    int m_cursorPosition = -1;
+};
+
+class BenchScene : public QObject
+{
+    Q_OBJECT
+
+public:
+    Q_INVOKABLE BenchScene(QObject *parent=nullptr) : QObject(parent) { }
+    ~BenchScene() { }
+
+    Q_PROPERTY(QString id READ id WRITE setId)
+    void setId(const QString &val) { m_id = val; }
+    QString id() const { return m_id; }
+
+    Q_PROPERTY(QString heading READ heading WRITE setHeading)
+    void setHeading(const QString &val) { m_heading = val; }
+    QString heading() const { return m_heading; }
+
+    Q_PROPERTY(QColor color READ color WRITE setColor)
+    void setColor(const QColor &val) { m_color = val; }
+    QColor color() const { return m_color; }
+
+    Q_PROPERTY(QRectF geometry READ geometry WRITE setGeometry)
+    void setGeometry(const QRectF &val) { m_geometry = val; }
+    QRectF geometry() const { return m_geometry; }
+
+    Q_PROPERTY(QStringList tags READ tags WRITE setTags)
+    void setTags(const QStringList &val) { m_tags = val; }
+    QStringList tags() const { return m_tags; }
+
+    Q_PROPERTY(QJsonObject userData READ userData WRITE setUserData)
+    void setUserData(const QJsonObject &val) { m_userData = val; }
+    QJsonObject userData() const { return m_userData; }
+
+    Q_PROPERTY(QQmlListProperty<BenchElement> elements READ elements)
+    QQmlListProperty<BenchElement> elements() { return QQmlListProperty<BenchElement>(this, m_elements); }
+
+    void addElement(BenchElement *element) { element->setParent(this); m_elements.append(element); }
+
+private:
+    QString m_id;
+    QString m_heading;
+    QColor m_color;
+    QRectF m_geometry;
+    QStringList m_tags;
+    QJsonObject m_userData;
+    QList<BenchElement*> m_elements;
+};
+
+class BenchDocument : public QObject
+{
+    Q_OBJECT
+
+public:
+    Q_INVOKABLE BenchDocument(QObject *parent=nullptr) : QObject(parent) { }
+    ~BenchDocument() { }
+
+    Q_PROPERTY(QString title READ title WRITE setTitle)
+    void setTitle(const QString &val) { m_title = val; }
+    QString title() const { return m_title; }
+
+    Q_PROPERTY(QQmlListProperty<BenchScene> scenes READ scenes)
+    QQmlListProperty<BenchScene> scenes() { return QQmlListProperty<BenchScene>(this, m_scenes); }
+
+    void addScene(BenchScene *scene) { scene->setParent(this); m_scenes.append(scene); }
+
+private:
+    QString m_title;
+    QList<BenchScene*> m_scenes;
+};
+
+static void populate(BenchDocument *document, int nrScenes)
+{
+    static const QStringList paragraphs = {
+        QStringLiteral("The door creaks open. A sliver of light cuts across the dusty floor."),
+        QStringLiteral("RAGHAV"),
+        QStringLiteral("I told you we should have waited until morning, but nobody ever listens to me."),
+        QStringLiteral("(whispering)"),
+        QStringLiteral("She steps inside, scanning the room, her hand never leaving the torch.")
+    };
+
+    document->setTitle(QStringLiteral("Synthetic Screenplay"));
+    for(int i=0; i<nrScenes; i++)
+    {
+        BenchScene *scene = new BenchScene;
+        scene->setId(QUuid::createUuid().toString());
+        scene->setHeading(QStringLiteral("INT. WAREHOUSE %1 - NIGHT").arg(i+1));
+        scene->setColor(QColor::fromHsv(i%360, 128, 255));
+        scene->setGeometry(QRectF(i%50*120, i/50*80, 100, 60));
+        scene->setTags({QStringLiteral("act%1").arg(i%3+1), QStringLiteral("night")});
+
+        const int nrElements = 10 + i%6;
+        for(int j=0; j<nrElements; j++)
+        {
+            BenchElement *element = new BenchElement;
+            element->setId(QUuid::createUuid().toString());
+            element->setType(BenchElement::Type(j%5));
+            element->setText(paragraphs.at(j%paragraphs.size()));
+            scene->addElement(element);
+        }
+
+        document->addScene(scene);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+
+    QCommandLineOption scenesOption("scenes", "Number of scenes in the synthetic document. Default is 5000.", "count");
+    parser.addOption(scenesOption);
+
+    QCommandLineOption iterationsOption("iterations", "Number of times to serialize and deserialize. Default is 5.", "count");
+    parser.addOption(iterationsOption);
+
+    parser.addHelpOption();
+
+    parser.process(a);
+
+    const int nrScenes = parser.isSet(scenesOption) ? qMax(1, parser.value(scenesOption).toInt()) : 5000;
+    const int nrIterations = parser.isSet(iterationsOption) ? qMax(1, parser.value(iterationsOption).toInt()) : 5;
+
+    BenchDocument document;
+    populate(&document, nrScenes);
+
+    qInfo("Serializing a document with %d scenes, %d times.", nrScenes, nrIterations);
+
+    QElapsedTimer timer;
+    qint64 toJsonTime = 0, fromJsonTime = 0;
+#ifdef QOBJECTSERIALIZER_HAS_FROMCBOR
+    qint64 fromCborTime = 0;
+#endif
+    for(int i=0; i<nrIterations; i++)
+    {
+        timer.start();
+        const QJsonObject json = QObjectSerializer::toJson(&document);
+        const qint64 t1 = timer.nsecsElapsed();
+
+        const QByteArray jsonBytes = QJsonDocument(json).toJson();
+
+        BenchDocument copy;
+        timer.start();
+        QObjectSerializer::fromJson(QJsonDocument::fromJson(jsonBytes).object(), &copy);
+        const qint64 t2 = timer.nsecsElapsed();
+
+        toJsonTime += t1;
+        fromJsonTime += t2;
+
+#ifdef QOBJECTSERIALIZER_HAS_FROMCBOR
+        const QByteArray cborBytes = QCborValue::fromJsonValue(json).toCbor();
+
+        BenchDocument copy2;
+        timer.start();
+        QObjectSerializer::fromCbor(QCborValue::fromCbor(cborBytes).toMap(), &copy2);
+        const qint64 t3 = timer.nsecsElapsed();
+
+        fromCborTime += t3;
+
+        qInfo("  Iteration %d: toJson %.2f ms, fromJson %.2f ms, fromCbor %.2f ms", i+1, double(t1)/1e6, double(t2)/1e6, double(t3)/1e6);
+#else
+        qInfo("  Iteration %d: toJson %.2f ms, fromJson %.2f ms", i+1, double(t1)/1e6, double(t2)/1e6);
+#endif
+    }
+
+#ifdef QOBJECTSERIALIZER_HAS_FROMCBOR
+    qInfo("Average: toJson %.2f ms, fromJson %.2f ms, fromCbor %.2f ms",
+          double(toJsonTime)/double(nrIterations)/1e6,
+          double(fromJsonTime)/double(nrIterations)/1e6,
+          double(fromCborTime)/double(nrIterations)/1e6);
+#else
+    qInfo("Average: toJson %.2f ms, fromJson %.2f ms",
+          double(toJsonTime)/double(nrIterations)/1e6,
+          double(fromJsonTime)/double(nrIterations)/1e6);
+#endif
+
+    return 0;
+}
+
+#include "main.moc"
@@ -0,0 +1,14 @@
+QT += core gui qml
+DESTDIR = $$PWD/../../../Release/
+TARGET = serializerbench
+CONFIG += console
+
+INCLUDEPATH += $$PWD/../../src/utils
+
+HEADERS += \
+    ../../src/utils/qobjectfactory.h \
+    ../../src/utils/qobjectserializer.h
+
+SOURCES += \
+    main.cpp \
+    ../../src/utils/qobjectserializer.cpp